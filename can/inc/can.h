@@ -25,6 +25,9 @@ typedef struct CanStorage {
 // Initializes the specified CAN configuration.
 StatusCode can_init(CanStorage *storage, const CanSettings *settings);
 
+// Device ID from the CAN settings, CAN_MSG_INVALID_DEVICE before can_init
+uint16_t can_get_device_id(void);
+
 // Adds a hardware filter in for the specified message ID.
 StatusCode can_add_filter_in(CanMessageId msg_id);
 
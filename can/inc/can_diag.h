@@ -0,0 +1,47 @@
+#pragma once
+// CAN diagnostics
+//
+// Diagnostic frames are raw frames which every board sends on message ID CAN_DIAG_MSG_ID, which
+// codegen leaves unused, so they don't need to be declared in each board's yaml. The frame ID
+// follows the codegen layout for non-critical messages, with the sender's device ID in the low
+// bits. The first byte of the payload is the CanDiagType.
+#include <stdint.h>
+
+#include "can_msg.h"
+#include "status.h"
+
+#define CAN_DIAG_MSG_ID 63
+#define CAN_DIAG_ID(device_id) ((CAN_DIAG_MSG_ID << 5) + (device_id))
+
+typedef enum {
+  // [1] MasterCycle, [2:3] max start delay, [4:5] max execution time, [6:7] min slack
+  // Times are in microseconds, saturated at UINT16_MAX. A min slack of 0 means an overrun.
+  CAN_DIAG_MASTER_CYCLE = 0,
+  // [1] task number, [2:3] CPU share of the last window in 0.01%, [4:5] stack high-water mark in
+  // words, [6:7] run time in the last window in ms
+  CAN_DIAG_TASK_STATS,
+  // [1] queue index, [2:3] peak items, [4:5] capacity, [6:7] items waiting
+  CAN_DIAG_QUEUE_STATS,
+  // [1] sequence number, [2:7] the next 6 bytes of the trace.h event stream
+  CAN_DIAG_TRACE,
+  // [1] boot phase, [2:4] start and [5:7] duration in microseconds, saturated at 2^24 - 1
+  CAN_DIAG_BOOT_PHASE,
+  // [1] boot phase, [2:7] the first 6 characters of its name, padded with zeros
+  CAN_DIAG_BOOT_NAME,
+  NUM_CAN_DIAG_TYPES,
+} CanDiagType;
+
+// Sends one CAN_DIAG_MASTER_CYCLE frame for each cycle class which has run
+StatusCode can_diag_tx_master_cycles(void);
+
+// Updates the run-time stats and sends a CAN_DIAG_TASK_STATS frame for each task and a
+// CAN_DIAG_QUEUE_STATS frame for each queue
+// Returns STATUS_CODE_UNIMPLEMENTED unless built with MS_RUN_TIME_STATS.
+StatusCode can_diag_tx_run_time_stats(void);
+
+// Sends a CAN_DIAG_BOOT_NAME and a CAN_DIAG_BOOT_PHASE frame for each boot phase recorded so far
+StatusCode can_diag_tx_boot(void);
+
+// Drains up to max_events trace events as CAN_DIAG_TRACE frames, two frames per event
+// Returns STATUS_CODE_UNIMPLEMENTED unless built with MS_TRACE.
+StatusCode can_diag_tx_trace(uint32_t max_events);
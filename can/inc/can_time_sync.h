@@ -0,0 +1,72 @@
+#pragma once
+// CAN time synchronisation
+//
+// One board (the master) periodically broadcasts its local microsecond clock in a raw frame.
+// Every other board timestamps the frame as it is received (in the CAN RX interrupt, or the RX
+// thread on x86), estimates its offset and clock drift against the master, and exposes a
+// car-wide time base with can_time_us().
+//
+// Corrections are slewed by adjusting the rate of the car clock, so it stays monotonic. Only the
+// first sync, or an error above CAN_TIME_SYNC_STEP_THRESHOLD_US, steps the clock.
+//
+// can_init() sets every board up as a slave and processes sync frames in the CAN RX task.
+// The master calls can_time_sync_set_master() once and can_time_sync_tx() periodically.
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "can_hw.h"
+#include "status.h"
+
+// Raw ID of the sync frame, in the critical range so it wins arbitration with little delay
+#define CAN_TIME_SYNC_ID 7
+// Frame payload: master time in the low 56 bits, sequence number in the top 8
+#define CAN_TIME_SYNC_TIME_MASK ((1ULL << 56) - 1)
+#define CAN_TIME_SYNC_SEQ_SHIFT 56
+
+// Errors larger than this step the clock instead of slewing it
+#define CAN_TIME_SYNC_STEP_THRESHOLD_US 5000
+// Bounds on the estimated drift and the temporary rate used to slew out an offset, in ppb
+#define CAN_TIME_SYNC_MAX_DRIFT_PPB 1000000
+#define CAN_TIME_SYNC_MAX_SLEW_PPB 10000000
+// Number of syncs the drift is measured across
+#define CAN_TIME_SYNC_DRIFT_WINDOW 16
+// Syncs ignored for the error statistics while the estimate settles
+#define CAN_TIME_SYNC_SETTLE_SYNCS CAN_TIME_SYNC_DRIFT_WINDOW
+
+typedef struct CanTimeSyncStats {
+  uint32_t num_syncs;  // Sync frames applied
+  uint32_t num_steps;  // Syncs which stepped the clock instead of slewing it
+  uint32_t num_missed;  // Sync frames lost, from gaps in the sequence number
+  int32_t last_error_us;  // Master time - car time when the last sync frame arrived
+  uint32_t max_error_us;  // Largest |error| once settled
+  uint32_t mean_error_us;  // Mean |error| once settled
+  int32_t drift_ppb;  // Estimated rate of the master clock relative to the local clock
+  int64_t offset_us;  // Car time - local time
+} CanTimeSyncStats;
+
+// Resets the sync state, called by can_init
+void can_time_sync_init(const CanSettings *settings);
+
+// Makes this board the time master: its local clock becomes car time
+void can_time_sync_set_master(bool master);
+
+// Broadcasts the master's clock, call periodically on the master
+StatusCode can_time_sync_tx(void);
+
+// Timestamps a received sync frame, called from the CAN HW RX path (interrupt context on ARM)
+void can_time_sync_rx_handler(uint64_t data);
+
+// Applies the last received sync frame, called from the CAN RX task
+void can_time_sync_process(void);
+
+// Car-wide monotonic time in microseconds
+// Before the first sync this is the local clock. Must be called from a task.
+uint64_t can_time_us(void);
+
+// Converts a local timestamp_us() value to car time
+uint64_t can_time_from_local_us(uint64_t local_us);
+
+// Whether this board is the master or has received a sync frame
+bool can_time_is_synced(void);
+
+StatusCode can_time_sync_get_stats(CanTimeSyncStats *stats);
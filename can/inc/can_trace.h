@@ -0,0 +1,61 @@
+#pragma once
+// CAN command latency tracing
+//
+// A traced message carries a 16 bit tag in its last two bytes: the car time (can_time_us())
+// it was sampled at, in units of CAN_TRACE_TAG_UNIT_US. Every board handling the message
+// records the car time since the sample at each hop it passes through, so the hops on different
+// boards share one time base. Each hop keeps a histogram of its latency from the sample.
+// Nothing is recorded until can_time_is_synced(), and a hop the car clock puts before its sample
+// is counted as clock skew rather than recorded.
+//
+// can.c records the TX enqueue, bus (RX interrupt) and RX decode hops of the traced message.
+// Application code tags the message with can_trace_tag() and records any further hops itself.
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "can_msg.h"
+#include "histogram.h"
+#include "status.h"
+
+#define CAN_TRACE_TAG_SHIFT 5
+#define CAN_TRACE_TAG_UNIT_US (1 << CAN_TRACE_TAG_SHIFT)
+#define CAN_TRACE_TAG_MASK 0xFFFF
+// Frames received between two RX task cycles that can be timestamped
+#define CAN_TRACE_RX_SLOTS 16
+
+typedef enum {
+  CAN_TRACE_HOP_TX_ENQUEUE = 0,  // Passed to the CAN HW by the sender
+  CAN_TRACE_HOP_BUS,  // Received off the bus, in the RX interrupt
+  CAN_TRACE_HOP_RX_DECODE,  // Popped from the RX queue and decoded
+  CAN_TRACE_HOP_MCP2515_TX,  // Forwarded to the motor controllers by the MCP2515
+  NUM_CAN_TRACE_HOPS,
+} CanTraceHop;
+
+// Traces the given message ID. Tracing is disabled until this is called.
+StatusCode can_trace_init(CanMessageId msg_id);
+
+// Tag for a command sampled now
+uint16_t can_trace_tag(void);
+
+// Records the latency of the given hop for the command with this tag
+// Repeats of the last tag seen by a hop are ignored, so a command is counted once per hop.
+// Hops after RX decode are ignored until a traced message has been received.
+StatusCode can_trace_record(CanTraceHop hop, uint16_t tag);
+
+// Called by can_transmit
+void can_trace_tx(const CanMessage *msg);
+
+// Called from the CAN HW RX path (interrupt context on ARM)
+void can_trace_rx_handler(const CanMessage *msg);
+
+// Called by can_receive
+void can_trace_rx(const CanMessage *msg);
+
+StatusCode can_trace_get_histogram(CanTraceHop hop, Histogram *hist);
+
+// Hops left out of the histograms because they came before their sample
+uint32_t can_trace_num_skewed(void);
+
+// Logs the histogram of every hop which has recorded samples. Boards only call it every slow
+// cycle when built with --define=MS_CAN_TRACE_LOG.
+void can_trace_log(void);
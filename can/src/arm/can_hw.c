@@ -2,6 +2,8 @@
 
 #include <string.h>
 
+#include "can_time_sync.h"
+#include "can_trace.h"
 #include "log.h"
 #include "stm32f10x.h"
 #include "stm32f10x_interrupt.h"
@@ -221,6 +223,12 @@ void USB_LP_CAN1_RX0_IRQHandler(void) {
         NVIC_SystemReset();
         while(1);
       }
+      // Timestamp sync frames as close to reception as possible
+      if (rx_msg.id.raw == CAN_TIME_SYNC_ID) {
+        can_time_sync_rx_handler(rx_msg.data);
+        CAN_ClearITPendingBit(CAN_HW_BASE, CAN_IT_FMP0);
+        return;
+      }
       // check id against filter out, if matches any filter in filter out then dont push
       bool s_filter_id_match = false;
       for (int i = 0; i < CAN_HW_NUM_FILTER_BANKS; i++) {
@@ -231,6 +239,7 @@ void USB_LP_CAN1_RX0_IRQHandler(void) {
       }
       // If filter match, do not push to rx queue
       if (!s_filter_id_match) {
+        can_trace_rx_handler(&rx_msg);
         can_queue_push_from_isr(s_g_rx_queue, &rx_msg, &higher_woken);
       }
     }
@@ -253,6 +262,12 @@ void CAN1_RX1_IRQHandler(void) {
         NVIC_SystemReset();
         while(1);
       }
+      // Timestamp sync frames as close to reception as possible
+      if (rx_msg.id.raw == CAN_TIME_SYNC_ID) {
+        can_time_sync_rx_handler(rx_msg.data);
+        CAN_ClearITPendingBit(CAN_HW_BASE, CAN_IT_FMP1);
+        return;
+      }
 
       // check id against filter out, if matches any filter in filter out then dont push
       bool s_filter_id_match = false;
@@ -264,6 +279,7 @@ void CAN1_RX1_IRQHandler(void) {
       }
       // If filter match, do not push to rx queue
       if (!s_filter_id_match) {
+        can_trace_rx_handler(&rx_msg);
         can_queue_push_from_isr(s_g_rx_queue, &rx_msg, &higher_woken);
       }
     }
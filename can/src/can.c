@@ -4,9 +4,13 @@
 #include "event_groups.h"
 // #include "can.h"
 #include "can_codegen.h"
+#include "can_time_sync.h"
+#include "can_trace.h"
 #include "can_watchdog.h"
 
+#include "boot.h"
 #include "log.h"
+#include "trace.h"
 
 rx_struct g_rx_struct;
 tx_struct g_tx_struct;
@@ -25,6 +29,7 @@ TASK(CAN_RX, TASK_STACK_256)
     LOG_DEBUG("can_rx called: %d!\n", counter);
     counter++;
 
+    can_time_sync_process();
     can_rx_all();
 
     send_task_end();
@@ -52,6 +57,7 @@ TASK(CAN_TX, TASK_STACK_256)
 
 StatusCode run_can_rx_cycle()
 {
+  tasks_expect_end(CAN_RX);
   StatusCode ret = notify(CAN_RX, 1);
   if (ret == pdFALSE) {
     return STATUS_CODE_INTERNAL_ERROR;
@@ -62,6 +68,7 @@ StatusCode run_can_rx_cycle()
 
 StatusCode run_can_tx_cycle()
 {
+  tasks_expect_end(CAN_TX);
   StatusCode ret = notify(CAN_TX, 1);
 
   if (ret == pdFALSE) {
@@ -92,6 +99,7 @@ StatusCode can_init(CanStorage *storage, const CanSettings *settings)
  
   // Initialize hardware settings
   status_ok_or_return(can_hw_init(&s_can_storage->rx_queue, settings));
+  can_time_sync_init(settings);
 
   if (settings->mode == CAN_CONTINUOUS){
     // Create RX and TX Tasks 
@@ -102,10 +110,22 @@ StatusCode can_init(CanStorage *storage, const CanSettings *settings)
   return STATUS_CODE_OK;
 }
 
+uint16_t can_get_device_id(void)
+{
+  if (s_can_storage == NULL) {
+    return CAN_MSG_INVALID_DEVICE;
+  }
+  return s_can_storage->device_id;
+}
+
 StatusCode can_receive(const CanMessage *msg)
 {
   // TODO: Figure out the ack_request
   StatusCode ret = can_queue_pop(&s_can_storage->rx_queue, msg);
+  if (ret == STATUS_CODE_OK) {
+    can_trace_rx(msg);
+    TRACE_EVENT(TRACE_EVENT_CAN_RX, msg->dlc, msg->id.raw);
+  }
 
   // if (ret == STATUS_CODE_OK)
   // {
@@ -124,15 +144,17 @@ StatusCode can_transmit(const CanMessage *msg)
     return status_code(STATUS_CODE_UNINITIALIZED);
   }
 
+  static bool s_sent = false;
+  if (!__atomic_exchange_n(&s_sent, true, __ATOMIC_RELAXED)) {
+    boot_mark("first CAN TX");
+  }
+
+  can_trace_tx(msg);
+  TRACE_EVENT(TRACE_EVENT_CAN_TX, msg->dlc, msg->id.raw);
   return can_hw_transmit(msg->id.raw, msg->extended, msg->data_u8, msg->dlc);
 }
 
 StatusCode can_add_filter_in(CanMessageId msg_id) {
-  //check if s_can_filter_in_en has been set
-  if (s_can_filter_in_en == 0){
-    s_can_filter_in_en = 1;
-  }
-
   if (s_can_storage == NULL) {
     return status_code(STATUS_CODE_UNINITIALIZED);
   } else if (msg_id >= CAN_MSG_MAX_IDS) {
@@ -141,10 +163,17 @@ StatusCode can_add_filter_in(CanMessageId msg_id) {
     return status_msg(STATUS_CODE_UNINITIALIZED, "CAN: CAN filter out is enabled already");
   }
 
-  CanId can_id = { .raw = msg_id };
   CanId mask = { 0 };
   mask.raw = (uint32_t)~mask.msg_id;
 
+  //check if s_can_filter_in_en has been set
+  if (s_can_filter_in_en == 0){
+    s_can_filter_in_en = 1;
+    // Filtering in drops everything else, keep receiving time sync frames
+    status_ok_or_return(can_hw_add_filter_in(mask.raw, CAN_TIME_SYNC_ID, false));
+  }
+
+  CanId can_id = { .raw = msg_id };
   return can_hw_add_filter_in(mask.raw, can_id.raw, false);
 }
 
@@ -0,0 +1,118 @@
+#include "can_diag.h"
+
+#include <string.h>
+
+#include "boot.h"
+#include "can.h"
+#include "master_task.h"
+#include "can_hw.h"
+#include "run_time_stats.h"
+#include "trace.h"
+
+// Trace stream bytes carried by each CAN_DIAG_TRACE frame
+#define CAN_DIAG_TRACE_BYTES 6
+// Name bytes carried by each CAN_DIAG_BOOT_NAME frame
+#define CAN_DIAG_BOOT_NAME_BYTES 6
+#define CAN_DIAG_U24_MAX 0xFFFFFF
+
+static uint8_t s_trace_seq;
+
+static CanMessage prv_diag_msg(CanDiagType type, uint8_t index) {
+  CanMessage msg = {
+    .id.raw = CAN_DIAG_ID(can_get_device_id()),
+    .dlc = 8,
+  };
+  msg.data_u8[0] = type;
+  msg.data_u8[1] = index;
+  return msg;
+}
+
+static uint16_t prv_saturate(uint32_t value) {
+  return (value > UINT16_MAX) ? UINT16_MAX : value;
+}
+
+// Little-endian, like the rest of the payload
+static void prv_put_u24(uint8_t *data, uint32_t value) {
+  if (value > CAN_DIAG_U24_MAX) {
+    value = CAN_DIAG_U24_MAX;
+  }
+  data[0] = value & 0xFF;
+  data[1] = (value >> 8) & 0xFF;
+  data[2] = (value >> 16) & 0xFF;
+}
+
+StatusCode can_diag_tx_master_cycles(void) {
+  // Too large for the calling task's stack
+  static MasterCycleStats stats;
+
+  for (uint8_t i = 0; i < NUM_MASTER_CYCLES; ++i) {
+    status_ok_or_return(master_task_get_cycle_stats(i, &stats));
+    if (stats.exec.count == 0) {
+      continue;
+    }
+    CanMessage msg = prv_diag_msg(CAN_DIAG_MASTER_CYCLE, i);
+    msg.data_u16[1] = prv_saturate(stats.start_delay.max);
+    msg.data_u16[2] = prv_saturate(stats.exec.max);
+    msg.data_u16[3] = prv_saturate(stats.slack.min);
+    status_ok_or_return(can_transmit(&msg));
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode can_diag_tx_run_time_stats(void) {
+  status_ok_or_return(run_time_stats_update());
+
+  for (uint8_t i = 0; i < run_time_stats_num_tasks(); ++i) {
+    RunTimeTaskStats task;
+    status_ok_or_return(run_time_stats_get_task(i, &task));
+    CanMessage msg = prv_diag_msg(CAN_DIAG_TASK_STATS, task.number);
+    msg.data_u16[1] = task.cpu_permyriad;
+    msg.data_u16[2] = prv_saturate(task.stack_high_water);
+    msg.data_u16[3] = prv_saturate(task.run_time_us / 1000);
+    status_ok_or_return(can_transmit(&msg));
+  }
+  for (uint8_t i = 0; i < run_time_stats_num_queues(); ++i) {
+    RunTimeQueueStats queue;
+    status_ok_or_return(run_time_stats_get_queue(i, &queue));
+    CanMessage msg = prv_diag_msg(CAN_DIAG_QUEUE_STATS, i);
+    msg.data_u16[1] = prv_saturate(queue.peak_items);
+    msg.data_u16[2] = prv_saturate(queue.num_items);
+    msg.data_u16[3] = prv_saturate(queue.items);
+    status_ok_or_return(can_transmit(&msg));
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode can_diag_tx_boot(void) {
+  for (uint8_t i = 0; i < boot_num_phases(); ++i) {
+    BootPhase phase;
+    status_ok_or_return(boot_get_phase(i, &phase));
+
+    CanMessage msg = prv_diag_msg(CAN_DIAG_BOOT_NAME, i);
+    if (phase.name != NULL) {
+      strncpy((char *)&msg.data_u8[2], phase.name, CAN_DIAG_BOOT_NAME_BYTES);
+    }
+    status_ok_or_return(can_transmit(&msg));
+
+    msg = prv_diag_msg(CAN_DIAG_BOOT_PHASE, i);
+    prv_put_u24(&msg.data_u8[2], phase.start_us);
+    prv_put_u24(&msg.data_u8[5], phase.duration_us);
+    status_ok_or_return(can_transmit(&msg));
+  }
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_tx_trace(const uint8_t *data, size_t len, void *context) {
+  for (size_t offset = 0; offset < len; offset += CAN_DIAG_TRACE_BYTES) {
+    CanMessage msg = prv_diag_msg(CAN_DIAG_TRACE, s_trace_seq++);
+    size_t chunk = (len - offset < CAN_DIAG_TRACE_BYTES) ? len - offset : CAN_DIAG_TRACE_BYTES;
+    memcpy(&msg.data_u8[2], data + offset, chunk);
+    // Bypasses can_transmit so draining the trace doesn't record CAN TX events
+    status_ok_or_return(can_hw_transmit(msg.id.raw, false, msg.data_u8, msg.dlc));
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode can_diag_tx_trace(uint32_t max_events) {
+  return trace_drain(prv_tx_trace, NULL, max_events);
+}
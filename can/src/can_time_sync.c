@@ -0,0 +1,241 @@
+#include "can_time_sync.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "can.h"
+#include "log.h"
+#include "task.h"
+#include "timestamp.h"
+
+// Bits on the wire for an 8 byte standard frame, including worst case bit stuffing
+#define CAN_TIME_SYNC_FRAME_BITS 135
+
+typedef struct CanTimeSyncSample {
+  uint64_t master_us;
+  uint64_t local_us;
+  uint8_t seq;
+} CanTimeSyncSample;
+
+// car(l) = base_car + d + d * drift / 1e9 + min(d, slew_len) * slew / 1e9, where d = l - base_local
+typedef struct CanTimeSyncClock {
+  uint64_t base_local_us;
+  uint64_t base_car_us;
+  int64_t drift_ppb;
+  int64_t slew_ppb;
+  uint64_t slew_len_us;
+} CanTimeSyncClock;
+
+static CanTimeSyncClock s_clock;
+static CanTimeSyncStats s_stats;
+static uint64_t s_error_sum_us;
+static uint32_t s_error_count;
+static uint32_t s_latency_us;
+static bool s_master;
+static bool s_synced;
+static uint8_t s_tx_seq;
+static uint8_t s_last_seq;
+static uint64_t s_last_sample_local_us;
+
+// Recent samples, drift is measured across the whole window to average out reception jitter
+static CanTimeSyncSample s_window[CAN_TIME_SYNC_DRIFT_WINDOW];
+static uint32_t s_window_count;
+
+// Written by the RX handler, read by the RX task. The sequence is odd while a write is in
+// progress, so the reader can detect a torn read without locking out the interrupt.
+static CanTimeSyncSample s_pending;
+static volatile uint32_t s_pending_seq;
+static uint32_t s_processed_seq;
+
+static const uint32_t s_bitrate_bps[NUM_CAN_HW_BITRATES] = {
+  [CAN_HW_BITRATE_125KBPS] = 125000,
+  [CAN_HW_BITRATE_250KBPS] = 250000,
+  [CAN_HW_BITRATE_500KBPS] = 500000,
+  [CAN_HW_BITRATE_1000KBPS] = 1000000,
+};
+
+static uint64_t prv_car_time(const CanTimeSyncClock *clock, uint64_t local_us) {
+  int64_t d = (int64_t)(local_us - clock->base_local_us);
+  int64_t slew_d = (d < (int64_t)clock->slew_len_us) ? d : (int64_t)clock->slew_len_us;
+  // d and the corrections are negative for a timestamp before the base
+  int64_t car_d = d + d * clock->drift_ppb / 1000000000 + slew_d * clock->slew_ppb / 1000000000;
+  return (uint64_t)((int64_t)clock->base_car_us + car_d);
+}
+
+static int64_t prv_clamp(int64_t value, int64_t limit) {
+  if (value > limit) return limit;
+  if (value < -limit) return -limit;
+  return value;
+}
+
+void can_time_sync_init(const CanSettings *settings) {
+  taskENTER_CRITICAL();
+  memset(&s_clock, 0, sizeof(s_clock));
+  memset(&s_stats, 0, sizeof(s_stats));
+  s_error_sum_us = 0;
+  s_error_count = 0;
+  s_master = false;
+  s_synced = false;
+  s_last_seq = 0;
+  s_last_sample_local_us = 0;
+  s_window_count = 0;
+  s_processed_seq = s_pending_seq;
+  taskEXIT_CRITICAL();
+
+#ifdef MS_PLATFORM_X86
+  // SocketCAN delivers frames without a simulated bit time
+  s_latency_us = 0;
+#else
+  // The RX interrupt fires at the end of the frame
+  s_latency_us = CAN_TIME_SYNC_FRAME_BITS * 1000000 / s_bitrate_bps[settings->bitrate];
+#endif
+}
+
+void can_time_sync_set_master(bool master) {
+  taskENTER_CRITICAL();
+  s_master = master;
+  s_synced = master;
+  // Car time continues from the local clock
+  memset(&s_clock, 0, sizeof(s_clock));
+  taskEXIT_CRITICAL();
+}
+
+StatusCode can_time_sync_tx(void) {
+  if (!s_master) {
+    return status_msg(STATUS_CODE_UNINITIALIZED, "CAN time sync: not the master");
+  }
+
+  CanMessage msg = { 0 };
+  msg.id.raw = CAN_TIME_SYNC_ID;
+  msg.dlc = sizeof(msg.data);
+  // Sample as late as possible before the frame is queued
+  msg.data = (timestamp_us() & CAN_TIME_SYNC_TIME_MASK) |
+             ((uint64_t)s_tx_seq << CAN_TIME_SYNC_SEQ_SHIFT);
+  s_tx_seq++;
+  return can_transmit(&msg);
+}
+
+void can_time_sync_rx_handler(uint64_t data) {
+  uint64_t local_us = timestamp_us();
+  if (s_master) {
+    return;
+  }
+
+  s_pending_seq++;
+  __sync_synchronize();
+  s_pending.master_us = data & CAN_TIME_SYNC_TIME_MASK;
+  s_pending.seq = data >> CAN_TIME_SYNC_SEQ_SHIFT;
+  s_pending.local_us = local_us;
+  __sync_synchronize();
+  s_pending_seq++;
+}
+
+static bool prv_take_sample(CanTimeSyncSample *sample) {
+  uint32_t seq;
+  do {
+    seq = s_pending_seq;
+    if (seq == s_processed_seq) {
+      return false;
+    }
+    __sync_synchronize();
+    *sample = s_pending;
+    __sync_synchronize();
+  } while ((seq & 1) || seq != s_pending_seq);
+
+  s_processed_seq = seq;
+  return true;
+}
+
+void can_time_sync_process(void) {
+  CanTimeSyncSample sample;
+  if (s_master || !prv_take_sample(&sample)) {
+    return;
+  }
+
+  // Master time when the frame was received here
+  uint64_t master_us = sample.master_us + s_latency_us;
+  uint64_t interval_us = sample.local_us - s_last_sample_local_us;
+
+  taskENTER_CRITICAL();
+  uint64_t now_us = timestamp_us();
+  int64_t error_us = (int64_t)(master_us - prv_car_time(&s_clock, sample.local_us));
+  bool step = !s_synced || error_us > CAN_TIME_SYNC_STEP_THRESHOLD_US ||
+              error_us < -CAN_TIME_SYNC_STEP_THRESHOLD_US || interval_us == 0;
+
+  if (step) {
+    s_clock.base_car_us = master_us + (now_us - sample.local_us);
+    s_clock.slew_ppb = 0;
+    s_clock.slew_len_us = 0;
+  } else {
+    // Rebase at the current time so the car clock is continuous
+    s_clock.base_car_us = prv_car_time(&s_clock, now_us);
+    // Slew out half the offset over the next sync interval
+    s_clock.slew_ppb =
+        prv_clamp(error_us * 1000000000 / (int64_t)interval_us / 2, CAN_TIME_SYNC_MAX_SLEW_PPB);
+    s_clock.slew_len_us = interval_us;
+  }
+  if (s_window_count >= CAN_TIME_SYNC_DRIFT_WINDOW) {
+    // Rate of the master clock against the local clock across the window
+    const CanTimeSyncSample *oldest = &s_window[s_window_count % CAN_TIME_SYNC_DRIFT_WINDOW];
+    int64_t local_span_us = (int64_t)(sample.local_us - oldest->local_us);
+    int64_t master_span_us = (int64_t)(sample.master_us - oldest->master_us);
+    if (local_span_us > 0) {
+      s_clock.drift_ppb = prv_clamp((master_span_us - local_span_us) * 1000000000 / local_span_us,
+                                    CAN_TIME_SYNC_MAX_DRIFT_PPB);
+    }
+  }
+  s_clock.base_local_us = now_us;
+  taskEXIT_CRITICAL();
+
+  if (s_synced && (uint8_t)(sample.seq - s_last_seq) > 1) {
+    s_stats.num_missed += (uint8_t)(sample.seq - s_last_seq) - 1;
+  }
+  s_window[s_window_count % CAN_TIME_SYNC_DRIFT_WINDOW] = sample;
+  s_window_count++;
+  s_last_seq = sample.seq;
+  s_last_sample_local_us = sample.local_us;
+  s_synced = true;
+
+  s_stats.num_syncs++;
+  s_stats.num_steps += step;
+  s_stats.last_error_us = prv_clamp(error_us, INT32_MAX);
+  if (!step && s_stats.num_syncs > CAN_TIME_SYNC_SETTLE_SYNCS) {
+    uint32_t abs_error_us = (uint32_t)((error_us < 0) ? -error_us : error_us);
+    if (abs_error_us > s_stats.max_error_us) {
+      s_stats.max_error_us = abs_error_us;
+    }
+    s_error_sum_us += abs_error_us;
+    s_error_count++;
+  }
+}
+
+uint64_t can_time_from_local_us(uint64_t local_us) {
+  taskENTER_CRITICAL();
+  uint64_t car_us = prv_car_time(&s_clock, local_us);
+  taskEXIT_CRITICAL();
+  return car_us;
+}
+
+uint64_t can_time_us(void) {
+  taskENTER_CRITICAL();
+  uint64_t car_us = prv_car_time(&s_clock, timestamp_us());
+  taskEXIT_CRITICAL();
+  return car_us;
+}
+
+bool can_time_is_synced(void) {
+  return s_synced;
+}
+
+StatusCode can_time_sync_get_stats(CanTimeSyncStats *stats) {
+  if (stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  taskENTER_CRITICAL();
+  *stats = s_stats;
+  stats->drift_ppb = s_clock.drift_ppb;
+  stats->offset_us = (int64_t)(s_clock.base_car_us - s_clock.base_local_us);
+  stats->mean_error_us = (s_error_count != 0) ? s_error_sum_us / s_error_count : 0;
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
@@ -0,0 +1,176 @@
+#include "can_trace.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "can_time_sync.h"
+#include "log.h"
+#include "task.h"
+#include "timestamp.h"
+
+// Latencies are measured modulo the range of the tag
+#define CAN_TRACE_WRAP_US ((uint64_t)(CAN_TRACE_TAG_MASK + 1) << CAN_TRACE_TAG_SHIFT)
+
+typedef struct CanTraceRxSlot {
+  uint64_t local_us;
+  uint16_t tag;
+} CanTraceRxSlot;
+
+static const char *s_hop_names[NUM_CAN_TRACE_HOPS] = {
+  [CAN_TRACE_HOP_TX_ENQUEUE] = "tx_enqueue",
+  [CAN_TRACE_HOP_BUS] = "bus",
+  [CAN_TRACE_HOP_RX_DECODE] = "rx_decode",
+  [CAN_TRACE_HOP_MCP2515_TX] = "mcp2515_tx",
+};
+
+static bool s_enabled;
+static CanMessageId s_msg_id;
+static Histogram s_hists[NUM_CAN_TRACE_HOPS];
+static uint16_t s_last_tag[NUM_CAN_TRACE_HOPS];
+static bool s_has_tag[NUM_CAN_TRACE_HOPS];
+// Hops recorded before the command was sampled, by the car clock
+static uint32_t s_skewed;
+
+// Single producer (RX interrupt) single consumer (RX task) ring of receive timestamps
+static CanTraceRxSlot s_rx_slots[CAN_TRACE_RX_SLOTS];
+static volatile uint32_t s_rx_head;
+static volatile uint32_t s_rx_tail;
+static volatile uint32_t s_rx_dropped;
+
+static bool prv_is_traced(const CanMessage *msg) {
+  return s_enabled && msg->id.raw == s_msg_id && msg->dlc >= sizeof(uint16_t);
+}
+
+static uint16_t prv_get_tag(const CanMessage *msg) {
+  return (msg->data >> (8 * (msg->dlc - sizeof(uint16_t)))) & CAN_TRACE_TAG_MASK;
+}
+
+static void prv_record(CanTraceHop hop, uint16_t tag, uint64_t car_us) {
+  // Latencies across boards are meaningless until car time is shared
+  if (!can_time_is_synced() || (s_has_tag[hop] && s_last_tag[hop] == tag)) {
+    return;
+  }
+  s_last_tag[hop] = tag;
+  s_has_tag[hop] = true;
+
+  uint64_t origin_us = (uint64_t)tag << CAN_TRACE_TAG_SHIFT;
+  uint64_t latency_us = (car_us - origin_us) & (CAN_TRACE_WRAP_US - 1);
+  // A negative latency wraps to the top half of the range, the clocks disagree by more than the hop
+  if (latency_us > CAN_TRACE_WRAP_US / 2) {
+    s_skewed++;
+    return;
+  }
+  histogram_record(&s_hists[hop], latency_us);
+}
+
+StatusCode can_trace_init(CanMessageId msg_id) {
+  if (msg_id >= CAN_MSG_MAX_IDS) {
+    return status_msg(STATUS_CODE_INVALID_ARGS, "CAN trace: Invalid message ID");
+  }
+  taskENTER_CRITICAL();
+  for (uint8_t i = 0; i < NUM_CAN_TRACE_HOPS; ++i) {
+    histogram_init(&s_hists[i]);
+    s_has_tag[i] = false;
+  }
+  s_skewed = 0;
+  s_rx_tail = s_rx_head;
+  s_rx_dropped = 0;
+  s_msg_id = msg_id;
+  s_enabled = true;
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+uint16_t can_trace_tag(void) {
+  return (can_time_us() >> CAN_TRACE_TAG_SHIFT) & CAN_TRACE_TAG_MASK;
+}
+
+StatusCode can_trace_record(CanTraceHop hop, uint16_t tag) {
+  if (hop >= NUM_CAN_TRACE_HOPS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  // Nothing to forward until a traced message has been received
+  bool received = hop <= CAN_TRACE_HOP_RX_DECODE || s_has_tag[CAN_TRACE_HOP_RX_DECODE];
+  if (s_enabled && received) {
+    prv_record(hop, tag, can_time_us());
+  }
+  return STATUS_CODE_OK;
+}
+
+void can_trace_tx(const CanMessage *msg) {
+  if (prv_is_traced(msg)) {
+    prv_record(CAN_TRACE_HOP_TX_ENQUEUE, prv_get_tag(msg), can_time_us());
+  }
+}
+
+void can_trace_rx_handler(const CanMessage *msg) {
+  uint64_t local_us = timestamp_us();
+  if (!prv_is_traced(msg)) {
+    return;
+  }
+  uint32_t head = s_rx_head;
+  if (head - s_rx_tail >= CAN_TRACE_RX_SLOTS) {
+    s_rx_dropped++;
+    return;
+  }
+  s_rx_slots[head % CAN_TRACE_RX_SLOTS].local_us = local_us;
+  s_rx_slots[head % CAN_TRACE_RX_SLOTS].tag = prv_get_tag(msg);
+  __sync_synchronize();
+  s_rx_head = head + 1;
+}
+
+void can_trace_rx(const CanMessage *msg) {
+  if (!prv_is_traced(msg)) {
+    return;
+  }
+  uint16_t tag = prv_get_tag(msg);
+  // Frames are queued in order, older timestamps belong to frames dropped from the RX queue. A
+  // newer one means this frame's timestamp was dropped from the full ring, it's left for its frame.
+  while (s_rx_tail != s_rx_head) {
+    __sync_synchronize();
+    CanTraceRxSlot slot = s_rx_slots[s_rx_tail % CAN_TRACE_RX_SLOTS];
+    if ((int16_t)(slot.tag - tag) > 0) {
+      break;
+    }
+    s_rx_tail++;
+    if (slot.tag == tag) {
+      prv_record(CAN_TRACE_HOP_BUS, tag, can_time_from_local_us(slot.local_us));
+      break;
+    }
+  }
+  prv_record(CAN_TRACE_HOP_RX_DECODE, tag, can_time_us());
+}
+
+StatusCode can_trace_get_histogram(CanTraceHop hop, Histogram *hist) {
+  if (hop >= NUM_CAN_TRACE_HOPS || hist == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  taskENTER_CRITICAL();
+  *hist = s_hists[hop];
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+uint32_t can_trace_num_skewed(void) {
+  return s_skewed;
+}
+
+void can_trace_log(void) {
+  if (!s_enabled) {
+    return;
+  }
+  Histogram hist;
+  for (uint8_t i = 0; i < NUM_CAN_TRACE_HOPS; ++i) {
+    can_trace_get_histogram(i, &hist);
+    if (hist.count != 0) {
+      histogram_log(&hist, s_hop_names[i]);
+    }
+  }
+  if (s_rx_dropped != 0) {
+    LOG_WARN("CAN trace: %u receive timestamps dropped\n", (unsigned)s_rx_dropped);
+  }
+  if (s_skewed != 0) {
+    LOG_WARN("CAN trace: %u hops before their sample, clock skew\n", (unsigned)s_skewed);
+  }
+}
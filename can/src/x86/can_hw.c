@@ -11,6 +11,7 @@ https://www.kernel.org/doc/Documentation/networking/can.txt
 #include <poll.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
@@ -21,7 +22,10 @@ https://www.kernel.org/doc/Documentation/networking/can.txt
 // TODO: get rid of extra includes
 #include <errno.h>
 
+#include "can_time_sync.h"
+#include "can_trace.h"
 #include "log.h"
+#include "x86_cosim.h"
 
 #define CAN_HW_MAX_FILTERS CAN_QUEUE_SIZE
 #define CAN_HW_TX_QUEUE_LEN 8
@@ -46,6 +50,9 @@ static bool s_keep_alive = true;
 
 static CanHwSocketData s_socket_data = { .can_fd = -1 };
 
+// Only used with the co-simulation
+static CanQueue *s_rx_queue;
+
 static uint32_t prv_get_delay(CanHwBitrate bitrate) {
   const uint32_t delay_us[NUM_CAN_HW_BITRATES] = {
     1000,  // 125 kbps
@@ -62,11 +69,51 @@ static SemaphoreHandle_t s_prv_can_tx_sem_handle;
 static StaticSemaphore_t s_prv_can_tx_sem;
 #endif
 
+// Passes the frame in s_socket_data.rx_frame on
+static void prv_rx_frame(CanQueue *rx_queue) {
+  CanMessage rx_msg = { 0 };
+  // TODO: I should check if they return status code ok or not
+  can_hw_receive(&rx_msg.id.raw, (bool *)&rx_msg.extended, &rx_msg.data, &rx_msg.dlc);
+  // Sync frames are timestamped here rather than queued
+  if (rx_msg.id.raw == CAN_TIME_SYNC_ID) {
+    can_time_sync_rx_handler(rx_msg.data);
+  } else {
+    can_trace_rx_handler(&rx_msg);
+    can_queue_push(rx_queue, &rx_msg);
+  }
+}
+
+// Applies the filters like SocketCAN does
+static bool prv_filter_match(canid_t can_id) {
+  if (s_socket_data.num_filters == 0) {
+    return true;
+  }
+  for (size_t i = 0; i < s_socket_data.num_filters; ++i) {
+    const struct can_filter *filter = &s_socket_data.filters[i];
+    if ((can_id & filter->can_mask) == (filter->can_id & filter->can_mask)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Frames from the co-simulation's virtual bus, in place of the RX thread
+static void prv_cosim_rx(const x86CosimFrame *frame) {
+  canid_t can_id = frame->extended ? (frame->id | CAN_EFF_FLAG) : frame->id;
+  if (!prv_filter_match(can_id)) {
+    return;
+  }
+  s_socket_data.rx_frame.can_id = can_id;
+  s_socket_data.rx_frame.can_dlc = frame->dlc;
+  memcpy(s_socket_data.rx_frame.data, &frame->data, sizeof(s_socket_data.rx_frame.data));
+  s_socket_data.rx_frame_valid = true;
+  prv_rx_frame(s_rx_queue);
+}
+
 static void *prv_rx_thread(void *arg) {
   LOG_DEBUG("CAN HW RX thread started\n");
 
   CanQueue *rx_queue = arg;
-  CanMessage rx_msg = { 0 };
 
   // Using poll
   struct pollfd pfd;
@@ -106,9 +153,7 @@ static void *prv_rx_thread(void *arg) {
         // also error if queue is full
         if (s_socket_data.rx_frame_valid) {
           // TODO: go through hw_filters here to get rid of messages
-          // TODO: I should check if they return status code ok or not
-          can_hw_receive(&rx_msg.id.raw, (bool *)&rx_msg.extended, &rx_msg.data, &rx_msg.dlc);
-          can_queue_push(rx_queue, &rx_msg);
+          prv_rx_frame(rx_queue);
 
 #ifdef MS_TEST
           // For ensuring tx has succeeded
@@ -149,6 +194,14 @@ StatusCode can_hw_init(const CanQueue *rx_queue, const CanSettings *settings) {
   s_socket_data.delay_us = prv_get_delay(settings->bitrate);
   s_socket_data.loopback = settings->loopback;
 
+  if (x86_cosim_connected()) {
+    // Frames go over the co-simulation's virtual bus instead of SocketCAN
+    s_rx_queue = (CanQueue *)rx_queue;
+    x86_cosim_set_can_rx_handler(prv_cosim_rx);
+    LOG_DEBUG("CAN HW initialized on the co-simulation bus\n");
+    return STATUS_CODE_OK;
+  }
+
   // Initialize socket
   s_socket_data.can_fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
   if (s_socket_data.can_fd == -1) {
@@ -206,9 +259,15 @@ StatusCode can_hw_init(const CanQueue *rx_queue, const CanSettings *settings) {
     return status_msg(STATUS_CODE_INTERNAL_ERROR, "CAN HW: Failed to bind socket");
   }
 
-  // Start RX thread
+  // Start RX thread. It inherits a mask blocking every signal, so the tick and the simulated
+  // interrupts, which are sent to the process, are never handled on it.
   s_keep_alive = true;
+  sigset_t all_signals;
+  sigset_t old_signals;
+  sigfillset(&all_signals);
+  pthread_sigmask(SIG_BLOCK, &all_signals, &old_signals);
   pthread_create(&s_rx_pthread_id, NULL, prv_rx_thread, rx_queue);
+  pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
 #ifdef MS_TEST
   s_prv_can_tx_sem_handle = xSemaphoreCreateBinaryStatic(&s_prv_can_tx_sem);
   configASSERT(s_prv_can_tx_sem_handle);
@@ -230,6 +289,9 @@ StatusCode can_hw_add_filter_in(uint32_t mask, uint32_t filter, bool extended) {
   s_socket_data.filters[s_socket_data.num_filters].can_mask = (mask & reg_mask) | CAN_EFF_FLAG;
   s_socket_data.num_filters++;
 
+  if (x86_cosim_connected()) {
+    return STATUS_CODE_OK;
+  }
   if (setsockopt(s_socket_data.can_fd, SOL_CAN_RAW, CAN_RAW_FILTER, s_socket_data.filters,
                  sizeof(s_socket_data.filters[0]) * s_socket_data.num_filters) < 0) {
     return status_msg(STATUS_CODE_INTERNAL_ERROR, "CAN HW: Failed to set raw filters");
@@ -252,6 +314,18 @@ StatusCode can_hw_transmit(uint32_t id, bool extended, const uint8_t *data, size
   struct can_frame frame = { .can_id = (id & mask) | extended_bit, .can_dlc = len };
   memcpy(&frame.data, data, len);
 
+  if (x86_cosim_connected()) {
+    x86CosimFrame cosim_frame = { .id = id & mask, .extended = extended, .dlc = len };
+    memcpy(&cosim_frame.data, data, len);
+    taskENTER_CRITICAL();
+    StatusCode status = x86_cosim_can_tx(&cosim_frame);
+    taskEXIT_CRITICAL();
+    if (s_socket_data.loopback) {
+      prv_cosim_rx(&cosim_frame);
+    }
+    return status;
+  }
+
   if (!s_socket_data.loopback) {
     // TODO: Don't think need to anything here
     // Unblock TX thread
@@ -0,0 +1,34 @@
+/*
+ * Included at the end of tasks.c when configINCLUDE_FREERTOS_TASK_C_ADDITIONS_H
+ * is 1, so it can read the scheduler's private state. Used by the x86 port's
+ * virtual time mode (MS_VIRTUAL_TIME).
+ */
+
+#ifndef FREERTOS_TASKS_C_ADDITIONS_H
+#define FREERTOS_TASKS_C_ADDITIONS_H
+
+/*
+ * Ticks until the next blocked task times out, if no task other than the
+ * calling idle task is ready to run. Returns 0 if another task is ready, and
+ * portMAX_DELAY if no task is blocked with a timeout.
+ *
+ * Must be called from the idle task in a critical section.
+ */
+TickType_t xTaskGetIdleTicksUntilUnblock( void )
+{
+    if( ( uxTopReadyPriority > tskIDLE_PRIORITY ) ||
+        ( listCURRENT_LIST_LENGTH( &( pxReadyTasksLists[ tskIDLE_PRIORITY ] ) ) > ( UBaseType_t ) 1 ) ||
+        ( uxSchedulerSuspended != ( UBaseType_t ) pdFALSE ) )
+    {
+        return 0;
+    }
+
+    if( xNextTaskUnblockTime == portMAX_DELAY )
+    {
+        return portMAX_DELAY;
+    }
+
+    return xNextTaskUnblockTime - xTickCount;
+}
+
+#endif /* FREERTOS_TASKS_C_ADDITIONS_H */
@@ -77,10 +77,11 @@ typedef unsigned long TickType_t;
 
 /* Scheduler utilities. */
 extern void vPortYield( void );
+extern void vPortYieldFromISR( void );
 
 #define portYIELD() vPortYield()
 
-#define portEND_SWITCHING_ISR( xSwitchRequired ) if( xSwitchRequired != pdFALSE ) vPortYield()
+#define portEND_SWITCHING_ISR( xSwitchRequired ) if( xSwitchRequired != pdFALSE ) vPortYieldFromISR()
 #define portYIELD_FROM_ISR( x ) portEND_SWITCHING_ISR( x )
 /*-----------------------------------------------------------*/
 
@@ -125,8 +126,17 @@ extern void vPortCancelThread( void *pxTaskToDelete );
 #define portMEMORY_BARRIER() __asm volatile( "" ::: "memory" )
 
 extern unsigned long ulPortGetRunTime( void );
+
+#ifdef MS_VIRTUAL_TIME
+/* Ticks taken from the wall clock because a task ran for a whole tick
+ * without blocking, see x86_virtual_time.c */
+extern unsigned long ulPortVirtualTimeForcedTicks( void );
+#endif
+/* FreeRTOSConfig.h may provide a wall clock counter instead of process CPU time */
+#ifndef portGET_RUN_TIME_COUNTER_VALUE
 #define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() /* no-op */
 #define portGET_RUN_TIME_COUNTER_VALUE()         ulPortGetRunTime()
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,22 @@
+/*
+ * Virtual time (MS_VIRTUAL_TIME) shared by the x86 ports, port.c and
+ * port_coroutine.c. See x86_virtual_time.c.
+ */
+
+#ifndef X86_VIRTUAL_TIME_H
+#define X86_VIRTUAL_TIME_H
+
+#include "FreeRTOS.h"
+
+#ifdef MS_VIRTUAL_TIME
+
+/*
+ * Called first by the port's SIGALRM handler. Returns pdTRUE if the handler
+ * should advance the tick, pdFALSE if the idle task or the co-simulation
+ * controller is moving the clock instead.
+ */
+BaseType_t xPortVirtualTimeTakeTick( void );
+
+#endif /* MS_VIRTUAL_TIME */
+
+#endif /* X86_VIRTUAL_TIME_H */
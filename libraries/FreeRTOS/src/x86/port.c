@@ -48,8 +48,15 @@
  * stdio (printf() and friends) should be called from a single task
  * only or serialized with a FreeRTOS primitive such as a binary
  * semaphore or mutex.
+ *
+ * Virtual time (MS_VIRTUAL_TIME) decouples the tick from the wall clock, see
+ * x86_virtual_time.c, which both x86 ports share.
+ *
+ * port_coroutine.c replaces this file with --define=MS_COROUTINE_PORT.
  *----------------------------------------------------------*/
 
+#ifndef MS_COROUTINE_PORT
+
 #include <errno.h>
 #include <pthread.h>
 #include <signal.h>
@@ -65,10 +72,16 @@
 #include "task.h"
 #include "timers.h"
 #include "wait_for_event.h"
+#include "x86_interrupt.h"
+#include "x86_virtual_time.h"
 /*-----------------------------------------------------------*/
 
 #define SIG_RESUME SIGUSR1
 
+/* Signals which were blocked before xPortSetInterruptMask() */
+#define portMASK_INTERRUPTS ( 1 )
+#define portMASK_TICK       ( 2 )
+
 typedef struct THREAD
 {
     pthread_t pthread;
@@ -293,6 +306,14 @@ void vPortYield( void )
 }
 /*-----------------------------------------------------------*/
 
+void vPortYieldFromISR( void )
+{
+    /* Like a PendSV, the switch waits until every nested interrupt handler
+     * has returned, see x86_interrupt.h. */
+    x86_interrupt_pend_switch( vPortYield );
+}
+/*-----------------------------------------------------------*/
+
 void vPortDisableInterrupts( void )
 {
     pthread_sigmask( SIG_BLOCK, &xAllSignals, NULL );
@@ -307,14 +328,38 @@ void vPortEnableInterrupts( void )
 
 portBASE_TYPE xPortSetInterruptMask( void )
 {
-    /* Interrupts are always disabled inside ISRs (signals
-       handlers). */
-    return pdTRUE;
+sigset_t xOldSignals;
+portBASE_TYPE xMask = 0;
+
+    /* Handlers of higher priority interrupts can preempt an ISR, like
+     * BASEPRI they're kept out of the kernel while it's in use. The tick
+     * stays masked afterwards inside an interrupt handler. */
+    pthread_sigmask( SIG_BLOCK, &xAllSignals, &xOldSignals );
+
+    if( sigismember( &xOldSignals, X86_INTERRUPT_SIGNAL ) )
+    {
+        xMask |= portMASK_INTERRUPTS;
+    }
+    if( sigismember( &xOldSignals, SIGALRM ) )
+    {
+        xMask |= portMASK_TICK;
+    }
+    return xMask;
 }
 /*-----------------------------------------------------------*/
 
 void vPortClearInterruptMask( portBASE_TYPE xMask )
 {
+sigset_t xSignals = xAllSignals;
+
+    if( ( xMask & portMASK_INTERRUPTS ) == 0 )
+    {
+        if( ( xMask & portMASK_TICK ) != 0 )
+        {
+            sigdelset( &xSignals, SIGALRM );
+        }
+        pthread_sigmask( SIG_UNBLOCK, &xSignals, NULL );
+    }
 }
 /*-----------------------------------------------------------*/
 
@@ -373,6 +418,13 @@ Thread_t *pxThreadToSuspend;
 Thread_t *pxThreadToResume;
 /* uint64_t xExpectedTicks; */
 
+#ifdef MS_VIRTUAL_TIME
+    if ( xPortVirtualTimeTakeTick() == pdFALSE )
+    {
+        return;
+    }
+#endif
+
     uxCriticalNesting++; /* Signals are blocked in this signal handler. */
 
 #if ( configUSE_PREEMPTION == 1 )
@@ -563,3 +615,5 @@ struct tms xTimes;
     return ( unsigned long ) xTimes.tms_utime;
 }
 /*-----------------------------------------------------------*/
+
+#endif /* MS_COROUTINE_PORT */
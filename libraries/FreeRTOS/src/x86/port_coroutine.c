@@ -0,0 +1,440 @@
+/*
+ * FreeRTOS Kernel <DEVELOPMENT BRANCH>
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*-----------------------------------------------------------
+ * Single threaded x86 port, built instead of port.c with
+ * --define=MS_COROUTINE_PORT.
+ *
+ * Every task is a ucontext coroutine with its own stack, and all of them
+ * run on the process's main thread. A task switch is a swapcontext() to
+ * the task chosen by vTaskSwitchContext(), rather than waking one pthread
+ * and putting another to sleep, so switches are cheap and which task runs
+ * next depends only on the kernel's state.
+ *
+ * Interrupts are POSIX signals delivered to that one thread: the tick is
+ * SIGALRM, and the simulated peripheral interrupts (x86_interrupt.h) share
+ * a real-time signal. Both are sent to the process, so every other host
+ * thread must block all signals for them to reach the main thread. A signal handler runs between any two instructions of
+ * the current task, on its stack. The tick switches task from its handler,
+ * peripheral interrupts once the last nested one returns, like a PendSV
+ * would. Critical sections block every signal.
+ *
+ * Each task's stack is allocated with mmap() with a guard page below it, so
+ * a stack overflow faults where it happens. Host library calls (printf in
+ * particular) need far more stack than the firmware sizes allow, so stacks
+ * are at least portCOROUTINE_MIN_STACK_BYTES.
+ *
+ * With MS_VIRTUAL_TIME the tick follows a virtual clock, shared with port.c
+ * in x86_virtual_time.c, so whole runs are repeatable.
+ *
+ * Threads other than the main thread, e.g. the x86 CAN RX thread, must not
+ * call into the kernel while a task is running, as with port.c. can_hw.c
+ * creates its RX thread with every signal blocked.
+ *----------------------------------------------------------*/
+
+#ifdef MS_COROUTINE_PORT
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/times.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "x86_interrupt.h"
+#include "x86_virtual_time.h"
+/*-----------------------------------------------------------*/
+
+#define portCOROUTINE_MIN_STACK_BYTES ( 64 * 1024 )
+
+/* Signals which were blocked before xPortSetInterruptMask() */
+#define portMASK_INTERRUPTS ( 1 )
+#define portMASK_TICK       ( 2 )
+
+typedef struct COROUTINE
+{
+    ucontext_t xContext;
+    pdTASK_CODE pxCode;
+    void *pvParams;
+    void *pvMapping;    /* Guard page and stack */
+    size_t xMappingSize;
+} Coroutine_t;
+
+/*
+ * The coroutine is stored at the beginning of the task's FreeRTOS stack,
+ * like the pthread port's per-thread data.
+ */
+static inline Coroutine_t *prvGetCoroutineFromTask( TaskHandle_t xTask )
+{
+StackType_t *pxTopOfStack = *(StackType_t **)xTask;
+
+    return (Coroutine_t *)(pxTopOfStack + 1);
+}
+/*-----------------------------------------------------------*/
+
+static sigset_t xAllSignals;
+static ucontext_t xSchedulerContext;
+static volatile portBASE_TYPE uxCriticalNesting;
+static size_t xPageSize;
+
+static void prvSetupSignals( void );
+static void prvSetupTimerInterrupt( void );
+static void prvCoroutineStart( void );
+static void prvInitialiseContext( Coroutine_t *pxCoroutine, void *pvStack, size_t xStackSize );
+static void prvSwitchCoroutine( Coroutine_t *pxFrom, Coroutine_t *pxTo );
+static void vPortSystemTickHandler( int sig );
+/*-----------------------------------------------------------*/
+
+static void prvFatalError( const char *pcCall, int iErrno )
+{
+    fprintf( stderr, "%s: %s\n", pcCall, strerror( iErrno ) );
+    abort();
+}
+/*-----------------------------------------------------------*/
+
+static void prvInitialiseContext( Coroutine_t *pxCoroutine, void *pvStack, size_t xStackSize )
+{
+    if( getcontext( &pxCoroutine->xContext ) != 0 )
+    {
+        prvFatalError( "getcontext", errno );
+    }
+    pxCoroutine->xContext.uc_stack.ss_sp = pvStack;
+    pxCoroutine->xContext.uc_stack.ss_size = xStackSize;
+    pxCoroutine->xContext.uc_link = NULL;
+    /* Tasks start with interrupts disabled, like a task switched to from
+     * inside a critical section or interrupt. */
+    pxCoroutine->xContext.uc_sigmask = xAllSignals;
+    makecontext( &pxCoroutine->xContext, prvCoroutineStart, 0 );
+}
+/*-----------------------------------------------------------*/
+
+portSTACK_TYPE *pxPortInitialiseStack( portSTACK_TYPE *pxTopOfStack,
+                                       portSTACK_TYPE *pxEndOfStack,
+                                       pdTASK_CODE pxCode, void *pvParameters )
+{
+Coroutine_t *pxCoroutine;
+size_t xStackSize;
+char *pcMapping;
+
+    if( xPageSize == 0 )
+    {
+        xPageSize = ( size_t )sysconf( _SC_PAGESIZE );
+        prvSetupSignals();
+    }
+
+    /*
+     * Store the coroutine at the start of the stack.
+     */
+    pxCoroutine = (Coroutine_t *)(pxTopOfStack + 1) - 1;
+    pxTopOfStack = (portSTACK_TYPE *)pxCoroutine - 1;
+
+    xStackSize = (pxTopOfStack + 1 - pxEndOfStack) * sizeof(*pxTopOfStack);
+    if( xStackSize < portCOROUTINE_MIN_STACK_BYTES )
+    {
+        xStackSize = portCOROUTINE_MIN_STACK_BYTES;
+    }
+    xStackSize = ( xStackSize + xPageSize - 1 ) / xPageSize * xPageSize;
+
+    pcMapping = mmap( NULL, xStackSize + xPageSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0 );
+    if( pcMapping == MAP_FAILED )
+    {
+        prvFatalError( "mmap", errno );
+    }
+    if( mprotect( pcMapping, xPageSize, PROT_NONE ) != 0 )
+    {
+        prvFatalError( "mprotect", errno );
+    }
+
+    pxCoroutine->pxCode = pxCode;
+    pxCoroutine->pvParams = pvParameters;
+    pxCoroutine->pvMapping = pcMapping;
+    pxCoroutine->xMappingSize = xStackSize + xPageSize;
+
+    prvInitialiseContext( pxCoroutine, pcMapping + xPageSize, xStackSize );
+
+    return pxTopOfStack;
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xPortStartScheduler( void )
+{
+Coroutine_t *pxFirst = prvGetCoroutineFromTask( xTaskGetCurrentTaskHandle() );
+
+    /* Interrupts are disabled here already. */
+    prvSetupTimerInterrupt();
+
+    /* Runs tasks until vPortEndScheduler() switches back here. */
+    if( swapcontext( &xSchedulerContext, &pxFirst->xContext ) != 0 )
+    {
+        prvFatalError( "swapcontext", errno );
+    }
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+struct itimerval itimer = { 0 };
+struct sigaction sigtick = { 0 };
+
+    /* Stop the timer and ignore any pending SIGALRMs. */
+    (void)setitimer( ITIMER_REAL, &itimer, NULL );
+
+    sigtick.sa_handler = SIG_IGN;
+    sigemptyset( &sigtick.sa_mask );
+    sigaction( SIGALRM, &sigtick, NULL );
+
+    setcontext( &xSchedulerContext );
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+    if ( uxCriticalNesting == 0 )
+    {
+        vPortDisableInterrupts();
+    }
+    uxCriticalNesting++;
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+    uxCriticalNesting--;
+
+    /* If we have reached 0 then re-enable the interrupts. */
+    if( uxCriticalNesting == 0 )
+    {
+        vPortEnableInterrupts();
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+Coroutine_t *pxFrom;
+
+    vPortEnterCritical();
+
+    pxFrom = prvGetCoroutineFromTask( xTaskGetCurrentTaskHandle() );
+    vTaskSwitchContext();
+    prvSwitchCoroutine( pxFrom, prvGetCoroutineFromTask( xTaskGetCurrentTaskHandle() ) );
+
+    vPortExitCritical();
+}
+/*-----------------------------------------------------------*/
+
+void vPortYieldFromISR( void )
+{
+    /* Like a PendSV, the switch waits until every nested interrupt handler
+     * has returned, see x86_interrupt.h. */
+    x86_interrupt_pend_switch( vPortYield );
+}
+/*-----------------------------------------------------------*/
+
+void vPortDisableInterrupts( void )
+{
+    sigprocmask( SIG_BLOCK, &xAllSignals, NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnableInterrupts( void )
+{
+    sigprocmask( SIG_UNBLOCK, &xAllSignals, NULL );
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xPortSetInterruptMask( void )
+{
+sigset_t xOldSignals;
+portBASE_TYPE xMask = 0;
+
+    /* Handlers of higher priority interrupts can preempt an ISR, like
+     * BASEPRI they're kept out of the kernel while it's in use. The tick
+     * stays masked afterwards inside an interrupt handler. */
+    sigprocmask( SIG_BLOCK, &xAllSignals, &xOldSignals );
+
+    if( sigismember( &xOldSignals, X86_INTERRUPT_SIGNAL ) )
+    {
+        xMask |= portMASK_INTERRUPTS;
+    }
+    if( sigismember( &xOldSignals, SIGALRM ) )
+    {
+        xMask |= portMASK_TICK;
+    }
+    return xMask;
+}
+/*-----------------------------------------------------------*/
+
+void vPortClearInterruptMask( portBASE_TYPE xMask )
+{
+sigset_t xSignals = xAllSignals;
+
+    if( ( xMask & portMASK_INTERRUPTS ) == 0 )
+    {
+        if( ( xMask & portMASK_TICK ) != 0 )
+        {
+            sigdelset( &xSignals, SIGALRM );
+        }
+        sigprocmask( SIG_UNBLOCK, &xSignals, NULL );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetupTimerInterrupt( void )
+{
+struct itimerval itimer;
+
+    itimer.it_interval.tv_sec = 0;
+    itimer.it_interval.tv_usec = portTICK_RATE_MICROSECONDS;
+    itimer.it_value = itimer.it_interval;
+
+    if ( setitimer( ITIMER_REAL, &itimer, NULL ) != 0 )
+    {
+        prvFatalError( "setitimer", errno );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void vPortSystemTickHandler( int sig )
+{
+Coroutine_t *pxFrom;
+
+#ifdef MS_VIRTUAL_TIME
+    if ( xPortVirtualTimeTakeTick() == pdFALSE )
+    {
+        return;
+    }
+#endif
+
+    uxCriticalNesting++; /* Signals are blocked in this signal handler. */
+
+    if( xTaskIncrementTick() != pdFALSE )
+    {
+        /* Switch from inside the handler, the task returns from it when
+         * it's switched back to. */
+        pxFrom = prvGetCoroutineFromTask( xTaskGetCurrentTaskHandle() );
+        vTaskSwitchContext();
+        prvSwitchCoroutine( pxFrom, prvGetCoroutineFromTask( xTaskGetCurrentTaskHandle() ) );
+    }
+
+    uxCriticalNesting--;
+}
+/*-----------------------------------------------------------*/
+
+void vPortThreadDying( void *pxTaskToDelete, volatile BaseType_t *pxPendYield )
+{
+    /* Nothing to do, a deleted task is never switched back to. */
+    ( void )pxTaskToDelete;
+    ( void )pxPendYield;
+}
+
+void vPortCancelThread( void *pxTaskToDelete )
+{
+Coroutine_t *pxCoroutine = prvGetCoroutineFromTask( pxTaskToDelete );
+
+    /* Called from another task once the task is deleted, so its stack is no
+     * longer in use. */
+    munmap( pxCoroutine->pvMapping, pxCoroutine->xMappingSize );
+}
+/*-----------------------------------------------------------*/
+
+static void prvCoroutineStart( void )
+{
+Coroutine_t *pxCoroutine = prvGetCoroutineFromTask( xTaskGetCurrentTaskHandle() );
+
+    /* Started for the first time, unblocks all signals. */
+    uxCriticalNesting = 0;
+    vPortEnableInterrupts();
+
+    /* Call the task's entry point. */
+    pxCoroutine->pxCode( pxCoroutine->pvParams );
+
+    /* A function that implements a task must not exit or attempt to return to
+     * its caller as there is nothing to return to. */
+    configASSERT( pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+static void prvSwitchCoroutine( Coroutine_t *pxFrom, Coroutine_t *pxTo )
+{
+BaseType_t uxSavedCriticalNesting;
+
+    if ( pxFrom != pxTo )
+    {
+        /*
+         * The critical section nesting is per-task, so save it on the
+         * stack of the current task, restoring it when we switch back.
+         */
+        uxSavedCriticalNesting = uxCriticalNesting;
+
+        if( swapcontext( &pxFrom->xContext, &pxTo->xContext ) != 0 )
+        {
+            prvFatalError( "swapcontext", errno );
+        }
+
+        uxCriticalNesting = uxSavedCriticalNesting;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetupSignals( void )
+{
+struct sigaction sigtick = { 0 };
+
+    sigfillset( &xAllSignals );
+    /* Don't block SIGINT so this can be used to break into GDB while
+     * in a critical section. */
+    sigdelset( &xAllSignals, SIGINT );
+
+    sigtick.sa_handler = vPortSystemTickHandler;
+    sigfillset( &sigtick.sa_mask );
+
+    if ( sigaction( SIGALRM, &sigtick, NULL ) != 0 )
+    {
+        prvFatalError( "sigaction", errno );
+    }
+}
+/*-----------------------------------------------------------*/
+
+unsigned long ulPortGetRunTime( void )
+{
+struct tms xTimes;
+
+    times( &xTimes );
+
+    return ( unsigned long ) xTimes.tms_utime;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* MS_COROUTINE_PORT */
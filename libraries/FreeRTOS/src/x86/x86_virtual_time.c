@@ -0,0 +1,98 @@
+/*-----------------------------------------------------------
+ * Virtual time (MS_VIRTUAL_TIME), used by both x86 ports.
+ *
+ * The tick is decoupled from the wall clock. Whenever every task is blocked
+ * the idle hook advances the tick straight to the next timeout, so a
+ * delay_ms(10000) returns as soon as the rest of the system is idle, and
+ * tasks wake in the same order at the same tick on every run. SIGALRM only
+ * advances the tick when a task has run for a whole wall clock tick without
+ * the idle task running, so code which busy-waits on the tick still makes
+ * progress; those ticks are counted by ulPortVirtualTimeForcedTicks() as
+ * they depend on host speed. With no task waiting on a timeout, the idle
+ * task sleeps in real time without advancing the clock, waiting for an
+ * external event (e.g. a CAN frame from another process).
+ *
+ * When started by the co-simulation controller (x86_cosim.h), it owns the
+ * clock instead: the idle hook only advances the tick up to the step the
+ * controller granted, and SIGALRM never does.
+ *----------------------------------------------------------*/
+
+#ifdef MS_VIRTUAL_TIME
+
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "x86_cosim.h"
+#include "x86_virtual_time.h"
+/*-----------------------------------------------------------*/
+
+/* See freertos_tasks_c_additions.h */
+extern TickType_t xTaskGetIdleTicksUntilUnblock( void );
+
+static volatile BaseType_t xIdleRanSinceTick = pdFALSE;
+static volatile unsigned long ulForcedTicks = 0;
+/*-----------------------------------------------------------*/
+
+BaseType_t xPortVirtualTimeTakeTick( void )
+{
+    if ( x86_cosim_connected() )
+    {
+        /* Only the co-simulation controller moves the clock. */
+        return pdFALSE;
+    }
+
+    /* The idle task moves the clock while it's running, only tick here if a
+     * task has kept it from running for a whole tick. */
+    if ( xIdleRanSinceTick != pdFALSE )
+    {
+        xIdleRanSinceTick = pdFALSE;
+        return pdFALSE;
+    }
+    ulForcedTicks++;
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationIdleHook( void )
+{
+TickType_t xTicks;
+struct timespec xSleep = { 0, portTICK_RATE_MICROSECONDS * 1000 };
+
+    xIdleRanSinceTick = pdTRUE;
+
+    vPortEnterCritical();
+    xTicks = xTaskGetIdleTicksUntilUnblock();
+    vPortExitCritical();
+
+    if ( x86_cosim_connected() )
+    {
+        /* Blocks once the tick reaches the step granted by the controller. */
+        xTicks = x86_cosim_idle( xTaskGetTickCount(), xTicks );
+        if ( xTicks > 0 )
+        {
+            xTaskCatchUpTicks( xTicks );
+        }
+    }
+    else if ( xTicks == portMAX_DELAY )
+    {
+        /* Only an external event can wake a task, wait for one in real time
+         * with the clock stopped. */
+        nanosleep( &xSleep, NULL );
+    }
+    else if ( xTicks > 0 )
+    {
+        /* Runs each tick up to the next timeout, then switches to the task
+         * which timed out. */
+        xTaskCatchUpTicks( xTicks );
+    }
+}
+/*-----------------------------------------------------------*/
+
+unsigned long ulPortVirtualTimeForcedTicks( void )
+{
+    return ulForcedTicks;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* MS_VIRTUAL_TIME */
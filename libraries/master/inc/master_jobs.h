@@ -0,0 +1,61 @@
+#pragma once
+// Periodic job table for the master task
+//
+// Instead of the fast, medium and slow cycles, a board can give the master task a table of jobs.
+// Each job runs every |period| master cycles, on the cycle |phase| within its period. Jobs due
+// on the same cycle run in descending priority. The execution budget of each job is used to
+// spread jobs with MASTER_JOB_AUTO_PHASE over the cycles, so work with different rates doesn't
+// all stack onto the same cycle.
+//
+// Usage:
+//   static MasterJob s_jobs[] = {
+//     { .name = "can", .run = prv_run_can, .period = 1, .priority = 3, .budget_us = 2000 },
+//     { .name = "fsm", .run = prv_run_fsm, .period = 10, .phase = MASTER_JOB_AUTO_PHASE,
+//       .priority = 2, .budget_us = 5000 },
+//   };
+//   master_jobs_init(s_jobs, SIZEOF_ARRAY(s_jobs));
+//   init_master_task();
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "status.h"
+
+#define MASTER_JOB_AUTO_PHASE UINT32_MAX
+#define MASTER_MAX_JOBS 16
+// Schedules repeat every LCM of the job periods, which must be at most this many cycles
+#define MASTER_MAX_HYPERPERIOD 1000
+
+typedef struct MasterJob {
+  const char *name;
+  void (*run)(void);
+  uint32_t period;  // In master cycles
+  uint32_t phase;  // Cycle within the period the job runs on, or MASTER_JOB_AUTO_PHASE
+  uint8_t priority;
+  uint32_t budget_us;  // Worst case execution time
+  // Filled in by master_jobs_init(): |phase|, or the one chosen for MASTER_JOB_AUTO_PHASE
+  uint32_t resolved_phase;
+  // Filled in by the master task
+  uint32_t runs;
+  uint32_t max_exec_us;
+  uint32_t over_budget;  // Runs which took longer than budget_us
+} MasterJob;
+
+// Replaces the fast, medium and slow cycles with the job table. Call before init_master_task().
+// Automatic phases are assigned to resolved_phase, the table's order and each job's phase are
+// left as given, so it can be changed and initialized again. The table must outlive the master
+// task.
+StatusCode master_jobs_init(MasterJob *jobs, uint8_t num_jobs);
+
+// Clears the job table, restoring the fast, medium and slow cycles
+void master_jobs_clear(void);
+
+// Runs the jobs due on the master task's cycle |counter|, which is 1 on the first cycle.
+// Returns false if there is no job table.
+bool master_jobs_run_cycle(uint32_t counter);
+
+// Largest total budget of the jobs due on any one cycle
+uint32_t master_jobs_peak_load_us(void);
+
+// Logs each job's period, phase, priority and budget, the worst case and average utilisation of
+// a master cycle, and the measured execution times so far
+void master_jobs_print_schedule(void);
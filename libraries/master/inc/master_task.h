@@ -1,8 +1,26 @@
 #pragma once
+#include "histogram.h"
 #include "log.h"
 #include "tasks.h"
 
+typedef enum {
+  MASTER_CYCLE_FAST = 0,
+  MASTER_CYCLE_MEDIUM,
+  MASTER_CYCLE_SLOW,
+  NUM_MASTER_CYCLES,
+} MasterCycle;
+
+// Timing of one cycle class, in microseconds. Not recorded with a job table (master_jobs.h).
+// Every class is released at the start of a master cycle and due by the start of the next.
+typedef struct MasterCycleStats {
+  Histogram start_delay;  // From the release to the start of the cycle, its spread is the jitter
+  Histogram exec;  // Execution time of the cycle
+  Histogram slack;  // From the end of the cycle to its deadline, 0 if it overran
+  uint32_t overruns;  // Cycles which finished after their deadline
+} MasterCycleStats;
+
 void set_master_cycle_time(uint32_t time_ms);
+uint32_t master_task_get_cycle_time(void);
 void set_medium_cycle_count(uint32_t cycles);
 void set_slow_cycle_count(uint32_t cycles);
 
@@ -14,6 +32,13 @@ void pre_loop_init();
 StatusCode init_master_task();
 Task *get_master_task();
 
+StatusCode master_task_get_cycle_stats(MasterCycle cycle, MasterCycleStats *stats);
+
+void master_task_reset_cycle_stats(void);
+
+// Logs the histograms of every cycle class which has run
+void master_task_log_cycle_stats(void);
+
 #ifdef MS_TEST
 uint8_t get_cycles_over();
 #endif
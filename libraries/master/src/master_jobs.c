@@ -0,0 +1,181 @@
+#include "master_jobs.h"
+
+#include <stddef.h>
+
+#include "log.h"
+#include "master_task.h"
+#include "timestamp.h"
+
+static MasterJob *s_jobs;
+static uint8_t s_num_jobs;
+// Indices of the jobs by descending priority, the caller's table is left in its order
+static uint8_t s_order[MASTER_MAX_JOBS];
+static uint32_t s_hyperperiod;
+
+static uint32_t prv_gcd(uint32_t a, uint32_t b) {
+  while (b != 0) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+static bool prv_is_due(const MasterJob *job, uint32_t cycle) {
+  return cycle % job->period == job->resolved_phase;
+}
+
+// Total budget of the first |num_jobs| jobs due on a cycle
+static uint32_t prv_load_us(uint8_t num_jobs, uint32_t cycle) {
+  uint32_t load_us = 0;
+  for (uint8_t i = 0; i < num_jobs; ++i) {
+    if (s_jobs[i].resolved_phase != MASTER_JOB_AUTO_PHASE && prv_is_due(&s_jobs[i], cycle)) {
+      load_us += s_jobs[i].budget_us;
+    }
+  }
+  return load_us;
+}
+
+static void prv_sort_by_priority(void) {
+  for (uint8_t i = 0; i < s_num_jobs; ++i) {
+    uint8_t j = i;
+    while (j > 0 && s_jobs[s_order[j - 1]].priority < s_jobs[i].priority) {
+      s_order[j] = s_order[j - 1];
+      --j;
+    }
+    s_order[j] = i;
+  }
+}
+
+// Places each automatic job, shortest period first, on the phase with the lowest peak load
+static void prv_assign_phases(void) {
+  uint8_t order[MASTER_MAX_JOBS];
+  uint8_t num_auto = 0;
+  for (uint8_t i = 0; i < s_num_jobs; ++i) {
+    if (s_jobs[i].phase == MASTER_JOB_AUTO_PHASE) {
+      uint8_t j = num_auto++;
+      while (j > 0 && s_jobs[order[j - 1]].period > s_jobs[i].period) {
+        order[j] = order[j - 1];
+        --j;
+      }
+      order[j] = i;
+    }
+  }
+
+  for (uint8_t n = 0; n < num_auto; ++n) {
+    MasterJob *job = &s_jobs[order[n]];
+    uint32_t best_phase = 0;
+    uint32_t best_peak_us = UINT32_MAX;
+    for (uint32_t phase = 0; phase < job->period; ++phase) {
+      uint32_t peak_us = 0;
+      for (uint32_t cycle = phase; cycle < s_hyperperiod; cycle += job->period) {
+        uint32_t load_us = prv_load_us(s_num_jobs, cycle);
+        if (load_us > peak_us) {
+          peak_us = load_us;
+        }
+      }
+      if (peak_us < best_peak_us) {
+        best_peak_us = peak_us;
+        best_phase = phase;
+      }
+    }
+    job->resolved_phase = best_phase;
+  }
+}
+
+StatusCode master_jobs_init(MasterJob *jobs, uint8_t num_jobs) {
+  if (jobs == NULL || num_jobs == 0 || num_jobs > MASTER_MAX_JOBS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  uint32_t hyperperiod = 1;
+  for (uint8_t i = 0; i < num_jobs; ++i) {
+    if (jobs[i].run == NULL || jobs[i].period == 0 ||
+        (jobs[i].phase != MASTER_JOB_AUTO_PHASE && jobs[i].phase >= jobs[i].period)) {
+      return status_msg(STATUS_CODE_INVALID_ARGS, "Master jobs: invalid job");
+    }
+    hyperperiod = hyperperiod / prv_gcd(hyperperiod, jobs[i].period) * jobs[i].period;
+    if (hyperperiod > MASTER_MAX_HYPERPERIOD) {
+      return status_msg(STATUS_CODE_OUT_OF_RANGE, "Master jobs: hyperperiod too long");
+    }
+    // Automatic phases are placed again from scratch on every init
+    jobs[i].resolved_phase = jobs[i].phase;
+    jobs[i].runs = 0;
+    jobs[i].max_exec_us = 0;
+    jobs[i].over_budget = 0;
+  }
+
+  s_jobs = jobs;
+  s_num_jobs = num_jobs;
+  s_hyperperiod = hyperperiod;
+  prv_sort_by_priority();
+  prv_assign_phases();
+  return STATUS_CODE_OK;
+}
+
+void master_jobs_clear(void) {
+  s_jobs = NULL;
+  s_num_jobs = 0;
+}
+
+bool master_jobs_run_cycle(uint32_t counter) {
+  if (s_jobs == NULL) {
+    return false;
+  }
+  // Cycle counter - 1 within the hyperperiod, every period divides it. Reduced first so a counter
+  // which has wrapped to 0 doesn't underflow.
+  uint32_t cycle = (counter % s_hyperperiod + s_hyperperiod - 1) % s_hyperperiod;
+  for (uint8_t i = 0; i < s_num_jobs; ++i) {
+    MasterJob *job = &s_jobs[s_order[i]];
+    if (!prv_is_due(job, cycle)) {
+      continue;
+    }
+    uint64_t start_us = timestamp_us();
+    job->run();
+    uint32_t exec_us = timestamp_us() - start_us;
+
+    job->runs++;
+    if (exec_us > job->max_exec_us) {
+      job->max_exec_us = exec_us;
+    }
+    if (exec_us > job->budget_us) {
+      job->over_budget++;
+    }
+  }
+  return true;
+}
+
+uint32_t master_jobs_peak_load_us(void) {
+  uint32_t peak_us = 0;
+  for (uint32_t cycle = 0; cycle < s_hyperperiod && s_jobs != NULL; ++cycle) {
+    uint32_t load_us = prv_load_us(s_num_jobs, cycle);
+    if (load_us > peak_us) {
+      peak_us = load_us;
+    }
+  }
+  return peak_us;
+}
+
+void master_jobs_print_schedule(void) {
+  if (s_jobs == NULL) {
+    LOG_DEBUG("No master job table\n");
+    return;
+  }
+  uint32_t cycle_us = master_task_get_cycle_time() * 1000;
+  // Average load in budget-microseconds per cycle, scaled by the hyperperiod
+  uint64_t total_us = 0;
+  for (uint8_t i = 0; i < s_num_jobs; ++i) {
+    const MasterJob *job = &s_jobs[s_order[i]];
+    total_us += (uint64_t)job->budget_us * (s_hyperperiod / job->period);
+    LOG_DEBUG("%-12s period %3u phase %3u prio %u budget %6u us, max %6u us, %u over\n",
+              job->name, (unsigned)job->period, (unsigned)job->resolved_phase,
+              (unsigned)job->priority, (unsigned)job->budget_us, (unsigned)job->max_exec_us,
+              (unsigned)job->over_budget);
+  }
+  uint32_t peak_us = master_jobs_peak_load_us();
+  LOG_DEBUG("Hyperperiod %u cycles of %u us: peak %u us (%u%%), average %u us (%u%%)\n",
+            (unsigned)s_hyperperiod, (unsigned)cycle_us, (unsigned)peak_us,
+            (unsigned)((uint64_t)peak_us * 100 / cycle_us),
+            (unsigned)(total_us / s_hyperperiod),
+            (unsigned)(total_us * 100 / s_hyperperiod / cycle_us));
+}
@@ -1,5 +1,12 @@
 #include "master_task.h"
 
+#include "boot.h"
+#include "master_jobs.h"
+#include "timestamp.h"
+#ifdef MS_PLATFORM_X86
+#include "x86_cosim.h"
+#endif
+
 static uint32_t MASTER_MS_CYCLE_TIME = 50;
 
 #define MASTER_TASK_PRIORITY (configMAX_PRIORITIES - 2)
@@ -10,9 +17,20 @@ static uint8_t s_cycles_over = 0;
 static uint32_t s_medium_cycle_count = 10;
 static uint32_t s_slow_cycle_count = 100;
 
+static MasterCycleStats s_cycle_stats[NUM_MASTER_CYCLES];
+
+static const char *s_cycle_names[NUM_MASTER_CYCLES] = {
+  [MASTER_CYCLE_FAST] = "fast",
+  [MASTER_CYCLE_MEDIUM] = "medium",
+  [MASTER_CYCLE_SLOW] = "slow",
+};
+
 void set_master_cycle_time(uint32_t time_ms) {
   MASTER_MS_CYCLE_TIME = time_ms;
 }
+uint32_t master_task_get_cycle_time(void) {
+  return MASTER_MS_CYCLE_TIME;
+}
 void set_medium_cycle_count(uint32_t cycles) {
   s_medium_cycle_count = cycles;
 }
@@ -48,26 +66,72 @@ void check_late_cycle(BaseType_t delay) {
   }
 }
 
+static void prv_run_cycle(MasterCycle cycle, void (*run)(void), uint64_t release_us) {
+  uint64_t start_us = timestamp_us();
+  run();
+  uint64_t end_us = timestamp_us();
+  uint64_t deadline_us = release_us + MASTER_MS_CYCLE_TIME * 1000;
+
+  MasterCycleStats *stats = &s_cycle_stats[cycle];
+  histogram_record(&stats->start_delay, start_us - release_us);
+  histogram_record(&stats->exec, end_us - start_us);
+  if (end_us <= deadline_us) {
+    histogram_record(&stats->slack, deadline_us - end_us);
+  } else {
+    histogram_record(&stats->slack, 0);
+    stats->overruns++;
+  }
+}
+
 TASK(master_task, TASK_STACK_512) {
   uint32_t counter = 1;
-  pre_loop_init();
+  BOOT_PHASE("pre_loop_init", pre_loop_init());
   TickType_t xLastWakeTime = xTaskGetTickCount();
+  uint64_t release_us = timestamp_us();
   while (true) {
     // LOG_DEBUG("counter: %u\n", counter);
+    // Align the releases with the earliest wake up seen, timestamp_us() and ticks are only
+    // guaranteed to share a phase on ARM
+    uint64_t wake_us = timestamp_us();
+    if (wake_us < release_us) {
+      release_us = wake_us;
+    }
 
-    run_fast_cycle();
-    if (!(counter % s_medium_cycle_count)) run_medium_cycle();
-    if (!(counter % s_slow_cycle_count)) run_slow_cycle();
+    if (!master_jobs_run_cycle(counter)) {
+      prv_run_cycle(MASTER_CYCLE_FAST, run_fast_cycle, release_us);
+      if (!(counter % s_medium_cycle_count)) {
+        prv_run_cycle(MASTER_CYCLE_MEDIUM, run_medium_cycle, release_us);
+      }
+      if (!(counter % s_slow_cycle_count)) {
+        prv_run_cycle(MASTER_CYCLE_SLOW, run_slow_cycle, release_us);
+      }
+    }
+
+    if (counter == 1) {
+      // The first cycle has sent the board's first CAN frames, log in its slack
+      boot_log();
+    }
 
     // TODO: perhaps also use xTaskCheckForTimeOut()?
     BaseType_t delay = xTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(MASTER_MS_CYCLE_TIME));
     check_late_cycle(delay);
     ++counter;
+    // Releases stay on the tick grid even when a cycle runs late
+    release_us += MASTER_MS_CYCLE_TIME * 1000;
   }
 }
 
 StatusCode init_master_task() {
   s_cycles_over = 0;
+  master_task_reset_cycle_stats();
+#ifdef MS_PLATFORM_X86
+  // Overruns show up in the co-simulation report
+  if (x86_cosim_connected()) {
+    x86_cosim_add_counter("fast overruns", &s_cycle_stats[MASTER_CYCLE_FAST].overruns);
+    x86_cosim_add_counter("medium overruns", &s_cycle_stats[MASTER_CYCLE_MEDIUM].overruns);
+    x86_cosim_add_counter("slow overruns", &s_cycle_stats[MASTER_CYCLE_SLOW].overruns);
+  }
+#endif
   tasks_init_task(master_task, TASK_PRIORITY(2), NULL);
   return STATUS_CODE_OK;
 }
@@ -75,3 +139,38 @@ StatusCode init_master_task() {
 Task *get_master_task() {
   return master_task;
 }
+
+StatusCode master_task_get_cycle_stats(MasterCycle cycle, MasterCycleStats *stats) {
+  if (cycle >= NUM_MASTER_CYCLES || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  taskENTER_CRITICAL();
+  *stats = s_cycle_stats[cycle];
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+void master_task_reset_cycle_stats(void) {
+  taskENTER_CRITICAL();
+  for (uint8_t i = 0; i < NUM_MASTER_CYCLES; ++i) {
+    histogram_init(&s_cycle_stats[i].start_delay);
+    histogram_init(&s_cycle_stats[i].exec);
+    histogram_init(&s_cycle_stats[i].slack);
+    s_cycle_stats[i].overruns = 0;
+  }
+  taskEXIT_CRITICAL();
+}
+
+void master_task_log_cycle_stats(void) {
+  for (uint8_t i = 0; i < NUM_MASTER_CYCLES; ++i) {
+    const MasterCycleStats *stats = &s_cycle_stats[i];
+    if (stats->exec.count == 0) {
+      continue;
+    }
+    LOG_DEBUG("%s cycle: %u overruns, jitter %u us\n", s_cycle_names[i], (unsigned)stats->overruns,
+              (unsigned)(stats->start_delay.max - stats->start_delay.min));
+    histogram_log(&stats->start_delay, "start delay");
+    histogram_log(&stats->exec, "exec");
+    histogram_log(&stats->slack, "slack");
+  }
+}
@@ -0,0 +1,128 @@
+#include "delay.h"
+#include "log.h"
+#include "master_jobs.h"
+#include "master_task.h"
+#include "misc.h"
+#include "semphr.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define CYCLE_MS 10
+
+static SemaphoreHandle_t s_sem_handle;
+static StaticSemaphore_t s_sem;
+static uint32_t s_cycle;
+static uint32_t s_fast_runs;
+static uint32_t s_medium_runs;
+static uint32_t s_slow_runs;
+static uint32_t s_medium_cycle;
+static uint32_t s_slow_cycle;
+
+static void prv_fast(void) {
+  // Runs first on every cycle, so it counts them
+  s_cycle = s_fast_runs++;
+  if (s_fast_runs == 21) {
+    xSemaphoreGive(s_sem_handle);
+  }
+}
+
+static void prv_medium(void) {
+  s_medium_runs++;
+  s_medium_cycle = s_cycle;
+}
+
+static void prv_slow(void) {
+  s_slow_runs++;
+  s_slow_cycle = s_cycle;
+}
+
+static MasterJob s_jobs[] = {
+  { .name = "slow", .run = prv_slow, .period = 10, .phase = MASTER_JOB_AUTO_PHASE,
+    .priority = 1, .budget_us = 3000 },
+  { .name = "medium", .run = prv_medium, .period = 5, .phase = MASTER_JOB_AUTO_PHASE,
+    .priority = 2, .budget_us = 3000 },
+  { .name = "fast", .run = prv_fast, .period = 1, .phase = 0, .priority = 3, .budget_us = 2000 },
+};
+
+void setup_test(void) {
+  log_init();
+}
+
+void teardown_test(void) {
+  master_jobs_clear();
+}
+
+TEST_IN_TASK
+void test_master_jobs_invalid(void) {
+  MasterJob job = { .name = "bad", .run = prv_fast, .period = 4, .phase = 4 };
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, master_jobs_init(&job, 1));
+  job.period = 0;
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, master_jobs_init(&job, 1));
+  MasterJob coprime[] = {
+    { .name = "a", .run = prv_fast, .period = 31, .phase = 0 },
+    { .name = "b", .run = prv_fast, .period = 37, .phase = 0 },
+  };
+  TEST_ASSERT_EQUAL(STATUS_CODE_OUT_OF_RANGE, master_jobs_init(coprime, SIZEOF_ARRAY(coprime)));
+}
+
+TEST_IN_TASK
+void test_master_jobs_spread(void) {
+  TEST_ASSERT_OK(master_jobs_init(s_jobs, SIZEOF_ARRAY(s_jobs)));
+
+  // The table is left as given, medium and slow are placed on different cycles
+  TEST_ASSERT_EQUAL_STRING("slow", s_jobs[0].name);
+  TEST_ASSERT_EQUAL(MASTER_JOB_AUTO_PHASE, s_jobs[0].phase);
+  TEST_ASSERT_EQUAL(MASTER_JOB_AUTO_PHASE, s_jobs[1].phase);
+  TEST_ASSERT_NOT_EQUAL(s_jobs[1].resolved_phase, s_jobs[0].resolved_phase % s_jobs[1].period);
+  TEST_ASSERT_EQUAL(5000, master_jobs_peak_load_us());
+
+  s_sem_handle = xSemaphoreCreateBinaryStatic(&s_sem);
+  set_master_cycle_time(CYCLE_MS);
+  init_master_task();
+  xSemaphoreTake(s_sem_handle, portMAX_DELAY);
+
+  // 20 cycles complete
+  TEST_ASSERT_EQUAL(4, s_medium_runs);
+  TEST_ASSERT_EQUAL(2, s_slow_runs);
+  TEST_ASSERT_EQUAL(s_jobs[1].resolved_phase, s_medium_cycle % 5);
+  TEST_ASSERT_EQUAL(s_jobs[0].resolved_phase, s_slow_cycle % 10);
+  TEST_ASSERT_EQUAL(20, s_jobs[2].runs);
+  master_jobs_print_schedule();
+}
+
+TEST_IN_TASK
+void test_master_jobs_reinit(void) {
+  MasterJob jobs[] = {
+    { .name = "a", .run = prv_slow, .period = 2, .phase = MASTER_JOB_AUTO_PHASE,
+      .budget_us = 5000 },
+    { .name = "b", .run = prv_slow, .period = 2, .phase = MASTER_JOB_AUTO_PHASE,
+      .budget_us = 1000 },
+    { .name = "c", .run = prv_slow, .period = 2, .phase = MASTER_JOB_AUTO_PHASE,
+      .budget_us = 1000 },
+  };
+  TEST_ASSERT_OK(master_jobs_init(&jobs[1], 2));
+  TEST_ASSERT_EQUAL(1000, master_jobs_peak_load_us());
+  TEST_ASSERT_EQUAL(MASTER_JOB_AUTO_PHASE, jobs[1].phase);
+
+  // Adding a job spreads every automatic job again: b and c share the cycle a doesn't run on,
+  // rather than a being stacked onto one of their old phases
+  TEST_ASSERT_OK(master_jobs_init(jobs, 3));
+  TEST_ASSERT_EQUAL(5000, master_jobs_peak_load_us());
+  TEST_ASSERT_EQUAL(jobs[1].resolved_phase, jobs[2].resolved_phase);
+  TEST_ASSERT_NOT_EQUAL(jobs[0].resolved_phase, jobs[1].resolved_phase);
+}
+
+TEST_IN_TASK
+void test_master_jobs_counter_wrap(void) {
+  MasterJob job = { .name = "last", .run = prv_slow, .period = 4, .phase = 3, .budget_us = 1000 };
+  TEST_ASSERT_OK(master_jobs_init(&job, 1));
+
+  // Counter 4 is cycle 3, so is a counter which has wrapped to 0
+  s_slow_runs = 0;
+  TEST_ASSERT_TRUE(master_jobs_run_cycle(4));
+  TEST_ASSERT_TRUE(master_jobs_run_cycle(0));
+  TEST_ASSERT_TRUE(master_jobs_run_cycle(1));
+  TEST_ASSERT_EQUAL(2, s_slow_runs);
+}
@@ -0,0 +1,80 @@
+#include "delay.h"
+#include "log.h"
+#include "master_task.h"
+#include "semphr.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define CYCLE_MS 10
+#define FAST_MS 2
+#define MEDIUM_MS 3
+// Overruns the cycle
+#define SLOW_MS 12
+// Fast cycles a loaded host may delay past their deadline, e.g. behind a slow cycle
+#define FAST_OVERRUN_TOLERANCE 2
+
+static SemaphoreHandle_t s_sem_handle;
+static StaticSemaphore_t s_sem;
+static uint32_t s_fast_cycles;
+
+void pre_loop_init() {}
+
+void run_fast_cycle() {
+  // Cycles 1 to 8 have been recorded
+  if (++s_fast_cycles == 9) {
+    xSemaphoreGive(s_sem_handle);
+  }
+  delay_ms(FAST_MS);
+}
+
+void run_medium_cycle() {
+  delay_ms(MEDIUM_MS);
+}
+
+void run_slow_cycle() {
+  delay_ms(SLOW_MS);
+}
+
+void setup_test(void) {
+  log_init();
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_master_task_cycle_stats(void) {
+  s_sem_handle = xSemaphoreCreateBinaryStatic(&s_sem);
+  set_master_cycle_time(CYCLE_MS);
+  set_medium_cycle_count(2);
+  set_slow_cycle_count(4);
+  init_master_task();
+
+  // 8 fast, 4 medium and 2 slow cycles
+  xSemaphoreTake(s_sem_handle, portMAX_DELAY);
+
+  MasterCycleStats stats;
+  TEST_ASSERT_OK(master_task_get_cycle_stats(MASTER_CYCLE_FAST, &stats));
+  TEST_ASSERT_EQUAL(8, stats.exec.count);
+  // delay_ms() blocks for whole ticks, so only the lower bound is tight
+  uint32_t exec_p50 = histogram_percentile(&stats.exec, 50);
+  TEST_ASSERT_TRUE(exec_p50 >= (FAST_MS - 1) * 1000);
+  TEST_ASSERT_TRUE(exec_p50 < CYCLE_MS * 1000);
+  TEST_ASSERT_TRUE(stats.overruns <= FAST_OVERRUN_TOLERANCE);
+  TEST_ASSERT_TRUE(stats.slack.max > 0);
+
+  TEST_ASSERT_OK(master_task_get_cycle_stats(MASTER_CYCLE_MEDIUM, &stats));
+  TEST_ASSERT_EQUAL(4, stats.exec.count);
+  // Medium cycles start after the fast cycle
+  TEST_ASSERT_TRUE(stats.start_delay.min >= (FAST_MS - 1) * 1000);
+
+  TEST_ASSERT_OK(master_task_get_cycle_stats(MASTER_CYCLE_SLOW, &stats));
+  TEST_ASSERT_EQUAL(2, stats.exec.count);
+  TEST_ASSERT_EQUAL(2, stats.overruns);
+  TEST_ASSERT_EQUAL(0, stats.slack.min);
+
+  master_task_log_cycle_stats();
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS,
+                    master_task_get_cycle_stats(NUM_MASTER_CYCLES, &stats));
+}
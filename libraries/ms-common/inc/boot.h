@@ -0,0 +1,111 @@
+#pragma once
+// Boot-phase timing and dependency-ordered init
+//
+// Phases time each stage of init on the boot clock, in microseconds from boot_init(), which
+// tasks_init() calls if main() hasn't already:
+//
+//   int main() {
+//     boot_init();
+//     BOOT_PHASE("tasks", tasks_init());
+//     BOOT_PHASE("can", can_init(&s_can_storage, &can_settings));
+//     ...
+//   }
+//
+// tasks_start() marks the start of the scheduler, pre_loop_init() is timed by the master task and
+// can_transmit() marks the first frame sent. The master task logs every phase over UART after its
+// first cycle, and can_diag_tx_boot() sends them over CAN.
+//
+// Init steps with no dependency between them run concurrently once the scheduler has started, so
+// one blocking on relay sequencing or an I2C device doesn't hold up the others:
+//
+//   static StatusCode prv_init_relays(void) { return init_bms_relays(&s_kill_switch); }
+//   ...
+//   static BootStep s_steps[] = {
+//     { .name = "fault_bps", .init = prv_init_fault_bps },
+//     { .name = "relays", .init = prv_init_relays, .deps = BOOT_DEP(0) },
+//     { .name = "afe", .init = prv_init_afe, .deps = BOOT_DEP(0) },
+//   };
+//   boot_run_steps(s_steps, SIZEOF_ARRAY(s_steps));  // In pre_loop_init()
+//
+// boot_run_steps() hands steps whose dependencies have finished to BOOT_NUM_WORKERS worker tasks,
+// in table order, and waits for them. Steps which touch the same peripheral or driver state must
+// depend on one another. A step which fails skips the steps which depend on it, the others still
+// run. Each step is recorded as a phase.
+//
+// The workers are created by the first call, at the caller's priority, and keep their stacks.
+// Build with BOOT_NUM_WORKERS=0 to run every step in the calling task, in table order.
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "status.h"
+#include "tasks.h"
+
+#define BOOT_MAX_PHASES 32
+#define BOOT_MAX_STEPS 16
+#define BOOT_DEP(step) (1u << (step))
+
+#ifndef BOOT_NUM_WORKERS
+#define BOOT_NUM_WORKERS 2
+#endif
+#define BOOT_MAX_WORKERS 3
+
+#ifndef BOOT_WORKER_STACK
+#define BOOT_WORKER_STACK TASK_STACK_512
+#endif
+
+// Longest boot_run_steps() waits for steps running on the workers
+#define BOOT_TIMEOUT_MS 5000
+
+// Returned by boot_phase_begin() once the phase table is full, ignored by boot_phase_end()
+#define BOOT_PHASE_INVALID UINT8_MAX
+
+// Times a call, e.g. BOOT_PHASE("gpio", gpio_init()). The call's result is discarded.
+#define BOOT_PHASE(name, call)                    \
+  do {                                            \
+    uint8_t _boot_phase = boot_phase_begin(name); \
+    call;                                         \
+    boot_phase_end(_boot_phase);                  \
+  } while (0)
+
+typedef struct BootPhase {
+  const char *name;
+  uint32_t start_us;
+  uint32_t duration_us;  // 0 for a mark
+  bool ended;
+} BootPhase;
+
+typedef struct BootStep {
+  const char *name;
+  StatusCode (*init)(void);
+  uint32_t deps;  // BOOT_DEP() of each step which must finish before this one starts
+  // Filled in by boot_run_steps(): the step's result, STATUS_CODE_UNINITIALIZED if a dependency
+  // failed or STATUS_CODE_TIMEOUT if it hadn't finished in time
+  StatusCode status;
+} BootStep;
+
+// Starts the boot clock, later calls do nothing. The clock is only meant for boot: on ARM it
+// counts core cycles and wraps after about a minute at 72 MHz.
+void boot_init(void);
+
+// Microseconds since boot_init(), 0 before it
+uint32_t boot_time_us(void);
+
+// Safe from any task, returns the phase's index for boot_phase_end()
+uint8_t boot_phase_begin(const char *name);
+
+void boot_phase_end(uint8_t phase);
+
+// Records an instant, e.g. the first CAN frame sent
+void boot_mark(const char *name);
+
+uint8_t boot_num_phases(void);
+
+StatusCode boot_get_phase(uint8_t phase, BootPhase *info);
+
+// Logs the start and duration of each phase
+void boot_log(void);
+
+// Runs every step once its dependencies have finished, see above. Returns the first failure, or
+// STATUS_CODE_INVALID_ARGS if a dependency is out of range or the dependencies form a cycle.
+// Only one task may run steps at a time.
+StatusCode boot_run_steps(BootStep *steps, uint8_t num_steps);
@@ -23,6 +23,8 @@
 //      notify(callback_task, event);
 //
 // To manually unregister a callback, use the cancel_callback function.
+//
+// For more callbacks, priorities or callbacks taking an argument, use dispatcher.h.
 
 #include <stdbool.h>
 
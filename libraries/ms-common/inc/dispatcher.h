@@ -0,0 +1,85 @@
+#pragma once
+// Prioritised callback dispatcher
+//
+// Like the callback handler, but not limited to 32 callbacks: each registered callback has a
+// priority, and every dispatch carries a 32 bit argument. Dispatches are queued in a bounded
+// lock-free queue per priority, so any task or interrupt can dispatch without blocking, and run
+// in order by |dispatcher_task|, highest priority first.
+//
+// USAGE:
+//
+//    bool on_adc_sample(void *context, uint32_t arg);
+//
+//    dispatcher_init(TASK_PRIORITY(2));
+//    DispatcherId id = dispatcher_register(on_adc_sample, &adc_state, DISPATCHER_PRIORITY_HIGH);
+//    ...
+//    dispatcher_dispatch(id, sample);  // or dispatcher_dispatch_from_isr() in an interrupt
+//
+// As with the callback handler, a callback returning true is unregistered after it runs. Queued
+// dispatches of an unregistered callback are dropped, even if its ID has been reused since.
+//
+// Capacity is set at build time with DISPATCHER_MAX_CALLBACKS and DISPATCHER_QUEUE_SIZE.
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "histogram.h"
+#include "status.h"
+#include "tasks.h"
+
+#ifndef DISPATCHER_MAX_CALLBACKS
+#define DISPATCHER_MAX_CALLBACKS 64
+#endif
+
+// Dispatches queued per priority, must be a power of two
+#ifndef DISPATCHER_QUEUE_SIZE
+#define DISPATCHER_QUEUE_SIZE 32
+#endif
+
+#define DISPATCHER_INVALID_ID UINT16_MAX
+
+typedef enum {
+  DISPATCHER_PRIORITY_LOW = 0,
+  DISPATCHER_PRIORITY_NORMAL,
+  DISPATCHER_PRIORITY_HIGH,
+  DISPATCHER_PRIORITY_CRITICAL,
+  NUM_DISPATCHER_PRIORITIES,
+} DispatcherPriority;
+
+typedef uint16_t DispatcherId;
+
+// Returns true to unregister the callback
+typedef bool (*DispatcherFn)(void *context, uint32_t arg);
+
+typedef struct DispatcherStats {
+  uint32_t dispatched;  // Callbacks run
+  uint32_t dropped;  // Dispatches rejected because the queue was full
+  uint32_t stale;  // Dispatches of callbacks unregistered before they ran
+  uint16_t peak_depth;
+  Histogram latency_us;  // From dispatch until the callback starts
+} DispatcherStats;
+
+DECLARE_TASK(dispatcher_task);
+
+void dispatcher_init(TaskPriority priority);
+
+// Returns DISPATCHER_INVALID_ID once DISPATCHER_MAX_CALLBACKS are registered
+DispatcherId dispatcher_register(DispatcherFn fn, void *context, DispatcherPriority priority);
+
+// Queued dispatches of the callback are dropped
+StatusCode dispatcher_cancel(DispatcherId id);
+
+// Queues a call of the callback with |arg|, STATUS_CODE_RESOURCE_EXHAUSTED if its priority's
+// queue is full
+StatusCode dispatcher_dispatch(DispatcherId id, uint32_t arg);
+
+StatusCode dispatcher_dispatch_from_isr(DispatcherId id, uint32_t arg);
+
+// Dispatches waiting in a priority's queue
+uint16_t dispatcher_queue_depth(DispatcherPriority priority);
+
+StatusCode dispatcher_get_stats(DispatcherPriority priority, DispatcherStats *stats);
+
+void dispatcher_reset_stats(void);
+
+// Logs counts, peak queue depth and latency percentiles of each priority
+void dispatcher_log_stats(void);
@@ -0,0 +1,62 @@
+#pragma once
+// Fork-join of the stages of a master cycle
+//
+// A stage's start function launches its work through the usual cycle helpers, e.g.
+// run_can_rx_cycle() or fsm_run_cycle(), which mark the tasks they notify as expected
+// (tasks_expect_end()). The stage ends once all of those tasks call send_task_end(). A stage
+// which starts no task, e.g. adc_run(), runs inline and ends when its start function returns.
+//
+// fork_join_run() starts every stage whose dependencies have ended, waits for any running stage
+// to end, and repeats until all stages have ended, so independent stages overlap while one
+// blocks on I2C or SPI. Stages with met dependencies start in table order.
+//
+// Usage:
+//   static void prv_start_can_rx(void) { run_can_rx_cycle(); }
+//   ...
+//   static ForkJoinStage s_stages[] = {
+//     { .name = "can_rx", .start = prv_start_can_rx },
+//     { .name = "lights", .start = prv_start_lights, .deps = FORK_JOIN_DEP(0) },
+//     { .name = "can_tx", .start = prv_start_can_tx, .deps = FORK_JOIN_DEP(1) },
+//   };
+//   static ForkJoin s_cycle;
+//   fork_join_init(&s_cycle, s_stages, SIZEOF_ARRAY(s_stages));
+//   fork_join_run(&s_cycle);  // In the master cycle instead of notify/wait_tasks pairs
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "status.h"
+#include "tasks.h"
+
+#define FORK_JOIN_MAX_STAGES 16
+#define FORK_JOIN_DEP(stage) (1u << (stage))
+
+typedef struct ForkJoinStage {
+  const char *name;
+  void (*start)(void);
+  uint32_t deps;  // FORK_JOIN_DEP() of each stage which must end before this one starts
+  // Filled in by fork_join_run(), in microseconds
+  uint32_t start_us;  // Start of the last run, from the start of fork_join_run()
+  uint32_t last_us;  // Duration of the last run
+  uint32_t max_us;
+  TaskMask tasks;  // Tasks started by the last run which haven't ended
+} ForkJoinStage;
+
+typedef struct ForkJoin {
+  ForkJoinStage *stages;
+  uint8_t num_stages;
+  uint32_t runs;
+  uint32_t timeouts;
+  uint32_t last_us;
+  uint32_t max_us;
+} ForkJoin;
+
+// Fails if a dependency is out of range or the dependencies form a cycle
+StatusCode fork_join_init(ForkJoin *fork_join, ForkJoinStage *stages, uint8_t num_stages);
+
+// Runs every stage once, returns STATUS_CODE_TIMEOUT if a stage hasn't ended within
+// WAIT_TASK_TIMEOUT_MS. The tasks which haven't ended are counted as missed, like wait_tasks(), and
+// stages which depend on them are skipped.
+StatusCode fork_join_run(ForkJoin *fork_join);
+
+// Logs the start offset and duration of each stage
+void fork_join_log(const ForkJoin *fork_join);
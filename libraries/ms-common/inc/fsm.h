@@ -57,6 +57,16 @@
 // To communicate with the fsm, ie send a notification, simply use
 // the name supplied upon creation:
 //    notify(fsm_name, notify_event);
+//
+// FSMs which don't need a task of their own can be declared with FSM_SHARED() instead and run by
+// an executor (see fsm_executor.h), which steps many of them on one task or inline in the caller.
+// Their transitions are a sparse list, stored as a bitset of destinations per state:
+//    FSM_SHARED(fsm_name, NUM_STATES);
+//    static const FsmTransition s_transitions[] = {
+//      FSM_TRANSITION(from, to),
+//      ...
+//    };
+//    fsm_shared_init(fsm_name, s_list, s_transitions, INITIAL_STATE, context);
 
 #include "notify.h"
 #include "semphr.h"
@@ -69,6 +79,8 @@
 #define FSM_TIMEOUT_MS 1000
 // TODO(mitchellostler): make this defined as part of project API
 #define CYCLE_RX_MAX 15
+// Shared FSMs keep one 32 bit transition bitset per state
+#define FSM_SHARED_MAX_STATES 32
 
 struct Fsm;
 typedef uint8_t StateId;
@@ -81,15 +93,22 @@ typedef struct FsmState {
   StateOutputFunc outputs;  // Output function associated with state
 } FsmState;
 
+typedef struct FsmTransition {
+  StateId from;
+  StateId to;
+} FsmTransition;
+
 typedef struct Fsm {
   FsmState *states;
-  bool *transition_table;
+  bool *transition_table;  // Dense num_states x num_states table, FSM() only
+  uint32_t *transition_rows;  // Bitset of destinations per state, FSM_SHARED() only
   void *context;
   StateId curr_state;
   const uint8_t num_states;
   bool transitioned;
+  // FSM() only, shared FSMs are stepped by their executor
   SemaphoreHandle_t fsm_sem;
-  StaticSemaphore_t sem_buf;
+  StaticSemaphore_t *sem_buf;
 } Fsm;
 
 // Forward declares an extern pointer to a task of name "fsm_name"
@@ -107,13 +126,27 @@ typedef struct Fsm {
 // and initializes its associated FSM task
 // num_states must be a defined constant
 #define FSM(name, num_fsm_states, stack_size) \
+  static StaticSemaphore_t _s_sem_buf_##name; \
   Fsm *name##_fsm = &((Fsm){                  \
       .num_states = num_fsm_states,           \
+      .sem_buf = &_s_sem_buf_##name,          \
   });                                         \
   TASK(name, stack_size) {                    \
     _fsm_task(context);                       \
   }
 
+// Forward declares a shared FSM, which has no task
+#define DECLARE_SHARED_FSM(name) extern Fsm *name##_fsm
+
+// Creates an FSM without a task, to be run by an executor
+// num_states must be a defined constant, at most FSM_SHARED_MAX_STATES
+#define FSM_SHARED(name, num_fsm_states)                                        \
+  _Static_assert((num_fsm_states) <= FSM_SHARED_MAX_STATES, "Too many states"); \
+  Fsm *name##_fsm = &((Fsm){                                                    \
+      .num_states = num_fsm_states,                                             \
+      .transition_rows = (uint32_t[num_fsm_states]){ 0 },                       \
+  })
+
 // Creates state with associated id in a state list
 // State id must be unique (preferred to use enum type)
 #define STATE(state_id, input_func, output_func) \
@@ -123,6 +156,9 @@ typedef struct Fsm {
 // Must be declared in a transition list
 #define TRANSITION(from_state, to_state) [from_state][to_state] = true
 
+// Defines a transition in the sparse transition list of a shared FSM
+#define FSM_TRANSITION(from_state, to_state) { .from = (from_state), .to = (to_state) }
+
 // Initialize an FSM
 // fsm_init(fsm, FsmState[] states, bool[][] transitions, StateId initial_state, void *context)
 #define fsm_init(fsm, states, transitions, initial_state, context)                    \
@@ -131,6 +167,14 @@ typedef struct Fsm {
   tasks_init_task(fsm, TASK_PRIORITY(FSM_PRIORITY), fsm##_fsm);                       \
   _init_fsm(fsm##_fsm, states, *transitions, initial_state, context)
 
+// Initialize a shared FSM
+// fsm_shared_init(fsm, FsmState[] states, const FsmTransition[] transitions,
+//                 StateId initial_state, void *context)
+#define fsm_shared_init(fsm, states, transitions, initial_state, context)                    \
+  configASSERT(SIZEOF_ARRAY(states) == fsm##_fsm->num_states);                               \
+  _init_shared_fsm(fsm##_fsm, states, transitions, SIZEOF_ARRAY(transitions), initial_state, \
+                   context)
+
 // Initiates a transition from the current state
 // Transition must exist in transition table
 StatusCode fsm_transition(Fsm *fsm, StateId to);
@@ -139,10 +183,21 @@ StatusCode fsm_transition(Fsm *fsm, StateId to);
 // Should be called with name supplied to FSM()
 void fsm_run_cycle(Task *fsm);
 
+// Runs the current state's input function, and the new state's output function if it
+// transitioned, in the calling task
+void fsm_step(Fsm *fsm);
+
+// RAM used by the FSM's structure and transitions, not counting its task
+size_t fsm_ram_bytes(const Fsm *fsm);
+
 // Internal implementation to initialize FSM
 // Do not call directly. Use the fsm_init() macro above
 StatusCode _init_fsm(Fsm *fsm, FsmState *states, bool *transitions, StateId initial_state,
                      void *context);
 
+// Do not call directly. Use the fsm_shared_init() macro above
+StatusCode _init_shared_fsm(Fsm *fsm, FsmState *states, const FsmTransition *transitions,
+                            size_t num_transitions, StateId initial_state, void *context);
+
 // Fsm task function implementation - Do not call directly
 void _fsm_task(void *context);
@@ -0,0 +1,90 @@
+#pragma once
+// FSM executor: steps many shared FSMs together
+//
+// An FSM() has its own task and stack, and each cycle is a semaphore handshake plus
+// send_task_end(). FSMs declared with FSM_SHARED() have neither; an executor steps each of its
+// FSMs in turn, either on one task shared by all of them or inline in the caller.
+//
+// On a task, for FSMs whose state functions block (e.g. on I2C):
+//    FSM_EXECUTOR(pd_fsms, TASK_STACK_512);
+//    fsm_executor_init(pd_fsms);
+//    fsm_executor_add(pd_fsms_executor, lights_fsm);
+//    fsm_executor_add(pd_fsms_executor, power_seq_fsm);
+//    ...
+//    fsm_executor_run_cycle(pd_fsms_executor);  // Ends with send_task_end(), like fsm_run_cycle()
+//
+// Inline, for FSMs which never block:
+//    static FsmExecutor s_executor;
+//    fsm_executor_init_inline(&s_executor);
+//    fsm_executor_add(&s_executor, fsm1_fsm);
+//    fsm_executor_run_cycle(&s_executor);  // Returns once every FSM has stepped
+//
+// fsm_executor_log_report() compares the RAM used with what the same FSMs would use on their own
+// tasks, and logs how long cycles take.
+#include <stdint.h>
+
+#include "fsm.h"
+#include "histogram.h"
+#include "semphr.h"
+#include "status.h"
+#include "tasks.h"
+
+#define FSM_EXECUTOR_MAX_FSMS 8
+
+typedef struct FsmExecutor {
+  Fsm *fsms[FSM_EXECUTOR_MAX_FSMS];
+  uint8_t num_fsms;
+  Task *task;  // NULL when cycles run inline
+  SemaphoreHandle_t cycle_sem;
+  StaticSemaphore_t sem_buf;
+  uint32_t cycles;
+  // Time from fsm_executor_run_cycle() until every FSM has stepped
+  Histogram cycle_us;
+  uint32_t cycle_start_us;
+} FsmExecutor;
+
+typedef struct FsmExecutorReport {
+  uint8_t num_fsms;
+  // FSMs, executor and its task, if any
+  uint32_t ram_bytes;
+  // The same FSMs declared with FSM(), each with a FSM_TASK_STACK task
+  uint32_t task_ram_bytes;
+  uint32_t cycles;
+  uint32_t cycle_mean_us;
+  uint32_t cycle_max_us;
+} FsmExecutorReport;
+
+#define DECLARE_FSM_EXECUTOR(name) \
+  DECLARE_TASK(name);              \
+  extern FsmExecutor *name##_executor
+
+// Creates an executor and the task it runs FSMs on
+#define FSM_EXECUTOR(name, stack_size)                  \
+  FsmExecutor *name##_executor = &((FsmExecutor){ 0 }); \
+  TASK(name, stack_size) {                              \
+    _fsm_executor_task(context);                        \
+  }
+
+// Initializes an executor declared with FSM_EXECUTOR() and starts its task
+#define fsm_executor_init(name)                                        \
+  tasks_init_task(name, TASK_PRIORITY(FSM_PRIORITY), name##_executor); \
+  _fsm_executor_init(name##_executor, name)
+
+// Initializes an executor without a task, its FSMs step in fsm_executor_run_cycle()
+#define fsm_executor_init_inline(executor) _fsm_executor_init((executor), NULL)
+
+// FSMs step in the order they're added
+StatusCode fsm_executor_add(FsmExecutor *executor, Fsm *fsm);
+
+// Steps every FSM once
+void fsm_executor_run_cycle(FsmExecutor *executor);
+
+void fsm_executor_get_report(const FsmExecutor *executor, FsmExecutorReport *report);
+
+void fsm_executor_log_report(const FsmExecutor *executor);
+
+// Do not call directly. Use fsm_executor_init() or fsm_executor_init_inline()
+StatusCode _fsm_executor_init(FsmExecutor *executor, Task *task);
+
+// Executor task function implementation - Do not call directly
+void _fsm_executor_task(void *context);
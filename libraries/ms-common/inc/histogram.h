@@ -0,0 +1,39 @@
+#pragma once
+// Log-linear histogram of unsigned samples, e.g. latencies in microseconds
+//
+// Each power of two is split into HISTOGRAM_SUB_BUCKETS buckets, so a bucket is at most
+// 1 / HISTOGRAM_SUB_BUCKETS of its value wide. Samples above the last bucket are counted in it.
+// Recording is O(1) with no locking, so each histogram must only have a single writer.
+#include <stdint.h>
+
+#include "status.h"
+
+#define HISTOGRAM_SUB_BITS 1
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+// Last bucket starts at 3 * 2^20, about 3s for microsecond samples
+#define HISTOGRAM_NUM_BUCKETS 44
+
+typedef struct Histogram {
+  uint32_t buckets[HISTOGRAM_NUM_BUCKETS];
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+} Histogram;
+
+void histogram_init(Histogram *hist);
+
+void histogram_record(Histogram *hist, uint32_t value);
+
+// Lowest value which falls in a bucket
+uint32_t histogram_bucket_lower(uint8_t bucket);
+
+uint8_t histogram_bucket_index(uint32_t value);
+
+uint32_t histogram_mean(const Histogram *hist);
+
+// Upper bound of the bucket containing the given percentile (0-100), capped at the max sample
+uint32_t histogram_percentile(const Histogram *hist, uint8_t percentile);
+
+// Logs count, min, mean, p50, p99 and max, followed by the non-empty buckets
+StatusCode histogram_log(const Histogram *hist, const char *name);
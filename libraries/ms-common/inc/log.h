@@ -41,13 +41,17 @@ extern UartSettings log_uart_settings;
 #define LOG_CRITICAL(fmt, ...) LOG(LOG_LEVEL_CRITICAL, fmt, ##__VA_ARGS__)
 
 #ifdef MS_PLATFORM_X86
-#define log_init() \
-  { mutex_init(&s_log_mutex); }
+#define log_init()                               \
+  {                                              \
+    mutex_init(&s_log_mutex);                    \
+    mutex_profile_set_name(&s_log_mutex, "log"); \
+  }
 #else
-#define log_init()                           \
-  {                                          \
-    mutex_init(&s_log_mutex);                \
-    uart_init(UARTPORT, &log_uart_settings); \
+#define log_init()                               \
+  {                                              \
+    mutex_init(&s_log_mutex);                    \
+    mutex_profile_set_name(&s_log_mutex, "log"); \
+    uart_init(UARTPORT, &log_uart_settings);     \
   }
 #endif
 
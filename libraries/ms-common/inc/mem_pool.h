@@ -0,0 +1,119 @@
+#pragma once
+// Fixed-block pools and bump arenas, in place of malloc
+//
+// Both are sized at compile time and take their storage from a static buffer:
+//
+//   MEM_POOL_DEFINE(s_frame_pool, sizeof(CanMessage), 16);
+//   CanMessage *msg = mem_pool_alloc(&s_frame_pool);
+//   ...
+//   mem_pool_free(&s_frame_pool, msg);
+//
+//   MEM_ARENA_DEFINE(s_scratch, 512);
+//   size_t mark = mem_arena_mark(&s_scratch);
+//   uint8_t *buf = mem_arena_alloc(&s_scratch, len);
+//   ...
+//   mem_arena_rewind(&s_scratch, mark);
+//
+// A pool hands out blocks of one size, and any block can be freed in any order, e.g. buffers passed
+// between tasks or from an ISR to a task. An arena hands out any size by moving a pointer, and is
+// freed all at once, back to a mark, e.g. reassembling a multi-frame message.
+//
+// Allocating and freeing are O(1) and lock-free, so they're safe from tasks and interrupts alike
+// without masking interrupts. Allocations are aligned to MEM_ALIGN. Running out returns NULL and
+// calls the overflow hook, so callers must handle it; the most ever in use is kept to size them.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "status.h"
+
+#define MEM_ALIGN 8
+#define MEM_ALIGN_UP(size) (((size) + MEM_ALIGN - 1) & ~(size_t)(MEM_ALIGN - 1))
+// Free blocks hold the free list's next pointer
+#define MEM_POOL_BLOCK_BYTES(size) \
+  MEM_ALIGN_UP((size) < sizeof(void *) ? sizeof(void *) : (size))
+
+// Called with the pool or arena's name and the size that couldn't be allocated, possibly from an
+// interrupt
+typedef void (*MemOverflowHook)(const char *name, size_t size);
+
+typedef struct MemPool {
+  const char *name;
+  uint8_t *storage;
+  size_t block_size;
+  uint16_t num_blocks;
+  // Blocks past this have never been allocated, so the free list needs no setup
+  uint16_t num_touched;
+  // Index + 1 of the first free block, 0 if none, and a count of changes in the top half so a
+  // stale head can't be swapped in
+  uint32_t free_head;
+  uint16_t in_use;
+  uint16_t peak_in_use;
+  uint32_t failures;
+} MemPool;
+
+typedef struct MemArena {
+  const char *name;
+  uint8_t *storage;
+  size_t size;
+  size_t used;
+  size_t peak_used;
+  uint32_t failures;
+} MemArena;
+
+// Blocks for pools, bytes for arenas
+typedef struct MemStats {
+  size_t capacity;
+  size_t in_use;
+  size_t peak_in_use;
+  uint32_t failures;
+} MemStats;
+
+#define MEM_POOL_DEFINE(pool, size, count)                                                  \
+  static _Alignas(MEM_ALIGN) uint8_t pool##_storage[(count)*MEM_POOL_BLOCK_BYTES(size)];    \
+  _Static_assert((count) > 0 && (count) < UINT16_MAX, #pool ": block count out of range");  \
+  static MemPool pool = {                                                                   \
+    .name = #pool,                                                                          \
+    .storage = pool##_storage,                                                              \
+    .block_size = MEM_POOL_BLOCK_BYTES(size),                                               \
+    .num_blocks = (count),                                                                  \
+  }
+
+#define MEM_ARENA_DEFINE(arena, bytes)                                          \
+  static _Alignas(MEM_ALIGN) uint8_t arena##_storage[MEM_ALIGN_UP(bytes)];      \
+  static MemArena arena = {                                                     \
+    .name = #arena,                                                             \
+    .storage = arena##_storage,                                                 \
+    .size = MEM_ALIGN_UP(bytes),                                                \
+  }
+
+// One hook for every pool and arena, NULL for none. Failures are counted either way.
+void mem_set_overflow_hook(MemOverflowHook hook);
+
+// NULL if every block is in use
+void *mem_pool_alloc(MemPool *pool);
+
+// Fails if the pointer isn't the start of one of the pool's blocks. Freeing a block twice corrupts
+// the pool.
+StatusCode mem_pool_free(MemPool *pool, void *block);
+
+bool mem_pool_contains(const MemPool *pool, const void *block);
+
+// Frees every block, which mustn't be used afterwards, and clears the stats. Not safe while
+// other tasks or interrupts use the pool.
+void mem_pool_reset(MemPool *pool);
+
+void mem_pool_get_stats(const MemPool *pool, MemStats *stats);
+
+// NULL if there isn't room, the arena isn't changed
+void *mem_arena_alloc(MemArena *arena, size_t size);
+
+// Position to rewind to, freeing everything allocated after it
+size_t mem_arena_mark(const MemArena *arena);
+
+StatusCode mem_arena_rewind(MemArena *arena, size_t mark);
+
+// Frees everything, keeping the high-water mark
+void mem_arena_reset(MemArena *arena);
+
+void mem_arena_get_stats(const MemArena *arena, MemStats *stats);
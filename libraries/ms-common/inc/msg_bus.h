@@ -0,0 +1,107 @@
+#pragma once
+// Message bus: publish/subscribe with typed payloads
+//
+// Extends notify's topics to carry data. A publisher allocates a payload from a fixed-block pool,
+// fills it in and publishes it. Every subscriber of the topic gets a pointer to the same block in
+// its mailbox and an event notification, nothing is copied. The block is reference counted and
+// returned to the pool once every subscriber has released it.
+//
+//   // Publisher
+//   BatteryStatus *status = MSG_BUS_ALLOC(TOPIC_1, BatteryStatus);
+//   if (status != NULL) {
+//     status->voltage = ...;
+//     msg_bus_publish(TOPIC_1, status);
+//   }
+//
+//   // Subscriber, after msg_bus_subscribe(my_task, TOPIC_1, MY_EVENT)
+//   const BatteryStatus *status;
+//   while (msg_bus_receive(TOPIC_1, (const void **)&status) == STATUS_CODE_OK) {
+//     ...
+//     msg_bus_release(status);
+//   }
+//
+// Each topic carries a single payload type, set with msg_bus_configure_topic(). When a
+// subscriber's mailbox is full, the topic's policy either drops the new message for that
+// subscriber, drops the oldest message in its mailbox, or blocks the publisher until there's
+// room. Allocating from an empty pool returns NULL, so publishers see back-pressure there too.
+//
+// Mailboxes are looked up by the calling task, so a task receives its own messages only.
+// Every function must be called from a task, never an interrupt: they use taskENTER_CRITICAL()
+// and notify() rather than their _FROM_ISR forms. An interrupt should hand its data to a task,
+// e.g. with notify_from_isr(), and let the task publish it.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram.h"
+#include "notify.h"
+#include "status.h"
+#include "tasks.h"
+
+// Largest payload
+#ifndef MSG_BUS_BLOCK_SIZE
+#define MSG_BUS_BLOCK_SIZE 32
+#endif
+
+#ifndef MSG_BUS_NUM_BLOCKS
+#define MSG_BUS_NUM_BLOCKS 16
+#endif
+
+#define MSG_BUS_MAX_SUBSCRIBERS 4
+// Messages waiting per subscriber
+#define MSG_BUS_MAILBOX_SIZE 4
+
+typedef enum {
+  MSG_BUS_DROP_NEWEST = 0,
+  MSG_BUS_DROP_OLDEST,
+  // Publisher waits up to block_ms for room, then drops the newest message
+  MSG_BUS_BLOCK,
+  NUM_MSG_BUS_POLICIES,
+} MsgBusPolicy;
+
+typedef struct MsgBusTopicSettings {
+  size_t payload_size;
+  MsgBusPolicy policy;
+  uint16_t block_ms;
+} MsgBusTopicSettings;
+
+typedef struct MsgBusStats {
+  uint32_t published;
+  uint32_t delivered;  // Messages added to a mailbox, once per subscriber
+  uint32_t dropped;  // Messages a subscriber didn't get because its mailbox was full
+  uint32_t blocked;  // Publishes which waited for room
+  uint32_t alloc_failures;
+  Histogram latency_us;  // From publish until each subscriber receives the message
+} MsgBusStats;
+
+// Allocates a payload of the given type, NULL if the type isn't the topic's or the pool is empty
+#define MSG_BUS_ALLOC(topic, type) ((type *)msg_bus_alloc((topic), sizeof(type)))
+
+// Clears every topic, subscription and message
+void msg_bus_init(void);
+
+StatusCode msg_bus_configure_topic(Topic topic, const MsgBusTopicSettings *settings);
+
+// The task is notified with |event| when a message is added to its mailbox
+StatusCode msg_bus_subscribe(Task *task, Topic topic, Event event);
+
+// Size must match the topic's payload size
+void *msg_bus_alloc(Topic topic, size_t size);
+
+// Returns a payload which won't be published to the pool
+StatusCode msg_bus_free(void *payload);
+
+// Hands the payload to every subscriber, the publisher mustn't touch it afterwards. Task only.
+StatusCode msg_bus_publish(Topic topic, void *payload);
+
+// Takes the oldest message in the calling task's mailbox, STATUS_CODE_EMPTY if there are none
+// The payload stays valid until it's released
+StatusCode msg_bus_receive(Topic topic, const void **payload);
+
+StatusCode msg_bus_release(const void *payload);
+
+StatusCode msg_bus_get_stats(Topic topic, MsgBusStats *stats);
+
+// Blocks currently allocated, and the most there have been since msg_bus_init
+uint16_t msg_bus_blocks_in_use(void);
+uint16_t msg_bus_peak_blocks_in_use(void);
@@ -1,5 +1,6 @@
 #pragma once
 // Library encompassing task-to-task and interrupt to task notifications
+// To publish data along with an event, use the message bus (msg_bus.h)
 
 #include "FreeRTOS.h"
 #include "status.h"
@@ -13,6 +13,7 @@ typedef struct {
   uint8_t *storage_buf;  // Must be declared statically, and have size num_items*item_size
   StaticQueue_t queue;   // Internal Queue storage
   QueueHandle_t handle;  // Handle used for all queue operations
+  uint32_t peak_items;   // Most items held at once, only tracked with MS_RUN_TIME_STATS
 } Queue;
 
 // Create a queue with the parameters specified in settings. Returns STATUS_CODE_OK if successful,
@@ -0,0 +1,64 @@
+#pragma once
+// FreeRTOS run-time statistics
+//
+// Per-task CPU usage, stack high-water marks and queue depth peaks. Disabled by default, since
+// the kernel samples the run-time counter on every context switch. Build with
+// --define=MS_RUN_TIME_STATS to enable it, otherwise every call is a stub and nothing is added to
+// the kernel or the queue wrappers.
+//
+// The run-time counter counts microseconds. ARM extends the DWT cycle counter in software, which
+// relies on a context switch at least every 2^32 CPU cycles (~59s at 72MHz). x86 uses
+// CLOCK_MONOTONIC.
+//
+// run_time_stats_update() closes the current measurement window and snapshots every task, which
+// can then be read back with run_time_stats_get_task(). Call it periodically from one task, e.g.
+// the slow master cycle.
+#include <stdint.h>
+
+#include "queues.h"
+#include "status.h"
+
+#define RUN_TIME_STATS_MAX_TASKS 20
+#define RUN_TIME_STATS_MAX_QUEUES 16
+
+typedef struct RunTimeTaskStats {
+  const char *name;
+  uint8_t number;  // Order the task was created in, stable across updates
+  uint16_t cpu_permyriad;  // Share of the last window spent in the task, in 0.01%
+  uint32_t run_time_us;  // Time spent in the task in the last window
+  uint32_t stack_high_water;  // Least free stack since the task started, in words
+} RunTimeTaskStats;
+
+typedef struct RunTimeQueueStats {
+  uint32_t num_items;  // Capacity
+  uint32_t item_size;
+  uint32_t items;  // Items currently waiting
+  uint32_t peak_items;  // Most items waiting at once since the queue was created
+} RunTimeQueueStats;
+
+// Hooks for FreeRTOSConfig.h, called by the kernel
+void run_time_stats_timer_init(void);
+uint32_t run_time_stats_counter(void);
+
+// Closes the measurement window and snapshots every task
+// Returns STATUS_CODE_UNIMPLEMENTED if the stats are disabled.
+StatusCode run_time_stats_update(void);
+
+// Length of the last window, in microseconds
+uint32_t run_time_stats_get_window_us(void);
+
+// Number of tasks in the last snapshot, ordered by task number
+uint8_t run_time_stats_num_tasks(void);
+
+StatusCode run_time_stats_get_task(uint8_t index, RunTimeTaskStats *stats);
+
+// Tracks a queue's depth, called by queue_init
+void run_time_stats_register_queue(Queue *queue);
+
+// Number of queues registered, in the order they were initialized
+uint8_t run_time_stats_num_queues(void);
+
+StatusCode run_time_stats_get_queue(uint8_t index, RunTimeQueueStats *stats);
+
+// Logs the last snapshot and the queue peaks
+void run_time_stats_log(void);
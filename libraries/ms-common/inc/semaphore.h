@@ -1,18 +1,46 @@
 #pragma once
 // Wrapper library for all mutex and semaphore usage
+//
+// Contention profiling: build with --define=MS_MUTEX_PROFILE to record, for each mutex and
+// semaphore, how often it's taken, how long callers wait for it and how long mutexes are held.
+// The wrappers keep their signatures, give a mutex a name for the report with
+// mutex_profile_set_name(). Without the define the profiling calls are stubs and the wrappers
+// are unchanged.
 #include <stdbool.h>
 
 #include "FreeRTOS.h"
+#include "histogram.h"
 #include "semphr.h"
 #include "status.h"
+#include "task.h"
 
 #define BLOCK_INDEFINITELY UINT16_MAX
 
+// Mutexes and semaphores profiled, later ones aren't
+#define MUTEX_PROFILE_MAX 12
+
+typedef struct MutexProfile {
+  const char *name;
+  bool is_mutex;
+  uint32_t acquisitions;
+  uint32_t contended;  // Acquisitions which had to wait
+  uint32_t timeouts;
+  Histogram wait_us;  // Time from calling lock or wait until the mutex or semaphore was taken
+  Histogram hold_us;  // Time from lock to unlock, mutexes only
+  const char *longest_holder;  // Task which held the mutex the longest
+  // Current holder, mutexes only
+  TaskHandle_t holder;
+  uint64_t locked_us;
+} MutexProfile;
+
 // Mutex Objects must be declared statically
 // Mutexes should NOT be used from ISRs (only sems)
 typedef struct Semaphore {
   SemaphoreHandle_t handle;
   StaticSemaphore_t buffer;
+#ifdef MS_MUTEX_PROFILE
+  MutexProfile *profile;  // Assigned by mutex_init or sem_init, NULL once the pool is used up
+#endif
 } Semaphore;
 
 typedef Semaphore Mutex;
@@ -51,3 +79,18 @@ StatusCode sem_post(Semaphore *sem);
 // Returns a semaphore's current counting value in case it is a counting semaphore
 // If semaphore is binary, returns 1 when the semaphore is available and 0 if it is not
 uint32_t sem_num_items(Semaphore *sem);
+
+// Names a mutex or semaphore in the profiling report, call after initializing it
+void mutex_profile_set_name(Mutex *mutex, const char *name);
+
+// Number of mutexes and semaphores profiled, in the order they were initialized
+uint8_t mutex_profile_count(void);
+
+// Copies a profile, returns STATUS_CODE_UNIMPLEMENTED unless built with MS_MUTEX_PROFILE
+StatusCode mutex_profile_get(uint8_t index, MutexProfile *profile);
+
+// Clears the statistics of every profile, keeping names
+void mutex_profile_reset(void);
+
+// Logs each profile, most contended first
+void mutex_profile_log(void);
@@ -3,24 +3,57 @@
 // Software-based timers using FreeRTOS
 // Soft timers should only be used for delayed function calls, use tasks and delayUntil for periodic
 // code running
+//
+// Timers are kept in a hierarchical timer wheel serviced by a single soft_timer task, so starting,
+// resetting and cancelling a timer is O(1) and takes effect immediately, with no command queue to
+// fill up. The task sleeps until the next slot which has timers in it, then runs every expired
+// callback in one batch. Callbacks run in the soft_timer task and should be short.
+//
+// Level 0 of the wheel has one slot per tick, each level above it covers SOFT_TIMER_WHEEL_SLOTS
+// times more. Timers further out than the wheel covers are parked in the last level and re-placed
+// as it turns.
 
 #include <stdbool.h>
 #include <stdint.h>
 
 #include "FreeRTOS.h"
 #include "status.h"
-#include "timers.h"
 
-typedef TimerHandle_t SoftTimerId;
+#define SOFT_TIMER_WHEEL_BITS 6
+#define SOFT_TIMER_WHEEL_SLOTS (1 << SOFT_TIMER_WHEEL_BITS)
+// 2^24 ticks, about 4.6 hours at 1 kHz
+#define SOFT_TIMER_WHEEL_LEVELS 4
+
+// Same as the kernel's timer service task it replaces
+#define SOFT_TIMER_TASK_PRIORITY 3
+
+typedef struct SoftTimer *SoftTimerId;
+
+// Soft timer callback, called when soft timer expire
+typedef void (*SoftTimerCallback)(SoftTimerId id);
 
 // Soft timer storage, must be declared statically
 typedef struct SoftTimer {
-  StaticTimer_t buffer;
-  SoftTimerId id;
+  SoftTimerCallback callback;
+  TickType_t duration;
+  TickType_t expiry;
+  // Wheel slot list, pprev is NULL while the timer isn't running
+  struct SoftTimer *next;
+  struct SoftTimer **pprev;
+  uint16_t slot;
+  SoftTimerId id;  // The timer itself once initialized
 } SoftTimer;
 
-// Soft timer callback, called when soft timer expire
-typedef void (*SoftTimerCallback)(SoftTimerId id);
+typedef struct SoftTimerStats {
+  uint32_t expired;
+  // Expirations whose callback ran at least a tick after the timer's expiry
+  uint32_t late;
+  uint32_t max_late_ms;
+  // Most callbacks run in a single wakeup of the soft_timer task
+  uint16_t max_batch;
+  uint16_t active;
+  uint16_t peak_active;
+} SoftTimerStats;
 
 // Adds a software timer. The provided duration is the number of
 // miliseconds before running and the callback is the process to run once
@@ -33,10 +66,10 @@ StatusCode soft_timer_init_and_start(uint32_t duration_ms, SoftTimerCallback cal
 StatusCode soft_timer_init(uint32_t duration_ms, SoftTimerCallback callback, SoftTimer *timer);
 
 // Starts the software timer. The timer must already be initialized
+// Starting a running timer restarts it
 StatusCode soft_timer_start(SoftTimer *timer);
 
-// Cancels the soft timer specified by name. Returns true if successful.
-// the timer is not cancelled immediately,
+// Cancels the soft timer, its callback won't run unless it's already running
 StatusCode soft_timer_cancel(SoftTimer *timer);
 
 // restart the timer
@@ -45,6 +78,8 @@ StatusCode soft_timer_reset(SoftTimer *timer);
 // Checks if the software timer is running
 bool soft_timer_inuse(SoftTimer *timer);
 
-// Checks the time left in ticks on a particular timer. Returns a 0 if the timer
+// Checks the time left in ms on a particular timer. Returns a 0 if the timer
 // has expired and is no longer in use.
 uint32_t soft_timer_remaining_time(SoftTimer *timer);
+
+void soft_timer_get_stats(SoftTimerStats *stats);
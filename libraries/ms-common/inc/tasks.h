@@ -24,11 +24,18 @@
 //
 //   tasks_init_task(my_cool_task, TASK_PRIORITY(1), my_context);
 //   tasks_start(); // Does not return!
+//
+// Tasks run once per master cycle are joined with an event group, one bit per task. Start a
+// cycle with tasks_expect_end() and notify the task, the task calls send_task_end() when it's
+// done, and wait_tasks() blocks until every expected task has ended. A task which misses the
+// wait is counted, and how late it finished is recorded once it ends. Tasks created past
+// MAX_NUM_TASKS can't be expected, but their ends still count for wait_tasks(num_tasks).
 
 #include <stdbool.h>
 #include <stddef.h>
 
 #include "FreeRTOS.h"
+#include "event_groups.h"
 #include "semphr.h"
 #include "status.h"
 #include "task.h"
@@ -63,6 +70,7 @@
 
 // Some common stack sizes to make specifying stack sizes more readable.
 // If your task is failing for strange reasons, try bumping the stack size one size up.
+// `scons --stack-usage=report` reports the worst case of each task, from the call graph.
 #define TASK_STACK_256 ((size_t)256)
 #define TASK_STACK_512 ((size_t)512)
 #define TASK_STACK_1024 ((size_t)1024)
@@ -72,7 +80,7 @@
 // A convenience macro for making declaring priorities more readable.
 #define TASK_PRIORITY(prio) ((TaskPriority)prio)
 
-// Parameter that will be used to initialize the end task semaphore.
+// Number of tasks which can be joined with wait_tasks(), at most one per event group bit.
 #define MAX_NUM_TASKS 15
 
 // Define wait timeout as 1 second, tasks cycle execution should not take longer than a second
@@ -80,6 +88,17 @@
 
 typedef UBaseType_t TaskPriority;
 
+// Set of tasks which can be joined, bit i is the i-th task created with tasks_init_task()
+typedef EventBits_t TaskMask;
+
+typedef struct TaskEndStats {
+  uint32_t cycles;  // Calls to send_task_end()
+  uint32_t misses;  // Cycles that weren't done by the end of wait_tasks()
+  uint32_t max_response_us;  // Longest time from tasks_expect_end() to send_task_end()
+  uint32_t last_late_us;  // How long after wait_tasks() timed out the last missed cycle ended
+  uint32_t max_late_us;
+} TaskEndStats;
+
 // Represents everything we need to know to initialize a task.
 // User code should not rely on the contents of this struct!
 typedef struct Task {
@@ -105,10 +124,26 @@ void tasks_start(void);
 // started.
 StatusCode tasks_init(void);
 
-// Attempts to take num_tasks items from end task semaphore, indicating the number of tasks
-// completed Returns STATUS_CODE_TIMEOUT if timeout occurs, STATUS_CODE_OK if num_tasks items taken
-// successfully
+// Records that |task| has been started for a cycle, so wait_tasks() waits for it to end.
+StatusCode tasks_expect_end(Task *task);
+
+// Waits for every expected task to call send_task_end(), ends from other tasks are ignored.
+// If no task is expected, waits for num_tasks calls to send_task_end() from any tasks instead.
+// Returns STATUS_CODE_TIMEOUT, and logs the tasks which missed, after WAIT_TASK_TIMEOUT_MS.
 StatusCode wait_tasks(uint16_t num_tasks);
 
-// A wrapper to give to the semaphore, to be called by tasks when they complete
+// Tasks marked with tasks_expect_end() which haven't ended yet
+TaskMask tasks_get_expected(void);
+
+// Waits up to timeout_ms for any of |tasks| to end, |ended| gets the ones which did.
+// Ends of tasks outside |tasks| are left for later waits. On timeout the expected tasks in
+// |tasks| are counted as missed, like wait_tasks().
+StatusCode wait_tasks_any(TaskMask tasks, TaskMask *ended, uint32_t timeout_ms);
+
+// Called by tasks when they complete a cycle
 StatusCode send_task_end(void);
+
+StatusCode tasks_get_end_stats(Task *task, TaskEndStats *stats);
+
+// Logs the end stats of every task which has ended a cycle
+void tasks_log_end_stats(void);
@@ -0,0 +1,15 @@
+#pragma once
+// Monotonic microsecond timestamps
+//
+// Finer grained than the FreeRTOS tick, for latency measurements and time synchronisation.
+// ARM interpolates the tick count with the SysTick counter. x86 uses CLOCK_MONOTONIC, offset to
+// the process start so each simulated board has its own power-on time. x86 can also simulate a
+// crystal error: set MIDSUN_X86_CLOCK_DRIFT_PPM to scale the local clock.
+// With --define=MS_VIRTUAL_TIME, x86 follows the virtual tick instead, interpolated between ticks
+// like ARM.
+//
+// Safe to call from tasks and interrupts.
+#include <stdint.h>
+
+// Microseconds since power-on
+uint64_t timestamp_us(void);
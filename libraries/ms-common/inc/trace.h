@@ -0,0 +1,124 @@
+#pragma once
+// Event tracing
+//
+// Records context switches, task notifications, queue sends and receives, CAN frames and
+// user-defined spans into a fixed-size ring with microsecond timestamps. Disabled by default:
+// build with --define=MS_TRACE to enable it, otherwise the TRACE_* macros compile to nothing and
+// no RAM is reserved.
+//
+// Recording is lock-free and safe from any task or interrupt: a writer claims a slot with an
+// atomic increment and publishes it with a sequence number. The ring keeps the most recent
+// TRACE_BUFFER_SIZE events, older events are overwritten and counted as dropped if they weren't
+// read in time. There must only be a single reader.
+//
+// Spans are identified by a user-defined ID, give them a name with trace_set_span_name():
+//
+//   trace_set_span_name(MY_SPAN, "adc_read");
+//   TRACE_SPAN_BEGIN(MY_SPAN);
+//   ...
+//   TRACE_SPAN_END(MY_SPAN);
+//
+// x86 writes the trace as Chrome trace event JSON, which chrome://tracing and the Perfetto UI
+// open directly. Set MIDSUN_X86_TRACE_FILE to write it when the process exits. Any platform can
+// drain the ring as a stream of TraceEvents over UART (trace_drain_uart()) or CAN
+// (can_diag_tx_trace()), which py/trace_decoder converts to the same JSON.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "status.h"
+#include "uart.h"
+
+// Number of events kept, must be a power of two
+#ifndef TRACE_BUFFER_SIZE
+#ifdef MS_PLATFORM_X86
+#define TRACE_BUFFER_SIZE 16384
+#else
+#define TRACE_BUFFER_SIZE 256
+#endif
+#endif
+
+#define TRACE_MAX_TASKS 24
+#define TRACE_MAX_SPANS 32
+// Bytes of a name carried by each name event
+#define TRACE_NAME_CHUNK 4
+#define TRACE_MAX_NAME_LEN 16
+
+typedef enum {
+  TRACE_EVENT_TASK_SWITCH = 0,  // id: task number switched in
+  TRACE_EVENT_TASK_NOTIFY,  // id: task number notified
+  TRACE_EVENT_QUEUE_SEND,  // id: queue number, arg: items before the send
+  TRACE_EVENT_QUEUE_RECEIVE,  // id: queue number, arg: items before the receive
+  TRACE_EVENT_CAN_TX,  // id: DLC, arg: CAN ID
+  TRACE_EVENT_CAN_RX,  // id: DLC, arg: CAN ID
+  TRACE_EVENT_SPAN_BEGIN,  // id: span ID
+  TRACE_EVENT_SPAN_END,  // id: span ID
+  TRACE_EVENT_INSTANT,  // id: span ID, arg: user value
+  // Names, only emitted by the drain: id is the task number or span ID, chunk is the byte offset
+  // into the name and arg holds the next TRACE_NAME_CHUNK bytes
+  TRACE_EVENT_TASK_NAME,
+  TRACE_EVENT_SPAN_NAME,
+  NUM_TRACE_EVENTS,
+} TraceEventType;
+
+// Wire format of the drain, little endian
+typedef struct TraceEvent {
+  uint32_t timestamp_us;  // Low 32 bits of timestamp_us()
+  uint8_t type;  // TraceEventType
+  uint8_t chunk;
+  uint16_t id;
+  uint32_t arg;
+} TraceEvent;
+
+typedef struct TraceStats {
+  uint32_t recorded;
+  uint32_t dropped;  // Overwritten before they were read
+} TraceStats;
+
+// Writes drained bytes, e.g. to a UART or a file
+typedef StatusCode (*TraceWriteFn)(const uint8_t *data, size_t len, void *context);
+
+#ifdef MS_TRACE
+#define TRACE_EVENT(type, id, arg) trace_record((type), (id), (arg))
+#else
+#define TRACE_EVENT(type, id, arg)
+#endif
+
+#define TRACE_SPAN_BEGIN(span) TRACE_EVENT(TRACE_EVENT_SPAN_BEGIN, (span), 0)
+#define TRACE_SPAN_END(span) TRACE_EVENT(TRACE_EVENT_SPAN_END, (span), 0)
+#define TRACE_INSTANT(span, value) TRACE_EVENT(TRACE_EVENT_INSTANT, (span), (value))
+
+// Empties the ring and forgets span names, task names are kept
+void trace_init(void);
+
+// Type is a TraceEventType
+void trace_record(uint8_t type, uint16_t id, uint32_t arg);
+
+// Called by the kernel's trace hooks in FreeRTOSConfig.h
+void trace_task_created(uint16_t number, const char *name);
+void trace_task_switched_in(uint16_t number);
+void trace_task_notified(uint16_t number);
+// Queues numbered 0, e.g. semaphores and mutexes, aren't traced
+void trace_queue_sent(uint16_t number, uint32_t items);
+void trace_queue_received(uint16_t number, uint32_t items);
+
+StatusCode trace_set_span_name(uint16_t span, const char *name);
+
+// Reads the next event, returns STATUS_CODE_EMPTY once the ring is caught up
+StatusCode trace_read(TraceEvent *event);
+
+// Writes names which haven't been drained yet, then up to max_events events
+StatusCode trace_drain(TraceWriteFn write, void *context, uint32_t max_events);
+
+StatusCode trace_drain_uart(UartPort uart, uint32_t max_events);
+
+void trace_get_stats(TraceStats *stats);
+
+// Name of a task or span, NULL if unknown
+const char *trace_get_task_name(uint16_t number);
+const char *trace_get_span_name(uint16_t span);
+
+#ifdef MS_PLATFORM_X86
+// Drains the ring into a Chrome trace event JSON file
+StatusCode trace_export_json(const char *path);
+#endif
@@ -136,10 +136,12 @@ StatusCode adc_init(void) {
 
   adc_add_channel(ADC_REF);
 
-  // Enable ADC1/DMA1 Clock
+  // Enable ADC1/DMA1 Clock, the RCC registers are shared with other drivers
+  taskENTER_CRITICAL();
   RCC_ADCCLKConfig(RCC_PCLK2_Div2);
   RCC_APB2PeriphClockCmd(RCC_APB2Periph_ADC1, ENABLE);
   RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+  taskEXIT_CRITICAL();
 
   // DMA initialization needed for multi-channel scan
   DMA_DeInit(DMA1_Channel1);
@@ -0,0 +1,24 @@
+#include "boot.h"
+#include "stm32f10x.h"
+
+// The CMSIS core_cm3.h in this tree predates the DWT definitions
+#define DWT_CTRL (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+#define DWT_CTRL_CYCCNTENA (1 << 0)
+
+// The cycle counter runs before the scheduler starts, unlike timestamp_us()
+static uint32_t s_cycles_per_us;
+
+void boot_init(void) {
+  if (s_cycles_per_us != 0) {
+    return;
+  }
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+  s_cycles_per_us = SystemCoreClock / 1000000;
+}
+
+uint32_t boot_time_us(void) {
+  return (s_cycles_per_us == 0) ? 0 : DWT_CYCCNT / s_cycles_per_us;
+}
@@ -39,19 +39,27 @@ StatusCode gpio_it_register_interrupt(const GpioAddress *address, const Interrup
   if (address->port >= NUM_GPIO_PORTS || address->pin >= GPIO_PINS_PER_PORT ||
       event >= INVALID_EVENT) {
     return status_code(STATUS_CODE_INVALID_ARGS);
-  } else if (s_gpio_it_interrupts[address->pin].task != NULL) {
+  }
+
+  // Boot steps may register interrupts from several tasks, and the EXTI and AFIO registers are
+  // shared between pins
+  taskENTER_CRITICAL();
+  if (s_gpio_it_interrupts[address->pin].task != NULL) {
+    taskEXIT_CRITICAL();
     return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "Pin already used.");
   }
 
   // Register exti channel and enable interrupt
-  status_ok_or_return(stm32f10x_interrupt_exti_enable(address, settings));
-
-  s_gpio_it_interrupts[address->pin].address = *address;
-  s_gpio_it_interrupts[address->pin].settings = *settings;
-  s_gpio_it_interrupts[address->pin].event = event;
-  s_gpio_it_interrupts[address->pin].task = task;
+  StatusCode status = stm32f10x_interrupt_exti_enable(address, settings);
+  if (status == STATUS_CODE_OK) {
+    s_gpio_it_interrupts[address->pin].address = *address;
+    s_gpio_it_interrupts[address->pin].settings = *settings;
+    s_gpio_it_interrupts[address->pin].event = event;
+    s_gpio_it_interrupts[address->pin].task = task;
+  }
+  taskEXIT_CRITICAL();
 
-  return STATUS_CODE_OK;
+  return status;
 }
 
 StatusCode gpio_it_trigger_interrupt(const GpioAddress *address) {
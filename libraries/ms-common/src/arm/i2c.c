@@ -55,6 +55,9 @@ static I2CPortData s_port[NUM_I2C_PORTS] = {
                    .err_irqn = I2C2_ER_IRQn },
 };
 
+// Names in the mutex profiling report
+static const char *s_mutex_names[NUM_I2C_PORTS] = { "i2c1", "i2c2" };
+
 // Generated using the I2C timing
 static const uint32_t s_i2c_timing[] = {
   [I2C_SPEED_STANDARD] = 100000,  // 100 kHz
@@ -95,7 +98,9 @@ StatusCode i2c_init(I2CPort i2c, const I2CSettings *settings) {
 
   s_port[i2c].settings = *settings;
 
-  // Enable clock for I2C and GPIOB
+  // Enable clock for I2C and GPIOB. The RCC and AFIO registers are shared with other drivers,
+  // which boot steps may be initializing at the same time.
+  taskENTER_CRITICAL();
   RCC_APB1PeriphClockCmd(s_port[i2c].periph, ENABLE);
   RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOB, ENABLE);
 
@@ -103,6 +108,7 @@ StatusCode i2c_init(I2CPort i2c, const I2CSettings *settings) {
   if (i2c == I2C_PORT_1) {
     GPIO_PinRemapConfig(GPIO_Remap_I2C1, ENABLE);
   }
+  taskEXIT_CRITICAL();
 
   // NOTE(mitch): This shouldn't be required for I2C, was needed to get around
   // Issue with SCL not being set high
@@ -140,6 +146,7 @@ StatusCode i2c_init(I2CPort i2c, const I2CSettings *settings) {
   s_port[i2c].multi_txn = false;
   status_ok_or_return(sem_init(&s_port[i2c].i2c_buf.wait_txn, 1, 0));
   status_ok_or_return(mutex_init(&s_port[i2c].mutex));
+  mutex_profile_set_name(&s_port[i2c].mutex, s_mutex_names[i2c]);
   status_ok_or_return(queue_init(&s_port[i2c].i2c_buf.queue));
 
   // Enable I2C peripheral
@@ -1,7 +1,12 @@
 #include "interrupt.h"
 
+#include "FreeRTOS.h"
 #include "stm32f10x_interrupt.h"
+#include "task.h"
 
 void interrupt_init(void) {
+  // Enables the AFIO clock, which may race with other drivers' clocks during boot
+  taskENTER_CRITICAL();
   stm32f10x_interrupt_init();
+  taskEXIT_CRITICAL();
 }
@@ -2,10 +2,12 @@
 
 #include <stdint.h>
 
+#include "FreeRTOS.h"
 #include "gpio.h"
 #include "pwm_mcu.h"
 #include "stm32f10x_rcc.h"
 #include "stm32f10x_tim.h"
+#include "task.h"
 
 #define NUM_CHANNELS 4
 typedef enum APBClk {
@@ -69,7 +71,10 @@ StatusCode pwm_init(PwmTimer timer, uint16_t period_us) {
     return status_msg(STATUS_CODE_INVALID_ARGS, "Period must be greater than 0");
   }
 
+  // Other drivers may be enabling their clocks from another task
+  taskENTER_CRITICAL();
   APBClk clk = prv_enable_periph_clock(timer);
+  taskEXIT_CRITICAL();
 
   s_period_us[timer] = period_us;
 
@@ -0,0 +1,34 @@
+#include "run_time_stats.h"
+#include "stm32f10x.h"
+
+// The CMSIS core_cm3.h in this tree predates the DWT definitions
+#define DWT_CTRL (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+#define DWT_CTRL_CYCCNTENA (1 << 0)
+
+static uint32_t s_cycles_per_us;
+static uint32_t s_last_cycles;
+static uint32_t s_rem_cycles;
+static uint32_t s_us;
+
+void run_time_stats_timer_init(void) {
+  s_cycles_per_us = SystemCoreClock / 1000000;
+  s_rem_cycles = 0;
+  s_us = 0;
+
+  // Left running rather than cleared, it's also the boot clock
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+  s_last_cycles = DWT_CYCCNT;
+}
+
+// Not reentrant: the kernel calls this from the context switch or with the scheduler suspended,
+// and run_time_stats.c calls it in a critical section
+uint32_t run_time_stats_counter(void) {
+  uint32_t cycles = DWT_CYCCNT;
+  s_rem_cycles += cycles - s_last_cycles;
+  s_last_cycles = cycles;
+  s_us += s_rem_cycles / s_cycles_per_us;
+  s_rem_cycles %= s_cycles_per_us;
+  return s_us;
+}
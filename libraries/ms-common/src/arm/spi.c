@@ -38,6 +38,9 @@ static SpiPortData s_port[NUM_SPI_PORTS] = {
                    .irqn = SPI2_IRQn },
 };
 
+// Names in the mutex profiling report
+static const char *s_mutex_names[NUM_SPI_PORTS] = { "spi1", "spi2" };
+
 StatusCode spi_init(SpiPort spi, const SpiSettings *settings) {
   if (spi >= NUM_SPI_PORTS) {
     return status_msg(STATUS_CODE_INVALID_ARGS, "Invalid SPI port.");
@@ -97,6 +100,7 @@ StatusCode spi_init(SpiPort spi, const SpiSettings *settings) {
   s_port[spi].spi_buf.tx_queue.item_size = sizeof(uint8_t);
   s_port[spi].spi_buf.tx_queue.storage_buf = s_port[spi].spi_buf.tx_buf;
   status_ok_or_return(mutex_init(&s_port[spi].spi_buf.mutex));
+  mutex_profile_set_name(&s_port[spi].spi_buf.mutex, s_mutex_names[spi]);
   status_ok_or_return(queue_init(&s_port[spi].spi_buf.rx_queue));
   status_ok_or_return(queue_init(&s_port[spi].spi_buf.tx_queue));
 
@@ -0,0 +1,29 @@
+#include "timestamp.h"
+
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "stm32f10x.h"
+#include "task.h"
+
+// The tick count wraps after 2^32 ms (~49 days), which is longer than the car is ever powered
+uint64_t timestamp_us(void) {
+  TickType_t ticks;
+  uint32_t val;
+  bool pending;
+  // Retry if a tick happened between reading the tick count and SysTick
+  do {
+    ticks = xTaskGetTickCountFromISR();
+    val = SysTick->VAL;
+    pending = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+  } while (ticks != xTaskGetTickCountFromISR());
+
+  uint32_t load = SysTick->LOAD + 1;
+  // SysTick wrapped but its interrupt is masked by the caller, so the tick count is one behind
+  if (pending && val > load / 2) {
+    ticks++;
+  }
+
+  uint64_t us = (uint64_t)ticks * (1000000 / configTICK_RATE_HZ);
+  return us + (uint64_t)(load - val) * (1000000 / configTICK_RATE_HZ) / load;
+}
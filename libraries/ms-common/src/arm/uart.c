@@ -57,6 +57,11 @@ StatusCode uart_init(UartPort uart, UartSettings *settings) {
   s_port_queues[uart].rx_queue.num_items = UART_MAX_BUFFER_LEN;
   s_port_queues[uart].rx_queue.storage_buf = s_port_queues[uart].rx_buf;
   queue_init(&s_port_queues[uart].rx_queue);
+#ifdef MS_TRACE
+  // The trace can be drained over a UART, which mustn't trace itself
+  vQueueSetQueueNumber(s_port_queues[uart].tx_queue.handle, 0);
+  vQueueSetQueueNumber(s_port_queues[uart].rx_queue.handle, 0);
+#endif
 
   gpio_init_pin(&settings->tx, GPIO_ALTFN_PUSH_PULL, GPIO_STATE_LOW);
   gpio_init_pin(&settings->rx, GPIO_INPUT_FLOATING, GPIO_STATE_LOW);
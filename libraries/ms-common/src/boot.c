@@ -0,0 +1,256 @@
+#include "boot.h"
+
+#include <stddef.h>
+
+#include "log.h"
+#include "notify.h"
+#include "queues.h"
+
+_Static_assert(BOOT_NUM_WORKERS <= BOOT_MAX_WORKERS, "Boot: too many workers");
+
+static BootPhase s_phases[BOOT_MAX_PHASES];
+// Phases claimed, may pass BOOT_MAX_PHASES
+static uint32_t s_num_phases;
+
+uint8_t boot_phase_begin(const char *name) {
+  uint32_t phase = __atomic_fetch_add(&s_num_phases, 1, __ATOMIC_RELAXED);
+  if (phase >= BOOT_MAX_PHASES) {
+    return BOOT_PHASE_INVALID;
+  }
+  s_phases[phase].name = name;
+  s_phases[phase].start_us = boot_time_us();
+  return phase;
+}
+
+void boot_phase_end(uint8_t phase) {
+  if (phase >= BOOT_MAX_PHASES) {
+    return;
+  }
+  s_phases[phase].duration_us = boot_time_us() - s_phases[phase].start_us;
+  __atomic_store_n(&s_phases[phase].ended, true, __ATOMIC_RELEASE);
+}
+
+void boot_mark(const char *name) {
+  uint8_t phase = boot_phase_begin(name);
+  if (phase < BOOT_MAX_PHASES) {
+    __atomic_store_n(&s_phases[phase].ended, true, __ATOMIC_RELEASE);
+  }
+}
+
+uint8_t boot_num_phases(void) {
+  uint32_t num_phases = __atomic_load_n(&s_num_phases, __ATOMIC_RELAXED);
+  return (num_phases < BOOT_MAX_PHASES) ? num_phases : BOOT_MAX_PHASES;
+}
+
+StatusCode boot_get_phase(uint8_t phase, BootPhase *info) {
+  if (phase >= boot_num_phases() || info == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  info->ended = __atomic_load_n(&s_phases[phase].ended, __ATOMIC_ACQUIRE);
+  info->name = s_phases[phase].name;
+  info->start_us = s_phases[phase].start_us;
+  info->duration_us = info->ended ? s_phases[phase].duration_us : 0;
+  return STATUS_CODE_OK;
+}
+
+void boot_log(void) {
+  uint8_t num_phases = boot_num_phases();
+  LOG_DEBUG("Boot: %u phases, %u us since boot_init()\n", (unsigned)num_phases,
+            (unsigned)boot_time_us());
+  for (uint8_t i = 0; i < num_phases; ++i) {
+    BootPhase phase;
+    boot_get_phase(i, &phase);
+    LOG_DEBUG("  %-16s at %8u us, took %8u us%s\n", phase.name, (unsigned)phase.start_us,
+              (unsigned)phase.duration_us, phase.ended ? "" : " (running)");
+  }
+}
+
+static void prv_run_step(BootStep *step) {
+  uint8_t phase = boot_phase_begin(step->name);
+  step->status = step->init();
+  boot_phase_end(phase);
+}
+
+#if BOOT_NUM_WORKERS > 0
+static uint8_t s_work_storage[BOOT_MAX_STEPS * sizeof(BootStep *)];
+static Queue s_work_queue = {
+  .num_items = BOOT_MAX_STEPS,
+  .item_size = sizeof(BootStep *),
+  .storage_buf = s_work_storage,
+};
+static uint8_t s_done_storage[BOOT_MAX_STEPS * sizeof(BootStep *)];
+static Queue s_done_queue = {
+  .num_items = BOOT_MAX_STEPS,
+  .item_size = sizeof(BootStep *),
+  .storage_buf = s_done_storage,
+};
+
+static bool s_workers_started;
+// A worker still running a step which timed out isn't idle until it finishes
+static uint8_t s_idle_workers;
+
+static void prv_worker(void) {
+  while (true) {
+    BootStep *step = NULL;
+    // Idle once boot is done
+    if (queue_receive(&s_work_queue, &step, BLOCK_INDEFINITELY) == STATUS_CODE_OK) {
+      prv_run_step(step);
+      queue_send(&s_done_queue, &step, BLOCK_INDEFINITELY);
+    }
+  }
+}
+
+TASK(boot_worker_0, BOOT_WORKER_STACK) {
+  prv_worker();
+}
+#if BOOT_NUM_WORKERS > 1
+TASK(boot_worker_1, BOOT_WORKER_STACK) {
+  prv_worker();
+}
+#endif
+#if BOOT_NUM_WORKERS > 2
+TASK(boot_worker_2, BOOT_WORKER_STACK) {
+  prv_worker();
+}
+#endif
+
+static StatusCode prv_start_workers(void) {
+  if (s_workers_started) {
+    return STATUS_CODE_OK;
+  }
+  status_ok_or_return(queue_init(&s_work_queue));
+  status_ok_or_return(queue_init(&s_done_queue));
+
+  TaskPriority priority = uxTaskPriorityGet(NULL);
+  status_ok_or_return(tasks_init_task(boot_worker_0, priority, NULL));
+#if BOOT_NUM_WORKERS > 1
+  status_ok_or_return(tasks_init_task(boot_worker_1, priority, NULL));
+#endif
+#if BOOT_NUM_WORKERS > 2
+  status_ok_or_return(tasks_init_task(boot_worker_2, priority, NULL));
+#endif
+  s_idle_workers = BOOT_NUM_WORKERS;
+  s_workers_started = true;
+  return STATUS_CODE_OK;
+}
+#endif
+
+static StatusCode prv_check_steps(const BootStep *steps, uint8_t num_steps) {
+  if (steps == NULL || num_steps == 0 || num_steps > BOOT_MAX_STEPS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  // Resolve steps in dependency order, a cycle leaves some unresolved
+  uint32_t all = (1u << num_steps) - 1;
+  uint32_t resolved = 0;
+  bool progress = true;
+  while (resolved != all && progress) {
+    progress = false;
+    for (uint8_t i = 0; i < num_steps; ++i) {
+      if (steps[i].init == NULL || (steps[i].deps & ~all) != 0) {
+        return status_msg(STATUS_CODE_INVALID_ARGS, "Boot: invalid step");
+      }
+      if (!(resolved & BOOT_DEP(i)) && (steps[i].deps & ~resolved) == 0) {
+        resolved |= BOOT_DEP(i);
+        progress = true;
+      }
+    }
+  }
+  if (resolved != all) {
+    return status_msg(STATUS_CODE_INVALID_ARGS, "Boot: dependency cycle");
+  }
+  return STATUS_CODE_OK;
+}
+
+// Returns the first failure, given the one so far
+static StatusCode prv_end_step(const BootStep *steps, uint8_t index, uint32_t *ended,
+                               uint32_t *failed, StatusCode status) {
+  *ended |= BOOT_DEP(index);
+  if (steps[index].status == STATUS_CODE_OK) {
+    return status;
+  }
+  *failed |= BOOT_DEP(index);
+  LOG_WARN("Boot: %s failed (%u)\n", steps[index].name, (unsigned)steps[index].status);
+  return (status == STATUS_CODE_OK) ? steps[index].status : status;
+}
+
+StatusCode boot_run_steps(BootStep *steps, uint8_t num_steps) {
+  status_ok_or_return(prv_check_steps(steps, num_steps));
+#if BOOT_NUM_WORKERS > 0
+  status_ok_or_return(prv_start_workers());
+#endif
+
+  for (uint8_t i = 0; i < num_steps; ++i) {
+    steps[i].status = STATUS_CODE_UNINITIALIZED;
+  }
+
+  uint32_t all = (1u << num_steps) - 1;
+  uint32_t started = 0;
+  uint32_t ended = 0;
+  uint32_t failed = 0;
+  TickType_t begin_ticks = xTaskGetTickCount();
+  StatusCode status = STATUS_CODE_OK;
+
+  while (ended != all) {
+    // Start every step which is ready, in table order, and skip those a failure blocks
+    for (uint8_t i = 0; i < num_steps; ++i) {
+      BootStep *step = &steps[i];
+      if (started & BOOT_DEP(i)) {
+        continue;
+      }
+      if (step->deps & failed) {
+        LOG_WARN("Boot: %s skipped, a dependency failed\n", step->name);
+        started |= BOOT_DEP(i);
+        ended |= BOOT_DEP(i);
+        failed |= BOOT_DEP(i);
+        continue;
+      }
+      if ((step->deps & ~ended) != 0) {
+        continue;
+      }
+#if BOOT_NUM_WORKERS > 0
+      if (s_idle_workers == 0) {
+        break;
+      }
+      status_ok_or_return(queue_send(&s_work_queue, &step, 0));
+      s_idle_workers--;
+      started |= BOOT_DEP(i);
+#else
+      started |= BOOT_DEP(i);
+      prv_run_step(step);
+      status = prv_end_step(steps, i, &ended, &failed, status);
+#endif
+    }
+
+#if BOOT_NUM_WORKERS > 0
+    if (ended == all) {
+      break;
+    }
+
+    // Wait for any step to finish
+    TickType_t elapsed = xTaskGetTickCount() - begin_ticks;
+    TickType_t timeout = pdMS_TO_TICKS(BOOT_TIMEOUT_MS);
+    BootStep *done = NULL;
+    if (elapsed >= timeout ||
+        queue_receive(&s_done_queue, &done, (timeout - elapsed) * portTICK_PERIOD_MS) !=
+            STATUS_CODE_OK) {
+      for (uint8_t i = 0; i < num_steps; ++i) {
+        if (!(ended & BOOT_DEP(i))) {
+          steps[i].status = STATUS_CODE_TIMEOUT;
+          LOG_WARN("Boot: %s timed out\n", steps[i].name);
+        }
+      }
+      return status_msg(STATUS_CODE_TIMEOUT, "Boot: step timed out");
+    }
+    s_idle_workers++;
+
+    // A step which timed out in an earlier run may finish now
+    if (done < steps || done >= steps + num_steps ||
+        !((started & ~ended) & BOOT_DEP(done - steps))) {
+      continue;
+    }
+    status = prv_end_step(steps, done - steps, &ended, &failed, status);
+#endif
+  }
+  return status;
+}
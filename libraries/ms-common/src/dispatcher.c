@@ -0,0 +1,261 @@
+#include "dispatcher.h"
+
+#include <string.h>
+
+#include "log.h"
+#include "notify.h"
+#include "timestamp.h"
+
+#define QUEUE_MASK (DISPATCHER_QUEUE_SIZE - 1)
+
+#if (DISPATCHER_QUEUE_SIZE & QUEUE_MASK) != 0
+#error DISPATCHER_QUEUE_SIZE must be a power of two
+#endif
+
+typedef struct DispatcherEntry {
+  DispatcherFn fn;
+  void *context;
+  DispatcherPriority priority;
+  bool registered;
+  // Incremented when the entry is unregistered, so queued dispatches can tell it was reused
+  uint8_t generation;
+} DispatcherEntry;
+
+typedef struct DispatchEvent {
+  DispatcherId id;
+  uint8_t generation;
+  uint32_t arg;
+  uint32_t dispatched_us;
+} DispatchEvent;
+
+// seq is the position the slot can next be written at, position + 1 once it's been written
+typedef struct DispatchSlot {
+  uint32_t seq;
+  DispatchEvent event;
+} DispatchSlot;
+
+// Multiple producers, the dispatcher task is the only consumer
+typedef struct DispatchQueue {
+  DispatchSlot slots[DISPATCHER_QUEUE_SIZE];
+  uint32_t head;
+  uint32_t tail;
+} DispatchQueue;
+
+static DispatcherEntry s_entries[DISPATCHER_MAX_CALLBACKS];
+static DispatchQueue s_queues[NUM_DISPATCHER_PRIORITIES];
+static DispatcherStats s_stats[NUM_DISPATCHER_PRIORITIES];
+
+static bool prv_push(DispatchQueue *queue, const DispatchEvent *event, uint16_t *depth) {
+  uint32_t pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+  DispatchSlot *slot;
+  while (true) {
+    slot = &queue->slots[pos & QUEUE_MASK];
+    int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The consumer hasn't freed this slot yet
+      return false;
+    } else {
+      pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    }
+  }
+  slot->event = *event;
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+  *depth = pos + 1 - __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+  return true;
+}
+
+static bool prv_pop(DispatchQueue *queue, DispatchEvent *event) {
+  DispatchSlot *slot = &queue->slots[queue->tail & QUEUE_MASK];
+  if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != queue->tail + 1) {
+    return false;
+  }
+  *event = slot->event;
+  __atomic_store_n(&slot->seq, queue->tail + DISPATCHER_QUEUE_SIZE, __ATOMIC_RELEASE);
+  __atomic_store_n(&queue->tail, queue->tail + 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+static void prv_record_depth(DispatcherStats *stats, uint16_t depth) {
+  uint16_t peak = __atomic_load_n(&stats->peak_depth, __ATOMIC_RELAXED);
+  while (depth > peak && !__atomic_compare_exchange_n(&stats->peak_depth, &peak, depth, true,
+                                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+static StatusCode prv_dispatch(DispatcherId id, uint32_t arg) {
+  if (id >= DISPATCHER_MAX_CALLBACKS || !s_entries[id].registered) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  DispatcherPriority priority = s_entries[id].priority;
+  DispatchEvent event = {
+    .id = id,
+    .generation = s_entries[id].generation,
+    .arg = arg,
+    .dispatched_us = timestamp_us(),
+  };
+  uint16_t depth = 0;
+  if (!prv_push(&s_queues[priority], &event, &depth)) {
+    __atomic_fetch_add(&s_stats[priority].dropped, 1, __ATOMIC_RELAXED);
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+  prv_record_depth(&s_stats[priority], depth);
+  return STATUS_CODE_OK;
+}
+
+// Runs the oldest dispatch of the highest priority, false once every queue is empty
+static bool prv_run_next(void) {
+  DispatchEvent event;
+  for (int8_t priority = NUM_DISPATCHER_PRIORITIES - 1; priority >= 0; --priority) {
+    if (!prv_pop(&s_queues[priority], &event)) {
+      continue;
+    }
+    DispatcherStats *stats = &s_stats[priority];
+    DispatcherEntry *entry = &s_entries[event.id];
+
+    taskENTER_CRITICAL();
+    bool current = entry->registered && entry->generation == event.generation;
+    DispatcherEntry callback = *entry;
+    taskEXIT_CRITICAL();
+    if (!current) {
+      stats->stale++;
+      return true;
+    }
+
+    histogram_record(&stats->latency_us, (uint32_t)timestamp_us() - event.dispatched_us);
+    stats->dispatched++;
+    if (callback.fn(callback.context, event.arg)) {
+      taskENTER_CRITICAL();
+      // Unless it was cancelled by the callback
+      if (entry->generation == event.generation) {
+        entry->registered = false;
+        entry->generation++;
+      }
+      taskEXIT_CRITICAL();
+    }
+    return true;
+  }
+  return false;
+}
+
+TASK(dispatcher_task, TASK_STACK_512) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    while (prv_run_next()) {
+    }
+  }
+}
+
+void dispatcher_init(TaskPriority priority) {
+  for (uint8_t i = 0; i < NUM_DISPATCHER_PRIORITIES; ++i) {
+    DispatchQueue *queue = &s_queues[i];
+    queue->head = 0;
+    queue->tail = 0;
+    for (uint32_t j = 0; j < DISPATCHER_QUEUE_SIZE; ++j) {
+      queue->slots[j].seq = j;
+    }
+  }
+  memset(s_entries, 0, sizeof(s_entries));
+  dispatcher_reset_stats();
+  tasks_init_task(dispatcher_task, priority, NULL);
+}
+
+DispatcherId dispatcher_register(DispatcherFn fn, void *context, DispatcherPriority priority) {
+  if (fn == NULL || priority >= NUM_DISPATCHER_PRIORITIES) {
+    return DISPATCHER_INVALID_ID;
+  }
+  taskENTER_CRITICAL();
+  for (DispatcherId id = 0; id < DISPATCHER_MAX_CALLBACKS; ++id) {
+    DispatcherEntry *entry = &s_entries[id];
+    if (!entry->registered) {
+      entry->fn = fn;
+      entry->context = context;
+      entry->priority = priority;
+      entry->registered = true;
+      taskEXIT_CRITICAL();
+      return id;
+    }
+  }
+  taskEXIT_CRITICAL();
+  LOG_CRITICAL("Dispatcher: more than %d callbacks\n", DISPATCHER_MAX_CALLBACKS);
+  return DISPATCHER_INVALID_ID;
+}
+
+StatusCode dispatcher_cancel(DispatcherId id) {
+  if (id >= DISPATCHER_MAX_CALLBACKS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  taskENTER_CRITICAL();
+  DispatcherEntry *entry = &s_entries[id];
+  bool registered = entry->registered;
+  if (registered) {
+    entry->registered = false;
+    entry->generation++;
+  }
+  taskEXIT_CRITICAL();
+  return registered ? STATUS_CODE_OK : status_code(STATUS_CODE_INVALID_ARGS);
+}
+
+StatusCode dispatcher_dispatch(DispatcherId id, uint32_t arg) {
+  status_ok_or_return(prv_dispatch(id, arg));
+  notify(dispatcher_task, 0);
+  return STATUS_CODE_OK;
+}
+
+StatusCode dispatcher_dispatch_from_isr(DispatcherId id, uint32_t arg) {
+  status_ok_or_return(prv_dispatch(id, arg));
+  notify_from_isr(dispatcher_task, 0);
+  return STATUS_CODE_OK;
+}
+
+uint16_t dispatcher_queue_depth(DispatcherPriority priority) {
+  if (priority >= NUM_DISPATCHER_PRIORITIES) {
+    return 0;
+  }
+  DispatchQueue *queue = &s_queues[priority];
+  return __atomic_load_n(&queue->head, __ATOMIC_RELAXED) -
+         __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+}
+
+StatusCode dispatcher_get_stats(DispatcherPriority priority, DispatcherStats *stats) {
+  if (priority >= NUM_DISPATCHER_PRIORITIES || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  taskENTER_CRITICAL();
+  *stats = s_stats[priority];
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+void dispatcher_reset_stats(void) {
+  for (uint8_t i = 0; i < NUM_DISPATCHER_PRIORITIES; ++i) {
+    taskENTER_CRITICAL();
+    s_stats[i].dispatched = 0;
+    s_stats[i].dropped = 0;
+    s_stats[i].stale = 0;
+    s_stats[i].peak_depth = 0;
+    histogram_init(&s_stats[i].latency_us);
+    taskEXIT_CRITICAL();
+  }
+}
+
+void dispatcher_log_stats(void) {
+  // Too large for the calling task's stack
+  static DispatcherStats stats;
+  for (uint8_t i = 0; i < NUM_DISPATCHER_PRIORITIES; ++i) {
+    dispatcher_get_stats(i, &stats);
+    LOG_DEBUG("Dispatcher priority %u: %u run, %u dropped, %u stale, peak depth %u\n", (unsigned)i,
+              (unsigned)stats.dispatched, (unsigned)stats.dropped, (unsigned)stats.stale,
+              (unsigned)stats.peak_depth);
+    if (stats.latency_us.count != 0) {
+      LOG_DEBUG("  latency us: p50 %u, p99 %u, max %u\n",
+                (unsigned)histogram_percentile(&stats.latency_us, 50),
+                (unsigned)histogram_percentile(&stats.latency_us, 99),
+                (unsigned)stats.latency_us.max);
+    }
+  }
+}
@@ -0,0 +1,147 @@
+#include "fork_join.h"
+
+#include <stddef.h>
+
+#include "log.h"
+#include "timestamp.h"
+
+StatusCode fork_join_init(ForkJoin *fork_join, ForkJoinStage *stages, uint8_t num_stages) {
+  if (fork_join == NULL || stages == NULL || num_stages == 0 ||
+      num_stages > FORK_JOIN_MAX_STAGES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  // Resolve stages in dependency order, a cycle leaves some unresolved
+  uint32_t all = (1u << num_stages) - 1;
+  uint32_t resolved = 0;
+  bool progress = true;
+  while (resolved != all && progress) {
+    progress = false;
+    for (uint8_t i = 0; i < num_stages; ++i) {
+      if (stages[i].start == NULL || (stages[i].deps & ~all) != 0) {
+        return status_msg(STATUS_CODE_INVALID_ARGS, "Fork join: invalid stage");
+      }
+      if (!(resolved & FORK_JOIN_DEP(i)) && (stages[i].deps & ~resolved) == 0) {
+        resolved |= FORK_JOIN_DEP(i);
+        progress = true;
+      }
+    }
+  }
+  if (resolved != all) {
+    return status_msg(STATUS_CODE_INVALID_ARGS, "Fork join: dependency cycle");
+  }
+
+  for (uint8_t i = 0; i < num_stages; ++i) {
+    stages[i].start_us = 0;
+    stages[i].last_us = 0;
+    stages[i].max_us = 0;
+    stages[i].tasks = 0;
+  }
+  fork_join->stages = stages;
+  fork_join->num_stages = num_stages;
+  fork_join->runs = 0;
+  fork_join->timeouts = 0;
+  fork_join->last_us = 0;
+  fork_join->max_us = 0;
+  return STATUS_CODE_OK;
+}
+
+static void prv_end_stage(ForkJoinStage *stage, uint64_t begin_us, uint64_t now_us) {
+  stage->last_us = now_us - begin_us - stage->start_us;
+  if (stage->last_us > stage->max_us) {
+    stage->max_us = stage->last_us;
+  }
+}
+
+StatusCode fork_join_run(ForkJoin *fork_join) {
+  if (fork_join == NULL || fork_join->stages == NULL) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+
+  uint32_t all = (1u << fork_join->num_stages) - 1;
+  uint32_t started = 0;
+  uint32_t ended = 0;
+  uint64_t begin_us = timestamp_us();
+  TickType_t begin_ticks = xTaskGetTickCount();
+  StatusCode status = STATUS_CODE_OK;
+
+  while (ended != all) {
+    // Fork every stage which is ready
+    for (uint8_t i = 0; i < fork_join->num_stages; ++i) {
+      ForkJoinStage *stage = &fork_join->stages[i];
+      if ((started & FORK_JOIN_DEP(i)) || (stage->deps & ~ended) != 0) {
+        continue;
+      }
+      started |= FORK_JOIN_DEP(i);
+      TaskMask before = tasks_get_expected();
+      stage->start_us = timestamp_us() - begin_us;
+      stage->start();
+      stage->tasks = tasks_get_expected() & ~before;
+      if (stage->tasks == 0) {
+        // Ran inline
+        ended |= FORK_JOIN_DEP(i);
+        prv_end_stage(stage, begin_us, timestamp_us());
+      }
+    }
+    if (ended == all) {
+      break;
+    }
+
+    // Join any running stage
+    TaskMask running = 0;
+    for (uint8_t i = 0; i < fork_join->num_stages; ++i) {
+      if ((started & ~ended) & FORK_JOIN_DEP(i)) {
+        running |= fork_join->stages[i].tasks;
+      }
+    }
+    if (running == 0) {
+      // Only inline stages were ready, fork again
+      continue;
+    }
+    TickType_t elapsed = xTaskGetTickCount() - begin_ticks;
+    TickType_t timeout = pdMS_TO_TICKS(WAIT_TASK_TIMEOUT_MS);
+    TickType_t remaining = (elapsed < timeout) ? timeout - elapsed : 0;
+    TaskMask tasks_ended = 0;
+    // Still polls once the deadline has passed, e.g. behind a slow inline stage, so the tasks
+    // which haven't ended are counted as missed and no longer expected
+    if (wait_tasks_any(running, &tasks_ended, remaining * portTICK_PERIOD_MS) != STATUS_CODE_OK) {
+      fork_join->timeouts++;
+      status = status_msg(STATUS_CODE_TIMEOUT, "Fork join: stage timed out");
+      break;
+    }
+
+    uint64_t now_us = timestamp_us();
+    for (uint8_t i = 0; i < fork_join->num_stages; ++i) {
+      ForkJoinStage *stage = &fork_join->stages[i];
+      if (!((started & ~ended) & FORK_JOIN_DEP(i))) {
+        continue;
+      }
+      stage->tasks &= ~tasks_ended;
+      if (stage->tasks == 0) {
+        ended |= FORK_JOIN_DEP(i);
+        prv_end_stage(stage, begin_us, now_us);
+      }
+    }
+  }
+
+  fork_join->runs++;
+  fork_join->last_us = timestamp_us() - begin_us;
+  if (fork_join->last_us > fork_join->max_us) {
+    fork_join->max_us = fork_join->last_us;
+  }
+  return status;
+}
+
+void fork_join_log(const ForkJoin *fork_join) {
+  if (fork_join == NULL || fork_join->stages == NULL) {
+    return;
+  }
+  LOG_DEBUG("Fork join: %u runs, %u timeouts, last %u us, max %u us\n",
+            (unsigned)fork_join->runs, (unsigned)fork_join->timeouts,
+            (unsigned)fork_join->last_us, (unsigned)fork_join->max_us);
+  for (uint8_t i = 0; i < fork_join->num_stages; ++i) {
+    const ForkJoinStage *stage = &fork_join->stages[i];
+    LOG_DEBUG("  %-12s start %6u us, last %6u us, max %6u us\n", stage->name,
+              (unsigned)stage->start_us, (unsigned)stage->last_us, (unsigned)stage->max_us);
+  }
+}
@@ -2,6 +2,7 @@
 
 #include <limits.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "log.h"
 #include "notify.h"
@@ -11,7 +12,10 @@ StatusCode fsm_transition(Fsm *fsm, StateId to) {
     return STATUS_CODE_INVALID_ARGS;
   }
   // Check entry in table to see if the transition exists
-  if (!fsm->transition_table[fsm->curr_state * fsm->num_states + to]) {
+  bool exists = (fsm->transition_rows != NULL)
+                    ? (fsm->transition_rows[fsm->curr_state] & (1u << to)) != 0
+                    : fsm->transition_table[fsm->curr_state * fsm->num_states + to];
+  if (!exists) {
     LOG_DEBUG("Transition from State %d -> State %d does not exist\n", fsm->curr_state, to);
     return STATUS_CODE_INTERNAL_ERROR;
   }
@@ -26,6 +30,7 @@ void fsm_run_cycle(Task *fsm) {
     return;
   }
   Fsm *task_fsm = fsm->context;
+  tasks_expect_end(fsm);
   // Allow fsm to run
   BaseType_t ret = xSemaphoreGive(task_fsm->fsm_sem);
   if (ret == pdFALSE) {
@@ -33,19 +38,30 @@ void fsm_run_cycle(Task *fsm) {
   }
 }
 
+void fsm_step(Fsm *fsm) {
+  // Parse inputs,updating curr_state if transition occurred
+  fsm->states[fsm->curr_state].inputs(fsm, fsm->context);
+  // If transition has occurred, execute output function
+  if (fsm->transitioned) {
+    fsm->states[fsm->curr_state].outputs(fsm->context);
+    fsm->transitioned = false;
+  }
+}
+
+size_t fsm_ram_bytes(const Fsm *fsm) {
+  if (fsm->transition_rows != NULL) {
+    return sizeof(Fsm) + fsm->num_states * sizeof(fsm->transition_rows[0]);
+  }
+  return sizeof(Fsm) + sizeof(StaticSemaphore_t) + fsm->num_states * fsm->num_states;
+}
+
 void _fsm_task(void *context) {
   Fsm *self = context;
   BaseType_t ret;
   while (true) {
     ret = xSemaphoreTake(self->fsm_sem, pdMS_TO_TICKS(FSM_TIMEOUT_MS));
     if (ret == pdTRUE) {
-      // Parse inputs,updating curr_state if transition occurred
-      self->states[self->curr_state].inputs(self, self->context);
-      // If transition has occurred, execute output function
-      if (self->transitioned) {
-        self->states[self->curr_state].outputs(self->context);
-        self->transitioned = false;
-      }
+      fsm_step(self);
     } else {
       // TODO(mitchellostler): Timeout Error handling
       LOG_DEBUG("FSM timeout\n");
@@ -68,6 +84,26 @@ StatusCode _init_fsm(Fsm *fsm, FsmState *states, bool *transitions, StateId init
   }
   fsm->transition_table = transitions;
   fsm->states = states;
-  fsm->fsm_sem = xSemaphoreCreateCountingStatic(CYCLE_RX_MAX, 0, &fsm->sem_buf);
+  fsm->fsm_sem = xSemaphoreCreateCountingStatic(CYCLE_RX_MAX, 0, fsm->sem_buf);
+  return STATUS_CODE_OK;
+}
+
+StatusCode _init_shared_fsm(Fsm *fsm, FsmState *states, const FsmTransition *transitions,
+                            size_t num_transitions, StateId initial_state, void *context) {
+  if (fsm == NULL || fsm->transition_rows == NULL || states == NULL || transitions == NULL ||
+      initial_state >= fsm->num_states) {
+    return STATUS_CODE_INVALID_ARGS;
+  }
+  memset(fsm->transition_rows, 0, fsm->num_states * sizeof(fsm->transition_rows[0]));
+  for (size_t i = 0; i < num_transitions; ++i) {
+    if (transitions[i].from >= fsm->num_states || transitions[i].to >= fsm->num_states) {
+      return STATUS_CODE_INVALID_ARGS;
+    }
+    fsm->transition_rows[transitions[i].from] |= 1u << transitions[i].to;
+  }
+  fsm->states = states;
+  fsm->context = context;
+  fsm->curr_state = initial_state;
+  fsm->transitioned = false;
   return STATUS_CODE_OK;
 }
@@ -0,0 +1,90 @@
+#include "fsm_executor.h"
+
+#include "log.h"
+#include "timestamp.h"
+
+static void prv_step_all(FsmExecutor *executor) {
+  for (uint8_t i = 0; i < executor->num_fsms; ++i) {
+    fsm_step(executor->fsms[i]);
+  }
+  executor->cycles++;
+  histogram_record(&executor->cycle_us, timestamp_us() - executor->cycle_start_us);
+}
+
+StatusCode _fsm_executor_init(FsmExecutor *executor, Task *task) {
+  if (executor == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  executor->num_fsms = 0;
+  executor->task = task;
+  executor->cycles = 0;
+  histogram_init(&executor->cycle_us);
+  if (task != NULL && executor->cycle_sem == NULL) {
+    executor->cycle_sem = xSemaphoreCreateCountingStatic(CYCLE_RX_MAX, 0, &executor->sem_buf);
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode fsm_executor_add(FsmExecutor *executor, Fsm *fsm) {
+  if (executor == NULL || fsm == NULL || fsm->states == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  if (fsm->transition_rows == NULL) {
+    return status_msg(STATUS_CODE_INVALID_ARGS, "FSM has its own task");
+  }
+  if (executor->num_fsms >= FSM_EXECUTOR_MAX_FSMS) {
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+  executor->fsms[executor->num_fsms++] = fsm;
+  return STATUS_CODE_OK;
+}
+
+void fsm_executor_run_cycle(FsmExecutor *executor) {
+  executor->cycle_start_us = timestamp_us();
+  if (executor->task == NULL) {
+    prv_step_all(executor);
+    return;
+  }
+  tasks_expect_end(executor->task);
+  if (xSemaphoreGive(executor->cycle_sem) == pdFALSE) {
+    LOG_CRITICAL("FSM executor cycle failed\n");
+  }
+}
+
+void _fsm_executor_task(void *context) {
+  FsmExecutor *self = context;
+  while (true) {
+    xSemaphoreTake(self->cycle_sem, portMAX_DELAY);
+    prv_step_all(self);
+    send_task_end();
+  }
+}
+
+void fsm_executor_get_report(const FsmExecutor *executor, FsmExecutorReport *report) {
+  report->num_fsms = executor->num_fsms;
+  report->ram_bytes = sizeof(FsmExecutor);
+  if (executor->task != NULL) {
+    report->ram_bytes += sizeof(Task) + executor->task->stack_size * sizeof(StackType_t);
+  }
+  report->task_ram_bytes = 0;
+  for (uint8_t i = 0; i < executor->num_fsms; ++i) {
+    const Fsm *fsm = executor->fsms[i];
+    report->ram_bytes += fsm_ram_bytes(fsm);
+    report->task_ram_bytes += sizeof(Fsm) + sizeof(StaticSemaphore_t) +
+                              fsm->num_states * fsm->num_states + sizeof(Task) +
+                              FSM_TASK_STACK * sizeof(StackType_t);
+  }
+  report->cycles = executor->cycles;
+  report->cycle_mean_us = histogram_mean(&executor->cycle_us);
+  report->cycle_max_us = executor->cycle_us.max;
+}
+
+void fsm_executor_log_report(const FsmExecutor *executor) {
+  FsmExecutorReport report;
+  fsm_executor_get_report(executor, &report);
+  LOG_DEBUG("FSM executor (%s): %u FSMs in %u bytes, %u bytes on their own tasks\n",
+            executor->task != NULL ? executor->task->name : "inline", (unsigned)report.num_fsms,
+            (unsigned)report.ram_bytes, (unsigned)report.task_ram_bytes);
+  LOG_DEBUG("  %u cycles, mean %u us, max %u us\n", (unsigned)report.cycles,
+            (unsigned)report.cycle_mean_us, (unsigned)report.cycle_max_us);
+}
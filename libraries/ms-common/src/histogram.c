@@ -0,0 +1,88 @@
+#include "histogram.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "log.h"
+
+void histogram_init(Histogram *hist) {
+  memset(hist, 0, sizeof(*hist));
+  hist->min = UINT32_MAX;
+}
+
+uint8_t histogram_bucket_index(uint32_t value) {
+  if (value < 2 * HISTOGRAM_SUB_BUCKETS) {
+    return value;
+  }
+  // value >= 2 * HISTOGRAM_SUB_BUCKETS, so exponent > HISTOGRAM_SUB_BITS and nothing wraps
+  uint32_t exponent = 31u - (uint32_t)__builtin_clz(value);
+  uint32_t sub = (value >> (exponent - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1u);
+  uint32_t index = HISTOGRAM_SUB_BUCKETS * (exponent - HISTOGRAM_SUB_BITS + 1u) + sub;
+  return (index < HISTOGRAM_NUM_BUCKETS) ? index : HISTOGRAM_NUM_BUCKETS - 1;
+}
+
+uint32_t histogram_bucket_lower(uint8_t bucket) {
+  if (bucket < 2 * HISTOGRAM_SUB_BUCKETS) {
+    return bucket;
+  }
+  uint8_t exponent = bucket / HISTOGRAM_SUB_BUCKETS - 1 + HISTOGRAM_SUB_BITS;
+  uint32_t sub = bucket % HISTOGRAM_SUB_BUCKETS;
+  return (HISTOGRAM_SUB_BUCKETS + sub) << (exponent - HISTOGRAM_SUB_BITS);
+}
+
+void histogram_record(Histogram *hist, uint32_t value) {
+  hist->buckets[histogram_bucket_index(value)]++;
+  hist->count++;
+  hist->sum += value;
+  if (value < hist->min) {
+    hist->min = value;
+  }
+  if (value > hist->max) {
+    hist->max = value;
+  }
+}
+
+uint32_t histogram_mean(const Histogram *hist) {
+  return (hist->count != 0) ? hist->sum / hist->count : 0;
+}
+
+uint32_t histogram_percentile(const Histogram *hist, uint8_t percentile) {
+  if (hist->count == 0) {
+    return 0;
+  }
+  // Rank of the sample at the percentile, rounded up
+  uint64_t rank = ((uint64_t)hist->count * percentile + 99) / 100;
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (uint8_t i = 0; i < HISTOGRAM_NUM_BUCKETS - 1; ++i) {
+    seen += hist->buckets[i];
+    if (seen >= rank) {
+      uint32_t upper = histogram_bucket_lower(i + 1) - 1;
+      return (upper < hist->max) ? upper : hist->max;
+    }
+  }
+  return hist->max;
+}
+
+StatusCode histogram_log(const Histogram *hist, const char *name) {
+  if (hist == NULL || name == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  if (hist->count == 0) {
+    LOG_DEBUG("%s: no samples\n", name);
+    return STATUS_CODE_OK;
+  }
+  LOG_DEBUG("%s: n %u min %u mean %u p50 %u p99 %u max %u\n", name, (unsigned)hist->count,
+            (unsigned)hist->min, (unsigned)histogram_mean(hist),
+            (unsigned)histogram_percentile(hist, 50), (unsigned)histogram_percentile(hist, 99),
+            (unsigned)hist->max);
+  for (uint8_t i = 0; i < HISTOGRAM_NUM_BUCKETS; ++i) {
+    if (hist->buckets[i] != 0) {
+      LOG_DEBUG("  %s[%u]: %u\n", name, (unsigned)histogram_bucket_lower(i),
+                (unsigned)hist->buckets[i]);
+    }
+  }
+  return STATUS_CODE_OK;
+}
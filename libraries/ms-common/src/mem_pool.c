@@ -0,0 +1,155 @@
+#include "mem_pool.h"
+
+// An interrupt can only make a compare-and-swap retry, so every loop below ends once the code
+// preempting it returns
+
+#define FREE_HEAD_INDEX(head) ((head)&0xFFFF)
+#define FREE_HEAD(index, tag) ((uint32_t)(tag) << 16 | (uint32_t)(index))
+
+static MemOverflowHook s_overflow_hook;
+
+static void prv_overflow(const char *name, size_t size) {
+  MemOverflowHook hook = __atomic_load_n(&s_overflow_hook, __ATOMIC_ACQUIRE);
+  if (hook != NULL) {
+    hook(name, size);
+  }
+}
+
+static void prv_update_peak(uint16_t *peak, uint16_t value) {
+  uint16_t current = __atomic_load_n(peak, __ATOMIC_RELAXED);
+  while (value > current &&
+         !__atomic_compare_exchange_n(peak, &current, value, true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+  }
+}
+
+// Free blocks start with the index + 1 of the next free block
+static uint16_t *prv_next(const MemPool *pool, uint16_t index) {
+  return (uint16_t *)(pool->storage + (size_t)(index - 1) * pool->block_size);
+}
+
+void mem_set_overflow_hook(MemOverflowHook hook) {
+  __atomic_store_n(&s_overflow_hook, hook, __ATOMIC_RELEASE);
+}
+
+void *mem_pool_alloc(MemPool *pool) {
+  uint32_t head = __atomic_load_n(&pool->free_head, __ATOMIC_ACQUIRE);
+  uint16_t index;
+  while ((index = FREE_HEAD_INDEX(head)) != 0) {
+    // The block may be taken before the swap, then the swap fails since the tag has changed
+    uint32_t next = FREE_HEAD(__atomic_load_n(prv_next(pool, index), __ATOMIC_RELAXED),
+                              (head >> 16) + 1);
+    if (__atomic_compare_exchange_n(&pool->free_head, &head, next, true, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_ACQUIRE)) {
+      break;
+    }
+  }
+
+  if (index == 0) {
+    // Nothing has been freed, take a block that has never been used
+    uint16_t touched = __atomic_load_n(&pool->num_touched, __ATOMIC_RELAXED);
+    do {
+      if (touched >= pool->num_blocks) {
+        __atomic_fetch_add(&pool->failures, 1, __ATOMIC_RELAXED);
+        prv_overflow(pool->name, pool->block_size);
+        return NULL;
+      }
+    } while (!__atomic_compare_exchange_n(&pool->num_touched, &touched, touched + 1, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    index = touched + 1;
+  }
+
+  prv_update_peak(&pool->peak_in_use, __atomic_add_fetch(&pool->in_use, 1, __ATOMIC_RELAXED));
+  return prv_next(pool, index);
+}
+
+bool mem_pool_contains(const MemPool *pool, const void *block) {
+  uintptr_t offset = (uintptr_t)block - (uintptr_t)pool->storage;
+  return (uintptr_t)block >= (uintptr_t)pool->storage &&
+         offset < pool->num_blocks * pool->block_size && offset % pool->block_size == 0;
+}
+
+StatusCode mem_pool_free(MemPool *pool, void *block) {
+  if (!mem_pool_contains(pool, block)) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  uint16_t index = ((uintptr_t)block - (uintptr_t)pool->storage) / pool->block_size + 1;
+
+  uint32_t head = __atomic_load_n(&pool->free_head, __ATOMIC_RELAXED);
+  do {
+    __atomic_store_n((uint16_t *)block, FREE_HEAD_INDEX(head), __ATOMIC_RELAXED);
+  } while (!__atomic_compare_exchange_n(&pool->free_head, &head,
+                                        FREE_HEAD(index, (head >> 16) + 1), true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  __atomic_sub_fetch(&pool->in_use, 1, __ATOMIC_RELAXED);
+  return STATUS_CODE_OK;
+}
+
+void mem_pool_reset(MemPool *pool) {
+  pool->free_head = 0;
+  pool->num_touched = 0;
+  pool->in_use = 0;
+  pool->peak_in_use = 0;
+  pool->failures = 0;
+}
+
+void mem_pool_get_stats(const MemPool *pool, MemStats *stats) {
+  *stats = (MemStats){
+    .capacity = pool->num_blocks,
+    .in_use = __atomic_load_n(&pool->in_use, __ATOMIC_RELAXED),
+    .peak_in_use = __atomic_load_n(&pool->peak_in_use, __ATOMIC_RELAXED),
+    .failures = __atomic_load_n(&pool->failures, __ATOMIC_RELAXED),
+  };
+}
+
+void *mem_arena_alloc(MemArena *arena, size_t size) {
+  size_t aligned = MEM_ALIGN_UP(size);
+  if (size == 0) {
+    return NULL;
+  }
+
+  size_t used = __atomic_load_n(&arena->used, __ATOMIC_RELAXED);
+  do {
+    if (aligned < size || aligned > arena->size - used) {
+      __atomic_fetch_add(&arena->failures, 1, __ATOMIC_RELAXED);
+      prv_overflow(arena->name, size);
+      return NULL;
+    }
+  } while (!__atomic_compare_exchange_n(&arena->used, &used, used + aligned, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  size_t peak = __atomic_load_n(&arena->peak_used, __ATOMIC_RELAXED);
+  while (used + aligned > peak &&
+         !__atomic_compare_exchange_n(&arena->peak_used, &peak, used + aligned, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+  return arena->storage + used;
+}
+
+size_t mem_arena_mark(const MemArena *arena) {
+  return __atomic_load_n(&arena->used, __ATOMIC_RELAXED);
+}
+
+StatusCode mem_arena_rewind(MemArena *arena, size_t mark) {
+  size_t used = __atomic_load_n(&arena->used, __ATOMIC_RELAXED);
+  do {
+    if (mark > used) {
+      return status_code(STATUS_CODE_INVALID_ARGS);
+    }
+  } while (!__atomic_compare_exchange_n(&arena->used, &used, mark, true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED));
+  return STATUS_CODE_OK;
+}
+
+void mem_arena_reset(MemArena *arena) {
+  mem_arena_rewind(arena, 0);
+}
+
+void mem_arena_get_stats(const MemArena *arena, MemStats *stats) {
+  *stats = (MemStats){
+    .capacity = arena->size,
+    .in_use = __atomic_load_n(&arena->used, __ATOMIC_RELAXED),
+    .peak_in_use = __atomic_load_n(&arena->peak_used, __ATOMIC_RELAXED),
+    .failures = __atomic_load_n(&arena->failures, __ATOMIC_RELAXED),
+  };
+}
@@ -0,0 +1,247 @@
+#include "msg_bus.h"
+
+#include <string.h>
+
+#include "delay.h"
+#include "log.h"
+#include "mem_pool.h"
+#include "timestamp.h"
+
+typedef struct MsgBlock {
+  uint32_t published_us;
+  uint8_t refs;
+  uint8_t topic;
+  bool allocated;
+  _Alignas(8) uint8_t payload[MSG_BUS_BLOCK_SIZE];
+} MsgBlock;
+
+typedef struct MsgBusMailbox {
+  Task *task;
+  Event event;
+  MsgBlock *messages[MSG_BUS_MAILBOX_SIZE];
+  uint8_t head;  // Oldest message
+  uint8_t count;
+} MsgBusMailbox;
+
+typedef struct MsgBusTopic {
+  MsgBusTopicSettings settings;
+  MsgBusMailbox mailboxes[MSG_BUS_MAX_SUBSCRIBERS];
+  uint8_t num_subscribers;
+  MsgBusStats stats;
+} MsgBusTopic;
+
+MEM_POOL_DEFINE(s_block_pool, sizeof(MsgBlock), MSG_BUS_NUM_BLOCKS);
+
+static MsgBusTopic s_topics[NUM_TOPICS];
+
+static MsgBlock *prv_block(const void *payload) {
+  MsgBlock *block = (MsgBlock *)((uintptr_t)payload - offsetof(MsgBlock, payload));
+  if (!mem_pool_contains(&s_block_pool, block) || !block->allocated) {
+    return NULL;
+  }
+  return block;
+}
+
+// Must be called in a critical section
+static void prv_free_block(MsgBlock *block) {
+  block->allocated = false;
+  mem_pool_free(&s_block_pool, block);
+}
+
+// Must be called in a critical section
+static void prv_unref(MsgBlock *block) {
+  if (--block->refs == 0) {
+    prv_free_block(block);
+  }
+}
+
+static bool prv_mailboxes_full(const MsgBusTopic *topic) {
+  for (uint8_t i = 0; i < topic->num_subscribers; ++i) {
+    if (topic->mailboxes[i].count == MSG_BUS_MAILBOX_SIZE) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static MsgBusMailbox *prv_find_mailbox(MsgBusTopic *topic, TaskHandle_t handle) {
+  for (uint8_t i = 0; i < topic->num_subscribers; ++i) {
+    if (topic->mailboxes[i].task->handle == handle) {
+      return &topic->mailboxes[i];
+    }
+  }
+  return NULL;
+}
+
+void msg_bus_init(void) {
+  taskENTER_CRITICAL();
+  memset(s_topics, 0, sizeof(s_topics));
+  for (uint8_t i = 0; i < NUM_TOPICS; ++i) {
+    histogram_init(&s_topics[i].stats.latency_us);
+  }
+  mem_pool_reset(&s_block_pool);
+  taskEXIT_CRITICAL();
+}
+
+StatusCode msg_bus_configure_topic(Topic topic, const MsgBusTopicSettings *settings) {
+  if (topic >= NUM_TOPICS || settings == NULL || settings->payload_size == 0 ||
+      settings->payload_size > MSG_BUS_BLOCK_SIZE || settings->policy >= NUM_MSG_BUS_POLICIES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  s_topics[topic].settings = *settings;
+  return STATUS_CODE_OK;
+}
+
+StatusCode msg_bus_subscribe(Task *task, Topic topic, Event event) {
+  if (topic >= NUM_TOPICS || task == NULL || event >= INVALID_EVENT) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  MsgBusTopic *bus_topic = &s_topics[topic];
+  taskENTER_CRITICAL();
+  if (bus_topic->num_subscribers >= MSG_BUS_MAX_SUBSCRIBERS) {
+    taskEXIT_CRITICAL();
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+  bus_topic->mailboxes[bus_topic->num_subscribers++] = (MsgBusMailbox){
+    .task = task,
+    .event = event,
+  };
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+void *msg_bus_alloc(Topic topic, size_t size) {
+  if (topic >= NUM_TOPICS || size != s_topics[topic].settings.payload_size) {
+    LOG_WARN("Message bus: wrong payload size for topic %u\n", (unsigned)topic);
+    return NULL;
+  }
+  taskENTER_CRITICAL();
+  MsgBlock *block = mem_pool_alloc(&s_block_pool);
+  if (block == NULL) {
+    s_topics[topic].stats.alloc_failures++;
+    taskEXIT_CRITICAL();
+    return NULL;
+  }
+  block->allocated = true;
+  block->topic = topic;
+  block->refs = 1;
+  taskEXIT_CRITICAL();
+  return block->payload;
+}
+
+StatusCode msg_bus_free(void *payload) {
+  return msg_bus_release(payload);
+}
+
+StatusCode msg_bus_publish(Topic topic, void *payload) {
+  MsgBlock *block = prv_block(payload);
+  if (topic >= NUM_TOPICS || block == NULL || block->topic != topic) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  MsgBusTopic *bus_topic = &s_topics[topic];
+
+  if (bus_topic->settings.policy == MSG_BUS_BLOCK && prv_mailboxes_full(bus_topic)) {
+    taskENTER_CRITICAL();
+    bus_topic->stats.blocked++;
+    taskEXIT_CRITICAL();
+    // Subscribers make room as they run, polled once per tick
+    for (uint16_t waited = 0; waited < bus_topic->settings.block_ms; ++waited) {
+      delay_ms(1);
+      if (!prv_mailboxes_full(bus_topic)) {
+        break;
+      }
+    }
+  }
+
+  uint8_t notify_mask = 0;
+  block->published_us = timestamp_us();
+  taskENTER_CRITICAL();
+  for (uint8_t i = 0; i < bus_topic->num_subscribers; ++i) {
+    MsgBusMailbox *mailbox = &bus_topic->mailboxes[i];
+    if (mailbox->count == MSG_BUS_MAILBOX_SIZE) {
+      bus_topic->stats.dropped++;
+      if (bus_topic->settings.policy != MSG_BUS_DROP_OLDEST) {
+        continue;
+      }
+      prv_unref(mailbox->messages[mailbox->head]);
+      mailbox->head = (mailbox->head + 1) % MSG_BUS_MAILBOX_SIZE;
+      mailbox->count--;
+    }
+    mailbox->messages[(mailbox->head + mailbox->count) % MSG_BUS_MAILBOX_SIZE] = block;
+    mailbox->count++;
+    block->refs++;
+    bus_topic->stats.delivered++;
+    notify_mask |= 1 << i;
+  }
+  bus_topic->stats.published++;
+  // The publisher's reference
+  prv_unref(block);
+  taskEXIT_CRITICAL();
+
+  for (uint8_t i = 0; i < bus_topic->num_subscribers; ++i) {
+    if (notify_mask & (1 << i)) {
+      notify(bus_topic->mailboxes[i].task, bus_topic->mailboxes[i].event);
+    }
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode msg_bus_receive(Topic topic, const void **payload) {
+  if (topic >= NUM_TOPICS || payload == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  MsgBusTopic *bus_topic = &s_topics[topic];
+  MsgBusMailbox *mailbox = prv_find_mailbox(bus_topic, xTaskGetCurrentTaskHandle());
+  if (mailbox == NULL) {
+    return status_msg(STATUS_CODE_UNINITIALIZED, "Message bus: task isn't subscribed");
+  }
+
+  uint32_t now_us = timestamp_us();
+  taskENTER_CRITICAL();
+  if (mailbox->count == 0) {
+    taskEXIT_CRITICAL();
+    return STATUS_CODE_EMPTY;
+  }
+  MsgBlock *block = mailbox->messages[mailbox->head];
+  mailbox->head = (mailbox->head + 1) % MSG_BUS_MAILBOX_SIZE;
+  mailbox->count--;
+  histogram_record(&bus_topic->stats.latency_us, now_us - block->published_us);
+  taskEXIT_CRITICAL();
+
+  *payload = block->payload;
+  return STATUS_CODE_OK;
+}
+
+StatusCode msg_bus_release(const void *payload) {
+  taskENTER_CRITICAL();
+  MsgBlock *block = prv_block(payload);
+  if (block == NULL) {
+    taskEXIT_CRITICAL();
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  prv_unref(block);
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+StatusCode msg_bus_get_stats(Topic topic, MsgBusStats *stats) {
+  if (topic >= NUM_TOPICS || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  taskENTER_CRITICAL();
+  *stats = s_topics[topic].stats;
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+uint16_t msg_bus_blocks_in_use(void) {
+  MemStats stats;
+  mem_pool_get_stats(&s_block_pool, &stats);
+  return stats.in_use;
+}
+
+uint16_t msg_bus_peak_blocks_in_use(void) {
+  MemStats stats;
+  mem_pool_get_stats(&s_block_pool, &stats);
+  return stats.peak_in_use;
+}
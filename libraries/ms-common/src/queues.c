@@ -2,6 +2,21 @@
 
 #include <string.h>
 
+#include "run_time_stats.h"
+
+#ifdef MS_TRACE
+// Queues numbered 0 aren't traced, which includes semaphores and mutexes
+static UBaseType_t s_num_traced_queues;
+#endif
+
+#ifdef MS_RUN_TIME_STATS
+static void prv_update_peak(Queue *queue, UBaseType_t items) {
+  if (items > queue->peak_items) {
+    queue->peak_items = items;
+  }
+}
+#endif
+
 StatusCode queue_init(Queue *queue) {
   queue->handle =
       xQueueCreateStatic(queue->num_items, queue->item_size, queue->storage_buf, &queue->queue);
@@ -9,6 +24,13 @@ StatusCode queue_init(Queue *queue) {
   if (queue->handle == NULL) {
     return STATUS_CODE_INVALID_ARGS;
   }
+  queue->peak_items = 0;
+#ifdef MS_RUN_TIME_STATS
+  run_time_stats_register_queue(queue);
+#endif
+#ifdef MS_TRACE
+  vQueueSetQueueNumber(queue->handle, ++s_num_traced_queues);
+#endif
 
   return STATUS_CODE_OK;
 }
@@ -22,6 +44,9 @@ StatusCode queue_send(Queue *queue, const void *item, uint32_t delay_ms) {
   if (ret == errQUEUE_FULL) {
     return STATUS_CODE_RESOURCE_EXHAUSTED;
   }
+#ifdef MS_RUN_TIME_STATS
+  prv_update_peak(queue, uxQueueMessagesWaiting(queue->handle));
+#endif
 
   return STATUS_CODE_OK;
 }
@@ -35,6 +60,9 @@ StatusCode queue_send_from_isr(Queue *queue, const void *item, BaseType_t *highe
   if (ret == errQUEUE_FULL) {
     return STATUS_CODE_RESOURCE_EXHAUSTED;
   }
+#ifdef MS_RUN_TIME_STATS
+  prv_update_peak(queue, uxQueueMessagesWaitingFromISR(queue->handle));
+#endif
 
   return STATUS_CODE_OK;
 }
@@ -0,0 +1,163 @@
+#include "run_time_stats.h"
+
+#include "FreeRTOS.h"
+#include "log.h"
+#include "task.h"
+
+#ifdef MS_RUN_TIME_STATS
+
+typedef struct RunTimeTaskSample {
+  TaskHandle_t handle;
+  uint32_t run_time_us;
+} RunTimeTaskSample;
+
+static TaskStatus_t s_status[RUN_TIME_STATS_MAX_TASKS];
+static RunTimeTaskStats s_tasks[RUN_TIME_STATS_MAX_TASKS];
+// Task run-time counters at the start of the current window
+static RunTimeTaskSample s_samples[RUN_TIME_STATS_MAX_TASKS];
+static uint8_t s_num_tasks;
+static uint32_t s_window_start_us;
+static uint32_t s_window_us;
+
+static Queue *s_queues[RUN_TIME_STATS_MAX_QUEUES];
+static uint8_t s_num_queues;
+
+static uint32_t prv_prev_run_time(TaskHandle_t handle) {
+  for (uint8_t i = 0; i < s_num_tasks; ++i) {
+    if (s_samples[i].handle == handle) {
+      return s_samples[i].run_time_us;
+    }
+  }
+  // Created during the window
+  return 0;
+}
+
+StatusCode run_time_stats_update(void) {
+  if (uxTaskGetNumberOfTasks() > RUN_TIME_STATS_MAX_TASKS) {
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "Run time stats: too many tasks");
+  }
+  uint32_t total_us = 0;
+  UBaseType_t num_tasks = uxTaskGetSystemState(s_status, RUN_TIME_STATS_MAX_TASKS, &total_us);
+
+  // Sort by task number so indices are stable between updates
+  for (UBaseType_t i = 1; i < num_tasks; ++i) {
+    TaskStatus_t status = s_status[i];
+    UBaseType_t j = i;
+    for (; j > 0 && s_status[j - 1].xTaskNumber > status.xTaskNumber; --j) {
+      s_status[j] = s_status[j - 1];
+    }
+    s_status[j] = status;
+  }
+
+  s_window_us = total_us - s_window_start_us;
+  s_window_start_us = total_us;
+  for (UBaseType_t i = 0; i < num_tasks; ++i) {
+    const TaskStatus_t *status = &s_status[i];
+    uint32_t run_time_us = status->ulRunTimeCounter - prv_prev_run_time(status->xHandle);
+    s_tasks[i] = (RunTimeTaskStats){
+      .name = status->pcTaskName,
+      .number = status->xTaskNumber,
+      .cpu_permyriad = (s_window_us != 0) ? (uint64_t)run_time_us * 10000 / s_window_us : 0,
+      .run_time_us = run_time_us,
+      .stack_high_water = status->usStackHighWaterMark,
+    };
+  }
+  for (UBaseType_t i = 0; i < num_tasks; ++i) {
+    s_samples[i].handle = s_status[i].xHandle;
+    s_samples[i].run_time_us = s_status[i].ulRunTimeCounter;
+  }
+  s_num_tasks = num_tasks;
+  return STATUS_CODE_OK;
+}
+
+uint32_t run_time_stats_get_window_us(void) {
+  return s_window_us;
+}
+
+uint8_t run_time_stats_num_tasks(void) {
+  return s_num_tasks;
+}
+
+StatusCode run_time_stats_get_task(uint8_t index, RunTimeTaskStats *stats) {
+  if (index >= s_num_tasks || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  *stats = s_tasks[index];
+  return STATUS_CODE_OK;
+}
+
+void run_time_stats_register_queue(Queue *queue) {
+  taskENTER_CRITICAL();
+  for (uint8_t i = 0; i < s_num_queues; ++i) {
+    if (s_queues[i] == queue) {
+      taskEXIT_CRITICAL();
+      return;
+    }
+  }
+  if (s_num_queues < RUN_TIME_STATS_MAX_QUEUES) {
+    s_queues[s_num_queues++] = queue;
+  }
+  taskEXIT_CRITICAL();
+}
+
+uint8_t run_time_stats_num_queues(void) {
+  return s_num_queues;
+}
+
+StatusCode run_time_stats_get_queue(uint8_t index, RunTimeQueueStats *stats) {
+  if (index >= s_num_queues || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  Queue *queue = s_queues[index];
+  stats->num_items = queue->num_items;
+  stats->item_size = queue->item_size;
+  stats->items = uxQueueMessagesWaiting(queue->handle);
+  stats->peak_items = queue->peak_items;
+  return STATUS_CODE_OK;
+}
+
+void run_time_stats_log(void) {
+  LOG_DEBUG("Run time stats over %u ms:\n", (unsigned)(s_window_us / 1000));
+  for (uint8_t i = 0; i < s_num_tasks; ++i) {
+    const RunTimeTaskStats *task = &s_tasks[i];
+    LOG_DEBUG("  %-16s %3u.%02u%% cpu, %5u words stack free\n", task->name,
+              (unsigned)(task->cpu_permyriad / 100), (unsigned)(task->cpu_permyriad % 100),
+              (unsigned)task->stack_high_water);
+  }
+  for (uint8_t i = 0; i < s_num_queues; ++i) {
+    LOG_DEBUG("  queue %u: peak %u of %u items\n", (unsigned)i,
+              (unsigned)s_queues[i]->peak_items, (unsigned)s_queues[i]->num_items);
+  }
+}
+
+#else
+
+StatusCode run_time_stats_update(void) {
+  return status_code(STATUS_CODE_UNIMPLEMENTED);
+}
+
+uint32_t run_time_stats_get_window_us(void) {
+  return 0;
+}
+
+uint8_t run_time_stats_num_tasks(void) {
+  return 0;
+}
+
+StatusCode run_time_stats_get_task(uint8_t index, RunTimeTaskStats *stats) {
+  return status_code(STATUS_CODE_UNIMPLEMENTED);
+}
+
+void run_time_stats_register_queue(Queue *queue) {}
+
+uint8_t run_time_stats_num_queues(void) {
+  return 0;
+}
+
+StatusCode run_time_stats_get_queue(uint8_t index, RunTimeQueueStats *stats) {
+  return status_code(STATUS_CODE_UNIMPLEMENTED);
+}
+
+void run_time_stats_log(void) {}
+
+#endif
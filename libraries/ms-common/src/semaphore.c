@@ -2,11 +2,185 @@
 
 #include <stdio.h>
 
+#include "log.h"
+#include "timestamp.h"
+
+#ifdef MS_MUTEX_PROFILE
+
+static MutexProfile s_profiles[MUTEX_PROFILE_MAX];
+static Semaphore *s_profiled[MUTEX_PROFILE_MAX];
+static uint8_t s_num_profiles;
+
+static void prv_profile_clear(MutexProfile *profile) {
+  profile->acquisitions = 0;
+  profile->contended = 0;
+  profile->timeouts = 0;
+  histogram_init(&profile->wait_us);
+  histogram_init(&profile->hold_us);
+  profile->longest_holder = NULL;
+}
+
+static void prv_profile_init(Semaphore *sem, bool is_mutex) {
+  taskENTER_CRITICAL();
+  sem->profile = NULL;
+  for (uint8_t i = 0; i < s_num_profiles; ++i) {
+    if (s_profiled[i] == sem) {
+      sem->profile = &s_profiles[i];
+    }
+  }
+  if (sem->profile == NULL && s_num_profiles < MUTEX_PROFILE_MAX) {
+    s_profiled[s_num_profiles] = sem;
+    sem->profile = &s_profiles[s_num_profiles++];
+    sem->profile->name = NULL;
+  }
+  if (sem->profile != NULL) {
+    prv_profile_clear(sem->profile);
+    sem->profile->is_mutex = is_mutex;
+    sem->profile->holder = NULL;
+  }
+  taskEXIT_CRITICAL();
+}
+
+// Tries to take without blocking first, so contention is counted exactly
+static BaseType_t prv_profile_take(Semaphore *sem, TickType_t ticks_to_wait) {
+  MutexProfile *profile = sem->profile;
+  if (profile == NULL) {
+    return xSemaphoreTake(sem->handle, ticks_to_wait);
+  }
+
+  uint64_t start_us = timestamp_us();
+  bool contended = false;
+  BaseType_t taken = xSemaphoreTake(sem->handle, 0);
+  if (taken == pdFALSE && ticks_to_wait != 0) {
+    contended = true;
+    taken = xSemaphoreTake(sem->handle, ticks_to_wait);
+  }
+  uint64_t now_us = timestamp_us();
+
+  taskENTER_CRITICAL();
+  if (taken == pdFALSE) {
+    profile->timeouts++;
+  } else {
+    profile->acquisitions++;
+    profile->contended += contended;
+    histogram_record(&profile->wait_us, now_us - start_us);
+    if (profile->is_mutex) {
+      profile->holder = xTaskGetCurrentTaskHandle();
+      profile->locked_us = now_us;
+    }
+  }
+  taskEXIT_CRITICAL();
+  return taken;
+}
+
+// Called before giving a mutex, so the next holder can't overwrite the lock time
+static void prv_profile_release(Mutex *mutex) {
+  MutexProfile *profile = mutex->profile;
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  if (profile == NULL || profile->holder != task) {
+    return;
+  }
+
+  uint32_t hold_us = timestamp_us() - profile->locked_us;
+  taskENTER_CRITICAL();
+  if (hold_us >= profile->hold_us.max) {
+    profile->longest_holder = pcTaskGetName(task);
+  }
+  histogram_record(&profile->hold_us, hold_us);
+  profile->holder = NULL;
+  taskEXIT_CRITICAL();
+}
+
+void mutex_profile_set_name(Mutex *mutex, const char *name) {
+  if (mutex != NULL && mutex->profile != NULL) {
+    mutex->profile->name = name;
+  }
+}
+
+uint8_t mutex_profile_count(void) {
+  return s_num_profiles;
+}
+
+StatusCode mutex_profile_get(uint8_t index, MutexProfile *profile) {
+  if (index >= s_num_profiles || profile == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  taskENTER_CRITICAL();
+  *profile = s_profiles[index];
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+void mutex_profile_reset(void) {
+  for (uint8_t i = 0; i < s_num_profiles; ++i) {
+    taskENTER_CRITICAL();
+    prv_profile_clear(&s_profiles[i]);
+    taskEXIT_CRITICAL();
+  }
+}
+
+void mutex_profile_log(void) {
+  // Too large for the calling task's stack
+  static MutexProfile profile;
+  bool logged[MUTEX_PROFILE_MAX] = { 0 };
+
+  for (uint8_t n = 0; n < s_num_profiles; ++n) {
+    // Most contended first
+    uint8_t next = 0;
+    bool found = false;
+    for (uint8_t i = 0; i < s_num_profiles; ++i) {
+      if (!logged[i] && (!found || s_profiles[i].contended > s_profiles[next].contended)) {
+        next = i;
+        found = true;
+      }
+    }
+    logged[next] = true;
+    mutex_profile_get(next, &profile);
+
+    LOG_DEBUG("%s %u: %u taken, %u contended, %u timeouts\n",
+              (profile.name != NULL) ? profile.name : (profile.is_mutex ? "mutex" : "sem"),
+              (unsigned)next, (unsigned)profile.acquisitions, (unsigned)profile.contended,
+              (unsigned)profile.timeouts);
+    LOG_DEBUG("  wait us: p50 %u, p99 %u, max %u\n",
+              (unsigned)histogram_percentile(&profile.wait_us, 50),
+              (unsigned)histogram_percentile(&profile.wait_us, 99), (unsigned)profile.wait_us.max);
+    if (profile.is_mutex && profile.hold_us.count != 0) {
+      LOG_DEBUG("  hold us: mean %u, p99 %u, max %u by %s\n",
+                (unsigned)histogram_mean(&profile.hold_us),
+                (unsigned)histogram_percentile(&profile.hold_us, 99), (unsigned)profile.hold_us.max,
+                (profile.longest_holder != NULL) ? profile.longest_holder : "?");
+    }
+  }
+}
+
+#else
+
+#define prv_profile_init(sem, is_mutex)
+#define prv_profile_take(sem, ticks_to_wait) xSemaphoreTake((sem)->handle, (ticks_to_wait))
+#define prv_profile_release(mutex)
+
+void mutex_profile_set_name(Mutex *mutex, const char *name) {}
+
+uint8_t mutex_profile_count(void) {
+  return 0;
+}
+
+StatusCode mutex_profile_get(uint8_t index, MutexProfile *profile) {
+  return status_code(STATUS_CODE_UNIMPLEMENTED);
+}
+
+void mutex_profile_reset(void) {}
+
+void mutex_profile_log(void) {}
+
+#endif
+
 StatusCode mutex_init(Mutex *mutex) {
   mutex->handle = xSemaphoreCreateMutexStatic(&mutex->buffer);
   if (mutex->handle == NULL) {
     return STATUS_CODE_UNINITIALIZED;
   } else {
+    prv_profile_init(mutex, true);
     return STATUS_CODE_OK;
   }
 }
@@ -21,7 +195,7 @@ StatusCode mutex_lock(Mutex *mutex, uint16_t ms_to_wait) {
   } else {
     ticks_to_wait = pdMS_TO_TICKS(ms_to_wait);
   }
-  if (xSemaphoreTake(mutex->handle, ticks_to_wait) == pdFALSE) {
+  if (prv_profile_take(mutex, ticks_to_wait) == pdFALSE) {
     return STATUS_CODE_TIMEOUT;
   }
   return STATUS_CODE_OK;
@@ -31,6 +205,7 @@ StatusCode mutex_unlock(Mutex *mutex) {
   if (mutex == NULL || mutex->handle == NULL) {
     return STATUS_CODE_INVALID_ARGS;
   }
+  prv_profile_release(mutex);
   if (xSemaphoreGive(mutex->handle) == pdFALSE) {
     return STATUS_CODE_INTERNAL_ERROR;
   }
@@ -45,6 +220,7 @@ StatusCode sem_init(Semaphore *sem, uint32_t max_count, uint32_t initial_count)
   if (sem->handle == NULL) {
     return STATUS_CODE_UNINITIALIZED;
   } else {
+    prv_profile_init(sem, false);
     return STATUS_CODE_OK;
   }
 }
@@ -53,7 +229,7 @@ StatusCode sem_wait(Semaphore *sem, uint32_t timeout_ms) {
   if (sem == NULL) {
     return STATUS_CODE_INVALID_ARGS;
   }
-  if (xSemaphoreTake(sem->handle, timeout_ms) == pdFALSE) {
+  if (prv_profile_take(sem, timeout_ms) == pdFALSE) {
     return STATUS_CODE_TIMEOUT;
   }
   return STATUS_CODE_OK;
@@ -1,5 +1,188 @@
 #include "soft_timer.h"
 
+#include "notify.h"
+#include "tasks.h"
+
+#define WHEEL_MASK (SOFT_TIMER_WHEEL_SLOTS - 1)
+#define NUM_WHEEL_SLOTS (SOFT_TIMER_WHEEL_LEVELS * SOFT_TIMER_WHEEL_SLOTS)
+// Furthest expiry the wheel can place, relative to the next tick
+#define WHEEL_RANGE ((TickType_t)1 << (SOFT_TIMER_WHEEL_BITS * SOFT_TIMER_WHEEL_LEVELS))
+// Slot of a timer which isn't in the wheel
+#define NO_SLOT UINT16_MAX
+
+// Ticks spanned by one slot of a level
+#define LEVEL_SHIFT(level) (SOFT_TIMER_WHEEL_BITS * (level))
+
+static SoftTimer *s_wheel[NUM_WHEEL_SLOTS];
+// Bit i is set when slot i of the level has timers in it
+static uint64_t s_occupied[SOFT_TIMER_WHEEL_LEVELS];
+// Next tick to process, the wheel is placed relative to it
+static TickType_t s_next_tick;
+// Expired timers whose callbacks haven't run yet
+static SoftTimer *s_expiring;
+// Tick the soft_timer task wakes up at, unless it's idle
+static TickType_t s_wake_tick;
+static bool s_idle = true;
+static SoftTimerStats s_stats;
+
+static bool prv_before(TickType_t a, TickType_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+static void prv_push(SoftTimer **head, SoftTimer *timer, uint16_t slot) {
+  timer->next = *head;
+  if (*head != NULL) {
+    (*head)->pprev = &timer->next;
+  }
+  *head = timer;
+  timer->pprev = head;
+  timer->slot = slot;
+}
+
+static void prv_unlink(SoftTimer *timer) {
+  *timer->pprev = timer->next;
+  if (timer->next != NULL) {
+    timer->next->pprev = timer->pprev;
+  }
+  if (timer->slot != NO_SLOT && s_wheel[timer->slot] == NULL) {
+    s_occupied[timer->slot / SOFT_TIMER_WHEEL_SLOTS] &=
+        ~((uint64_t)1 << (timer->slot & WHEEL_MASK));
+  }
+  timer->pprev = NULL;
+}
+
+// Places a timer in the lowest level whose range covers its expiry, must be called in a critical
+// section
+static void prv_place(SoftTimer *timer) {
+  TickType_t delta = timer->expiry - s_next_tick;
+  TickType_t expiry = timer->expiry;
+  uint8_t level = 0;
+  if ((int32_t)delta < 0) {
+    // Already due
+    expiry = s_next_tick;
+  } else if (delta >= WHEEL_RANGE) {
+    // Parked in the furthest slot, placed again when it's cascaded
+    expiry = s_next_tick + WHEEL_RANGE - 1;
+    level = SOFT_TIMER_WHEEL_LEVELS - 1;
+  } else {
+    while (delta >= ((TickType_t)1 << LEVEL_SHIFT(level + 1))) {
+      level++;
+    }
+  }
+
+  uint8_t index = (expiry >> LEVEL_SHIFT(level)) & WHEEL_MASK;
+  uint16_t slot = level * SOFT_TIMER_WHEEL_SLOTS + index;
+  prv_push(&s_wheel[slot], timer, slot);
+  s_occupied[level] |= (uint64_t)1 << index;
+}
+
+// Next tick which has expiring timers or cascades a level, false if the wheel is empty
+static bool prv_next_event(TickType_t *tick) {
+  bool found = false;
+  uint8_t offset = s_next_tick & WHEEL_MASK;
+  if (s_occupied[0] != 0) {
+    // Rotate so bit 0 is the next tick
+    uint64_t pending = (s_occupied[0] >> offset) | (s_occupied[0] << ((64 - offset) & 63));
+    *tick = s_next_tick + (TickType_t)__builtin_ctzll(pending);
+    found = true;
+  }
+  for (uint8_t level = 1; level < SOFT_TIMER_WHEEL_LEVELS; ++level) {
+    if (s_occupied[level] != 0) {
+      TickType_t cascade = s_next_tick + ((SOFT_TIMER_WHEEL_SLOTS - offset) & WHEEL_MASK);
+      if (!found || prv_before(cascade, *tick)) {
+        *tick = cascade;
+      }
+      found = true;
+      break;
+    }
+  }
+  return found;
+}
+
+// Moves the timers of each level whose slot turns over at tick down the wheel
+static void prv_cascade(TickType_t tick) {
+  for (uint8_t level = 1; level < SOFT_TIMER_WHEEL_LEVELS; ++level) {
+    if ((tick & (((TickType_t)1 << LEVEL_SHIFT(level)) - 1)) != 0) {
+      break;
+    }
+    uint8_t index = (tick >> LEVEL_SHIFT(level)) & WHEEL_MASK;
+    SoftTimer *timer = s_wheel[level * SOFT_TIMER_WHEEL_SLOTS + index];
+    s_wheel[level * SOFT_TIMER_WHEEL_SLOTS + index] = NULL;
+    s_occupied[level] &= ~((uint64_t)1 << index);
+    while (timer != NULL) {
+      SoftTimer *next = timer->next;
+      prv_place(timer);
+      timer = next;
+    }
+  }
+}
+
+// Runs the callbacks of every timer which expired by now, returns the ticks until the next event
+static TickType_t prv_process(void) {
+  uint16_t batch = 0;
+  TickType_t now = xTaskGetTickCount();
+  taskENTER_CRITICAL();
+  TickType_t tick = 0;
+  while (prv_next_event(&tick) && !prv_before(now, tick)) {
+    // Nothing happens between the previous tick and this one
+    s_next_tick = tick;
+    prv_cascade(tick);
+
+    SoftTimer **slot = &s_wheel[tick & WHEEL_MASK];
+    while (*slot != NULL) {
+      SoftTimer *timer = *slot;
+      prv_unlink(timer);
+      prv_push(&s_expiring, timer, NO_SLOT);
+    }
+    // Timers started by the callbacks are placed after this tick
+    s_next_tick = tick + 1;
+
+    while (s_expiring != NULL) {
+      SoftTimer *timer = s_expiring;
+      prv_unlink(timer);
+      s_stats.active--;
+      s_stats.expired++;
+      TickType_t late = xTaskGetTickCount() - timer->expiry;
+      if ((int32_t)late > 0) {
+        s_stats.late++;
+        uint32_t late_ms = late * 1000U / configTICK_RATE_HZ;
+        if (late_ms > s_stats.max_late_ms) {
+          s_stats.max_late_ms = late_ms;
+        }
+      }
+      batch++;
+      taskEXIT_CRITICAL();
+      timer->callback(timer->id);
+      taskENTER_CRITICAL();
+    }
+    now = xTaskGetTickCount();
+  }
+
+  if (batch > s_stats.max_batch) {
+    s_stats.max_batch = batch;
+  }
+  TickType_t wait = portMAX_DELAY;
+  s_idle = !prv_next_event(&tick);
+  if (!s_idle) {
+    s_wake_tick = tick;
+    wait = tick - now;
+  }
+  taskEXIT_CRITICAL();
+  return wait;
+}
+
+TASK(soft_timer, TASK_STACK_256) {
+  while (true) {
+    TickType_t wait = prv_process();
+    uint32_t wait_ms = BLOCK_INDEFINITELY;
+    if (wait != portMAX_DELAY) {
+      // Never long enough to block indefinitely, the task wakes at least once per level 0 turn
+      wait_ms = wait * 1000U / configTICK_RATE_HZ;
+    }
+    notify_wait(NULL, wait_ms);
+  }
+}
+
 StatusCode soft_timer_init_and_start(uint32_t duration_ms, SoftTimerCallback callback,
                                      SoftTimer *timer) {
   status_ok_or_return(soft_timer_init(duration_ms, callback, timer));
@@ -7,12 +190,17 @@ StatusCode soft_timer_init_and_start(uint32_t duration_ms, SoftTimerCallback cal
 }
 
 StatusCode soft_timer_init(uint32_t duration_ms, SoftTimerCallback callback, SoftTimer *timer) {
+  // Only created by the first timer
+  status_ok_or_return(tasks_init_task(soft_timer, SOFT_TIMER_TASK_PRIORITY, NULL));
+
   if (timer->id != NULL) {
-    // timer already exist/inuse, delete the old timer
-    xTimerDelete(timer->id, 0);
+    // timer already exist/inuse, stop the old timer
+    soft_timer_cancel(timer);
   }
-  timer->id = xTimerCreateStatic(NULL, pdMS_TO_TICKS(duration_ms), pdFALSE,  //
-                                 NULL, callback, &timer->buffer);
+  timer->callback = callback;
+  timer->duration = pdMS_TO_TICKS(duration_ms);
+  timer->pprev = NULL;
+  timer->id = timer;
   return STATUS_CODE_OK;
 }
 
@@ -20,34 +208,69 @@ StatusCode soft_timer_start(SoftTimer *timer) {
   if (timer->id == NULL) {
     return STATUS_CODE_UNINITIALIZED;
   }
-  if (xTimerStart(timer->id, 0) != pdPASS) {
-    return status_msg(STATUS_CODE_INTERNAL_ERROR, "timer command queue is full");
+  TickType_t now = xTaskGetTickCount();
+  taskENTER_CRITICAL();
+  if (s_stats.active == 0 && prv_before(s_next_tick, now)) {
+    // Catch up an empty wheel in one step
+    s_next_tick = now;
+  }
+  if (timer->pprev != NULL) {
+    prv_unlink(timer);
+  } else if (++s_stats.active > s_stats.peak_active) {
+    s_stats.peak_active = s_stats.active;
+  }
+  timer->expiry = now + timer->duration;
+  prv_place(timer);
+  // The task only needs waking if it would sleep past this timer
+  bool wake = s_idle || prv_before(timer->expiry, s_wake_tick);
+  if (wake) {
+    s_idle = false;
+    s_wake_tick = timer->expiry;
+  }
+  taskEXIT_CRITICAL();
+
+  if (wake) {
+    notify(soft_timer, 0);
   }
   return STATUS_CODE_OK;
 }
 
 StatusCode soft_timer_cancel(SoftTimer *timer) {
-  if (xTimerDelete(timer->id, 0) != pdPASS) {
-    return status_msg(STATUS_CODE_INTERNAL_ERROR, "timer command queue is full");
+  if (timer->id == NULL) {
+    return STATUS_CODE_UNINITIALIZED;
+  }
+  taskENTER_CRITICAL();
+  if (timer->pprev != NULL) {
+    prv_unlink(timer);
+    s_stats.active--;
   }
+  taskEXIT_CRITICAL();
   return STATUS_CODE_OK;
 }
 
 StatusCode soft_timer_reset(SoftTimer *timer) {
-  if (xTimerReset(timer->id, 0) != pdPASS) {
-    return status_msg(STATUS_CODE_INTERNAL_ERROR, "timer command queue is full");
-  }
-  return STATUS_CODE_OK;
+  return soft_timer_start(timer);
 }
 
 bool soft_timer_inuse(SoftTimer *timer) {
-  return xTimerIsTimerActive(timer->id);
+  return timer->id != NULL && timer->pprev != NULL;
 }
 
 uint32_t soft_timer_remaining_time(SoftTimer *timer) {
   if (!soft_timer_inuse(timer)) {
     return 0;
   }
+  TickType_t remaining = timer->expiry - xTaskGetTickCount();
+  if ((int32_t)remaining < 0) {
+    // Expired, waiting for the soft_timer task to run it
+    return 0;
+  }
   // convert to ms
-  return (xTimerGetExpiryTime(timer->id) - xTaskGetTickCount()) * 1000U / configTICK_RATE_HZ;
+  return remaining * 1000U / configTICK_RATE_HZ;
+}
+
+void soft_timer_get_stats(SoftTimerStats *stats) {
+  taskENTER_CRITICAL();
+  *stats = s_stats;
+  taskEXIT_CRITICAL();
 }
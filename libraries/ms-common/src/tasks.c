@@ -1,14 +1,35 @@
 #include "tasks.h"
 
 #include <stdbool.h>
+#include <string.h>
 
 #include "FreeRTOS.h"
+#include "boot.h"
 #include "log.h"
 #include "status.h"
+#include "timestamp.h"
 
-// End task semaphore.
-static StaticSemaphore_t s_end_task_sem;
-static SemaphoreHandle_t s_end_task_handle = NULL;
+#define TASK_END_ALL_BITS ((EventBits_t)((1u << MAX_NUM_TASKS) - 1))
+// Set when a task which can't be joined ends, wakes wait_tasks(num_tasks)
+#define TASK_END_COUNT_BIT ((EventBits_t)(1u << MAX_NUM_TASKS))
+// Thread local storage pointer holding the Task of every task created with tasks_init_task()
+#define TASK_TLS_INDEX 0
+
+// End task event group, bit i is set when s_tasks[i] ends a cycle
+static StaticEventGroup_t s_end_task_group;
+static EventGroupHandle_t s_end_task_handle = NULL;
+
+static Task *s_tasks[MAX_NUM_TASKS];
+static uint8_t s_num_tasks;
+static TaskEndStats s_end_stats[MAX_NUM_TASKS];
+static uint64_t s_expect_us[MAX_NUM_TASKS];
+static uint64_t s_missed_us[MAX_NUM_TASKS];
+// Tasks which wait_tasks() is waiting on
+static EventBits_t s_expected;
+// Tasks which missed wait_tasks() and haven't ended yet
+static EventBits_t s_late;
+// Ends not yet taken by wait_tasks(num_tasks), a task may end more than once
+static uint32_t s_num_ends;
 
 // Add any setup or teardown that needs to be done for every task here.
 static void prv_task(void *params) {
@@ -19,6 +40,7 @@ static void prv_task(void *params) {
   }
 
   LOG_DEBUG("Task %s starting.\n", task->name);
+  vTaskSetThreadLocalStoragePointer(NULL, TASK_TLS_INDEX, task);
 
   // Call the task function. This shouldn't exit.
   task->task_func(task->context);
@@ -28,6 +50,16 @@ static void prv_task(void *params) {
   vTaskDelete(NULL);
 }
 
+static bool prv_find_task(TaskHandle_t handle, uint8_t *index) {
+  for (uint8_t i = 0; i < s_num_tasks; ++i) {
+    if (s_tasks[i]->handle == handle) {
+      *index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
 StatusCode tasks_init_task(Task *task, TaskPriority priority, void *context) {
   // Defensively guard against invalid initialization - it's bad to get this wrong.
   if (task == NULL || task->task_func == NULL) {
@@ -48,28 +80,57 @@ StatusCode tasks_init_task(Task *task, TaskPriority priority, void *context) {
     task->stack_size = TASK_MIN_STACK_SIZE;
   }
 
-  // Task already created
-  if (task->handle != NULL) {
-    return STATUS_CODE_OK;
+  // A task already created is only registered again if tasks_init() has run since
+  if (task->handle == NULL) {
+    task->context = context;
+    task->handle = xTaskCreateStatic(prv_task, task->name, task->stack_size, task, priority,
+                                     task->stack, &task->tcb);
+    if (task->handle == NULL) {
+      LOG_CRITICAL("Failed to create Task %s", task->name);  // make sure it was created
+      return status_msg(STATUS_CODE_INTERNAL_ERROR, "Task creation failed");
+    }
+    LOG_DEBUG("Create Task %s", task->name);
   }
 
-  task->context = context;
-  task->handle = xTaskCreateStatic(prv_task, task->name, task->stack_size, task, priority,
-                                   task->stack, &task->tcb);
-  if (task->handle == NULL) {
-    LOG_CRITICAL("Failed to create Task %s", task->name);  // make sure it was created
-  } else {
-    LOG_DEBUG("Create Task %s", task->name);  // make sure it was created
+  // Boot steps may create tasks from several tasks at once
+  uint8_t index = 0;
+  taskENTER_CRITICAL();
+  bool registered = prv_find_task(task->handle, &index);
+  bool joinable = registered || s_num_tasks < MAX_NUM_TASKS;
+  if (!registered && joinable) {
+    s_tasks[s_num_tasks++] = task;
+  }
+  taskEXIT_CRITICAL();
+  if (!joinable) {
+    LOG_WARN("Task %s can't be joined, more than %d tasks\n", task->name, MAX_NUM_TASKS);
   }
   return STATUS_CODE_OK;
 }
 
+static uint32_t prv_saturate(uint64_t value) {
+  return (value > UINT32_MAX) ? UINT32_MAX : (uint32_t)value;
+}
+
+// Called when wait_tasks() times out
+static void prv_missed(EventBits_t missed) {
+  uint64_t now_us = timestamp_us();
+  for (uint8_t i = 0; i < s_num_tasks; ++i) {
+    if (missed & (1u << i)) {
+      s_end_stats[i].misses++;
+      s_missed_us[i] = now_us;
+      LOG_WARN("Task %s missed its deadline (%u times)\n", s_tasks[i]->name,
+               (unsigned)s_end_stats[i].misses);
+    }
+  }
+}
+
 void tasks_start(void) {
   if (s_end_task_handle == NULL) {
-    LOG_CRITICAL("s_end_task_sem not initialized! Call tasks_init() first\n");
+    LOG_CRITICAL("End task event group not initialized! Call tasks_init() first\n");
     return;
   }
 
+  boot_mark("scheduler");
   vTaskStartScheduler();
 
   // We expect the scheduler to stop in task tests, but it's a critical problem otherwise.
@@ -79,8 +140,18 @@ void tasks_start(void) {
 }
 
 StatusCode tasks_init(void) {
-  // Initialize the end task semaphore.
-  s_end_task_handle = xSemaphoreCreateCountingStatic(MAX_NUM_TASKS, 0, &s_end_task_sem);
+  // The first thing every board does, so boot phases are timed from here unless main() started
+  // the boot clock earlier
+  boot_init();
+
+  // Initialize the end task event group.
+  s_end_task_handle = xEventGroupCreateStatic(&s_end_task_group);
+  // Tasks are registered again by tasks_init_task()
+  s_num_tasks = 0;
+  memset(s_end_stats, 0, sizeof(s_end_stats));
+  s_expected = 0;
+  s_late = 0;
+  s_num_ends = 0;
 
   if (s_end_task_handle == NULL) {
     return STATUS_CODE_UNINITIALIZED;
@@ -89,25 +160,188 @@ StatusCode tasks_init(void) {
   }
 }
 
+StatusCode tasks_expect_end(Task *task) {
+  uint8_t index = 0;
+  if (task == NULL || !prv_find_task(task->handle, &index)) {
+    return status_msg(STATUS_CODE_INVALID_ARGS, "Task can't be joined");
+  }
+  uint64_t now_us = timestamp_us();
+  taskENTER_CRITICAL();
+  s_expect_us[index] = now_us;
+  s_expected |= 1u << index;
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+// Waits for num_tasks ends from any tasks, counting each end rather than each task
+static StatusCode prv_wait_num_ends(uint16_t num_tasks) {
+  TickType_t start = xTaskGetTickCount();
+  TickType_t timeout = pdMS_TO_TICKS(WAIT_TASK_TIMEOUT_MS);
+  while (true) {
+    taskENTER_CRITICAL();
+    bool done = s_num_ends >= num_tasks;
+    if (done) {
+      s_num_ends -= num_tasks;
+    }
+    taskEXIT_CRITICAL();
+    if (done) {
+      return STATUS_CODE_OK;
+    }
+
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= timeout) {
+      // Task took longer than 1 second for its execution cycle, return timeout
+      taskENTER_CRITICAL();
+      s_num_ends = 0;
+      taskEXIT_CRITICAL();
+      return STATUS_CODE_TIMEOUT;
+    }
+    // Every end sets its task's bit after counting, so this wakes for ends since the check
+    xEventGroupWaitBits(s_end_task_handle, TASK_END_ALL_BITS | TASK_END_COUNT_BIT, pdTRUE, pdFALSE,
+                        timeout - elapsed);
+  }
+}
+
 StatusCode wait_tasks(uint16_t num_tasks) {
-  for (uint16_t i = 0; i < num_tasks; ++i) {
-    if (xSemaphoreTake(s_end_task_handle, pdMS_TO_TICKS(WAIT_TASK_TIMEOUT_MS)) != pdTRUE) {
+  taskENTER_CRITICAL();
+  EventBits_t expected = s_expected;
+  taskEXIT_CRITICAL();
+  if (expected == 0) {
+    return prv_wait_num_ends(num_tasks);
+  }
+
+  TickType_t start = xTaskGetTickCount();
+  TickType_t timeout = pdMS_TO_TICKS(WAIT_TASK_TIMEOUT_MS);
+  EventBits_t ended = 0;
+  while ((expected & ~ended) != 0) {
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= timeout) {
       // Task took longer than 1 second for its execution cycle, return timeout
+      EventBits_t missed = expected & ~ended;
+      taskENTER_CRITICAL();
+      s_expected &= ~expected;
+      s_late |= missed;
+      s_num_ends = 0;
+      taskEXIT_CRITICAL();
+      prv_missed(missed);
       return STATUS_CODE_TIMEOUT;
     }
+    // Ends from tasks we aren't waiting on are stray
+    ended |= xEventGroupWaitBits(s_end_task_handle, TASK_END_ALL_BITS, pdTRUE, pdFALSE,
+                                 timeout - elapsed) &
+             expected;
   }
+
+  taskENTER_CRITICAL();
+  s_expected &= ~ended;
+  // Ends are only counted for the num_tasks form
+  s_num_ends = 0;
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+TaskMask tasks_get_expected(void) {
+  taskENTER_CRITICAL();
+  TaskMask expected = s_expected;
+  taskEXIT_CRITICAL();
+  return expected;
+}
+
+StatusCode wait_tasks_any(TaskMask tasks, TaskMask *ended, uint32_t timeout_ms) {
+  if (ended == NULL || (tasks & ~TASK_END_ALL_BITS) != 0 || tasks == 0) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  EventBits_t bits = xEventGroupWaitBits(s_end_task_handle, tasks, pdTRUE, pdFALSE,
+                                         pdMS_TO_TICKS(timeout_ms)) &
+                     tasks;
+  *ended = bits;
+  if (bits == 0) {
+    taskENTER_CRITICAL();
+    EventBits_t missed = s_expected & tasks;
+    s_expected &= ~tasks;
+    s_late |= missed;
+    taskEXIT_CRITICAL();
+    prv_missed(missed);
+    return STATUS_CODE_TIMEOUT;
+  }
+
+  taskENTER_CRITICAL();
+  s_expected &= ~bits;
+  taskEXIT_CRITICAL();
   return STATUS_CODE_OK;
 }
 
 StatusCode send_task_end() {
-  if (xSemaphoreGive(s_end_task_handle) != pdTRUE) {
-    // if giving to semaphore failed, we ran out of space in the buffer
-    LOG_CRITICAL("CRITICAL: Out of buffer space in semaphore.\n");
-    return STATUS_CODE_RESOURCE_EXHAUSTED;
+  uint8_t index = 0;
+  if (!prv_find_task(xTaskGetCurrentTaskHandle(), &index)) {
+    if (pvTaskGetThreadLocalStoragePointer(NULL, TASK_TLS_INDEX) == NULL) {
+      LOG_CRITICAL("CRITICAL: send_task_end called from a task not created by tasks_init_task.\n");
+      return STATUS_CODE_INVALID_ARGS;
+    }
+    // Past MAX_NUM_TASKS, the end still counts for wait_tasks(num_tasks)
+    taskENTER_CRITICAL();
+    s_num_ends++;
+    taskEXIT_CRITICAL();
+    xEventGroupSetBits(s_end_task_handle, TASK_END_COUNT_BIT);
+    return STATUS_CODE_OK;
+  }
+  EventBits_t bit = 1u << index;
+  uint64_t now_us = timestamp_us();
+  TaskEndStats *stats = &s_end_stats[index];
+
+  taskENTER_CRITICAL();
+  bool late = s_late & bit;
+  stats->cycles++;
+  if (late) {
+    s_late &= ~bit;
+    stats->last_late_us = prv_saturate(now_us - s_missed_us[index]);
+    if (stats->last_late_us > stats->max_late_us) {
+      stats->max_late_us = stats->last_late_us;
+    }
+  } else {
+    s_num_ends++;
+    if (s_expected & bit) {
+      uint32_t response_us = prv_saturate(now_us - s_expect_us[index]);
+      if (response_us > stats->max_response_us) {
+        stats->max_response_us = response_us;
+      }
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  if (late) {
+    // wait_tasks() has already given up on this cycle
+    LOG_WARN("Task %s ended %u us late\n", s_tasks[index]->name, (unsigned)stats->last_late_us);
+  } else {
+    xEventGroupSetBits(s_end_task_handle, bit);
   }
   return STATUS_CODE_OK;
 }
 
+StatusCode tasks_get_end_stats(Task *task, TaskEndStats *stats) {
+  uint8_t index = 0;
+  if (task == NULL || stats == NULL || !prv_find_task(task->handle, &index)) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  taskENTER_CRITICAL();
+  *stats = s_end_stats[index];
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+void tasks_log_end_stats(void) {
+  for (uint8_t i = 0; i < s_num_tasks; ++i) {
+    TaskEndStats stats;
+    tasks_get_end_stats(s_tasks[i], &stats);
+    if (stats.cycles == 0) {
+      continue;
+    }
+    LOG_DEBUG("%s: %u cycles, max response %u us, %u missed, max late %u us\n", s_tasks[i]->name,
+              (unsigned)stats.cycles, (unsigned)stats.max_response_us, (unsigned)stats.misses,
+              (unsigned)stats.max_late_us);
+  }
+}
+
 void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName) {
   LOG_CRITICAL("CRITICAL: Task '%s' has overflowed its allocated stack space.\n", pcTaskName);
 }
@@ -0,0 +1,259 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "timestamp.h"
+
+#define TRACE_FILE_ENV "MIDSUN_X86_TRACE_FILE"
+
+#ifdef MS_TRACE
+
+#define TRACE_INDEX_MASK (TRACE_BUFFER_SIZE - 1)
+
+#if (TRACE_BUFFER_SIZE & TRACE_INDEX_MASK) != 0
+#error TRACE_BUFFER_SIZE must be a power of two
+#endif
+
+// seq is index + 1 once the event at index is published, 0 while it's being written
+typedef struct TraceSlot {
+  uint32_t seq;
+  TraceEvent event;
+} TraceSlot;
+
+static TraceSlot s_slots[TRACE_BUFFER_SIZE];
+// Next index to claim, only ever incremented
+static uint32_t s_head;
+// Next index to read, only touched by the reader
+static uint32_t s_tail;
+static uint32_t s_head_at_init;
+static uint32_t s_dropped;
+
+static const char *s_task_names[TRACE_MAX_TASKS];
+static const char *s_span_names[TRACE_MAX_SPANS];
+// Names already written by trace_drain
+static uint32_t s_task_names_drained;
+static uint32_t s_span_names_drained;
+
+void trace_init(void) {
+  s_tail = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+  s_head_at_init = s_tail;
+  s_dropped = 0;
+  memset(s_span_names, 0, sizeof(s_span_names));
+  s_task_names_drained = 0;
+  s_span_names_drained = 0;
+}
+
+void trace_record(uint8_t type, uint16_t id, uint32_t arg) {
+  // Sampled before claiming a slot so slots are close to timestamp order
+  uint32_t timestamp = timestamp_us();
+  uint32_t index = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+  TraceSlot *slot = &s_slots[index & TRACE_INDEX_MASK];
+
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  slot->event = (TraceEvent){
+    .timestamp_us = timestamp,
+    .type = type,
+    .id = id,
+    .arg = arg,
+  };
+  __atomic_store_n(&slot->seq, index + 1, __ATOMIC_RELEASE);
+}
+
+void trace_task_created(uint16_t number, const char *name) {
+  if (number < TRACE_MAX_TASKS) {
+    s_task_names[number] = name;
+  }
+}
+
+void trace_task_switched_in(uint16_t number) {
+  trace_record(TRACE_EVENT_TASK_SWITCH, number, 0);
+}
+
+void trace_task_notified(uint16_t number) {
+  trace_record(TRACE_EVENT_TASK_NOTIFY, number, 0);
+}
+
+void trace_queue_sent(uint16_t number, uint32_t items) {
+  if (number != 0) {
+    trace_record(TRACE_EVENT_QUEUE_SEND, number, items);
+  }
+}
+
+void trace_queue_received(uint16_t number, uint32_t items) {
+  if (number != 0) {
+    trace_record(TRACE_EVENT_QUEUE_RECEIVE, number, items);
+  }
+}
+
+StatusCode trace_set_span_name(uint16_t span, const char *name) {
+  if (span >= TRACE_MAX_SPANS || name == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  s_span_names[span] = name;
+  s_span_names_drained &= ~(1u << span);
+  return STATUS_CODE_OK;
+}
+
+StatusCode trace_read(TraceEvent *event) {
+  while (true) {
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    if (s_tail == head) {
+      return STATUS_CODE_EMPTY;
+    }
+    if (head - s_tail > TRACE_BUFFER_SIZE) {
+      s_dropped += head - s_tail - TRACE_BUFFER_SIZE;
+      s_tail = head - TRACE_BUFFER_SIZE;
+    }
+
+    const TraceSlot *slot = &s_slots[s_tail & TRACE_INDEX_MASK];
+    uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq == s_tail + 1) {
+      *event = slot->event;
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+        s_tail++;
+        return STATUS_CODE_OK;
+      }
+    } else if ((int32_t)(seq - (s_tail + 1)) < 0) {
+      // Claimed but not published yet, the writer was preempted
+      return STATUS_CODE_EMPTY;
+    }
+    // Overwritten by a newer event while we were reading it
+    s_dropped++;
+    s_tail++;
+  }
+}
+
+static StatusCode prv_drain_name(TraceWriteFn write, void *context, TraceEventType type,
+                                 uint16_t id, const char *name) {
+  // Copies at most TRACE_MAX_NAME_LEN bytes, and always sends a chunk holding the terminator so
+  // the decoder knows the name is complete
+  bool terminated = false;
+  for (uint8_t offset = 0; !terminated; offset += TRACE_NAME_CHUNK) {
+    TraceEvent event = {
+      .timestamp_us = timestamp_us(),
+      .type = type,
+      .chunk = offset,
+      .id = id,
+    };
+    uint8_t *chunk = (uint8_t *)&event.arg;
+    for (uint8_t i = 0; i < TRACE_NAME_CHUNK; ++i) {
+      if (offset + i >= TRACE_MAX_NAME_LEN || name[offset + i] == '\0') {
+        terminated = true;
+        break;
+      }
+      chunk[i] = (uint8_t)name[offset + i];
+    }
+    status_ok_or_return(write((const uint8_t *)&event, sizeof(event), context));
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode trace_drain(TraceWriteFn write, void *context, uint32_t max_events) {
+  for (uint16_t i = 0; i < TRACE_MAX_TASKS; ++i) {
+    if (s_task_names[i] != NULL && !(s_task_names_drained & (1u << i))) {
+      status_ok_or_return(
+          prv_drain_name(write, context, TRACE_EVENT_TASK_NAME, i, s_task_names[i]));
+      s_task_names_drained |= 1u << i;
+    }
+  }
+  for (uint16_t i = 0; i < TRACE_MAX_SPANS; ++i) {
+    if (s_span_names[i] != NULL && !(s_span_names_drained & (1u << i))) {
+      status_ok_or_return(
+          prv_drain_name(write, context, TRACE_EVENT_SPAN_NAME, i, s_span_names[i]));
+      s_span_names_drained |= 1u << i;
+    }
+  }
+
+  TraceEvent event;
+  for (uint32_t i = 0; i < max_events && trace_read(&event) == STATUS_CODE_OK; ++i) {
+    status_ok_or_return(write((const uint8_t *)&event, sizeof(event), context));
+  }
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_write_uart(const uint8_t *data, size_t len, void *context) {
+  UartPort uart = (UartPort)(uintptr_t)context;
+  size_t sent = len;
+  status_ok_or_return(uart_tx(uart, (uint8_t *)data, &sent));
+  return (sent == len) ? STATUS_CODE_OK : status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+}
+
+StatusCode trace_drain_uart(UartPort uart, uint32_t max_events) {
+  return trace_drain(prv_write_uart, (void *)(uintptr_t)uart, max_events);
+}
+
+void trace_get_stats(TraceStats *stats) {
+  stats->recorded = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE) - s_head_at_init;
+  stats->dropped = s_dropped;
+}
+
+const char *trace_get_task_name(uint16_t number) {
+  return (number < TRACE_MAX_TASKS) ? s_task_names[number] : NULL;
+}
+
+const char *trace_get_span_name(uint16_t span) {
+  return (span < TRACE_MAX_SPANS) ? s_span_names[span] : NULL;
+}
+
+#ifdef MS_PLATFORM_X86
+static void prv_export_at_exit(void) {
+  trace_export_json(getenv(TRACE_FILE_ENV));
+}
+
+// Lives here rather than with the exporter so it's always linked in
+__attribute__((constructor)) static void prv_trace_export_init(void) {
+  if (getenv(TRACE_FILE_ENV) != NULL) {
+    atexit(prv_export_at_exit);
+  }
+}
+#endif
+
+#else
+
+void trace_init(void) {}
+
+void trace_record(uint8_t type, uint16_t id, uint32_t arg) {}
+
+void trace_task_created(uint16_t number, const char *name) {}
+
+void trace_task_switched_in(uint16_t number) {}
+
+void trace_task_notified(uint16_t number) {}
+
+void trace_queue_sent(uint16_t number, uint32_t items) {}
+
+void trace_queue_received(uint16_t number, uint32_t items) {}
+
+StatusCode trace_set_span_name(uint16_t span, const char *name) {
+  return status_code(STATUS_CODE_UNIMPLEMENTED);
+}
+
+StatusCode trace_read(TraceEvent *event) {
+  return STATUS_CODE_EMPTY;
+}
+
+StatusCode trace_drain(TraceWriteFn write, void *context, uint32_t max_events) {
+  return status_code(STATUS_CODE_UNIMPLEMENTED);
+}
+
+StatusCode trace_drain_uart(UartPort uart, uint32_t max_events) {
+  return status_code(STATUS_CODE_UNIMPLEMENTED);
+}
+
+void trace_get_stats(TraceStats *stats) {
+  stats->recorded = 0;
+  stats->dropped = 0;
+}
+
+const char *trace_get_task_name(uint16_t number) {
+  return NULL;
+}
+
+const char *trace_get_span_name(uint16_t span) {
+  return NULL;
+}
+
+#endif
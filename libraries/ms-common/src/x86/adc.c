@@ -9,6 +9,7 @@
 #include "log.h"
 #include "semaphore.h"
 #include "soft_timer.h"
+#include "x86_cosim.h"
 
 #define ADC_Channel_Vrefint 17
 #define ADC_Channel_TempSensor 16
@@ -115,6 +116,11 @@ StatusCode adc_add_channel(GpioAddress address) {
   return STATUS_CODE_OK;
 }
 
+static void prv_cosim_input(const x86CosimInput *input) {
+  GpioAddress address = { .port = input->port, .pin = input->pin };
+  adc_set_reading(address, (input->value > UINT16_MAX) ? UINT16_MAX : input->value);
+}
+
 StatusCode adc_init(void) {
   if (s_adc_status.initialized) {
     return STATUS_CODE_INVALID_ARGS;
@@ -130,6 +136,10 @@ StatusCode adc_init(void) {
   // Initialize static variables
   sem_init(&s_adc_status.converting, 1, 0);
   s_adc_status.initialized = true;
+
+  if (x86_cosim_connected()) {
+    x86_cosim_set_input_handler(X86_COSIM_INPUT_ADC, prv_cosim_input);
+  }
   return STATUS_CODE_OK;
 }
 
@@ -139,10 +149,9 @@ void adc_deinit(void) {
   memset(s_adc_ranks, 0, sizeof(uint8_t) * NUM_ADC_CHANNELS);
 }
 
-// Mimic ISR behaviour
+// Mimic ISR behaviour. A scan takes microseconds on the real ADC, so it finishes within a tick.
 static void prv_adc_mock_reading(void) {
-  LOG_DEBUG("Reading ADC\n");
-  delay_ms(100);
+  delay_ms(1);
   mutex_unlock(&s_adc_status.converting);
 }
 
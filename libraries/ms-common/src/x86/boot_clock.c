@@ -0,0 +1,19 @@
+#include <stdbool.h>
+
+#include "boot.h"
+#include "timestamp.h"
+
+static bool s_started;
+static uint64_t s_start_us;
+
+void boot_init(void) {
+  if (s_started) {
+    return;
+  }
+  s_start_us = timestamp_us();
+  s_started = true;
+}
+
+uint32_t boot_time_us(void) {
+  return s_started ? timestamp_us() - s_start_us : 0;
+}
@@ -9,6 +9,7 @@
 
 #define FLASH_DEFAULT_FILENAME "x86_flash"
 #define FLASH_USER_ENV "MIDSUN_X86_FLASH_FILE"
+#define FLASH_VERIFY_CHUNK_BYTES 64
 
 static FILE *s_flash_fp = NULL;
 
@@ -40,11 +41,21 @@ StatusCode flash_init(void) {
   return STATUS_CODE_OK;
 }
 
+// Boards don't call flash_init() since the real flash needs no setup, so the file is opened on
+// first use instead
+static StatusCode prv_check_open(void) {
+  if (s_flash_fp == NULL) {
+    return flash_init();
+  }
+  return STATUS_CODE_OK;
+}
+
 StatusCode flash_read(uintptr_t address, size_t read_bytes, uint8_t *buffer, size_t buffer_len) {
   if (buffer_len < read_bytes || address < FLASH_BASE_ADDR ||
       (address + read_bytes) > FLASH_END_ADDR || (intptr_t)address < 0) {
     return status_code(STATUS_CODE_OUT_OF_RANGE);
   }
+  status_ok_or_return(prv_check_open());
 
   fseek(s_flash_fp, (intptr_t)address, SEEK_SET);
   size_t ret = fread(buffer, 1, read_bytes, s_flash_fp);
@@ -60,24 +71,27 @@ StatusCode flash_write(uintptr_t address, uint8_t *buffer, size_t buffer_len) {
   } else if (buffer_len % FLASH_WRITE_BYTES != 0 || address % FLASH_WRITE_BYTES != 0) {
     return status_code(STATUS_CODE_INVALID_ARGS);
   }
+  status_ok_or_return(prv_check_open());
 
-  uint8_t *read_buffer = malloc(buffer_len);
-
+  // STM32 does not overwriting at all - emulate behavior
+  // Checked a chunk at a time, so any length can be written without allocating
+  uint8_t read_buffer[FLASH_VERIFY_CHUNK_BYTES];
   fseek(s_flash_fp, (intptr_t)address, SEEK_SET);
-  size_t read = fread(read_buffer, 1, buffer_len, s_flash_fp);
-  (void)read;
-
-  for (size_t i = 0; i < buffer_len; i++) {
-    // STM32 does not overwriting at all - emulate behavior
-    if (read_buffer[i] != 0xFF) {
-      free(read_buffer);
-      return status_msg(STATUS_CODE_INTERNAL_ERROR,
-                        "Flash: Attempted to write to already written flash");
+  for (size_t offset = 0; offset < buffer_len; offset += sizeof(read_buffer)) {
+    size_t chunk = buffer_len - offset;
+    if (chunk > sizeof(read_buffer)) {
+      chunk = sizeof(read_buffer);
+    }
+    size_t read = fread(read_buffer, 1, chunk, s_flash_fp);
+    (void)read;
+    for (size_t i = 0; i < chunk; i++) {
+      if (read_buffer[i] != 0xFF) {
+        return status_msg(STATUS_CODE_INTERNAL_ERROR,
+                          "Flash: Attempted to write to already written flash");
+      }
     }
   }
 
-  free(read_buffer);
-
   fseek(s_flash_fp, (intptr_t)address, SEEK_SET);
   fwrite(buffer, 1, buffer_len, s_flash_fp);
   fflush(s_flash_fp);
@@ -89,6 +103,7 @@ StatusCode flash_erase(FlashPage page) {
   if (page >= NUM_FLASH_PAGES) {
     return status_code(STATUS_CODE_OUT_OF_RANGE);
   }
+  status_ok_or_return(prv_check_open());
 
   char buffer[FLASH_PAGE_BYTES];
   memset(buffer, 0xFF, sizeof(buffer));
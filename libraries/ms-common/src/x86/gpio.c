@@ -4,9 +4,11 @@
 #include <stdint.h>
 
 #include "FreeRTOS.h"
+#include "gpio_it.h"
 #include "log.h"
 #include "status.h"
 #include "task.h"
+#include "x86_cosim.h"
 
 static GpioMode s_gpio_pin_modes[GPIO_TOTAL_PINS];
 static uint8_t s_gpio_pin_state[GPIO_TOTAL_PINS];
@@ -15,11 +17,38 @@ static uint32_t prv_get_index(const GpioAddress *address) {
   return address->port * (uint32_t)GPIO_PINS_PER_PORT + address->pin;
 }
 
+// Drives an input pin from the co-simulation, firing its interrupt on a matching edge
+static void prv_cosim_input(const x86CosimInput *input) {
+  GpioAddress address = { .port = input->port, .pin = input->pin };
+  if (address.port >= NUM_GPIO_PORTS || address.pin >= GPIO_PINS_PER_PORT ||
+      input->value >= NUM_GPIO_STATES) {
+    return;
+  }
+
+  taskENTER_CRITICAL();
+  uint32_t index = prv_get_index(&address);
+  GpioState prev_state = s_gpio_pin_state[index];
+  s_gpio_pin_state[index] = input->value;
+  taskEXIT_CRITICAL();
+
+  InterruptEdge edge;
+  if (prev_state == input->value || gpio_it_get_edge(&address, &edge) != STATUS_CODE_OK) {
+    return;
+  }
+  if (edge == INTERRUPT_EDGE_RISING_FALLING ||
+      (edge == INTERRUPT_EDGE_RISING) == (input->value == GPIO_STATE_HIGH)) {
+    gpio_it_trigger_interrupt(&address);
+  }
+}
+
 StatusCode gpio_init(void) {
   for (uint32_t i = 0; i < GPIO_TOTAL_PINS; i++) {
     s_gpio_pin_state[i] = GPIO_STATE_LOW;
   }
 
+  if (x86_cosim_connected()) {
+    x86_cosim_set_input_handler(X86_COSIM_INPUT_GPIO, prv_cosim_input);
+  }
   return STATUS_CODE_OK;
 }
 
@@ -50,6 +79,7 @@ StatusCode gpio_set_state(const GpioAddress *address, GpioState state) {
   }
   GpioMode mode = s_gpio_pin_modes[prv_get_index(address)];
   if (mode != GPIO_OUTPUT_OPEN_DRAIN && mode != GPIO_OUTPUT_PUSH_PULL) {
+    taskEXIT_CRITICAL();
     LOG_WARN("Attempting to set an input pin, check your configuration");
     return status_code(STATUS_CODE_INVALID_ARGS);
   }
@@ -8,28 +8,24 @@
 #include "status.h"
 #include "x86_interrupt.h"
 
+// As on the STM32, pin n of every port shares EXTI line n, so one interrupt per pin number
 typedef struct GpioInterrupt {
-  uint8_t interrupt_id;
   InterruptEdge edge;
   GpioAddress address;
   Task *task;
   Event event;
 } GpioInterrupt;
 
-static uint8_t s_gpio_it_handler_id;
 static GpioInterrupt s_gpio_it_interrupts[GPIO_PINS_PER_PORT];
 
-static void prv_gpio_it_handler(uint8_t interrupt_id) {
-  for (int i = 0; i < GPIO_PINS_PER_PORT; ++i) {
-    if (s_gpio_it_interrupts[i].task != NULL &&
-        s_gpio_it_interrupts[i].interrupt_id == interrupt_id) {
-      notify_from_isr(s_gpio_it_interrupts[i].task, s_gpio_it_interrupts[i].event);
-    }
+static void prv_gpio_it_handler(uint8_t vector) {
+  GpioInterrupt *interrupt = &s_gpio_it_interrupts[vector - X86_INTERRUPT_VECTOR_EXTI(0)];
+  if (interrupt->task != NULL) {
+    notify_from_isr(interrupt->task, interrupt->event);
   }
 }
 
 void gpio_it_init(void) {
-  x86_interrupt_register_handler(prv_gpio_it_handler, &s_gpio_it_handler_id);
   GpioInterrupt empty_interrupt = { 0 };
   for (uint16_t i = 0; i < GPIO_PINS_PER_PORT; i++) {
     s_gpio_it_interrupts[i] = empty_interrupt;
@@ -53,11 +49,9 @@ StatusCode gpio_it_register_interrupt(const GpioAddress *address, const Interrup
     return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "Pin already in use.");
   }
 
-  uint8_t interrupt_id;
-  status_ok_or_return(
-      x86_interrupt_register_interrupt(s_gpio_it_handler_id, settings, &interrupt_id));
+  status_ok_or_return(x86_interrupt_register(X86_INTERRUPT_VECTOR_EXTI(address->pin),
+                                             prv_gpio_it_handler, settings));
 
-  s_gpio_it_interrupts[address->pin].interrupt_id = interrupt_id;
   s_gpio_it_interrupts[address->pin].edge = settings->edge;
   s_gpio_it_interrupts[address->pin].address = *address;
   s_gpio_it_interrupts[address->pin].task = task;
@@ -69,10 +63,15 @@ StatusCode gpio_it_register_interrupt(const GpioAddress *address, const Interrup
 StatusCode gpio_it_trigger_interrupt(const GpioAddress *address) {
   if (address->port >= NUM_GPIO_PORTS || address->pin >= GPIO_PINS_PER_PORT) {
     return status_code(STATUS_CODE_INVALID_ARGS);
+  } else if (s_gpio_it_interrupts[address->pin].task == NULL) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
   }
-  return x86_interrupt_trigger(s_gpio_it_interrupts[address->pin].interrupt_id);
+  return x86_interrupt_trigger(X86_INTERRUPT_VECTOR_EXTI(address->pin));
 }
 
 StatusCode gpio_it_mask_interrupt(const GpioAddress *address, bool masked) {
-  return status_code(STATUS_CODE_UNIMPLEMENTED);
+  if (address->port >= NUM_GPIO_PORTS || address->pin >= GPIO_PINS_PER_PORT) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  return x86_interrupt_set_enabled(X86_INTERRUPT_VECTOR_EXTI(address->pin), !masked);
 }
@@ -6,6 +6,7 @@
 #include "queues.h"
 #include "semaphore.h"
 #include "stdio.h"
+#include "x86_cosim.h"
 
 typedef enum I2CMode {
   I2C_MODE_TRANSMIT = 0,
@@ -36,6 +37,15 @@ static I2CPortData s_port[NUM_I2C_PORTS] = {
   [I2C_PORT_2] = {},
 };
 
+// Queues the bytes for the port's next reads, as if a device had sent them. The device takes
+// whatever was written before, or the tx queue would fill up since nothing else reads it.
+static void prv_cosim_input(const x86CosimInput *input) {
+  if (input->port < NUM_I2C_PORTS) {
+    queue_reset(&s_port[input->port].i2c_tx_buf.queue);
+    i2c_set_data(input->port, (uint8_t *)input->data, input->len);
+  }
+}
+
 StatusCode i2c_init(I2CPort i2c, const I2CSettings *settings) {
   if (i2c >= NUM_I2C_PORTS) {
     return status_msg(STATUS_CODE_INVALID_ARGS, "Invalid I2C port.");
@@ -55,6 +65,9 @@ StatusCode i2c_init(I2CPort i2c, const I2CSettings *settings) {
   s_port[i2c].i2c_tx_buf.queue.storage_buf = s_port[i2c].i2c_tx_buf.buf;
   status_ok_or_return(queue_init(&s_port[i2c].i2c_tx_buf.queue));
 
+  if (x86_cosim_connected()) {
+    x86_cosim_set_input_handler(X86_COSIM_INPUT_I2C, prv_cosim_input);
+  }
   return STATUS_CODE_OK;
 }
 
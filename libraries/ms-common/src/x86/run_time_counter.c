@@ -0,0 +1,19 @@
+#include <time.h>
+
+#include "run_time_stats.h"
+
+static uint64_t s_start_us;
+
+static uint64_t prv_host_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+void run_time_stats_timer_init(void) {
+  s_start_us = prv_host_us();
+}
+
+uint32_t run_time_stats_counter(void) {
+  return (uint32_t)(prv_host_us() - s_start_us);
+}
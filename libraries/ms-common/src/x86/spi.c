@@ -1,9 +1,14 @@
 #include "spi.h"
 
+#include <string.h>
+
+#include "FreeRTOS.h"
 #include "log.h"
 #include "queues.h"
 #include "semaphore.h"
 #include "spi_mcu.h"
+#include "task.h"
+#include "x86_cosim.h"
 
 #define SPI_BUF_SIZE 32
 
@@ -18,10 +23,27 @@ typedef struct {
 typedef struct {
   GpioState cs_state;
   SPIBuffer spi_buf;
+  // Set by the co-simulation, answers every exchange in place of spi_set_rx()
+  uint8_t response[X86_COSIM_INPUT_DATA_LEN];
+  uint8_t response_len;
 } SpiPortData;
 
 static SpiPortData s_port[NUM_SPI_PORTS];
 
+// Names in the mutex profiling report
+static const char *s_mutex_names[NUM_SPI_PORTS] = { "spi1", "spi2" };
+
+static void prv_cosim_input(const x86CosimInput *input) {
+  if (input->port >= NUM_SPI_PORTS) {
+    return;
+  }
+  SpiPortData *port = &s_port[input->port];
+  taskENTER_CRITICAL();
+  port->response_len = (input->len < sizeof(port->response)) ? input->len : sizeof(port->response);
+  memcpy(port->response, input->data, port->response_len);
+  taskEXIT_CRITICAL();
+}
+
 StatusCode spi_init(SpiPort spi, const SpiSettings *settings) {
   if (spi >= NUM_SPI_PORTS) {
     return status_msg(STATUS_CODE_INVALID_ARGS, "Invalid SPI port.");
@@ -36,9 +58,13 @@ StatusCode spi_init(SpiPort spi, const SpiSettings *settings) {
   s_port[spi].spi_buf.tx_queue.item_size = sizeof(uint8_t);
   s_port[spi].spi_buf.tx_queue.storage_buf = s_port[spi].spi_buf.tx_buf;
   status_ok_or_return(mutex_init(&s_port[spi].spi_buf.mutex));
+  mutex_profile_set_name(&s_port[spi].spi_buf.mutex, s_mutex_names[spi]);
   status_ok_or_return(queue_init(&s_port[spi].spi_buf.rx_queue));
   status_ok_or_return(queue_init(&s_port[spi].spi_buf.tx_queue));
 
+  if (x86_cosim_connected()) {
+    x86_cosim_set_input_handler(X86_COSIM_INPUT_SPI, prv_cosim_input);
+  }
   return STATUS_CODE_OK;
 }
 
@@ -50,6 +76,17 @@ StatusCode spi_exchange(SpiPort spi, uint8_t *tx_data, size_t tx_len, uint8_t *r
   // Proceed if mutex is unlocked
   status_ok_or_return(mutex_lock(&s_port[spi].spi_buf.mutex, SPI_TIMEOUT_MS));
 
+  if (s_port[spi].response_len > 0) {
+    // The rx bytes come from the response, padded with zeros
+    taskENTER_CRITICAL();
+    for (size_t i = 0; i < rx_len; i++) {
+      rx_data[i] = (i < s_port[spi].response_len) ? s_port[spi].response[i] : 0;
+    }
+    taskEXIT_CRITICAL();
+    mutex_unlock(&s_port[spi].spi_buf.mutex);
+    return STATUS_CODE_OK;
+  }
+
   queue_reset(&s_port[spi].spi_buf.tx_queue);
   queue_reset(&s_port[spi].spi_buf.rx_queue);
 
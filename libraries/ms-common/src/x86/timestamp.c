@@ -0,0 +1,59 @@
+#include "timestamp.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define TIMESTAMP_DRIFT_ENV "MIDSUN_X86_CLOCK_DRIFT_PPM"
+
+static uint64_t s_start_ns;
+static int64_t s_drift_ppm;
+
+static uint64_t prv_host_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#ifdef MS_VIRTUAL_TIME
+#define TICK_NS (portTICK_RATE_MICROSECONDS * 1000ULL)
+
+static uint64_t s_last_ns;
+static uint64_t s_last_host_ns;
+
+// The virtual tick, plus host time elapsed since the last call so short intervals can still be
+// measured. Held below the next tick, which only the scheduler moves to.
+static uint64_t prv_elapsed_ns(void) {
+  uint64_t host_ns = prv_host_ns();
+  uint64_t tick_ns = (uint64_t)xTaskGetTickCount() * TICK_NS;
+  uint64_t elapsed_ns = s_last_ns + (host_ns - s_last_host_ns);
+  if (elapsed_ns < tick_ns) {
+    elapsed_ns = tick_ns;
+  } else if (elapsed_ns >= tick_ns + TICK_NS) {
+    elapsed_ns = tick_ns + TICK_NS - 1000;
+  }
+  s_last_ns = elapsed_ns;
+  s_last_host_ns = host_ns;
+  return elapsed_ns;
+}
+#else
+static uint64_t prv_elapsed_ns(void) {
+  return prv_host_ns() - s_start_ns;
+}
+#endif
+
+// Runs before main so the clock starts at "power-on"
+__attribute__((constructor)) static void prv_timestamp_init(void) {
+  s_start_ns = prv_host_ns();
+  char *drift = getenv(TIMESTAMP_DRIFT_ENV);
+  if (drift != NULL) {
+    s_drift_ppm = strtol(drift, NULL, 10);
+  }
+}
+
+uint64_t timestamp_us(void) {
+  uint64_t elapsed_ns = prv_elapsed_ns();
+  return (elapsed_ns + (int64_t)elapsed_ns / 1000000 * s_drift_ppm) / 1000;
+}
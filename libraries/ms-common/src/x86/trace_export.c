@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#ifdef MS_TRACE
+
+typedef struct TraceExport {
+  FILE *file;
+  int pid;
+  bool first;
+  uint64_t last_us;
+  uint16_t running;  // Task number switched in, 0 before the first switch
+  uint64_t running_since_us;
+} TraceExport;
+
+static void prv_begin_event(TraceExport *export) {
+  fprintf(export->file, export->first ? "\n  " : ",\n  ");
+  export->first = false;
+}
+
+static void prv_task_label(char *buf, size_t len, uint16_t number) {
+  const char *name = trace_get_task_name(number);
+  if (name != NULL) {
+    snprintf(buf, len, "%s", name);
+  } else {
+    snprintf(buf, len, "task %u", (unsigned)number);
+  }
+}
+
+static void prv_span_label(char *buf, size_t len, uint16_t span) {
+  const char *name = trace_get_span_name(span);
+  if (name != NULL) {
+    snprintf(buf, len, "%s", name);
+  } else {
+    snprintf(buf, len, "span %u", (unsigned)span);
+  }
+}
+
+static void prv_instant(TraceExport *export, uint64_t ts, const char *name, const char *args) {
+  prv_begin_event(export);
+  fprintf(export->file,
+          "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":%d,\"tid\":%u,"
+          "\"args\":{%s}}",
+          name, (unsigned long long)ts, export->pid, (unsigned)export->running, args);
+}
+
+static void prv_export_event(TraceExport *export, const TraceEvent *event) {
+  // Events are roughly in order, so the 32 bit timestamp is unwrapped against the previous one
+  uint64_t ts = export->last_us + (int32_t)(event->timestamp_us - (uint32_t)export->last_us);
+  export->last_us = ts;
+
+  char name[TRACE_MAX_NAME_LEN + 16];
+  char args[48];
+  switch (event->type) {
+    case TRACE_EVENT_TASK_SWITCH:
+      if (export->running != 0) {
+        prv_task_label(name, sizeof(name), export->running);
+        prv_begin_event(export);
+        fprintf(export->file,
+                "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%u}",
+                name, (unsigned long long)export->running_since_us,
+                (unsigned long long)(ts - export->running_since_us), export->pid,
+                (unsigned)export->running);
+      }
+      export->running = event->id;
+      export->running_since_us = ts;
+      break;
+    case TRACE_EVENT_TASK_NOTIFY:
+      prv_task_label(name, sizeof(name), event->id);
+      snprintf(args, sizeof(args), "\"task\":\"%s\"", name);
+      prv_instant(export, ts, "notify", args);
+      break;
+    case TRACE_EVENT_QUEUE_SEND:
+    case TRACE_EVENT_QUEUE_RECEIVE:
+      // Depth after the operation as a counter track
+      prv_begin_event(export);
+      fprintf(export->file,
+              "{\"name\":\"queue %u\",\"ph\":\"C\",\"ts\":%llu,\"pid\":%d,\"args\":{\"items\":%u}}",
+              (unsigned)event->id, (unsigned long long)ts, export->pid,
+              (unsigned)(event->arg + ((event->type == TRACE_EVENT_QUEUE_SEND) ? 1 : -1)));
+      break;
+    case TRACE_EVENT_CAN_TX:
+    case TRACE_EVENT_CAN_RX:
+      snprintf(args, sizeof(args), "\"id\":\"0x%x\",\"dlc\":%u", (unsigned)event->arg,
+               (unsigned)event->id);
+      prv_instant(export, ts, (event->type == TRACE_EVENT_CAN_TX) ? "can tx" : "can rx", args);
+      break;
+    case TRACE_EVENT_SPAN_BEGIN:
+    case TRACE_EVENT_SPAN_END:
+      prv_span_label(name, sizeof(name), event->id);
+      prv_begin_event(export);
+      fprintf(export->file, "{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%llu,\"pid\":%d,\"tid\":%u}",
+              name, (event->type == TRACE_EVENT_SPAN_BEGIN) ? "B" : "E", (unsigned long long)ts,
+              export->pid, (unsigned)export->running);
+      break;
+    case TRACE_EVENT_INSTANT:
+      prv_span_label(name, sizeof(name), event->id);
+      snprintf(args, sizeof(args), "\"value\":%u", (unsigned)event->arg);
+      prv_instant(export, ts, name, args);
+      break;
+    default:
+      break;
+  }
+}
+
+StatusCode trace_export_json(const char *path) {
+  TraceExport export = {
+    .file = fopen(path, "w"),
+    .pid = getpid(),
+    .first = true,
+  };
+  if (export.file == NULL) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "Trace: can't open the output file");
+  }
+
+  fprintf(export.file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (uint16_t i = 0; i < TRACE_MAX_TASKS; ++i) {
+    const char *name = trace_get_task_name(i);
+    if (name != NULL) {
+      prv_begin_event(&export);
+      fprintf(export.file,
+              "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+              "\"args\":{\"name\":\"%s\"}}",
+              export.pid, (unsigned)i, name);
+    }
+  }
+
+  TraceEvent event;
+  bool started = false;
+  while (trace_read(&event) == STATUS_CODE_OK) {
+    if (!started) {
+      export.last_us = event.timestamp_us;
+      started = true;
+    }
+    prv_export_event(&export, &event);
+  }
+
+  TraceStats stats;
+  trace_get_stats(&stats);
+  fprintf(export.file, "\n],\"otherData\":{\"recorded\":%u,\"dropped\":%u}}\n",
+          (unsigned)stats.recorded, (unsigned)stats.dropped);
+  fclose(export.file);
+  return STATUS_CODE_OK;
+}
+
+#else
+
+StatusCode trace_export_json(const char *path) {
+  return status_code(STATUS_CODE_UNIMPLEMENTED);
+}
+
+#endif
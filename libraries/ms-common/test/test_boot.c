@@ -0,0 +1,129 @@
+#include "boot.h"
+#include "delay.h"
+#include "log.h"
+#include "misc.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define STEP_MS 50
+
+static uint32_t s_order;
+static uint32_t s_a_order;
+static uint32_t s_b_order;
+static uint32_t s_c_order;
+
+// Blocks like relay sequencing or an I2C device's setup
+static StatusCode prv_init_a(void) {
+  delay_ms(STEP_MS);
+  s_a_order = ++s_order;
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_init_b(void) {
+  delay_ms(STEP_MS);
+  s_b_order = ++s_order;
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_init_c(void) {
+  s_c_order = ++s_order;
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_init_fails(void) {
+  return STATUS_CODE_INTERNAL_ERROR;
+}
+
+void setup_test(void) {
+  log_init();
+  s_order = 0;
+  s_a_order = 0;
+  s_b_order = 0;
+  s_c_order = 0;
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_boot_phases(void) {
+  uint8_t first = boot_num_phases();
+  uint8_t phase = boot_phase_begin("phase");
+  delay_ms(STEP_MS);
+  boot_phase_end(phase);
+  boot_mark("mark");
+  TEST_ASSERT_EQUAL(first + 2, boot_num_phases());
+
+  BootPhase info;
+  TEST_ASSERT_OK(boot_get_phase(phase, &info));
+  TEST_ASSERT_EQUAL_STRING("phase", info.name);
+  TEST_ASSERT_TRUE(info.ended);
+  TEST_ASSERT_TRUE(info.duration_us >= (STEP_MS - 1) * 1000);
+
+  TEST_ASSERT_OK(boot_get_phase(phase + 1, &info));
+  TEST_ASSERT_EQUAL_STRING("mark", info.name);
+  TEST_ASSERT_EQUAL(0, info.duration_us);
+  TEST_ASSERT_TRUE(info.start_us >= (STEP_MS - 1) * 1000);
+
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, boot_get_phase(boot_num_phases(), &info));
+  boot_log();
+}
+
+TEST_IN_TASK
+void test_boot_steps_invalid(void) {
+  BootStep cycle[] = {
+    { .name = "x", .init = prv_init_c, .deps = BOOT_DEP(1) },
+    { .name = "y", .init = prv_init_c, .deps = BOOT_DEP(0) },
+  };
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, boot_run_steps(cycle, SIZEOF_ARRAY(cycle)));
+  cycle[0].deps = BOOT_DEP(2);
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, boot_run_steps(cycle, SIZEOF_ARRAY(cycle)));
+  TEST_ASSERT_EQUAL(0, s_order);
+}
+
+TEST_IN_TASK
+void test_boot_steps_overlap(void) {
+  BootStep steps[] = {
+    { .name = "a", .init = prv_init_a },
+    { .name = "b", .init = prv_init_b },
+    { .name = "c", .init = prv_init_c, .deps = BOOT_DEP(0) | BOOT_DEP(1) },
+  };
+
+  uint32_t start_us = boot_time_us();
+  TEST_ASSERT_OK(boot_run_steps(steps, SIZEOF_ARRAY(steps)));
+  uint32_t elapsed_us = boot_time_us() - start_us;
+
+  for (uint8_t i = 0; i < SIZEOF_ARRAY(steps); ++i) {
+    TEST_ASSERT_OK(steps[i].status);
+  }
+  // The dependent step runs after its dependencies
+  TEST_ASSERT_TRUE(s_c_order > s_a_order);
+  TEST_ASSERT_TRUE(s_c_order > s_b_order);
+#if BOOT_NUM_WORKERS > 1
+  // a and b overlap, so boot takes one step's time rather than two
+  TEST_ASSERT_TRUE(elapsed_us < STEP_MS * 1000 * 3 / 2);
+#endif
+  TEST_ASSERT_TRUE(elapsed_us >= (STEP_MS - 1) * 1000);
+  boot_log();
+}
+
+TEST_IN_TASK
+void test_boot_steps_failure(void) {
+  BootStep steps[] = {
+    { .name = "fails", .init = prv_init_fails },
+    { .name = "a", .init = prv_init_a, .deps = BOOT_DEP(0) },
+    { .name = "c", .init = prv_init_c, .deps = BOOT_DEP(1) },
+    { .name = "b", .init = prv_init_b },
+  };
+
+  TEST_ASSERT_EQUAL(STATUS_CODE_INTERNAL_ERROR, boot_run_steps(steps, SIZEOF_ARRAY(steps)));
+  TEST_ASSERT_EQUAL(STATUS_CODE_INTERNAL_ERROR, steps[0].status);
+  // Everything downstream of the failure is skipped, independent steps still run
+  TEST_ASSERT_EQUAL(STATUS_CODE_UNINITIALIZED, steps[1].status);
+  TEST_ASSERT_EQUAL(STATUS_CODE_UNINITIALIZED, steps[2].status);
+  TEST_ASSERT_EQUAL(0, s_a_order);
+  TEST_ASSERT_EQUAL(0, s_c_order);
+  TEST_ASSERT_OK(steps[3].status);
+  TEST_ASSERT_TRUE(s_b_order > 0);
+}
@@ -0,0 +1,142 @@
+#include "delay.h"
+#include "dispatcher.h"
+#include "log.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define NUM_ORDERED 6
+
+static uint32_t s_calls[DISPATCHER_MAX_CALLBACKS];
+static uint32_t s_args[DISPATCHER_MAX_CALLBACKS];
+static uint32_t s_order[NUM_ORDERED];
+static uint8_t s_num_ordered;
+
+static bool prv_count(void *context, uint32_t arg) {
+  uint32_t index = (uint32_t *)context - s_calls;
+  s_calls[index]++;
+  s_args[index] += arg;
+  return false;
+}
+
+static bool prv_record_order(void *context, uint32_t arg) {
+  if (s_num_ordered < NUM_ORDERED) {
+    s_order[s_num_ordered++] = arg;
+  }
+  return false;
+}
+
+static bool prv_one_shot(void *context, uint32_t arg) {
+  (*(uint32_t *)context)++;
+  return true;
+}
+
+void setup_test(void) {
+  log_init();
+  // Lower than the test task, so dispatches queue up until it blocks
+  dispatcher_init(TASK_PRIORITY(1));
+  for (uint16_t i = 0; i < DISPATCHER_MAX_CALLBACKS; ++i) {
+    s_calls[i] = 0;
+    s_args[i] = 0;
+  }
+  s_num_ordered = 0;
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_dispatcher_capacity(void) {
+  // More than the 32 callbacks of the callback handler
+  DispatcherId ids[DISPATCHER_MAX_CALLBACKS];
+  for (uint16_t i = 0; i < DISPATCHER_MAX_CALLBACKS; ++i) {
+    ids[i] = dispatcher_register(prv_count, &s_calls[i], i % NUM_DISPATCHER_PRIORITIES);
+    TEST_ASSERT_EQUAL(i, ids[i]);
+  }
+  TEST_ASSERT_EQUAL(DISPATCHER_INVALID_ID,
+                    dispatcher_register(prv_count, NULL, DISPATCHER_PRIORITY_LOW));
+
+  for (uint16_t i = 0; i < DISPATCHER_MAX_CALLBACKS; ++i) {
+    TEST_ASSERT_OK(dispatcher_dispatch(ids[i], i));
+  }
+  delay_ms(10);
+  for (uint16_t i = 0; i < DISPATCHER_MAX_CALLBACKS; ++i) {
+    TEST_ASSERT_EQUAL(1, s_calls[i]);
+    TEST_ASSERT_EQUAL(i, s_args[i]);
+    TEST_ASSERT_OK(dispatcher_cancel(ids[i]));
+  }
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, dispatcher_dispatch(ids[0], 0));
+}
+
+TEST_IN_TASK
+void test_dispatcher_priority_order(void) {
+  DispatcherId low = dispatcher_register(prv_record_order, NULL, DISPATCHER_PRIORITY_LOW);
+  DispatcherId high = dispatcher_register(prv_record_order, NULL, DISPATCHER_PRIORITY_HIGH);
+  DispatcherId critical =
+      dispatcher_register(prv_record_order, NULL, DISPATCHER_PRIORITY_CRITICAL);
+
+  TEST_ASSERT_OK(dispatcher_dispatch(low, 1));
+  TEST_ASSERT_OK(dispatcher_dispatch(high, 2));
+  TEST_ASSERT_OK(dispatcher_dispatch(low, 3));
+  TEST_ASSERT_OK(dispatcher_dispatch(critical, 4));
+  TEST_ASSERT_OK(dispatcher_dispatch(high, 5));
+  TEST_ASSERT_EQUAL(2, dispatcher_queue_depth(DISPATCHER_PRIORITY_LOW));
+  delay_ms(10);
+
+  // Highest priority first, in dispatch order within a priority
+  uint32_t expected[] = { 4, 2, 5, 1, 3 };
+  TEST_ASSERT_EQUAL(5, s_num_ordered);
+  TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, s_order, 5);
+  TEST_ASSERT_EQUAL(0, dispatcher_queue_depth(DISPATCHER_PRIORITY_LOW));
+}
+
+TEST_IN_TASK
+void test_dispatcher_one_shot_and_stale(void) {
+  uint32_t calls = 0;
+  DispatcherId id = dispatcher_register(prv_one_shot, &calls, DISPATCHER_PRIORITY_NORMAL);
+  TEST_ASSERT_OK(dispatcher_dispatch(id, 0));
+  // Runs once, the second dispatch is of an unregistered callback
+  TEST_ASSERT_OK(dispatcher_dispatch(id, 0));
+  delay_ms(10);
+  TEST_ASSERT_EQUAL(1, calls);
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, dispatcher_cancel(id));
+
+  // Dispatches queued before a cancel don't reach a callback reusing the ID
+  id = dispatcher_register(prv_count, &s_calls[0], DISPATCHER_PRIORITY_NORMAL);
+  TEST_ASSERT_OK(dispatcher_dispatch(id, 0));
+  TEST_ASSERT_OK(dispatcher_cancel(id));
+  TEST_ASSERT_EQUAL(id, dispatcher_register(prv_count, &s_calls[0], DISPATCHER_PRIORITY_NORMAL));
+  delay_ms(10);
+  TEST_ASSERT_EQUAL(0, s_calls[0]);
+
+  DispatcherStats stats;
+  TEST_ASSERT_OK(dispatcher_get_stats(DISPATCHER_PRIORITY_NORMAL, &stats));
+  TEST_ASSERT_EQUAL(1, stats.dispatched);
+  TEST_ASSERT_EQUAL(2, stats.stale);
+}
+
+TEST_IN_TASK
+void test_dispatcher_queue_full(void) {
+  DispatcherId id = dispatcher_register(prv_count, &s_calls[0], DISPATCHER_PRIORITY_LOW);
+  for (uint32_t i = 0; i < DISPATCHER_QUEUE_SIZE; ++i) {
+    TEST_ASSERT_OK(dispatcher_dispatch(id, 1));
+  }
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED, dispatcher_dispatch(id, 1));
+  delay_ms(10);
+  TEST_ASSERT_EQUAL(DISPATCHER_QUEUE_SIZE, s_calls[0]);
+
+  // Space again once the queue is drained
+  TEST_ASSERT_OK(dispatcher_dispatch(id, 1));
+  delay_ms(10);
+  TEST_ASSERT_EQUAL(DISPATCHER_QUEUE_SIZE + 1, s_calls[0]);
+
+  dispatcher_log_stats();
+  DispatcherStats stats;
+  TEST_ASSERT_OK(dispatcher_get_stats(DISPATCHER_PRIORITY_LOW, &stats));
+  TEST_ASSERT_EQUAL(DISPATCHER_QUEUE_SIZE + 1, stats.dispatched);
+  TEST_ASSERT_EQUAL(1, stats.dropped);
+  TEST_ASSERT_EQUAL(DISPATCHER_QUEUE_SIZE, stats.peak_depth);
+  TEST_ASSERT_EQUAL(DISPATCHER_QUEUE_SIZE + 1, stats.latency_us.count);
+  // Queued until the test task blocked
+  TEST_ASSERT_TRUE(stats.latency_us.max < 10000);
+}
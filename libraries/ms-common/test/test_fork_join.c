@@ -0,0 +1,143 @@
+#include "delay.h"
+#include "fork_join.h"
+#include "log.h"
+#include "misc.h"
+#include "notify.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define STAGE_MS 50
+
+static bool s_inline_ran;
+static uint32_t s_order;
+static uint32_t s_a_order;
+static uint32_t s_c_order;
+
+// Blocks like a stage waiting on I2C or SPI
+TASK(stage_a, TASK_STACK_512) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    delay_ms(STAGE_MS);
+    s_a_order = s_order++;
+    send_task_end();
+  }
+}
+
+TASK(stage_b, TASK_STACK_512) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    delay_ms(STAGE_MS);
+    send_task_end();
+  }
+}
+
+// Doesn't end within WAIT_TASK_TIMEOUT_MS
+TASK(stage_slow, TASK_STACK_512) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    delay_ms(WAIT_TASK_TIMEOUT_MS + STAGE_MS);
+    send_task_end();
+  }
+}
+
+static void prv_start_slow(void) {
+  tasks_expect_end(stage_slow);
+  notify(stage_slow, 0);
+}
+
+// Inline, uses up the whole timeout before fork_join_run() first waits
+static void prv_start_blocking(void) {
+  delay_ms(WAIT_TASK_TIMEOUT_MS);
+}
+
+static void prv_start_a(void) {
+  tasks_expect_end(stage_a);
+  notify(stage_a, 0);
+}
+
+static void prv_start_b(void) {
+  tasks_expect_end(stage_b);
+  notify(stage_b, 0);
+}
+
+static void prv_start_c(void) {
+  s_inline_ran = true;
+  s_c_order = s_order++;
+}
+
+static ForkJoinStage s_stages[] = {
+  { .name = "a", .start = prv_start_a },
+  { .name = "b", .start = prv_start_b },
+  { .name = "c", .start = prv_start_c, .deps = FORK_JOIN_DEP(0) | FORK_JOIN_DEP(1) },
+};
+static ForkJoin s_fork_join;
+
+void setup_test(void) {
+  log_init();
+  tasks_init_task(stage_a, TASK_PRIORITY(1), NULL);
+  tasks_init_task(stage_b, TASK_PRIORITY(1), NULL);
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_fork_join_invalid(void) {
+  ForkJoin fork_join;
+  ForkJoinStage cycle[] = {
+    { .name = "x", .start = prv_start_c, .deps = FORK_JOIN_DEP(1) },
+    { .name = "y", .start = prv_start_c, .deps = FORK_JOIN_DEP(0) },
+  };
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS,
+                    fork_join_init(&fork_join, cycle, SIZEOF_ARRAY(cycle)));
+  cycle[0].deps = FORK_JOIN_DEP(2);
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS,
+                    fork_join_init(&fork_join, cycle, SIZEOF_ARRAY(cycle)));
+}
+
+TEST_IN_TASK
+void test_fork_join_overlaps_stages(void) {
+  TEST_ASSERT_OK(fork_join_init(&s_fork_join, s_stages, SIZEOF_ARRAY(s_stages)));
+
+  for (uint8_t run = 0; run < 3; ++run) {
+    s_inline_ran = false;
+    TEST_ASSERT_OK(fork_join_run(&s_fork_join));
+    TEST_ASSERT_TRUE(s_inline_ran);
+    // The dependent stage runs after its dependencies
+    TEST_ASSERT_TRUE(s_c_order > s_a_order);
+  }
+
+  // a and b overlap, so the run takes one stage's time rather than two
+  TEST_ASSERT_EQUAL(3, s_fork_join.runs);
+  TEST_ASSERT_TRUE(s_fork_join.max_us < STAGE_MS * 1000 * 3 / 2);
+  TEST_ASSERT_TRUE(s_stages[0].last_us >= (STAGE_MS - 1) * 1000);
+  TEST_ASSERT_TRUE(s_stages[2].start_us >= (STAGE_MS - 1) * 1000);
+  fork_join_log(&s_fork_join);
+}
+
+TEST_IN_TASK
+void test_fork_join_timeout(void) {
+  tasks_init_task(stage_slow, TASK_PRIORITY(1), NULL);
+  ForkJoin fork_join;
+  ForkJoinStage stages[] = {
+    { .name = "slow", .start = prv_start_slow },
+    { .name = "blocking", .start = prv_start_blocking },
+  };
+  TEST_ASSERT_OK(fork_join_init(&fork_join, stages, SIZEOF_ARRAY(stages)));
+
+  TEST_ASSERT_EQUAL(STATUS_CODE_TIMEOUT, fork_join_run(&fork_join));
+  TEST_ASSERT_EQUAL(1, fork_join.timeouts);
+  // The slow stage's task is missed rather than left expected for the next wait
+  TEST_ASSERT_EQUAL(0, tasks_get_expected());
+  TaskEndStats stats;
+  TEST_ASSERT_OK(tasks_get_end_stats(stage_slow, &stats));
+  TEST_ASSERT_EQUAL(1, stats.misses);
+
+  // Its late end doesn't end a stage of the next run early
+  TEST_ASSERT_OK(fork_join_init(&s_fork_join, s_stages, SIZEOF_ARRAY(s_stages)));
+  delay_ms(STAGE_MS * 2);
+  TEST_ASSERT_OK(fork_join_run(&s_fork_join));
+  TEST_ASSERT_TRUE(s_stages[0].last_us >= (STAGE_MS - 1) * 1000);
+  TEST_ASSERT_EQUAL(0, tasks_get_expected());
+}
@@ -0,0 +1,165 @@
+#include "fsm.h"
+#include "fsm_executor.h"
+#include "log.h"
+#include "misc.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "timestamp.h"
+#include "unity.h"
+
+#define NUM_RING_STATES 3
+#define NUM_CYCLES 30
+
+typedef enum RingStateId {
+  RING_STATE_0 = 0,
+  RING_STATE_1,
+  RING_STATE_2,
+} RingStateId;
+
+FSM_SHARED(ring_a, NUM_RING_STATES);
+FSM_SHARED(ring_b, NUM_RING_STATES);
+FSM(ring_dedicated, NUM_RING_STATES, FSM_TASK_STACK);
+FSM_EXECUTOR(test_executor, TASK_STACK_512);
+
+// Output count of each FSM, passed as its context
+static uint32_t s_outputs_a;
+static uint32_t s_outputs_b;
+static uint32_t s_outputs_dedicated;
+
+static void prv_ring_input(Fsm *fsm, void *context) {
+  fsm_transition(fsm, (fsm->curr_state + 1) % NUM_RING_STATES);
+}
+
+static void prv_ring_output(void *context) {
+  (*(uint32_t *)context)++;
+}
+
+static FsmState s_ring_states[NUM_RING_STATES] = {
+  STATE(RING_STATE_0, prv_ring_input, prv_ring_output),
+  STATE(RING_STATE_1, prv_ring_input, prv_ring_output),
+  STATE(RING_STATE_2, prv_ring_input, prv_ring_output),
+};
+
+static const FsmTransition s_ring_transitions[] = {
+  FSM_TRANSITION(RING_STATE_0, RING_STATE_1),
+  FSM_TRANSITION(RING_STATE_1, RING_STATE_2),
+  FSM_TRANSITION(RING_STATE_2, RING_STATE_0),
+};
+
+static bool s_ring_table[NUM_RING_STATES][NUM_RING_STATES] = {
+  TRANSITION(RING_STATE_0, RING_STATE_1),
+  TRANSITION(RING_STATE_1, RING_STATE_2),
+  TRANSITION(RING_STATE_2, RING_STATE_0),
+};
+
+void setup_test(void) {
+  log_init();
+  s_outputs_a = 0;
+  s_outputs_b = 0;
+  s_outputs_dedicated = 0;
+  fsm_shared_init(ring_a, s_ring_states, s_ring_transitions, RING_STATE_0, &s_outputs_a);
+  fsm_shared_init(ring_b, s_ring_states, s_ring_transitions, RING_STATE_1, &s_outputs_b);
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_shared_fsm_transitions(void) {
+  TEST_ASSERT_EQUAL(RING_STATE_0, ring_a_fsm->curr_state);
+  TEST_ASSERT_EQUAL(STATUS_CODE_INTERNAL_ERROR, fsm_transition(ring_a_fsm, RING_STATE_2));
+  TEST_ASSERT_EQUAL(STATUS_CODE_INTERNAL_ERROR, fsm_transition(ring_a_fsm, RING_STATE_0));
+  TEST_ASSERT_EQUAL(RING_STATE_0, ring_a_fsm->curr_state);
+  TEST_ASSERT_NOT_OK(fsm_transition(ring_a_fsm, NUM_RING_STATES));
+
+  TEST_ASSERT_OK(fsm_transition(ring_a_fsm, RING_STATE_1));
+  TEST_ASSERT_OK(fsm_transition(ring_a_fsm, RING_STATE_2));
+  TEST_ASSERT_OK(fsm_transition(ring_a_fsm, RING_STATE_0));
+  TEST_ASSERT_EQUAL(RING_STATE_0, ring_a_fsm->curr_state);
+
+  // One bitset per state instead of a bool per pair of states
+  TEST_ASSERT_EQUAL(sizeof(Fsm) + NUM_RING_STATES * sizeof(uint32_t), fsm_ram_bytes(ring_a_fsm));
+
+  // Transitions must be between existing states
+  const FsmTransition bad_transitions[] = { FSM_TRANSITION(RING_STATE_0, NUM_RING_STATES) };
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS,
+                    _init_shared_fsm(ring_b_fsm, s_ring_states, bad_transitions,
+                                     SIZEOF_ARRAY(bad_transitions), RING_STATE_0, NULL));
+}
+
+TEST_IN_TASK
+void test_executor_inline(void) {
+  FsmExecutor executor = { 0 };
+  fsm_executor_init_inline(&executor);
+  TEST_ASSERT_OK(fsm_executor_add(&executor, ring_a_fsm));
+  TEST_ASSERT_OK(fsm_executor_add(&executor, ring_b_fsm));
+  // FSMs with their own task can't be added
+  TEST_ASSERT_NOT_OK(fsm_executor_add(&executor, ring_dedicated_fsm));
+
+  for (uint32_t i = 0; i < NUM_CYCLES; ++i) {
+    fsm_executor_run_cycle(&executor);
+    // Steps finish before the cycle returns
+    TEST_ASSERT_EQUAL((RING_STATE_0 + i + 1) % NUM_RING_STATES, ring_a_fsm->curr_state);
+    TEST_ASSERT_EQUAL((RING_STATE_1 + i + 1) % NUM_RING_STATES, ring_b_fsm->curr_state);
+  }
+  TEST_ASSERT_EQUAL(NUM_CYCLES, s_outputs_a);
+  TEST_ASSERT_EQUAL(NUM_CYCLES, s_outputs_b);
+
+  FsmExecutorReport report;
+  fsm_executor_get_report(&executor, &report);
+  TEST_ASSERT_EQUAL(2, report.num_fsms);
+  TEST_ASSERT_EQUAL(NUM_CYCLES, report.cycles);
+  TEST_ASSERT_EQUAL(sizeof(FsmExecutor) + 2 * fsm_ram_bytes(ring_a_fsm), report.ram_bytes);
+  fsm_executor_log_report(&executor);
+}
+
+// Compares the shared task and inline executors with the FSMs on their own tasks
+TEST_IN_TASK
+void test_executor_task_vs_dedicated(void) {
+  fsm_init(ring_dedicated, s_ring_states, s_ring_table, RING_STATE_0, &s_outputs_dedicated);
+  uint32_t start_us = timestamp_us();
+  for (uint32_t i = 0; i < NUM_CYCLES; ++i) {
+    fsm_run_cycle(ring_dedicated);
+    TEST_ASSERT_OK(wait_tasks(1));
+  }
+  uint32_t dedicated_us = timestamp_us() - start_us;
+  TEST_ASSERT_EQUAL(NUM_CYCLES, s_outputs_dedicated);
+
+  fsm_executor_init(test_executor);
+  TEST_ASSERT_OK(fsm_executor_add(test_executor_executor, ring_a_fsm));
+  TEST_ASSERT_OK(fsm_executor_add(test_executor_executor, ring_b_fsm));
+  start_us = timestamp_us();
+  for (uint32_t i = 0; i < NUM_CYCLES; ++i) {
+    fsm_executor_run_cycle(test_executor_executor);
+    TEST_ASSERT_OK(wait_tasks(1));
+  }
+  uint32_t shared_us = timestamp_us() - start_us;
+  TEST_ASSERT_EQUAL(NUM_CYCLES, s_outputs_a);
+  TEST_ASSERT_EQUAL(NUM_CYCLES, s_outputs_b);
+
+  FsmExecutor inline_executor = { 0 };
+  fsm_executor_init_inline(&inline_executor);
+  TEST_ASSERT_OK(fsm_executor_add(&inline_executor, ring_a_fsm));
+  TEST_ASSERT_OK(fsm_executor_add(&inline_executor, ring_b_fsm));
+  start_us = timestamp_us();
+  for (uint32_t i = 0; i < NUM_CYCLES; ++i) {
+    fsm_executor_run_cycle(&inline_executor);
+  }
+  uint32_t inline_us = timestamp_us() - start_us;
+  TEST_ASSERT_EQUAL(2 * NUM_CYCLES, s_outputs_a);
+
+  LOG_DEBUG("%u cycles: 1 FSM on its own task %u us, 2 on a shared task %u us, 2 inline %u us\n",
+            (unsigned)NUM_CYCLES, (unsigned)dedicated_us, (unsigned)shared_us,
+            (unsigned)inline_us);
+  fsm_executor_log_report(test_executor_executor);
+
+  FsmExecutorReport report;
+  fsm_executor_get_report(test_executor_executor, &report);
+  TEST_ASSERT_EQUAL(NUM_CYCLES, report.cycles);
+  // Even with its own stack, the executor is smaller than two FSM() tasks
+  TEST_ASSERT_LESS_THAN(report.task_ram_bytes, report.ram_bytes);
+#ifndef MS_VIRTUAL_TIME
+  // Virtual time barely moves while tasks are running
+  TEST_ASSERT_LESS_THAN(dedicated_us, inline_us);
+#endif
+}
@@ -7,7 +7,13 @@
 #include "queue.h"
 #include "task_test_helpers.h"
 #include "tasks.h"
+#include "test_helpers.h"
 #include "unity.h"
+#ifdef MS_PLATFORM_X86
+#include <string.h>
+
+#include "x86_interrupt.h"
+#endif
 
 static const GpioAddress leds[] = {
   { .port = GPIO_PORT_B, .pin = 4 },
@@ -78,6 +84,136 @@ void test_gpio_it(void) {
   TEST_ASSERT_EQUAL(5, triggered_times);
 }
 
+#ifdef MS_PLATFORM_X86
+// Vectors past the EXTI lines, each handler appends its letter when it runs
+#define VECTOR_LOW 40
+#define VECTOR_NORMAL 41
+#define VECTOR_HIGH 42
+#define VECTOR_LOW_2 43
+
+static char s_order[16];
+
+static void prv_append(char c) {
+  size_t len = strlen(s_order);
+  if (len < sizeof(s_order) - 1) {
+    s_order[len] = c;
+  }
+}
+
+static void prv_high_handler(uint8_t vector) {
+  prv_append('H');
+}
+
+static void prv_normal_handler(uint8_t vector) {
+  prv_append('N');
+}
+
+static void prv_low_2_handler(uint8_t vector) {
+  prv_append('2');
+}
+
+// Raises a higher and an equal priority vector while running, only the first preempts it
+static void prv_low_handler(uint8_t vector) {
+  prv_append('L');
+  x86_interrupt_trigger(VECTOR_LOW_2);
+  x86_interrupt_trigger(VECTOR_HIGH);
+  prv_append('l');
+}
+
+static void prv_register_vectors(void) {
+  InterruptSettings vector_settings = settings;
+  vector_settings.priority = INTERRUPT_PRIORITY_LOW;
+  x86_interrupt_register(VECTOR_LOW, prv_low_handler, &vector_settings);
+  x86_interrupt_register(VECTOR_LOW_2, prv_low_2_handler, &vector_settings);
+  vector_settings.priority = INTERRUPT_PRIORITY_NORMAL;
+  x86_interrupt_register(VECTOR_NORMAL, prv_normal_handler, &vector_settings);
+  vector_settings.priority = INTERRUPT_PRIORITY_HIGH;
+  x86_interrupt_register(VECTOR_HIGH, prv_high_handler, &vector_settings);
+  memset(s_order, 0, sizeof(s_order));
+}
+
+TEST_IN_TASK
+void test_x86_interrupt_priority(void) {
+  interrupt_init();
+  prv_register_vectors();
+
+  // Raised together, they run highest priority first
+  taskENTER_CRITICAL();
+  x86_interrupt_trigger(VECTOR_NORMAL);
+  x86_interrupt_trigger(VECTOR_HIGH);
+  taskEXIT_CRITICAL();
+  delay_ms(10);
+  TEST_ASSERT_EQUAL_STRING("HN", s_order);
+
+  memset(s_order, 0, sizeof(s_order));
+  x86_interrupt_trigger(VECTOR_LOW);
+  delay_ms(10);
+  TEST_ASSERT_EQUAL_STRING("LHl2", s_order);
+
+  X86InterruptStats stats;
+  TEST_ASSERT_OK(x86_interrupt_get_stats(VECTOR_HIGH, &stats));
+  TEST_ASSERT_EQUAL(2, stats.count);
+  TEST_ASSERT_EQUAL(1, stats.preemptions);
+  TEST_ASSERT_EQUAL(2, stats.latency_us.count);
+  TEST_ASSERT_OK(x86_interrupt_get_stats(VECTOR_LOW_2, &stats));
+  TEST_ASSERT_EQUAL(1, stats.count);
+  TEST_ASSERT_EQUAL(0, stats.preemptions);
+}
+
+TEST_IN_TASK
+void test_x86_interrupt_masked(void) {
+  interrupt_init();
+  prv_register_vectors();
+  x86_interrupt_reset_stats();
+
+  // Stays pending while disabled, and is lost if raised again
+  TEST_ASSERT_OK(x86_interrupt_set_enabled(VECTOR_NORMAL, false));
+  TEST_ASSERT_OK(x86_interrupt_trigger(VECTOR_NORMAL));
+  TEST_ASSERT_OK(x86_interrupt_trigger(VECTOR_NORMAL));
+  delay_ms(10);
+  TEST_ASSERT_EQUAL_STRING("", s_order);
+  TEST_ASSERT_TRUE(x86_interrupt_is_pending(VECTOR_NORMAL));
+
+  TEST_ASSERT_OK(x86_interrupt_set_enabled(VECTOR_NORMAL, true));
+  delay_ms(10);
+  TEST_ASSERT_EQUAL_STRING("N", s_order);
+  TEST_ASSERT_FALSE(x86_interrupt_is_pending(VECTOR_NORMAL));
+
+  X86InterruptStats stats;
+  TEST_ASSERT_OK(x86_interrupt_get_stats(VECTOR_NORMAL, &stats));
+  TEST_ASSERT_EQUAL(1, stats.count);
+  TEST_ASSERT_EQUAL(1, stats.lost);
+  TEST_ASSERT_EQUAL(1, stats.exec_us.count);
+
+  // Registrations survive interrupt_init() from another driver
+  interrupt_init();
+  x86_interrupt_trigger(VECTOR_HIGH);
+  delay_ms(10);
+  TEST_ASSERT_EQUAL_STRING("NH", s_order);
+}
+
+TEST_IN_TASK
+void test_gpio_it_masked(void) {
+  interrupt_init();
+  gpio_it_init();
+  // The handler task is still running from test_gpio_it
+  triggered_times = 0;
+  TEST_ASSERT_OK(gpio_it_register_interrupt(&buttons[0], &settings, BUTTON_0, handler));
+
+  TEST_ASSERT_OK(gpio_it_mask_interrupt(&buttons[0], true));
+  TEST_ASSERT_OK(gpio_it_trigger_interrupt(&buttons[0]));
+  delay_ms(10);
+  TEST_ASSERT_EQUAL(0, triggered_times);
+
+  TEST_ASSERT_OK(gpio_it_mask_interrupt(&buttons[0], false));
+  delay_ms(10);
+  TEST_ASSERT_EQUAL(1, triggered_times);
+
+  // Nothing registered on the line
+  TEST_ASSERT_NOT_OK(gpio_it_trigger_interrupt(&buttons[1]));
+}
+#endif
+
 // test for hardware, uncomment and test with tutorial boards. leds should toggle with the two
 // buttons
 
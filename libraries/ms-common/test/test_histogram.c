@@ -0,0 +1,39 @@
+#include "histogram.h"
+#include "log.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+static Histogram s_hist;
+
+void setup_test(void) {
+  histogram_init(&s_hist);
+}
+
+void teardown_test(void) {}
+
+void test_histogram_bucket_bounds(void) {
+  // Every value falls between its bucket's lower bound and the next one
+  for (uint32_t value = 0; value < 100000; ++value) {
+    uint8_t bucket = histogram_bucket_index(value);
+    TEST_ASSERT_TRUE(histogram_bucket_lower(bucket) <= value);
+    TEST_ASSERT_TRUE(value < histogram_bucket_lower(bucket + 1));
+  }
+  TEST_ASSERT_EQUAL(HISTOGRAM_NUM_BUCKETS - 1, histogram_bucket_index(UINT32_MAX));
+}
+
+void test_histogram_stats(void) {
+  TEST_ASSERT_EQUAL(0, histogram_percentile(&s_hist, 50));
+  for (uint32_t i = 1; i <= 100; ++i) {
+    histogram_record(&s_hist, i * 10);
+  }
+  TEST_ASSERT_EQUAL(100, s_hist.count);
+  TEST_ASSERT_EQUAL(10, s_hist.min);
+  TEST_ASSERT_EQUAL(1000, s_hist.max);
+  TEST_ASSERT_EQUAL(505, histogram_mean(&s_hist));
+
+  // Percentiles are accurate to the bucket width
+  uint32_t p50 = histogram_percentile(&s_hist, 50);
+  TEST_ASSERT_TRUE(p50 >= 500 && p50 < 750);
+  TEST_ASSERT_EQUAL(1000, histogram_percentile(&s_hist, 100));
+  TEST_ASSERT_OK(histogram_log(&s_hist, "test"));
+}
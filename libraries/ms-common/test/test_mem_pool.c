@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include "log.h"
+#include "mem_pool.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define NUM_BLOCKS 4
+
+typedef struct Record {
+  uint32_t id;
+  uint8_t data[10];
+} Record;
+
+MEM_POOL_DEFINE(s_pool, sizeof(Record), NUM_BLOCKS);
+MEM_ARENA_DEFINE(s_arena, 100);
+
+static const char *s_overflow_name;
+static size_t s_overflow_size;
+static uint32_t s_overflows;
+
+static void prv_overflow(const char *name, size_t size) {
+  s_overflow_name = name;
+  s_overflow_size = size;
+  s_overflows++;
+}
+
+void setup_test(void) {
+  mem_pool_reset(&s_pool);
+  mem_arena_reset(&s_arena);
+  mem_set_overflow_hook(prv_overflow);
+  s_overflow_name = NULL;
+  s_overflow_size = 0;
+  s_overflows = 0;
+}
+
+void teardown_test(void) {}
+
+void test_mem_pool_alloc_free(void) {
+  Record *records[NUM_BLOCKS];
+  for (uint8_t i = 0; i < NUM_BLOCKS; ++i) {
+    records[i] = mem_pool_alloc(&s_pool);
+    TEST_ASSERT_NOT_NULL(records[i]);
+    TEST_ASSERT_EQUAL(0, (uintptr_t)records[i] % MEM_ALIGN);
+    memset(records[i], i, sizeof(Record));
+  }
+  // Blocks don't overlap
+  for (uint8_t i = 0; i < NUM_BLOCKS; ++i) {
+    TEST_ASSERT_EQUAL(i, records[i]->data[9]);
+  }
+
+  TEST_ASSERT_NULL(mem_pool_alloc(&s_pool));
+  TEST_ASSERT_EQUAL(1, s_overflows);
+  TEST_ASSERT_EQUAL_STRING("s_pool", s_overflow_name);
+  TEST_ASSERT_EQUAL(MEM_POOL_BLOCK_BYTES(sizeof(Record)), s_overflow_size);
+
+  // Freed blocks are reused first
+  TEST_ASSERT_OK(mem_pool_free(&s_pool, records[2]));
+  TEST_ASSERT_OK(mem_pool_free(&s_pool, records[0]));
+  TEST_ASSERT_EQUAL_PTR(records[0], mem_pool_alloc(&s_pool));
+  TEST_ASSERT_EQUAL_PTR(records[2], mem_pool_alloc(&s_pool));
+
+  MemStats stats;
+  mem_pool_get_stats(&s_pool, &stats);
+  TEST_ASSERT_EQUAL(NUM_BLOCKS, stats.capacity);
+  TEST_ASSERT_EQUAL(NUM_BLOCKS, stats.in_use);
+  TEST_ASSERT_EQUAL(NUM_BLOCKS, stats.peak_in_use);
+  TEST_ASSERT_EQUAL(1, stats.failures);
+
+  for (uint8_t i = 0; i < NUM_BLOCKS; ++i) {
+    TEST_ASSERT_OK(mem_pool_free(&s_pool, records[i]));
+  }
+  mem_pool_get_stats(&s_pool, &stats);
+  TEST_ASSERT_EQUAL(0, stats.in_use);
+  TEST_ASSERT_EQUAL(NUM_BLOCKS, stats.peak_in_use);
+}
+
+void test_mem_pool_invalid_free(void) {
+  uint8_t *block = mem_pool_alloc(&s_pool);
+  TEST_ASSERT_NOT_NULL(block);
+  TEST_ASSERT_TRUE(mem_pool_contains(&s_pool, block));
+
+  Record outside;
+  TEST_ASSERT_NOT_OK(mem_pool_free(&s_pool, &outside));
+  TEST_ASSERT_NOT_OK(mem_pool_free(&s_pool, block + 1));
+  TEST_ASSERT_NOT_OK(mem_pool_free(&s_pool, NULL));
+
+  MemStats stats;
+  mem_pool_get_stats(&s_pool, &stats);
+  TEST_ASSERT_EQUAL(1, stats.in_use);
+}
+
+void test_mem_arena(void) {
+  size_t start = mem_arena_mark(&s_arena);
+  uint8_t *a = mem_arena_alloc(&s_arena, 3);
+  uint8_t *b = mem_arena_alloc(&s_arena, 8);
+  TEST_ASSERT_NOT_NULL(a);
+  TEST_ASSERT_EQUAL_PTR(a + MEM_ALIGN, b);
+
+  size_t mark = mem_arena_mark(&s_arena);
+  uint8_t *c = mem_arena_alloc(&s_arena, 50);
+  TEST_ASSERT_NOT_NULL(c);
+  // Only 32 of the 104 bytes are left
+  TEST_ASSERT_NULL(mem_arena_alloc(&s_arena, 40));
+  TEST_ASSERT_EQUAL(1, s_overflows);
+  TEST_ASSERT_EQUAL_STRING("s_arena", s_overflow_name);
+  TEST_ASSERT_EQUAL(40, s_overflow_size);
+  TEST_ASSERT_NULL(mem_arena_alloc(&s_arena, 0));
+
+  TEST_ASSERT_OK(mem_arena_rewind(&s_arena, mark));
+  TEST_ASSERT_EQUAL_PTR(c, mem_arena_alloc(&s_arena, 8));
+  TEST_ASSERT_NOT_OK(mem_arena_rewind(&s_arena, 200));
+
+  TEST_ASSERT_OK(mem_arena_rewind(&s_arena, start));
+  MemStats stats;
+  mem_arena_get_stats(&s_arena, &stats);
+  TEST_ASSERT_EQUAL(104, stats.capacity);
+  TEST_ASSERT_EQUAL(0, stats.in_use);
+  TEST_ASSERT_EQUAL(72, stats.peak_in_use);
+  TEST_ASSERT_EQUAL(1, stats.failures);
+}
@@ -0,0 +1,172 @@
+#include "delay.h"
+#include "log.h"
+#include "msg_bus.h"
+#include "notify.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "timestamp.h"
+#include "unity.h"
+
+#define SLOW_MS 10
+
+typedef struct TestMsg {
+  uint32_t seq;
+  uint16_t value;
+} TestMsg;
+
+// Declared by the test runner
+DECLARE_TASK(test_task);
+
+static const TestMsg *s_last_received;
+static uint32_t s_received;
+
+// Receives and releases messages as they arrive
+TASK(sub_task, TASK_STACK_512) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    const TestMsg *msg;
+    while (msg_bus_receive(TOPIC_1, (const void **)&msg) == STATUS_CODE_OK) {
+      s_last_received = msg;
+      s_received++;
+      msg_bus_release(msg);
+    }
+  }
+}
+
+// Takes a message every SLOW_MS
+TASK(slow_task, TASK_STACK_512) {
+  while (true) {
+    const TestMsg *msg;
+    if (msg_bus_receive(TOPIC_2, (const void **)&msg) == STATUS_CODE_OK) {
+      msg_bus_release(msg);
+    }
+    delay_ms(SLOW_MS);
+  }
+}
+
+static void prv_configure(Topic topic, MsgBusPolicy policy, uint16_t block_ms) {
+  MsgBusTopicSettings settings = {
+    .payload_size = sizeof(TestMsg),
+    .policy = policy,
+    .block_ms = block_ms,
+  };
+  TEST_ASSERT_OK(msg_bus_configure_topic(topic, &settings));
+}
+
+static StatusCode prv_publish(Topic topic, uint32_t seq) {
+  TestMsg *msg = MSG_BUS_ALLOC(topic, TestMsg);
+  TEST_ASSERT_NOT_NULL(msg);
+  msg->seq = seq;
+  return msg_bus_publish(topic, msg);
+}
+
+void setup_test(void) {
+  log_init();
+  msg_bus_init();
+  s_last_received = NULL;
+  s_received = 0;
+  tasks_init_task(sub_task, TASK_PRIORITY(1), NULL);
+  tasks_init_task(slow_task, TASK_PRIORITY(1), NULL);
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_msg_bus_fan_out(void) {
+  prv_configure(TOPIC_1, MSG_BUS_DROP_NEWEST, 0);
+  TEST_ASSERT_OK(msg_bus_subscribe(test_task, TOPIC_1, 0));
+  TEST_ASSERT_OK(msg_bus_subscribe(sub_task, TOPIC_1, 0));
+
+  // Only the topic's payload type can be allocated
+  TEST_ASSERT_NULL(msg_bus_alloc(TOPIC_1, sizeof(uint8_t)));
+
+  TestMsg *msg = MSG_BUS_ALLOC(TOPIC_1, TestMsg);
+  TEST_ASSERT_NOT_NULL(msg);
+  msg->value = 42;
+  TEST_ASSERT_OK(msg_bus_publish(TOPIC_1, msg));
+  TEST_ASSERT_EQUAL(1, msg_bus_blocks_in_use());
+  delay_ms(5);
+  TEST_ASSERT_EQUAL(1, s_received);
+
+  // Both subscribers got the publisher's block, not a copy
+  const TestMsg *received;
+  TEST_ASSERT_OK(msg_bus_receive(TOPIC_1, (const void **)&received));
+  TEST_ASSERT_EQUAL_PTR(msg, received);
+  TEST_ASSERT_EQUAL_PTR(msg, s_last_received);
+  TEST_ASSERT_EQUAL(42, received->value);
+  TEST_ASSERT_EQUAL(STATUS_CODE_EMPTY, msg_bus_receive(TOPIC_1, (const void **)&received));
+
+  // Freed by the last release
+  TEST_ASSERT_EQUAL(1, msg_bus_blocks_in_use());
+  TEST_ASSERT_OK(msg_bus_release(received));
+  TEST_ASSERT_EQUAL(0, msg_bus_blocks_in_use());
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, msg_bus_release(received));
+
+  MsgBusStats stats;
+  TEST_ASSERT_OK(msg_bus_get_stats(TOPIC_1, &stats));
+  TEST_ASSERT_EQUAL(1, stats.published);
+  TEST_ASSERT_EQUAL(2, stats.delivered);
+  TEST_ASSERT_EQUAL(2, stats.latency_us.count);
+}
+
+TEST_IN_TASK
+void test_msg_bus_drop_policies(void) {
+  prv_configure(TOPIC_3, MSG_BUS_DROP_NEWEST, 0);
+  prv_configure(TOPIC_4, MSG_BUS_DROP_OLDEST, 0);
+  TEST_ASSERT_OK(msg_bus_subscribe(test_task, TOPIC_3, 0));
+  TEST_ASSERT_OK(msg_bus_subscribe(test_task, TOPIC_4, 1));
+
+  for (uint32_t seq = 0; seq < MSG_BUS_MAILBOX_SIZE + 2; ++seq) {
+    TEST_ASSERT_OK(prv_publish(TOPIC_3, seq));
+    TEST_ASSERT_OK(prv_publish(TOPIC_4, seq));
+  }
+  // Dropped messages went straight back to the pool
+  TEST_ASSERT_EQUAL(2 * MSG_BUS_MAILBOX_SIZE, msg_bus_blocks_in_use());
+
+  for (uint32_t i = 0; i < MSG_BUS_MAILBOX_SIZE; ++i) {
+    const TestMsg *newest_dropped;
+    const TestMsg *oldest_dropped;
+    TEST_ASSERT_OK(msg_bus_receive(TOPIC_3, (const void **)&newest_dropped));
+    TEST_ASSERT_OK(msg_bus_receive(TOPIC_4, (const void **)&oldest_dropped));
+    TEST_ASSERT_EQUAL(i, newest_dropped->seq);
+    TEST_ASSERT_EQUAL(i + 2, oldest_dropped->seq);
+    msg_bus_release(newest_dropped);
+    msg_bus_release(oldest_dropped);
+  }
+  TEST_ASSERT_EQUAL(0, msg_bus_blocks_in_use());
+
+  MsgBusStats stats;
+  TEST_ASSERT_OK(msg_bus_get_stats(TOPIC_3, &stats));
+  TEST_ASSERT_EQUAL(2, stats.dropped);
+  TEST_ASSERT_OK(msg_bus_get_stats(TOPIC_4, &stats));
+  TEST_ASSERT_EQUAL(2, stats.dropped);
+}
+
+TEST_IN_TASK
+void test_msg_bus_back_pressure(void) {
+  prv_configure(TOPIC_2, MSG_BUS_BLOCK, 2 * SLOW_MS);
+  TEST_ASSERT_OK(msg_bus_subscribe(slow_task, TOPIC_2, 0));
+
+  // The first publishes fill the mailbox, the rest wait for the slow subscriber to make room
+  uint32_t start_us = timestamp_us();
+  for (uint32_t seq = 0; seq < MSG_BUS_MAILBOX_SIZE + 2; ++seq) {
+    TEST_ASSERT_OK(prv_publish(TOPIC_2, seq));
+  }
+  TEST_ASSERT_TRUE(timestamp_us() - start_us >= SLOW_MS * 1000);
+
+  MsgBusStats stats;
+  TEST_ASSERT_OK(msg_bus_get_stats(TOPIC_2, &stats));
+  TEST_ASSERT_EQUAL(2, stats.blocked);
+  TEST_ASSERT_EQUAL(0, stats.dropped);
+  TEST_ASSERT_EQUAL(MSG_BUS_MAILBOX_SIZE + 2, stats.delivered);
+
+  // The pool running out is back-pressure too
+  while (msg_bus_blocks_in_use() < MSG_BUS_NUM_BLOCKS) {
+    TEST_ASSERT_NOT_NULL(MSG_BUS_ALLOC(TOPIC_2, TestMsg));
+  }
+  TEST_ASSERT_NULL(MSG_BUS_ALLOC(TOPIC_2, TestMsg));
+  TEST_ASSERT_OK(msg_bus_get_stats(TOPIC_2, &stats));
+  TEST_ASSERT_EQUAL(1, stats.alloc_failures);
+  TEST_ASSERT_EQUAL(MSG_BUS_NUM_BLOCKS, msg_bus_peak_blocks_in_use());
+}
@@ -0,0 +1,127 @@
+#include <string.h>
+
+#include "delay.h"
+#include "log.h"
+#include "notify.h"
+#include "semaphore.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define HOLD_MS 20
+#define START_MS 5
+#define TOLERANCE_US 5000
+
+static Mutex s_mutex;
+static Semaphore s_sem;
+
+// Holds the mutex for HOLD_MS each time it's notified
+TASK(holder_task, TASK_STACK_512) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    mutex_lock(&s_mutex, BLOCK_INDEFINITELY);
+    delay_ms(HOLD_MS);
+    mutex_unlock(&s_mutex);
+  }
+}
+
+// Returns once the holder has the mutex
+static void prv_start_holder(void) {
+  notify(holder_task, 0);
+  delay_ms(START_MS);
+}
+
+static bool prv_find_profile(const char *name, MutexProfile *profile) {
+  for (uint8_t i = 0; i < mutex_profile_count(); ++i) {
+    TEST_ASSERT_OK(mutex_profile_get(i, profile));
+    if (profile->name != NULL && strcmp(profile->name, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void setup_test(void) {
+  log_init();
+  mutex_init(&s_mutex);
+  mutex_profile_set_name(&s_mutex, "test");
+  sem_init(&s_sem, 1, 0);
+  mutex_profile_set_name(&s_sem, "sem");
+  tasks_init_task(holder_task, TASK_PRIORITY(1), NULL);
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_mutex_profile_contention(void) {
+  MutexProfile profile = { 0 };
+#ifndef MS_MUTEX_PROFILE
+  TEST_ASSERT_EQUAL(0, mutex_profile_count());
+  TEST_ASSERT_EQUAL(STATUS_CODE_UNIMPLEMENTED, mutex_profile_get(0, &profile));
+  TEST_IGNORE_MESSAGE("Build with --define=MS_MUTEX_PROFILE");
+  return;
+#endif
+  // Wait out the rest of the holder's hold
+  prv_start_holder();
+  TEST_ASSERT_OK(mutex_lock(&s_mutex, BLOCK_INDEFINITELY));
+  TEST_ASSERT_OK(mutex_unlock(&s_mutex));
+  mutex_profile_log();
+
+  TEST_ASSERT_TRUE(prv_find_profile("test", &profile));
+  TEST_ASSERT_TRUE(profile.is_mutex);
+  TEST_ASSERT_EQUAL(2, profile.acquisitions);
+  TEST_ASSERT_EQUAL(1, profile.contended);
+  TEST_ASSERT_EQUAL(0, profile.timeouts);
+  TEST_ASSERT_EQUAL(2, profile.wait_us.count);
+  TEST_ASSERT_UINT32_WITHIN(TOLERANCE_US, (HOLD_MS - START_MS) * 1000, profile.wait_us.max);
+
+  TEST_ASSERT_EQUAL(2, profile.hold_us.count);
+  TEST_ASSERT_UINT32_WITHIN(TOLERANCE_US, HOLD_MS * 1000, profile.hold_us.max);
+  TEST_ASSERT_NOT_NULL(profile.longest_holder);
+  TEST_ASSERT_EQUAL_STRING("holder_task", profile.longest_holder);
+  TEST_ASSERT_NULL(profile.holder);
+
+  // Statistics are cleared, names kept
+  mutex_profile_reset();
+  TEST_ASSERT_TRUE(prv_find_profile("test", &profile));
+  TEST_ASSERT_EQUAL(0, profile.acquisitions);
+  TEST_ASSERT_EQUAL(0, profile.hold_us.count);
+}
+
+TEST_IN_TASK
+void test_mutex_profile_timeout(void) {
+#ifndef MS_MUTEX_PROFILE
+  TEST_IGNORE_MESSAGE("Build with --define=MS_MUTEX_PROFILE");
+  return;
+#endif
+  prv_start_holder();
+  TEST_ASSERT_EQUAL(STATUS_CODE_TIMEOUT, mutex_lock(&s_mutex, 5));
+  delay_ms(HOLD_MS);
+
+  MutexProfile profile = { 0 };
+  TEST_ASSERT_TRUE(prv_find_profile("test", &profile));
+  TEST_ASSERT_EQUAL(1, profile.acquisitions);
+  TEST_ASSERT_EQUAL(1, profile.timeouts);
+  TEST_ASSERT_EQUAL(1, profile.hold_us.count);
+}
+
+TEST_IN_TASK
+void test_mutex_profile_semaphore(void) {
+#ifndef MS_MUTEX_PROFILE
+  TEST_IGNORE_MESSAGE("Build with --define=MS_MUTEX_PROFILE");
+  return;
+#endif
+  TEST_ASSERT_OK(sem_post(&s_sem));
+  TEST_ASSERT_OK(sem_wait(&s_sem, 0));
+  TEST_ASSERT_EQUAL(STATUS_CODE_TIMEOUT, sem_wait(&s_sem, 2));
+
+  MutexProfile profile = { 0 };
+  TEST_ASSERT_TRUE(prv_find_profile("sem", &profile));
+  TEST_ASSERT_FALSE(profile.is_mutex);
+  TEST_ASSERT_EQUAL(1, profile.acquisitions);
+  TEST_ASSERT_EQUAL(0, profile.contended);
+  TEST_ASSERT_EQUAL(1, profile.timeouts);
+  // Semaphores aren't held by a task
+  TEST_ASSERT_EQUAL(0, profile.hold_us.count);
+}
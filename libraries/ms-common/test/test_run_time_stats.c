@@ -0,0 +1,108 @@
+#include <string.h>
+
+#include "delay.h"
+#include "log.h"
+#include "queues.h"
+#include "run_time_stats.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "timestamp.h"
+#include "unity.h"
+
+#define BUSY_US 3000
+#define PERIOD_MS 10
+#define QUEUE_LENGTH 5
+
+static uint8_t s_queue_buf[QUEUE_LENGTH];
+static Queue s_queue = {
+  .num_items = QUEUE_LENGTH,
+  .item_size = sizeof(uint8_t),
+  .storage_buf = s_queue_buf,
+};
+
+// Uses roughly BUSY_US / PERIOD_MS of the CPU
+TASK(busy_task, TASK_STACK_512) {
+  while (true) {
+    uint64_t start_us = timestamp_us();
+    while (timestamp_us() - start_us < BUSY_US) {
+    }
+    delay_ms(PERIOD_MS);
+  }
+}
+
+static bool prv_find_task(const char *name, RunTimeTaskStats *stats) {
+  for (uint8_t i = 0; i < run_time_stats_num_tasks(); ++i) {
+    TEST_ASSERT_OK(run_time_stats_get_task(i, stats));
+    if (strcmp(stats->name, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void setup_test(void) {
+  log_init();
+  tasks_init_task(busy_task, TASK_PRIORITY(1), NULL);
+  queue_init(&s_queue);
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_run_time_stats_tasks(void) {
+#ifndef MS_RUN_TIME_STATS
+  TEST_ASSERT_EQUAL(STATUS_CODE_UNIMPLEMENTED, run_time_stats_update());
+  TEST_IGNORE_MESSAGE("Build with --define=MS_RUN_TIME_STATS");
+  return;
+#endif
+  // Discard the startup window
+  TEST_ASSERT_OK(run_time_stats_update());
+  delay_ms(500);
+  TEST_ASSERT_OK(run_time_stats_update());
+  run_time_stats_log();
+
+  uint32_t window_us = run_time_stats_get_window_us();
+  TEST_ASSERT_UINT32_WITHIN(50000, 500000, window_us);
+
+  RunTimeTaskStats busy = { 0 };
+  TEST_ASSERT_TRUE(prv_find_task("busy_task", &busy));
+  // BUSY_US / (BUSY_US + PERIOD_MS), with slack for the host scheduler
+  TEST_ASSERT_UINT32_WITHIN(1000, 2300, busy.cpu_permyriad);
+  TEST_ASSERT_TRUE(busy.stack_high_water > 0);
+  TEST_ASSERT_TRUE(busy.stack_high_water < TASK_STACK_512);
+
+  // Every task is accounted for, including idle
+  uint32_t total = 0;
+  uint8_t last_number = 0;
+  for (uint8_t i = 0; i < run_time_stats_num_tasks(); ++i) {
+    RunTimeTaskStats stats;
+    TEST_ASSERT_OK(run_time_stats_get_task(i, &stats));
+    TEST_ASSERT_TRUE(i == 0 || stats.number > last_number);
+    last_number = stats.number;
+    total += stats.cpu_permyriad;
+  }
+  TEST_ASSERT_UINT32_WITHIN(100, 10000, total);
+}
+
+TEST_IN_TASK
+void test_run_time_stats_queue_peak(void) {
+#ifndef MS_RUN_TIME_STATS
+  TEST_IGNORE_MESSAGE("Build with --define=MS_RUN_TIME_STATS");
+  return;
+#endif
+  uint8_t item = 0;
+  for (uint8_t i = 0; i < 3; ++i) {
+    TEST_ASSERT_OK(queue_send(&s_queue, &item, 0));
+  }
+  TEST_ASSERT_OK(queue_receive(&s_queue, &item, 0));
+  TEST_ASSERT_OK(queue_receive(&s_queue, &item, 0));
+  TEST_ASSERT_OK(queue_send(&s_queue, &item, 0));
+
+  TEST_ASSERT_EQUAL(1, run_time_stats_num_queues());
+  RunTimeQueueStats stats = { 0 };
+  TEST_ASSERT_OK(run_time_stats_get_queue(0, &stats));
+  TEST_ASSERT_EQUAL(3, stats.peak_items);
+  TEST_ASSERT_EQUAL(2, stats.items);
+  TEST_ASSERT_EQUAL(QUEUE_LENGTH, stats.num_items);
+}
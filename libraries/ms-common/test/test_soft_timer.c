@@ -90,3 +90,93 @@ void test_multiple_timer() {
     TEST_ASSERT_FALSE(soft_timer_inuse(&s_timer_2));
   }
 }
+
+#define NUM_BURST_TIMERS 32
+
+static SoftTimer s_burst[NUM_BURST_TIMERS];
+static volatile uint32_t s_burst_fired;
+static volatile uint32_t s_burst_order_errors;
+
+static void prv_burst(SoftTimerId id) {
+  // Timers with a shorter duration fire first
+  uint32_t index = id - s_burst;
+  if (index / 4 != s_burst_fired / 4) {
+    s_burst_order_errors++;
+  }
+  s_burst_fired++;
+}
+
+TEST_IN_TASK
+void test_soft_timer_burst() {
+  SoftTimerStats before;
+  soft_timer_get_stats(&before);
+  s_burst_fired = 0;
+  s_burst_order_errors = 0;
+
+  // More starts at once than the kernel's timer command queue could hold, four per tick
+  for (uint32_t i = 0; i < NUM_BURST_TIMERS; ++i) {
+    TEST_ASSERT_OK(soft_timer_init_and_start(20 + i / 4, prv_burst, &s_burst[i]));
+  }
+  for (uint32_t i = 0; i < NUM_BURST_TIMERS; ++i) {
+    TEST_ASSERT_TRUE(soft_timer_inuse(&s_burst[i]));
+  }
+  // Cancelled timers don't fire
+  TEST_ASSERT_OK(soft_timer_cancel(&s_burst[NUM_BURST_TIMERS - 1]));
+  TEST_ASSERT_FALSE(soft_timer_inuse(&s_burst[NUM_BURST_TIMERS - 1]));
+
+  delay_ms(40);
+  TEST_ASSERT_EQUAL(NUM_BURST_TIMERS - 1, s_burst_fired);
+  TEST_ASSERT_EQUAL(0, s_burst_order_errors);
+
+  SoftTimerStats after;
+  soft_timer_get_stats(&after);
+  TEST_ASSERT_EQUAL(NUM_BURST_TIMERS - 1, after.expired - before.expired);
+  TEST_ASSERT_EQUAL(0, after.active);
+  TEST_ASSERT_TRUE(after.peak_active >= NUM_BURST_TIMERS);
+  TEST_ASSERT_TRUE(after.max_batch >= 4);
+}
+
+static volatile uint32_t s_restarts;
+
+static void prv_restart(SoftTimerId id) {
+  if (++s_restarts < 3) {
+    soft_timer_start(id);
+  }
+}
+
+TEST_IN_TASK
+void test_soft_timer_restart_in_callback() {
+  s_restarts = 0;
+  soft_timer_init_and_start(10, prv_restart, &s_timer);
+  delay_ms(25);
+  TEST_ASSERT_EQUAL(2, s_restarts);
+  TEST_ASSERT_TRUE(soft_timer_inuse(&s_timer));
+  delay_ms(10);
+  TEST_ASSERT_EQUAL(3, s_restarts);
+  TEST_ASSERT_FALSE(soft_timer_inuse(&s_timer));
+}
+
+TEST_IN_TASK
+void test_soft_timer_cascade() {
+  // Placed in the second and third levels of the wheel, then moved down as it turns
+  TickType_t last_wake = xTaskGetTickCount();
+  triggered = false;
+  soft_timer_init_and_start(300, prv_set, &s_timer);
+  soft_timer_init_and_start(4200, prv_set, &s_timer_2);
+
+  xTaskDelayUntil(&last_wake, 299);
+  TEST_ASSERT_FALSE(triggered);
+  TEST_ASSERT_EQUAL(1, soft_timer_remaining_time(&s_timer));
+  xTaskDelayUntil(&last_wake, 3);
+  TEST_ASSERT_TRUE(triggered);
+  TEST_ASSERT_EQUAL(last_triggered_id, s_timer.id);
+
+  triggered = false;
+  xTaskDelayUntil(&last_wake, 3895);
+  TEST_ASSERT_FALSE(triggered);
+  TEST_ASSERT_EQUAL(3, soft_timer_remaining_time(&s_timer_2));
+  xTaskDelayUntil(&last_wake, 5);
+  TEST_ASSERT_TRUE(triggered);
+  TEST_ASSERT_EQUAL(last_triggered_id, s_timer_2.id);
+  TEST_ASSERT_FALSE(soft_timer_inuse(&s_timer_2));
+}
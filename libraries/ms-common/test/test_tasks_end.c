@@ -0,0 +1,148 @@
+#include <stdbool.h>
+
+#include "delay.h"
+#include "log.h"
+#include "notify.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+static uint32_t s_work_ms;
+
+void setup_test(void) {
+  log_init();
+}
+
+void teardown_test(void) {}
+
+// Runs one cycle of s_work_ms per notification
+TASK(worker, TASK_STACK_512) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    delay_ms(s_work_ms);
+    send_task_end();
+  }
+}
+
+// Ends as soon as it is notified, without being expected
+TASK(stray, TASK_STACK_512) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    send_task_end();
+  }
+}
+
+// Created without tasks_init_task(), so it can't be joined
+static StackType_t s_unjoinable_stack[TASK_STACK_512];
+static StaticTask_t s_unjoinable_tcb;
+static StatusCode s_unjoinable_status;
+
+static void prv_unjoinable(void *context) {
+  s_unjoinable_status = send_task_end();
+  vTaskDelete(NULL);
+}
+
+// Enough tasks that the last ones are past MAX_NUM_TASKS
+static StackType_t s_filler_stacks[MAX_NUM_TASKS][TASK_MIN_STACK_SIZE];
+static Task s_fillers[MAX_NUM_TASKS];
+
+static void prv_filler(void *context) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    send_task_end();
+  }
+}
+
+static StatusCode prv_run_worker(uint32_t work_ms) {
+  s_work_ms = work_ms;
+  TEST_ASSERT_OK(tasks_expect_end(worker));
+  notify(worker, 0);
+  return wait_tasks(1);
+}
+
+TEST_IN_TASK
+void test_tasks_end_expected(void) {
+  tasks_init_task(worker, TASK_PRIORITY(1), NULL);
+  tasks_init_task(stray, TASK_PRIORITY(1), NULL);
+
+  TaskEndStats before;
+  TEST_ASSERT_OK(tasks_get_end_stats(worker, &before));
+
+  // Ends from other tasks don't satisfy the wait
+  notify(stray, 0);
+  TickType_t start = xTaskGetTickCount();
+  TEST_ASSERT_OK(prv_run_worker(50));
+  TEST_ASSERT_TRUE(xTaskGetTickCount() - start >= pdMS_TO_TICKS(50));
+
+  TaskEndStats stats;
+  TEST_ASSERT_OK(tasks_get_end_stats(worker, &stats));
+  TEST_ASSERT_EQUAL(before.cycles + 1, stats.cycles);
+  TEST_ASSERT_EQUAL(0, stats.misses);
+  TEST_ASSERT_TRUE(stats.max_response_us >= 45000);
+}
+
+TEST_IN_TASK
+void test_tasks_end_missed(void) {
+  tasks_init_task(worker, TASK_PRIORITY(1), NULL);
+
+  TEST_ASSERT_EQUAL(STATUS_CODE_TIMEOUT, prv_run_worker(WAIT_TASK_TIMEOUT_MS + 200));
+  TaskEndStats stats;
+  TEST_ASSERT_OK(tasks_get_end_stats(worker, &stats));
+  TEST_ASSERT_EQUAL(1, stats.misses);
+
+  // How late the cycle ended is recorded once it does
+  delay_ms(300);
+  TEST_ASSERT_OK(tasks_get_end_stats(worker, &stats));
+  TEST_ASSERT_UINT32_WITHIN(20000, 200000, stats.last_late_us);
+
+  // The late end isn't taken as the end of the next cycle
+  TickType_t start = xTaskGetTickCount();
+  TEST_ASSERT_OK(prv_run_worker(20));
+  TEST_ASSERT_TRUE(xTaskGetTickCount() - start >= pdMS_TO_TICKS(20));
+  tasks_log_end_stats();
+}
+
+TEST_IN_TASK
+void test_tasks_end_counts_ends(void) {
+  tasks_init_task(stray, TASK_PRIORITY(1), NULL);
+
+  // With no task expected each end counts, including two from the same task
+  notify(stray, 0);
+  delay_ms(10);
+  notify(stray, 0);
+  delay_ms(10);
+  TickType_t start = xTaskGetTickCount();
+  TEST_ASSERT_OK(wait_tasks(2));
+  TEST_ASSERT_TRUE(xTaskGetTickCount() - start < pdMS_TO_TICKS(WAIT_TASK_TIMEOUT_MS / 2));
+}
+
+TEST_IN_TASK
+void test_tasks_end_unjoinable(void) {
+  s_unjoinable_status = STATUS_CODE_UNKNOWN;
+  xTaskCreateStatic(prv_unjoinable, "unjoinable", TASK_STACK_512, NULL, TASK_PRIORITY(1),
+                    s_unjoinable_stack, &s_unjoinable_tcb);
+  delay_ms(10);
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, s_unjoinable_status);
+}
+
+TEST_IN_TASK
+void test_tasks_end_past_max(void) {
+  for (uint8_t i = 0; i < MAX_NUM_TASKS; ++i) {
+    s_fillers[i] = (Task){
+      .task_func = prv_filler,
+      .name = "filler",
+      .stack = s_filler_stacks[i],
+      .stack_size = TASK_MIN_STACK_SIZE,
+    };
+    TEST_ASSERT_OK(tasks_init_task(&s_fillers[i], TASK_PRIORITY(1), NULL));
+  }
+  Task *last = &s_fillers[MAX_NUM_TASKS - 1];
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, tasks_expect_end(last));
+
+  // Its end still counts
+  notify(last, 0);
+  TickType_t start = xTaskGetTickCount();
+  TEST_ASSERT_OK(wait_tasks(1));
+  TEST_ASSERT_TRUE(xTaskGetTickCount() - start < pdMS_TO_TICKS(WAIT_TASK_TIMEOUT_MS / 2));
+}
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "delay.h"
+#include "log.h"
+#include "notify.h"
+#include "queues.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "trace.h"
+#include "unity.h"
+
+#define TEST_SPAN 3
+#define QUEUE_LENGTH 4
+#define MAX_EVENTS 64
+
+static uint8_t s_queue_buf[QUEUE_LENGTH];
+static Queue s_queue = {
+  .num_items = QUEUE_LENGTH,
+  .item_size = sizeof(uint8_t),
+  .storage_buf = s_queue_buf,
+};
+
+static TraceEvent s_events[MAX_EVENTS];
+static uint32_t s_num_events;
+static uint8_t s_drained[1024];
+static size_t s_drained_len;
+
+TASK(trace_worker, TASK_STACK_512) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    uint8_t item = 1;
+    queue_send(&s_queue, &item, 0);
+  }
+}
+
+static void prv_read_all(void) {
+  s_num_events = 0;
+  while (s_num_events < MAX_EVENTS && trace_read(&s_events[s_num_events]) == STATUS_CODE_OK) {
+    s_num_events++;
+  }
+}
+
+// Index of the first event of a type and id after start, or -1
+static int32_t prv_find(uint32_t start, TraceEventType type, uint16_t id) {
+  for (uint32_t i = start; i < s_num_events; ++i) {
+    if (s_events[i].type == type && s_events[i].id == id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static StatusCode prv_write(const uint8_t *data, size_t len, void *context) {
+  if (s_drained_len + len > sizeof(s_drained)) {
+    return STATUS_CODE_RESOURCE_EXHAUSTED;
+  }
+  memcpy(&s_drained[s_drained_len], data, len);
+  s_drained_len += len;
+  return STATUS_CODE_OK;
+}
+
+void setup_test(void) {
+  log_init();
+  tasks_init_task(trace_worker, TASK_PRIORITY(2), NULL);
+  queue_init(&s_queue);
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_trace_spans(void) {
+#ifndef MS_TRACE
+  TEST_IGNORE_MESSAGE("Build with --define=MS_TRACE");
+  return;
+#endif
+  trace_init();
+  TEST_ASSERT_OK(trace_set_span_name(TEST_SPAN, "test_span"));
+  TEST_ASSERT_EQUAL_STRING("test_span", trace_get_span_name(TEST_SPAN));
+
+  TRACE_SPAN_BEGIN(TEST_SPAN);
+  TRACE_INSTANT(TEST_SPAN, 42);
+  TRACE_SPAN_END(TEST_SPAN);
+  prv_read_all();
+
+  int32_t begin = prv_find(0, TRACE_EVENT_SPAN_BEGIN, TEST_SPAN);
+  int32_t instant = prv_find(0, TRACE_EVENT_INSTANT, TEST_SPAN);
+  int32_t end = prv_find(0, TRACE_EVENT_SPAN_END, TEST_SPAN);
+  TEST_ASSERT_TRUE(begin >= 0 && begin < instant && instant < end);
+  TEST_ASSERT_EQUAL(42, s_events[instant].arg);
+  TEST_ASSERT_TRUE(s_events[end].timestamp_us >= s_events[begin].timestamp_us);
+  TEST_ASSERT_EQUAL(STATUS_CODE_EMPTY, trace_read(&s_events[0]));
+}
+
+TEST_IN_TASK
+void test_trace_kernel_events(void) {
+#ifndef MS_TRACE
+  TEST_IGNORE_MESSAGE("Build with --define=MS_TRACE");
+  return;
+#endif
+  trace_init();
+  notify(trace_worker, 0);
+  delay_ms(5);
+  prv_read_all();
+
+  // Find the worker's task number from its name
+  uint16_t worker = 0;
+  for (uint16_t i = 0; i < TRACE_MAX_TASKS; ++i) {
+    const char *name = trace_get_task_name(i);
+    if (name != NULL && strcmp(name, "trace_worker") == 0) {
+      worker = i;
+    }
+  }
+  TEST_ASSERT_NOT_EQUAL(0, worker);
+
+  int32_t notified = prv_find(0, TRACE_EVENT_TASK_NOTIFY, worker);
+  TEST_ASSERT_TRUE(notified >= 0);
+  int32_t switched = prv_find(notified, TRACE_EVENT_TASK_SWITCH, worker);
+  TEST_ASSERT_TRUE(switched >= 0);
+
+  // The queue send happened in the worker with the queue empty
+  bool sent = false;
+  for (int32_t i = switched; i < (int32_t)s_num_events; ++i) {
+    if (s_events[i].type == TRACE_EVENT_QUEUE_SEND) {
+      TEST_ASSERT_EQUAL(0, s_events[i].arg);
+      sent = true;
+    }
+  }
+  TEST_ASSERT_TRUE(sent);
+}
+
+TEST_IN_TASK
+void test_trace_overwrite(void) {
+#ifndef MS_TRACE
+  TEST_IGNORE_MESSAGE("Build with --define=MS_TRACE");
+  return;
+#endif
+  trace_init();
+  for (uint32_t i = 0; i < TRACE_BUFFER_SIZE + 10; ++i) {
+    TRACE_INSTANT(TEST_SPAN, i);
+  }
+
+  // The oldest events were overwritten, the rest come out in order
+  TraceEvent event;
+  TEST_ASSERT_OK(trace_read(&event));
+  TEST_ASSERT_TRUE(event.arg >= 10);
+  uint32_t last = event.arg;
+  while (trace_read(&event) == STATUS_CODE_OK) {
+    if (event.type == TRACE_EVENT_INSTANT) {
+      TEST_ASSERT_EQUAL(last + 1, event.arg);
+      last = event.arg;
+    }
+  }
+  TEST_ASSERT_EQUAL(TRACE_BUFFER_SIZE + 9, last);
+
+  TraceStats stats;
+  trace_get_stats(&stats);
+  TEST_ASSERT_TRUE(stats.dropped >= 10);
+  TEST_ASSERT_TRUE(stats.recorded >= TRACE_BUFFER_SIZE + 10);
+}
+
+TEST_IN_TASK
+void test_trace_drain(void) {
+#ifndef MS_TRACE
+  TEST_ASSERT_EQUAL(STATUS_CODE_UNIMPLEMENTED, trace_drain(prv_write, NULL, 1));
+  TEST_IGNORE_MESSAGE("Build with --define=MS_TRACE");
+  return;
+#endif
+  trace_init();
+  TEST_ASSERT_OK(trace_set_span_name(TEST_SPAN, "drained"));
+  TRACE_INSTANT(TEST_SPAN, 7);
+  s_drained_len = 0;
+  TEST_ASSERT_OK(trace_drain(prv_write, NULL, 10));
+  TEST_ASSERT_EQUAL(0, s_drained_len % sizeof(TraceEvent));
+
+  // Names come first, in chunks, then the events
+  char name[TRACE_MAX_NAME_LEN + TRACE_NAME_CHUNK] = { 0 };
+  bool found = false;
+  for (size_t offset = 0; offset < s_drained_len; offset += sizeof(TraceEvent)) {
+    TraceEvent event;
+    memcpy(&event, &s_drained[offset], sizeof(event));
+    if (event.type == TRACE_EVENT_SPAN_NAME && event.id == TEST_SPAN) {
+      memcpy(&name[event.chunk], &event.arg, TRACE_NAME_CHUNK);
+    } else if (event.type == TRACE_EVENT_INSTANT && event.id == TEST_SPAN) {
+      TEST_ASSERT_EQUAL(7, event.arg);
+      found = true;
+    }
+  }
+  TEST_ASSERT_EQUAL_STRING("drained", name);
+  TEST_ASSERT_TRUE(found);
+
+  // Names are only drained once
+  s_drained_len = 0;
+  TEST_ASSERT_OK(trace_drain(prv_write, NULL, 10));
+  TEST_ASSERT_EQUAL(0, s_drained_len);
+}
+
+TEST_IN_TASK
+void test_trace_export_json(void) {
+#ifndef MS_TRACE
+  TEST_IGNORE_MESSAGE("Build with --define=MS_TRACE");
+  return;
+#endif
+  trace_init();
+  TEST_ASSERT_OK(trace_set_span_name(TEST_SPAN, "exported"));
+  TRACE_SPAN_BEGIN(TEST_SPAN);
+  notify(trace_worker, 0);
+  delay_ms(2);
+  TRACE_SPAN_END(TEST_SPAN);
+
+  const char *path = "test_trace.json";
+  TEST_ASSERT_OK(trace_export_json(path));
+  FILE *file = fopen(path, "r");
+  TEST_ASSERT_NOT_NULL(file);
+  char json[8192] = { 0 };
+  fread(json, 1, sizeof(json) - 1, file);
+  fclose(file);
+  remove(path);
+
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"traceEvents\""));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"name\":\"exported\",\"ph\":\"B\""));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"name\":\"exported\",\"ph\":\"E\""));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"args\":{\"name\":\"trace_worker\"}"));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"ph\":\"X\""));
+}
@@ -0,0 +1,105 @@
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "delay.h"
+#include "log.h"
+#include "notify.h"
+#include "task.h"
+#include "task_test_helpers.h"
+#include "tasks.h"
+#include "test_helpers.h"
+#include "timestamp.h"
+#include "unity.h"
+
+#define MAX_WAKEUPS 16
+
+// Tick each periodic task woke at, in order
+static TickType_t s_wakeups[MAX_WAKEUPS];
+static char s_wakeup_task[MAX_WAKEUPS];
+static uint8_t s_num_wakeups;
+
+#ifdef MS_VIRTUAL_TIME
+static uint64_t prv_host_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+#endif
+
+static void prv_periodic(char name, uint32_t period_ms) {
+  while (true) {
+    notify_wait(NULL, BLOCK_INDEFINITELY);
+    TickType_t wake = xTaskGetTickCount();
+    for (uint8_t i = 0; i < 3; ++i) {
+      vTaskDelayUntil(&wake, pdMS_TO_TICKS(period_ms));
+      if (s_num_wakeups < MAX_WAKEUPS) {
+        s_wakeup_task[s_num_wakeups] = name;
+        s_wakeups[s_num_wakeups++] = wake;
+      }
+    }
+    send_task_end();
+  }
+}
+
+TASK(every_30ms, TASK_STACK_512) {
+  prv_periodic('a', 30);
+}
+
+TASK(every_50ms, TASK_STACK_512) {
+  prv_periodic('b', 50);
+}
+
+void setup_test(void) {
+  log_init();
+  tasks_init_task(every_30ms, TASK_PRIORITY(2), NULL);
+  tasks_init_task(every_50ms, TASK_PRIORITY(1), NULL);
+  s_num_wakeups = 0;
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_virtual_time_long_delay(void) {
+#ifndef MS_VIRTUAL_TIME
+  TEST_IGNORE_MESSAGE("Build with --define=MS_VIRTUAL_TIME");
+#else
+  uint64_t host_start_ms = prv_host_ms();
+  TickType_t start_tick = xTaskGetTickCount();
+  uint64_t start_us = timestamp_us();
+
+  delay_ms(10000);
+
+  // Wakes on the exact tick, with the timestamp following the tick
+  TEST_ASSERT_EQUAL(pdMS_TO_TICKS(10000), xTaskGetTickCount() - start_tick);
+  uint64_t elapsed_us = timestamp_us() - start_us;
+  TEST_ASSERT_UINT64_WITHIN(1000, 10000000, elapsed_us);
+  uint64_t host_ms = prv_host_ms() - host_start_ms;
+  LOG_DEBUG("10 s of virtual time took %u ms\n", (unsigned)host_ms);
+  TEST_ASSERT_LESS_THAN(1000, host_ms);
+#endif
+}
+
+TEST_IN_TASK
+void test_virtual_time_deterministic_order(void) {
+#ifndef MS_VIRTUAL_TIME
+  TEST_IGNORE_MESSAGE("Build with --define=MS_VIRTUAL_TIME");
+#else
+  unsigned long forced_ticks = ulPortVirtualTimeForcedTicks();
+  TickType_t start = xTaskGetTickCount();
+  tasks_expect_end(every_30ms);
+  tasks_expect_end(every_50ms);
+  notify(every_30ms, 0);
+  notify(every_50ms, 0);
+  TEST_ASSERT_OK(wait_tasks(2));
+
+  // a at 30, 60, 90 and b at 50, 100, 150, each on its deadline
+  const char order[] = { 'a', 'b', 'a', 'a', 'b', 'b' };
+  const TickType_t ticks[] = { 30, 50, 60, 90, 100, 150 };
+  TEST_ASSERT_EQUAL(SIZEOF_ARRAY(order), s_num_wakeups);
+  for (uint8_t i = 0; i < s_num_wakeups; ++i) {
+    TEST_ASSERT_EQUAL(order[i], s_wakeup_task[i]);
+    TEST_ASSERT_EQUAL(pdMS_TO_TICKS(ticks[i]), s_wakeups[i] - start);
+  }
+  TEST_ASSERT_EQUAL(forced_ticks, ulPortVirtualTimeForcedTicks());
+#endif
+}
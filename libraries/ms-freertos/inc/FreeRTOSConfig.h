@@ -4,6 +4,19 @@
 #if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
 #include <stdint.h>
 extern uint32_t SystemCoreClock;
+#ifdef MS_RUN_TIME_STATS
+// Run-time counter hooks, see run_time_stats.h
+void run_time_stats_timer_init(void);
+uint32_t run_time_stats_counter(void);
+#endif
+#ifdef MS_TRACE
+// Kernel trace hooks, see trace.h
+void trace_task_created(uint16_t number, const char *name);
+void trace_task_switched_in(uint16_t number);
+void trace_task_notified(uint16_t number);
+void trace_queue_sent(uint16_t number, uint32_t items);
+void trace_queue_received(uint16_t number, uint32_t items);
+#endif
 #endif
 
 // Allow projects to add more priorities with the NUM_FREERTOS_PRIORITIES macro.
@@ -57,15 +70,52 @@ extern uint32_t SystemCoreClock;
 #define configSTACK_ALLOCATION_FROM_SEPARATE_HEAP 0
 
 // Hook function related definitions
+// x86 virtual time, enabled with --define=MS_VIRTUAL_TIME: the idle hook skips the clock ahead to
+// the next deadline, see libraries/FreeRTOS/src/x86/x86_virtual_time.c
+#if defined(MS_VIRTUAL_TIME) && defined(MS_PLATFORM_X86)
+#define configUSE_IDLE_HOOK 1
+#define configINCLUDE_FREERTOS_TASK_C_ADDITIONS_H 1
+#else
 #define configUSE_IDLE_HOOK 0
+#endif
 #define configUSE_TICK_HOOK 0
 #define configCHECK_FOR_STACK_OVERFLOW 2
 #define configUSE_MALLOC_FAILED_HOOK 0
 #define configUSE_DAEMON_TASK_STARTUP_HOOK 0
 
 // Run time and task stats gathering related definitions
+// Enabled with --define=MS_RUN_TIME_STATS, see run_time_stats.h
+#ifdef MS_RUN_TIME_STATS
+#define configGENERATE_RUN_TIME_STATS 1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() run_time_stats_timer_init()
+#define portGET_RUN_TIME_COUNTER_VALUE() run_time_stats_counter()
+#else
 #define configGENERATE_RUN_TIME_STATS 0
+#endif
+#if defined(MS_RUN_TIME_STATS) || defined(MS_TRACE)
+#define configUSE_TRACE_FACILITY 1
+#else
 #define configUSE_TRACE_FACILITY 0
+#endif
+
+// Event tracing hooks, enabled with --define=MS_TRACE, see trace.h
+// The hooks are expanded inside tasks.c and queue.c, where the TCB and queue fields are visible.
+#ifdef MS_TRACE
+#define traceTASK_CREATE(pxNewTCB) \
+  trace_task_created((pxNewTCB)->uxTCBNumber, (pxNewTCB)->pcTaskName)
+#define traceTASK_SWITCHED_IN() trace_task_switched_in(pxCurrentTCB->uxTCBNumber)
+#define traceTASK_NOTIFY(uxIndexToNotify) trace_task_notified(pxTCB->uxTCBNumber)
+#define traceTASK_NOTIFY_FROM_ISR(uxIndexToNotify) trace_task_notified(pxTCB->uxTCBNumber)
+#define traceTASK_NOTIFY_GIVE_FROM_ISR(uxIndexToNotify) trace_task_notified(pxTCB->uxTCBNumber)
+#define traceQUEUE_SEND(pxQueue) \
+  trace_queue_sent((pxQueue)->uxQueueNumber, (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) \
+  trace_queue_sent((pxQueue)->uxQueueNumber, (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_RECEIVE(pxQueue) \
+  trace_queue_received((pxQueue)->uxQueueNumber, (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) \
+  trace_queue_received((pxQueue)->uxQueueNumber, (pxQueue)->uxMessagesWaiting)
+#endif
 #define configUSE_STATS_FORMATTING_FUNCTIONS 0
 
 // Co-routine definitions
@@ -73,10 +123,8 @@ extern uint32_t SystemCoreClock;
 #define configMAX_CO_ROUTINE_PRIORITIES 2
 
 // Software timer related functions
-#define configUSE_TIMERS 1
-#define configTIMER_TASK_PRIORITY 3
-#define configTIMER_QUEUE_LENGTH 10
-#define configTIMER_TASK_STACK_DEPTH configMINIMAL_STACK_SIZE
+// Soft timers run on their own timer wheel task (soft_timer.h), not the kernel's timer service
+#define configUSE_TIMERS 0
 
 // Optional functions - most linkers will remove unused functions anyway
 #define INCLUDE_vTaskPrioritySet 1
@@ -0,0 +1,117 @@
+#pragma once
+// Co-simulation client, lets py/cosim run several x86 boards on one virtual clock and CAN bus
+//
+// A board started by the controller finds its socket in MIDSUN_COSIM_SOCKET and connects before
+// main(). Boards must be built with --define=MS_VIRTUAL_TIME: the controller then owns the tick.
+// Whenever every task is blocked, the idle hook calls x86_cosim_idle(), which advances the tick
+// up to the last step the controller granted. Once it's reached, the board reports its CPU time,
+// counters and transmitted frames, and blocks until the controller grants the next step.
+//
+// Frames transmitted during a step are delivered to every other board at the start of the next
+// one, in the order the boards were started. A step can also carry peripheral inputs (ADC
+// readings, input pin levels, I2C and SPI data) that are applied at its start, before any frames.
+// Each driver registers a handler for its own inputs when it's initialized.
+//
+// Ticks only move when every board is idle, so a task that busy-waits on the tick never returns.
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "status.h"
+
+#define X86_COSIM_SOCKET_ENV "MIDSUN_COSIM_SOCKET"
+#define X86_COSIM_NAME_ENV "MIDSUN_COSIM_NAME"
+
+#define X86_COSIM_NAME_LEN 32
+#define X86_COSIM_COUNTER_NAME_LEN 16
+#define X86_COSIM_MAX_COUNTERS 8
+// Frames per step in each direction, more are dropped and counted
+#define X86_COSIM_MAX_FRAMES 64
+#define X86_COSIM_MAX_INPUTS 32
+#define X86_COSIM_INPUT_DATA_LEN 24
+
+// Message layouts, must match py/cosim/main.py
+typedef enum {
+  X86_COSIM_MSG_HELLO = 'H',
+  X86_COSIM_MSG_DONE = 'D',
+  X86_COSIM_MSG_STEP = 'S',
+} x86CosimMsgType;
+
+typedef struct x86CosimFrame {
+  uint32_t id;
+  uint8_t extended;
+  uint8_t dlc;
+  uint8_t reserved[2];
+  uint64_t data;
+} x86CosimFrame;
+
+typedef enum {
+  X86_COSIM_INPUT_ADC = 0,  // value is the reading in mV
+  X86_COSIM_INPUT_GPIO,     // value is the pin's GpioState
+  X86_COSIM_INPUT_I2C,      // port is the I2CPort, data is queued for the next reads
+  X86_COSIM_INPUT_SPI,      // port is the SpiPort, data answers every following exchange
+  NUM_X86_COSIM_INPUTS,
+} x86CosimInputType;
+
+typedef struct x86CosimInput {
+  uint8_t type;
+  uint8_t port;
+  uint8_t pin;
+  uint8_t len;
+  uint32_t value;
+  uint8_t data[X86_COSIM_INPUT_DATA_LEN];
+} x86CosimInput;
+
+typedef struct x86CosimHello {
+  uint8_t type;
+  uint8_t reserved[3];
+  char name[X86_COSIM_NAME_LEN];
+} x86CosimHello;
+
+typedef struct x86CosimCounter {
+  char name[X86_COSIM_COUNTER_NAME_LEN];
+  uint32_t value;
+} x86CosimCounter;
+
+// Followed by num_counters x86CosimCounters, then num_frames x86CosimFrames
+typedef struct x86CosimDone {
+  uint8_t type;
+  uint8_t num_counters;
+  uint8_t num_frames;
+  uint8_t reserved;
+  uint32_t tick;
+  uint64_t cpu_ns;  // Process CPU time since start
+  uint32_t tx_dropped;
+  uint32_t reserved2;
+} x86CosimDone;
+
+// Followed by num_inputs x86CosimInputs, then num_frames x86CosimFrames
+typedef struct x86CosimStep {
+  uint8_t type;
+  uint8_t num_frames;
+  uint8_t num_inputs;
+  uint8_t reserved;
+  uint32_t target_tick;
+} x86CosimStep;
+
+typedef void (*x86CosimFrameHandler)(const x86CosimFrame *frame);
+typedef void (*x86CosimInputHandler)(const x86CosimInput *input);
+
+// True when the board was started by the co-simulation controller
+bool x86_cosim_connected(void);
+
+// Called by the idle hook with the tick and the ticks until the next task unblocks (UINT32_MAX if
+// none will). Returns the number of ticks to catch up by, may block waiting for the controller.
+uint32_t x86_cosim_idle(uint32_t tick, uint32_t ticks_until_unblock);
+
+// Queues a frame for the virtual bus, sent at the end of the step
+StatusCode x86_cosim_can_tx(const x86CosimFrame *frame);
+
+// Received frames are passed to the handler from the idle task
+void x86_cosim_set_can_rx_handler(x86CosimFrameHandler handler);
+
+// Inputs of the given type are passed to the handler from the idle task, inputs without a
+// handler are dropped
+StatusCode x86_cosim_set_input_handler(x86CosimInputType type, x86CosimInputHandler handler);
+
+// Reports the counter's value with every step, e.g. cycle overruns
+StatusCode x86_cosim_add_counter(const char *name, const volatile uint32_t *counter);
@@ -1,39 +1,71 @@
 #pragma once
-
+// Interrupt controller model, stands in for the NVIC and EXTI on x86
+//
+// Peripherals raise numbered vectors. A raised vector is pending until its handler runs, and
+// raising it again while it's pending is lost, as on the NVIC. Handlers run on the current task's
+// thread from a single real-time signal: the highest priority pending vector that is enabled runs
+// first, lowest number first within a priority, and a vector of strictly higher priority preempts a
+// running handler. Picking the next vector is O(1) using one pending bitmask per priority.
+//
+// Context switches requested by handlers (portYIELD_FROM_ISR) are deferred until the outermost
+// handler returns, like a PendSV, so a switch never leaves a handler half run.
+#include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
-#include <sys/types.h>
 
+#include "histogram.h"
 #include "interrupt_def.h"
 #include "status.h"
 
-typedef void (*x86InterruptHandler)(uint8_t interrupt_id);
+// EXTI line n (pin n of any port) raises vector n
+#define X86_INTERRUPT_VECTOR_EXTI(line) (line)
+#define X86_INTERRUPT_NUM_EXTI_LINES 16
+#define NUM_X86_INTERRUPT_VECTORS 64
 
-// Initializes the interrupt internals. If called multiple times the subsequent
-// attempts will clear everything resulting in the need to re initialize all
-// interrupts.
-void x86_interrupt_init(void);
+// Interrupts are masked while this is blocked, as in critical sections
+#define X86_INTERRUPT_SIGNAL SIGRTMIN
 
-// Registers an ISR handler. The handler_id is updated to the id assigned to the
-// handler if registered successfully.
-StatusCode x86_interrupt_register_handler(x86InterruptHandler handler, uint8_t *handler_id);
+typedef void (*x86InterruptHandler)(uint8_t vector);
 
-// Registers a callback to a handler assigning it a new id from the global
-// interrupt id pool.
-StatusCode x86_interrupt_register_interrupt(uint8_t handler_id, const InterruptSettings *settings,
-                                            uint8_t *interrupt_id);
+typedef struct X86InterruptStats {
+  uint32_t count;        // Times the handler ran, or the event was taken
+  uint32_t lost;         // Raised while already pending
+  uint32_t preemptions;  // Times the handler preempted another one
+  Histogram latency_us;  // Raised to handler entry
+  Histogram exec_us;     // Handler run time, including handlers that preempted it
+} X86InterruptStats;
 
-// Triggers a software interrupt by interrupt_id.
-StatusCode x86_interrupt_trigger(uint8_t interrupt_id);
+// Sets up the controller. Registered vectors are kept if called again, as interrupt_init() is
+// called by several drivers.
+void x86_interrupt_init(void);
 
-// Wakes wait()
-void x86_interrupt_wake(void);
+// Registers the vector's handler and priority, and enables it. Event type vectors only wake the
+// processor, so their handler isn't run.
+StatusCode x86_interrupt_register(uint8_t vector, x86InterruptHandler handler,
+                                  const InterruptSettings *settings);
 
-// Configures the block mask on the signal handler for critical sections.
-void x86_interrupt_mask(void);
-void x86_interrupt_unmask(void);
+// Marks the vector pending, it runs as soon as it's enabled and nothing of higher or equal
+// priority is running. Safe from tasks, handlers and other threads.
+StatusCode x86_interrupt_trigger(uint8_t vector);
 
-// Inits the correct signal mask on a pthread.
-void x86_interrupt_pthread_init(void);
+// A disabled vector still becomes pending, and runs once enabled again
+StatusCode x86_interrupt_set_enabled(uint8_t vector, bool enabled);
 
+bool x86_interrupt_is_pending(uint8_t vector);
+
+// True while a handler runs
 bool x86_interrupt_in_handler(void);
+
+// Runs fn once the outermost handler has returned, or now outside of handlers. Used by the
+// FreeRTOS ports to defer context switches.
+void x86_interrupt_pend_switch(void (*fn)(void));
+
+StatusCode x86_interrupt_get_stats(uint8_t vector, X86InterruptStats *stats);
+
+void x86_interrupt_reset_stats(void);
+
+// Time from a handler asking for a context switch to the switch, after the outermost handler
+void x86_interrupt_get_switch_stats(Histogram *switch_us);
+
+// Logs every vector that has run: count, lost, preemptions, then latency and exec histograms
+void x86_interrupt_log_stats(void);
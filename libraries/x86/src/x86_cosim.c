@@ -0,0 +1,214 @@
+#include "x86_cosim.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "status.h"
+
+#define X86_COSIM_MAX_MSG_SIZE                                               \
+  (sizeof(x86CosimDone) + X86_COSIM_MAX_COUNTERS * sizeof(x86CosimCounter) + \
+   X86_COSIM_MAX_FRAMES * sizeof(x86CosimFrame))
+
+typedef struct Counter {
+  const char *name;
+  const volatile uint32_t *value;
+} Counter;
+
+static int s_fd = -1;
+// Last tick granted by the controller
+static uint32_t s_target_tick;
+
+static x86CosimFrame s_tx_frames[X86_COSIM_MAX_FRAMES];
+static uint8_t s_num_tx_frames;
+static uint32_t s_tx_dropped;
+
+static x86CosimFrame s_rx_frames[X86_COSIM_MAX_FRAMES];
+static uint8_t s_num_rx_frames;
+static x86CosimFrameHandler s_rx_handler;
+
+static x86CosimInput s_inputs[X86_COSIM_MAX_INPUTS];
+static uint8_t s_num_inputs;
+static x86CosimInputHandler s_input_handlers[NUM_X86_COSIM_INPUTS];
+
+static Counter s_counters[X86_COSIM_MAX_COUNTERS];
+static uint8_t s_num_counters;
+
+// Only used from the idle task, whose stack is too small for them
+static uint8_t s_tx_msg[X86_COSIM_MAX_MSG_SIZE];
+static uint8_t s_rx_msg[sizeof(x86CosimStep) + X86_COSIM_MAX_INPUTS * sizeof(x86CosimInput) +
+                        X86_COSIM_MAX_FRAMES * sizeof(x86CosimFrame)];
+
+// The board can't run without its controller
+static void prv_fatal(const char *what) {
+  fprintf(stderr, "cosim: %s: %s\n", what, strerror(errno));
+  exit(EXIT_FAILURE);
+}
+
+// Runs before main so the board is connected before anything else starts
+__attribute__((constructor)) static void prv_cosim_connect(void) {
+  const char *path = getenv(X86_COSIM_SOCKET_ENV);
+  if (path == NULL) {
+    return;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (fd == -1) {
+    prv_fatal("socket");
+  }
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    prv_fatal(path);
+  }
+
+  x86CosimHello hello = { .type = X86_COSIM_MSG_HELLO };
+  const char *name = getenv(X86_COSIM_NAME_ENV);
+  snprintf(hello.name, sizeof(hello.name), "%s",
+           (name != NULL) ? name : program_invocation_short_name);
+  if (send(fd, &hello, sizeof(hello), 0) != sizeof(hello)) {
+    prv_fatal("send");
+  }
+  s_fd = fd;
+}
+
+static uint64_t prv_cpu_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void prv_send_done(uint32_t tick) {
+  uint8_t *msg = s_tx_msg;
+  x86CosimDone done = {
+    .type = X86_COSIM_MSG_DONE,
+    .num_counters = s_num_counters,
+    .num_frames = s_num_tx_frames,
+    .tick = tick,
+    .cpu_ns = prv_cpu_ns(),
+    .tx_dropped = s_tx_dropped,
+  };
+  size_t size = 0;
+  memcpy(msg, &done, sizeof(done));
+  size += sizeof(done);
+  for (uint8_t i = 0; i < s_num_counters; ++i) {
+    x86CosimCounter counter = { .value = *s_counters[i].value };
+    strncpy(counter.name, s_counters[i].name, sizeof(counter.name));
+    memcpy(msg + size, &counter, sizeof(counter));
+    size += sizeof(counter);
+  }
+  memcpy(msg + size, s_tx_frames, s_num_tx_frames * sizeof(x86CosimFrame));
+  size += s_num_tx_frames * sizeof(x86CosimFrame);
+  s_num_tx_frames = 0;
+
+  if (send(s_fd, msg, size, 0) != (ssize_t)size) {
+    prv_fatal("send");
+  }
+}
+
+static void prv_receive_step(void) {
+  uint8_t *msg = s_rx_msg;
+  ssize_t size;
+  do {
+    // Signals still arrive while the controller is paused
+    size = recv(s_fd, msg, sizeof(s_rx_msg), 0);
+  } while (size == -1 && errno == EINTR);
+
+  if (size == 0) {
+    // The controller has quit
+    exit(EXIT_SUCCESS);
+  }
+  if (size < (ssize_t)sizeof(x86CosimStep)) {
+    prv_fatal("recv");
+  }
+
+  x86CosimStep step;
+  memcpy(&step, msg, sizeof(step));
+  uint8_t num_inputs = step.num_inputs;
+  uint8_t num_frames = step.num_frames;
+  size_t inputs_size = num_inputs * sizeof(x86CosimInput);
+  if (num_inputs > X86_COSIM_MAX_INPUTS || num_frames > X86_COSIM_MAX_FRAMES ||
+      (size_t)size < sizeof(step) + inputs_size + num_frames * sizeof(x86CosimFrame)) {
+    fprintf(stderr, "cosim: malformed step\n");
+    exit(EXIT_FAILURE);
+  }
+  memcpy(s_inputs, msg + sizeof(step), inputs_size);
+  s_num_inputs = num_inputs;
+  memcpy(s_rx_frames, msg + sizeof(step) + inputs_size, num_frames * sizeof(x86CosimFrame));
+  s_num_rx_frames = num_frames;
+  s_target_tick = step.target_tick;
+}
+
+// Runs the handlers at the start of the step, with the tick still at the last one reported
+static void prv_deliver_step(void) {
+  for (uint8_t i = 0; i < s_num_inputs; ++i) {
+    const x86CosimInput *input = &s_inputs[i];
+    if (input->type < NUM_X86_COSIM_INPUTS && s_input_handlers[input->type] != NULL) {
+      s_input_handlers[input->type](input);
+    }
+  }
+  s_num_inputs = 0;
+
+  for (uint8_t i = 0; i < s_num_rx_frames && s_rx_handler != NULL; ++i) {
+    s_rx_handler(&s_rx_frames[i]);
+  }
+  s_num_rx_frames = 0;
+}
+
+bool x86_cosim_connected(void) {
+  return s_fd != -1;
+}
+
+uint32_t x86_cosim_idle(uint32_t tick, uint32_t ticks_until_unblock) {
+  if (ticks_until_unblock == 0) {
+    // A task is ready to run
+    return 0;
+  }
+  if (tick < s_target_tick) {
+    uint32_t ticks = s_target_tick - tick;
+    return (ticks_until_unblock < ticks) ? ticks_until_unblock : ticks;
+  }
+
+  prv_send_done(tick);
+  prv_receive_step();
+  // Tasks woken by the step's inputs and frames run before the tick moves
+  prv_deliver_step();
+  return 0;
+}
+
+StatusCode x86_cosim_can_tx(const x86CosimFrame *frame) {
+  if (s_num_tx_frames >= X86_COSIM_MAX_FRAMES) {
+    s_tx_dropped++;
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "cosim: too many frames this step");
+  }
+  s_tx_frames[s_num_tx_frames++] = *frame;
+  return STATUS_CODE_OK;
+}
+
+void x86_cosim_set_can_rx_handler(x86CosimFrameHandler handler) {
+  s_rx_handler = handler;
+}
+
+StatusCode x86_cosim_set_input_handler(x86CosimInputType type, x86CosimInputHandler handler) {
+  if (type >= NUM_X86_COSIM_INPUTS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  s_input_handlers[type] = handler;
+  return STATUS_CODE_OK;
+}
+
+StatusCode x86_cosim_add_counter(const char *name, const volatile uint32_t *counter) {
+  if (name == NULL || counter == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  if (s_num_counters >= X86_COSIM_MAX_COUNTERS) {
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+  s_counters[s_num_counters++] = (Counter){ .name = name, .value = counter };
+  return STATUS_CODE_OK;
+}
@@ -4,212 +4,290 @@
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "interrupt_def.h"
 #include "log.h"
 #include "status.h"
 
-#define NUM_X86_INTERRUPT_HANDLERS 64
-#define NUM_X86_INTERRUPT_INTERRUPTS 128
+// Active priority outside of handlers, lower than every interrupt priority
+#define THREAD_MODE_PRIORITY NUM_INTERRUPT_PRIORITIES
+#define NO_VECTOR NUM_X86_INTERRUPT_VECTORS
 
-typedef enum {
-  X86_INTERRUPT_STATE_NONE = 0,
-  X86_INTERRUPT_STATE_MASK,
-  X86_INTERRUPT_STATE_UNMASK,
-} X86InterruptState;
-
-typedef struct Interrupt {
+typedef struct Vector {
+  x86InterruptHandler handler;
   InterruptPriority priority;
-  uint8_t handler_id;
   bool is_event;
-} Interrupt;
+  uint32_t raised_us;
+  X86InterruptStats stats;
+} Vector;
 
-static bool s_in_handler_flag = false;
-static X86InterruptState s_interrupt_state_update = X86_INTERRUPT_STATE_NONE;
+static Vector s_vectors[NUM_X86_INTERRUPT_VECTORS];
 
-static pid_t s_pid = 0;
+// Pending vectors by priority, so the next one to run is found without looking at every vector
+static volatile uint64_t s_pending[NUM_INTERRUPT_PRIORITIES];
+static volatile uint64_t s_enabled;
+// Set while a signal has been sent that no handler has started on yet
+static volatile bool s_signal_sent;
 
-static uint8_t s_x86_interrupt_next_interrupt_id = 0;
-static uint8_t s_x86_interrupt_next_handler_id = 0;
+static volatile uint8_t s_active_priority = THREAD_MODE_PRIORITY;
+static volatile uint8_t s_depth;
 
-static Interrupt s_x86_interrupt_interrupts_map[NUM_X86_INTERRUPT_INTERRUPTS];
-static x86InterruptHandler s_x86_interrupt_handlers[NUM_X86_INTERRUPT_HANDLERS];
+static void (*volatile s_pending_switch)(void);
+static uint32_t s_switch_requested_us;
+static Histogram s_switch_us;
 
-// Signal handler for all interrupts. Prioritization is handled by the
-// implementation of signals and the init function. Signals of higher priority
-// interrupt the running of this function. All other signals are stored in a
-// pqueue and are executed in order of priority then arrival. Runs the handler
-// associated with the interrupt id it receives via the sival_int.
-static void prv_sig_handler(int signum, siginfo_t *info, void *ptr) {
-  (void)signum;
-  (void)ptr;
-  s_in_handler_flag = true;
-  if (info->si_value.sival_int < NUM_X86_INTERRUPT_INTERRUPTS) {
-    // If the interrupt is an event don't run the handler as it is just a wake
-    // event.
-    if (!s_x86_interrupt_interrupts_map[info->si_value.sival_int].is_event) {
-      // Execute the handler passing it the interrupt ID. To determine which
-      // handler look up in the interrupts map by interrupt ID.
-      s_x86_interrupt_handlers[s_x86_interrupt_interrupts_map[info->si_value.sival_int].handler_id](
-          info->si_value.sival_int);
+static pid_t s_pid;
+static bool s_installed;
+
+// Host time rather than timestamp_us(), as the virtual clock doesn't move inside a handler
+static uint32_t prv_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000);
+}
+
+// Stops handlers running on this thread while the controller's state is changed
+static void prv_block(sigset_t *old) {
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, X86_INTERRUPT_SIGNAL);
+  pthread_sigmask(SIG_BLOCK, &set, old);
+}
+
+static void prv_restore(const sigset_t *old) {
+  pthread_sigmask(SIG_SETMASK, old, NULL);
+}
+
+static void prv_raise(void) {
+  if (!__atomic_exchange_n(&s_signal_sent, true, __ATOMIC_ACQ_REL)) {
+    sigqueue(s_pid, X86_INTERRUPT_SIGNAL, (union sigval){ 0 });
+  }
+}
+
+// Highest priority vector that is pending, enabled and would preempt the given priority
+static uint8_t prv_next(uint8_t active_priority) {
+  for (uint8_t priority = 0; priority < active_priority; ++priority) {
+    uint64_t ready = s_pending[priority] & s_enabled;
+    if (ready != 0) {
+      return (uint8_t)__builtin_ctzll(ready);
     }
   }
-  s_in_handler_flag = false;
+  return NO_VECTOR;
 }
 
-// Blocks all interrupts (excluding signals to block/unblock interrupts) when
-// triggered. Should use signal number |SIGRTMIN + NUM_INTERRUPT_PRIORITIES| to
-// trigger. This has to be run as a signal handler since a thread can only
-// manipulate its own signal mask or its children up until the point they are
-// spawned. As a result the signal handling thread MUST be interrupted in order
-// to change its signal mask in the event of a critical section.
-static void prv_sig_state_handler(int signum, siginfo_t *info, void *ptr) {
+static void prv_run(uint8_t vector, uint8_t preempted_priority) {
+  Vector *v = &s_vectors[vector];
+  uint32_t entry_us = prv_now_us();
+  histogram_record(&v->stats.latency_us, entry_us - v->raised_us);
+  v->stats.count++;
+  if (preempted_priority != THREAD_MODE_PRIORITY) {
+    v->stats.preemptions++;
+  }
+
+  // Event type vectors only wake the processor
+  if (!v->is_event && v->handler != NULL) {
+    s_active_priority = v->priority;
+    v->handler(vector);
+    s_active_priority = preempted_priority;
+  }
+  histogram_record(&v->stats.exec_us, prv_now_us() - entry_us);
+}
+
+// Every vector shares one signal, which isn't blocked while its handler runs, so a vector of higher
+// priority than the running one is taken as soon as it's raised. Lower or equal priority vectors
+// are left for the handler instance they interrupted, which runs them once its vector returns.
+static void prv_sig_handler(int signum, siginfo_t *info, void *ptr) {
   (void)signum;
-  // We actually need to manipulate the block mask of the context that is
-  // restored for this thread. So we alter |ctx| rather than directly calling
-  // |pthread_sigmask| as this gets overridden on context switch after exiting
-  // the handler.
-  ucontext_t *ctx = ptr;
+  (void)info;
+  (void)ptr;
+  // Anything raised from here on needs another signal
+  __atomic_store_n(&s_signal_sent, false, __ATOMIC_RELEASE);
+
+  uint8_t preempted_priority = s_active_priority;
+  s_depth++;
+  uint8_t vector;
+  while ((vector = prv_next(preempted_priority)) != NO_VECTOR) {
+    uint64_t bit = 1ULL << vector;
+    // A nested handler may have taken it already
+    if (__atomic_fetch_and(&s_pending[s_vectors[vector].priority], ~bit, __ATOMIC_ACQ_REL) & bit) {
+      prv_run(vector, preempted_priority);
+    }
+  }
+  s_depth--;
 
-  // Based on the sival_int change the state of interrupts. If invalid number
-  // silently ignore.
-  if (info->si_value.sival_int == X86_INTERRUPT_STATE_MASK) {
-    sigaddset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_LOW);
-    sigaddset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_NORMAL);
-    sigaddset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_HIGH);
-  } else if (info->si_value.sival_int == X86_INTERRUPT_STATE_UNMASK) {
-    sigdelset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_LOW);
-    sigdelset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_NORMAL);
-    sigdelset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_HIGH);
+  if (s_depth == 0 && s_pending_switch != NULL) {
+    void (*fn)(void) = s_pending_switch;
+    s_pending_switch = NULL;
+    histogram_record(&s_switch_us, prv_now_us() - s_switch_requested_us);
+    fn();
   }
 }
 
 void x86_interrupt_init(void) {
-  // Assign the s_pid to be the process id handling the interrupts. This
-  // prevents subprocesses from sending a signal to itself instead.
+  // Signals go to the process so that whichever thread is running the current task handles them
   s_pid = getpid();
+  if (s_installed) {
+    return;
+  }
 
-  // Create a handler sigaction.
   struct sigaction act;
+  memset(&act, 0, sizeof(act));
   act.sa_sigaction = prv_sig_handler;
-  act.sa_flags = SA_SIGINFO | SA_RESTART;  // Set SA_RESTART to allow syscalls to be retried.
-
-  // Define an empty blocking mask (no signals are blocked to start).
-  sigset_t block_mask;
-  sigemptyset(&block_mask);
-
-  // Add a rule for low priority interrupts which blocks only other low priority
-  // signals.
-  sigaddset(&block_mask, SIGRTMIN + INTERRUPT_PRIORITY_LOW);
-  act.sa_mask = block_mask;
-  sigaction(SIGRTMIN + INTERRUPT_PRIORITY_LOW, &act, NULL);
-
-  // Add a rule for normal priority interrupts which blocks low and other normal
-  // priority signals.
-  sigaddset(&block_mask, SIGRTMIN + INTERRUPT_PRIORITY_NORMAL);
-  act.sa_mask = block_mask;
-  sigaction(SIGRTMIN + INTERRUPT_PRIORITY_NORMAL, &act, NULL);
-
-  // Add a rule for high priority interrupts which blocks all other interrupt
-  // signals.
-  sigaddset(&block_mask, SIGRTMIN + INTERRUPT_PRIORITY_HIGH);
-  act.sa_mask = block_mask;
-  sigaction(SIGRTMIN + INTERRUPT_PRIORITY_HIGH, &act, NULL);
-
-  // Add a rule for the masking (critical sectioning) of the signals.
-  act.sa_mask = block_mask;
-  act.sa_sigaction = prv_sig_state_handler;
-  sigaction(SIGRTMIN + NUM_INTERRUPT_PRIORITIES, &act, NULL);
-
-  // Clear statics.
-  s_interrupt_state_update = X86_INTERRUPT_STATE_NONE;
-  s_in_handler_flag = false;
-  s_x86_interrupt_next_interrupt_id = 0;
-  s_x86_interrupt_next_handler_id = 0;
-  memset(&s_x86_interrupt_interrupts_map, 0, sizeof(s_x86_interrupt_interrupts_map));
-  memset(&s_x86_interrupt_handlers, 0, sizeof(s_x86_interrupt_handlers));
+  // SA_RESTART allows syscalls to be retried, SA_NODEFER lets handlers be preempted
+  act.sa_flags = SA_SIGINFO | SA_RESTART | SA_NODEFER;
+  // The tick has the lowest priority, as on the STM32, so it can't switch tasks mid handler
+  sigemptyset(&act.sa_mask);
+  sigaddset(&act.sa_mask, SIGALRM);
+  sigaction(X86_INTERRUPT_SIGNAL, &act, NULL);
+
+  s_installed = true;
+  x86_interrupt_reset_stats();
 }
 
-StatusCode x86_interrupt_register_handler(x86InterruptHandler handler, uint8_t *handler_id) {
-  if (s_x86_interrupt_next_handler_id >= NUM_X86_INTERRUPT_HANDLERS) {
-    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+StatusCode x86_interrupt_register(uint8_t vector, x86InterruptHandler handler,
+                                  const InterruptSettings *settings) {
+  if (vector >= NUM_X86_INTERRUPT_VECTORS || settings == NULL ||
+      settings->priority < INTERRUPT_PRIORITY_HIGH ||
+      settings->priority >= NUM_INTERRUPT_PRIORITIES || settings->type >= NUM_INTERRUPT_CLASSES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
   }
-
-  *handler_id = s_x86_interrupt_next_handler_id;
-  s_x86_interrupt_next_handler_id++;
-  s_x86_interrupt_handlers[*handler_id] = handler;
+  // Raising a vector without the handler installed would kill the process
+  x86_interrupt_init();
+
+  sigset_t old;
+  prv_block(&old);
+  uint64_t bit = 1ULL << vector;
+  for (uint8_t priority = 0; priority < NUM_INTERRUPT_PRIORITIES; ++priority) {
+    __atomic_fetch_and(&s_pending[priority], ~bit, __ATOMIC_ACQ_REL);
+  }
+  s_vectors[vector].handler = handler;
+  s_vectors[vector].priority = settings->priority;
+  s_vectors[vector].is_event = (settings->type == INTERRUPT_TYPE_EVENT);
+  __atomic_fetch_or(&s_enabled, bit, __ATOMIC_ACQ_REL);
+  prv_restore(&old);
 
   return STATUS_CODE_OK;
 }
 
-StatusCode x86_interrupt_register_interrupt(uint8_t handler_id, const InterruptSettings *settings,
-                                            uint8_t *interrupt_id) {
-  if (handler_id >= s_x86_interrupt_next_handler_id ||
-      settings->priority >= NUM_INTERRUPT_PRIORITIES || settings->type >= NUM_INTERRUPT_CLASSES) {
+StatusCode x86_interrupt_trigger(uint8_t vector) {
+  if (vector >= NUM_X86_INTERRUPT_VECTORS || !s_installed ||
+      (s_vectors[vector].handler == NULL && !s_vectors[vector].is_event)) {
     return status_code(STATUS_CODE_INVALID_ARGS);
-  } else if (s_x86_interrupt_next_interrupt_id >= NUM_X86_INTERRUPT_INTERRUPTS) {
-    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
   }
 
-  *interrupt_id = s_x86_interrupt_next_interrupt_id;
-  s_x86_interrupt_next_interrupt_id++;
-  Interrupt interrupt = {
-    .priority = settings->priority,
-    .handler_id = handler_id,
-    .is_event = (bool)settings->type,
-  };
-  s_x86_interrupt_interrupts_map[*interrupt_id] = interrupt;
+  sigset_t old;
+  prv_block(&old);
+  Vector *v = &s_vectors[vector];
+  uint64_t bit = 1ULL << vector;
+  if (__atomic_load_n(&s_pending[v->priority], __ATOMIC_ACQUIRE) & bit) {
+    __atomic_fetch_add(&v->stats.lost, 1, __ATOMIC_RELAXED);
+  } else {
+    v->raised_us = prv_now_us();
+    __atomic_fetch_or(&s_pending[v->priority], bit, __ATOMIC_ACQ_REL);
+    if (s_enabled & bit) {
+      prv_raise();
+    }
+  }
+  prv_restore(&old);
 
   return STATUS_CODE_OK;
 }
 
-StatusCode x86_interrupt_trigger(uint8_t interrupt_id) {
-  if (interrupt_id >= s_x86_interrupt_next_interrupt_id) {
+StatusCode x86_interrupt_set_enabled(uint8_t vector, bool enabled) {
+  if (vector >= NUM_X86_INTERRUPT_VECTORS) {
     return status_code(STATUS_CODE_INVALID_ARGS);
   }
 
-  // Enqueue a new signal sent to this process that has a signal number
-  // determined by the id for the callback it is going to run.
-  siginfo_t value_store;
-  value_store.si_value.sival_int = interrupt_id;
-  sigqueue(s_pid, SIGRTMIN + (int)s_x86_interrupt_interrupts_map[interrupt_id].priority,
-           value_store.si_value);
-
+  uint64_t bit = 1ULL << vector;
+  if (!enabled) {
+    __atomic_fetch_and(&s_enabled, ~bit, __ATOMIC_ACQ_REL);
+    return STATUS_CODE_OK;
+  }
+  __atomic_fetch_or(&s_enabled, bit, __ATOMIC_ACQ_REL);
+  // Raised while disabled
+  if (x86_interrupt_is_pending(vector)) {
+    prv_raise();
+  }
   return STATUS_CODE_OK;
 }
 
-void x86_interrupt_pthread_init(void) {
-  sigset_t block_mask;
-  sigemptyset(&block_mask);
-  sigaddset(&block_mask, SIGRTMIN + INTERRUPT_PRIORITY_LOW);
-  sigaddset(&block_mask, SIGRTMIN + INTERRUPT_PRIORITY_NORMAL);
-  sigaddset(&block_mask, SIGRTMIN + INTERRUPT_PRIORITY_HIGH);
-  sigaddset(&block_mask, SIGRTMIN + NUM_INTERRUPT_PRIORITIES);
-  pthread_sigmask(SIG_BLOCK, &block_mask, NULL);
+bool x86_interrupt_is_pending(uint8_t vector) {
+  if (vector >= NUM_X86_INTERRUPT_VECTORS) {
+    return false;
+  }
+  uint64_t bit = 1ULL << vector;
+  return (__atomic_load_n(&s_pending[s_vectors[vector].priority], __ATOMIC_ACQUIRE) & bit) != 0;
 }
 
-void x86_interrupt_mask(void) {
-  siginfo_t value_store;
-  value_store.si_value.sival_int = X86_INTERRUPT_STATE_MASK;
-  sigqueue(s_pid, SIGRTMIN + NUM_INTERRUPT_PRIORITIES, value_store.si_value);
+bool x86_interrupt_in_handler(void) {
+  return s_depth != 0;
 }
 
-void x86_interrupt_unmask(void) {
-  siginfo_t value_store;
-  value_store.si_value.sival_int = X86_INTERRUPT_STATE_UNMASK;
-  sigqueue(s_pid, SIGRTMIN + NUM_INTERRUPT_PRIORITIES, value_store.si_value);
+void x86_interrupt_pend_switch(void (*fn)(void)) {
+  if (s_depth == 0) {
+    fn();
+    return;
+  }
+  if (s_pending_switch == NULL) {
+    s_switch_requested_us = prv_now_us();
+  }
+  s_pending_switch = fn;
 }
 
-void x86_interrupt_wake(void) {
-  siginfo_t value_store;
-  uint8_t interrupt_id = NUM_X86_INTERRUPT_INTERRUPTS;
-  value_store.si_value.sival_int = interrupt_id;
-  sigqueue(s_pid, SIGRTMIN + INTERRUPT_PRIORITY_HIGH, value_store.si_value);
+StatusCode x86_interrupt_get_stats(uint8_t vector, X86InterruptStats *stats) {
+  if (vector >= NUM_X86_INTERRUPT_VECTORS || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  sigset_t old;
+  prv_block(&old);
+  *stats = s_vectors[vector].stats;
+  prv_restore(&old);
+  return STATUS_CODE_OK;
 }
 
-bool x86_interrupt_in_handler(void) {
-  return s_in_handler_flag;
+void x86_interrupt_get_switch_stats(Histogram *switch_us) {
+  sigset_t old;
+  prv_block(&old);
+  *switch_us = s_switch_us;
+  prv_restore(&old);
+}
+
+void x86_interrupt_reset_stats(void) {
+  sigset_t old;
+  prv_block(&old);
+  for (uint8_t vector = 0; vector < NUM_X86_INTERRUPT_VECTORS; ++vector) {
+    X86InterruptStats *stats = &s_vectors[vector].stats;
+    stats->count = 0;
+    stats->lost = 0;
+    stats->preemptions = 0;
+    histogram_init(&stats->latency_us);
+    histogram_init(&stats->exec_us);
+  }
+  histogram_init(&s_switch_us);
+  prv_restore(&old);
+}
+
+void x86_interrupt_log_stats(void) {
+  char name[24];
+  for (uint8_t vector = 0; vector < NUM_X86_INTERRUPT_VECTORS; ++vector) {
+    X86InterruptStats stats;
+    x86_interrupt_get_stats(vector, &stats);
+    if (stats.count == 0 && stats.lost == 0) {
+      continue;
+    }
+    LOG_DEBUG("vector %u: count %u lost %u preemptions %u\n", (unsigned)vector,
+              (unsigned)stats.count, (unsigned)stats.lost, (unsigned)stats.preemptions);
+    snprintf(name, sizeof(name), "vector %u latency us", (unsigned)vector);
+    histogram_log(&stats.latency_us, name);
+    snprintf(name, sizeof(name), "vector %u exec us", (unsigned)vector);
+    histogram_log(&stats.exec_us, name);
+  }
+  Histogram switch_us;
+  x86_interrupt_get_switch_stats(&switch_us);
+  histogram_log(&switch_us, "context switch us");
 }
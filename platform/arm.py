@@ -40,7 +40,6 @@ cflags = [
     '-ffunction-sections',
     '-fdata-sections',
     '-Wl,--gc-sections',
-    '-Wl,-Map=build/out.map',
     '--specs=nosys.specs',
     '--specs=nano.specs',
 ]
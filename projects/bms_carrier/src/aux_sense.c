@@ -3,8 +3,8 @@
 static const GpioAddress aux_sense_pin = { .port = GPIO_PORT_A, .pin = 5 };
 BmsStorage *storage;
 
-StatusCode aux_sense_init(BmsStorage *storage) {
-  storage = storage;
+StatusCode aux_sense_init(BmsStorage *bms) {
+  storage = bms;
   gpio_init_pin(&aux_sense_pin, GPIO_ANALOG, GPIO_STATE_LOW);
   adc_add_channel(aux_sense_pin);
   adc_init();
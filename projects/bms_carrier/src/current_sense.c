@@ -83,6 +83,7 @@ TASK(current_sense, TASK_STACK_256) {
 }
 
 StatusCode current_sense_run() {
+  tasks_expect_end(current_sense);
   StatusCode ret = notify(current_sense, CURRENT_SENSE_RUN_CYCLE);
   if (ret != STATUS_CODE_OK) {
     fault_bps_set(BMS_FAULT_COMMS_LOSS_CURR_SENSE);
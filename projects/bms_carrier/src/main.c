@@ -3,16 +3,20 @@
 
 #include "aux_sense.h"
 #include "bms.h"
+#include "boot.h"
 #include "can.h"
 #include "can_board_ids.h"
+#include "can_diag.h"
 #include "cell_sense.h"
 #include "current_sense.h"
 #include "fan.h"
 #include "gpio.h"
 #include "gpio_it.h"
+#include "interrupt.h"
 #include "log.h"
 #include "master_task.h"
 #include "relays.h"
+#include "misc.h"
 #include "tasks.h"
 
 #define FUEL_GAUGE_CYCLE_TIME_MS 100
@@ -40,14 +44,45 @@ BmsStorage bms_storage = { .config = { .series_count = NUM_SERIES_CELLS,
 
 uint32_t notification;
 
+static StatusCode prv_init_fault_bps(void) {
+  return fault_bps_init(&bms_storage);
+}
+
+static StatusCode prv_init_relays(void) {
+  return init_bms_relays(&kill_switch_mntr);
+}
+
+static StatusCode prv_init_current_sense(void) {
+  return current_sense_init(&bms_storage, &i2c_settings, FUEL_GAUGE_CYCLE_TIME_MS);
+}
+
+static StatusCode prv_init_cell_sense(void) {
+  return cell_sense_init(&bms_storage);
+}
+
+static StatusCode prv_init_aux_sense(void) {
+  return aux_sense_init(&bms_storage);
+}
+
+static StatusCode prv_init_fan(void) {
+  bms_fan_init(&bms_storage);
+  return STATUS_CODE_OK;
+}
+
+// Relay sequencing and the fuel gauge's I2C setup block for most of boot, so they run alongside
+// each other. Everything which can raise a fault waits for fault_bps.
+static BootStep s_init_steps[] = {
+  { .name = "fault_bps", .init = prv_init_fault_bps },
+  { .name = "relays", .init = prv_init_relays, .deps = BOOT_DEP(0) },
+  { .name = "current_sense", .init = prv_init_current_sense, .deps = BOOT_DEP(0) },
+  { .name = "cell_sense", .init = prv_init_cell_sense, .deps = BOOT_DEP(0) },
+  { .name = "aux_sense", .init = prv_init_aux_sense },
+  { .name = "fan", .init = prv_init_fan },
+};
+
 void pre_loop_init() {
   LOG_DEBUG("Welcome to BMS \n");
-  fault_bps_init(&bms_storage);
-  init_bms_relays(&kill_switch_mntr);
-  current_sense_init(&bms_storage, &i2c_settings, FUEL_GAUGE_CYCLE_TIME_MS);
-  cell_sense_init(&bms_storage);
-  aux_sense_init(&bms_storage);
-  bms_fan_init(&bms_storage);
+  boot_run_steps(s_init_steps, SIZEOF_ARRAY(s_init_steps));
 }
 
 void run_fast_cycle() {
@@ -69,15 +104,24 @@ void run_medium_cycle() {
   bms_run_fan();
 }
 
-void run_slow_cycle() {}
+void run_slow_cycle() {
+  // Boot phases are all recorded by now, including the first CAN frame
+  static bool s_boot_sent = false;
+  if (!s_boot_sent) {
+    s_boot_sent = (can_diag_tx_boot() == STATUS_CODE_OK);
+  }
+}
 
 int main() {
+  boot_init();
   // Remove this in the future - Aryan
-  tasks_init();
-  log_init();
-  gpio_init();
-  gpio_it_init();
-  can_init(&s_can_storage, &can_settings);
+  BOOT_PHASE("tasks", tasks_init());
+  BOOT_PHASE("log", log_init());
+  BOOT_PHASE("gpio", gpio_init());
+  BOOT_PHASE("gpio_it", gpio_it_init());
+  // Before the scheduler, as the relays and current sense steps both register interrupts
+  BOOT_PHASE("interrupt", interrupt_init());
+  BOOT_PHASE("can", can_init(&s_can_storage, &can_settings));
 
   LOG_DEBUG("Welcome to BMS!\n");
   init_master_task();
@@ -0,0 +1,124 @@
+#include "can_time_sync.h"
+#include "delay.h"
+#include "log.h"
+#include "task_test_helpers.h"
+#include "test_helpers.h"
+#include "timestamp.h"
+#include "unity.h"
+
+#define MASTER_OFFSET_US 1000000
+#define MASTER_DRIFT_PPM 200
+#define SYNC_PERIOD_MS 10
+
+static const CanSettings s_can_settings = {
+  .bitrate = CAN_HW_BITRATE_500KBPS,
+  .tx = { GPIO_PORT_A, 12 },
+  .rx = { GPIO_PORT_A, 11 },
+  .loopback = true,
+};
+
+// Master time of a clock MASTER_OFFSET_US ahead which runs drift_ppm fast
+static uint64_t prv_master_us(uint64_t local_us, int32_t drift_ppm) {
+  return (uint64_t)((int64_t)local_us + MASTER_OFFSET_US +
+                    (int64_t)local_us * drift_ppm / 1000000);
+}
+
+static void prv_receive_drifting_sync(int32_t drift_ppm, int32_t jitter_us) {
+  uint64_t master_us = prv_master_us(timestamp_us(), drift_ppm) + (uint64_t)(int64_t)jitter_us;
+  can_time_sync_rx_handler(master_us & CAN_TIME_SYNC_TIME_MASK);
+  can_time_sync_process();
+}
+
+static void prv_receive_sync(int32_t jitter_us) {
+  prv_receive_drifting_sync(MASTER_DRIFT_PPM, jitter_us);
+}
+
+static uint32_t prv_abs_diff(uint64_t a, uint64_t b) {
+  return (a > b) ? a - b : b - a;
+}
+
+void setup_test(void) {
+  can_time_sync_init(&s_can_settings);
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_can_time_sync_unsynced(void) {
+  TEST_ASSERT_FALSE(can_time_is_synced());
+  TEST_ASSERT_LESS_THAN(100, prv_abs_diff(can_time_us(), timestamp_us()));
+}
+
+TEST_IN_TASK
+void test_can_time_sync_first_sync_steps(void) {
+  prv_receive_sync(0);
+  TEST_ASSERT_TRUE(can_time_is_synced());
+
+  CanTimeSyncStats stats = { 0 };
+  TEST_ASSERT_OK(can_time_sync_get_stats(&stats));
+  TEST_ASSERT_EQUAL(1, stats.num_syncs);
+  TEST_ASSERT_EQUAL(1, stats.num_steps);
+
+  uint64_t local_us = timestamp_us();
+  uint64_t expected_us = local_us + MASTER_OFFSET_US + local_us * MASTER_DRIFT_PPM / 1000000;
+  TEST_ASSERT_LESS_THAN(200, prv_abs_diff(can_time_us(), expected_us));
+}
+
+TEST_IN_TASK
+void test_can_time_sync_tracks_drift(void) {
+  uint64_t last_us = 0;
+  for (uint32_t i = 0; i < 100; ++i) {
+    // Alternate a small error around the true master time
+    prv_receive_sync((i % 2) ? 2 : -2);
+    for (uint32_t j = 0; j < 10; ++j) {
+      uint64_t now_us = can_time_us();
+      TEST_ASSERT_TRUE(now_us >= last_us);
+      last_us = now_us;
+    }
+    delay_ms(SYNC_PERIOD_MS);
+  }
+
+  CanTimeSyncStats stats = { 0 };
+  TEST_ASSERT_OK(can_time_sync_get_stats(&stats));
+  LOG_DEBUG("drift %d ppb, error last %d us, max %u us, mean %u us\n", (int)stats.drift_ppb,
+            (int)stats.last_error_us, (unsigned)stats.max_error_us,
+            (unsigned)stats.mean_error_us);
+  TEST_ASSERT_EQUAL(100, stats.num_syncs);
+  TEST_ASSERT_EQUAL(1, stats.num_steps);
+  TEST_ASSERT_EQUAL(0, stats.num_missed);
+  TEST_ASSERT_INT_WITHIN(MASTER_DRIFT_PPM * 1000 / 4, MASTER_DRIFT_PPM * 1000, stats.drift_ppb);
+  TEST_ASSERT_LESS_THAN(1000, stats.max_error_us);
+}
+
+TEST_IN_TASK
+void test_can_time_sync_negative_drift_before_base(void) {
+  for (uint32_t i = 0; i < CAN_TIME_SYNC_DRIFT_WINDOW * 2; ++i) {
+    prv_receive_drifting_sync(-MASTER_DRIFT_PPM, 0);
+    delay_ms(SYNC_PERIOD_MS);
+  }
+  CanTimeSyncStats stats = { 0 };
+  TEST_ASSERT_OK(can_time_sync_get_stats(&stats));
+  TEST_ASSERT_TRUE(stats.drift_ppb < 0);
+
+  // A timestamp taken just before the last sync is before the clock's base, so the elapsed time
+  // and the drift correction are both negative
+  prv_receive_drifting_sync(-MASTER_DRIFT_PPM, 0);
+  uint64_t local_us = timestamp_us() - 100;
+  uint64_t car_us = can_time_from_local_us(local_us);
+  TEST_ASSERT_LESS_THAN(200, prv_abs_diff(car_us, prv_master_us(local_us, -MASTER_DRIFT_PPM)));
+  TEST_ASSERT_TRUE(car_us < can_time_from_local_us(local_us + 100));
+}
+
+TEST_IN_TASK
+void test_can_time_sync_master(void) {
+  can_time_sync_set_master(true);
+  TEST_ASSERT_TRUE(can_time_is_synced());
+
+  // Sync frames are ignored by the master
+  prv_receive_sync(0);
+  CanTimeSyncStats stats = { 0 };
+  TEST_ASSERT_OK(can_time_sync_get_stats(&stats));
+  TEST_ASSERT_EQUAL(0, stats.num_syncs);
+  TEST_ASSERT_LESS_THAN(100, prv_abs_diff(can_time_us(), timestamp_us()));
+  can_time_sync_set_master(false);
+}
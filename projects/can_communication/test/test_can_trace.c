@@ -0,0 +1,129 @@
+#include "can_time_sync.h"
+#include "can_trace.h"
+#include "delay.h"
+#include "log.h"
+#include "task_test_helpers.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define TRACED_ID 3
+// Traced frame with the tag in its last two bytes
+#define TRACED_DLC 7
+
+static CanMessage prv_traced_msg(uint16_t tag) {
+  CanMessage msg = { .id.raw = TRACED_ID, .dlc = TRACED_DLC };
+  msg.data = 0xAABBCCDDEEULL | ((uint64_t)tag << 40);
+  return msg;
+}
+
+static Histogram prv_get_hist(CanTraceHop hop) {
+  Histogram hist;
+  TEST_ASSERT_OK(can_trace_get_histogram(hop, &hist));
+  return hist;
+}
+
+void setup_test(void) {
+  can_time_sync_set_master(true);
+  TEST_ASSERT_OK(can_trace_init(TRACED_ID));
+}
+
+void teardown_test(void) {}
+
+TEST_IN_TASK
+void test_can_trace_tx_enqueue(void) {
+  CanMessage msg = prv_traced_msg(can_trace_tag());
+  delay_ms(5);
+  can_trace_tx(&msg);
+  // Repeats of a tag are only counted once
+  can_trace_tx(&msg);
+
+  // Other messages are ignored
+  CanMessage other = prv_traced_msg(0);
+  other.id.raw = TRACED_ID + 1;
+  can_trace_tx(&other);
+
+  Histogram hist = prv_get_hist(CAN_TRACE_HOP_TX_ENQUEUE);
+  TEST_ASSERT_EQUAL(1, hist.count);
+  TEST_ASSERT_UINT32_WITHIN(3000, 5000 + CAN_TRACE_TAG_UNIT_US, hist.max);
+}
+
+TEST_IN_TASK
+void test_can_trace_rx(void) {
+  // Forwarded commands are ignored until one has been received
+  TEST_ASSERT_OK(can_trace_record(CAN_TRACE_HOP_MCP2515_TX, 0));
+  TEST_ASSERT_EQUAL(0, prv_get_hist(CAN_TRACE_HOP_MCP2515_TX).count);
+
+  CanMessage first = prv_traced_msg(can_trace_tag());
+  delay_ms(2);
+  can_trace_rx_handler(&first);
+  CanMessage second = prv_traced_msg(can_trace_tag());
+  delay_ms(2);
+  can_trace_rx_handler(&second);
+  delay_ms(10);
+
+  // First frame was dropped from the RX queue, its timestamp is skipped
+  can_trace_rx(&second);
+  uint16_t tag = second.data >> 40;
+  TEST_ASSERT_OK(can_trace_record(CAN_TRACE_HOP_MCP2515_TX, tag));
+
+  Histogram bus = prv_get_hist(CAN_TRACE_HOP_BUS);
+  Histogram decode = prv_get_hist(CAN_TRACE_HOP_RX_DECODE);
+  Histogram forward = prv_get_hist(CAN_TRACE_HOP_MCP2515_TX);
+  TEST_ASSERT_EQUAL(1, bus.count);
+  TEST_ASSERT_EQUAL(1, decode.count);
+  TEST_ASSERT_EQUAL(1, forward.count);
+  TEST_ASSERT_UINT32_WITHIN(1500, 2000 + CAN_TRACE_TAG_UNIT_US, bus.max);
+  TEST_ASSERT_UINT32_WITHIN(3000, 12000 + CAN_TRACE_TAG_UNIT_US, decode.max);
+  TEST_ASSERT_TRUE(forward.max >= decode.max);
+  can_trace_log();
+}
+
+TEST_IN_TASK
+void test_can_trace_unsynced(void) {
+  can_time_sync_set_master(false);
+  CanMessage msg = prv_traced_msg(can_trace_tag());
+  can_trace_tx(&msg);
+  can_trace_rx_handler(&msg);
+  can_trace_rx(&msg);
+  TEST_ASSERT_EQUAL(0, prv_get_hist(CAN_TRACE_HOP_TX_ENQUEUE).count);
+  TEST_ASSERT_EQUAL(0, prv_get_hist(CAN_TRACE_HOP_BUS).count);
+  TEST_ASSERT_EQUAL(0, prv_get_hist(CAN_TRACE_HOP_RX_DECODE).count);
+}
+
+TEST_IN_TASK
+void test_can_trace_skew(void) {
+  // Sampled by a sender whose clock is ahead, received before the sample by this board's clock
+  CanMessage msg = prv_traced_msg(can_trace_tag() + 2);
+  can_trace_rx_handler(&msg);
+  delay_ms(1);
+  can_trace_rx(&msg);
+
+  TEST_ASSERT_EQUAL(0, prv_get_hist(CAN_TRACE_HOP_BUS).count);
+  TEST_ASSERT_EQUAL(1, can_trace_num_skewed());
+  Histogram decode = prv_get_hist(CAN_TRACE_HOP_RX_DECODE);
+  TEST_ASSERT_EQUAL(1, decode.count);
+  TEST_ASSERT_TRUE(decode.max < 2000);
+}
+
+TEST_IN_TASK
+void test_can_trace_rx_timestamp_dropped(void) {
+  CanMessage old = prv_traced_msg(can_trace_tag());
+  for (uint8_t i = 0; i < CAN_TRACE_RX_SLOTS; ++i) {
+    can_trace_rx_handler(&old);
+  }
+  delay_ms(1);
+  // The ring is full, this frame's timestamp is dropped
+  CanMessage dropped = prv_traced_msg(can_trace_tag());
+  can_trace_rx_handler(&dropped);
+  can_trace_rx(&old);
+  delay_ms(1);
+  CanMessage newer = prv_traced_msg(can_trace_tag());
+  can_trace_rx_handler(&newer);
+
+  // The dropped frame doesn't take the newer frame's timestamp
+  can_trace_rx(&dropped);
+  TEST_ASSERT_EQUAL(1, prv_get_hist(CAN_TRACE_HOP_BUS).count);
+  can_trace_rx(&newer);
+  TEST_ASSERT_EQUAL(2, prv_get_hist(CAN_TRACE_HOP_BUS).count);
+  TEST_ASSERT_EQUAL(3, prv_get_hist(CAN_TRACE_HOP_RX_DECODE).count);
+}
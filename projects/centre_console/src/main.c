@@ -2,6 +2,9 @@
 
 #include "can.h"
 #include "can_board_ids.h"
+#include "can_diag.h"
+#include "can_time_sync.h"
+#include "can_trace.h"
 #include "cc_buttons.h"
 #include "cc_monitor.h"
 #include "delay.h"
@@ -70,9 +73,18 @@ void run_medium_cycle() {
   wait_tasks(1);
 
   update_drive_output();
+
+  // Centre console is the car's time master
+  can_time_sync_tx();
 }
 
-void run_slow_cycle() {}
+void run_slow_cycle() {
+#ifdef MS_CAN_TRACE_LOG
+  can_trace_log();
+#endif
+  can_diag_tx_master_cycles();
+  can_diag_tx_run_time_stats();
+}
 
 int main() {
   tasks_init();
@@ -89,6 +101,8 @@ int main() {
   };
   i2c_init(I2C_PORT_1, &i2c_settings);
   can_init(&s_can_storage, &can_settings);
+  can_time_sync_set_master(true);
+  can_trace_init(SYSTEM_CAN_MESSAGE_CENTRE_CONSOLE_CC_PEDAL);
 
   LOG_DEBUG("Welcome to TEST! \n");
 
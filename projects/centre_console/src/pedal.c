@@ -1,5 +1,6 @@
 #include "pedal.h"
 
+#include "can_trace.h"
 #include "centre_console_setters.h"
 
 static const GpioAddress brake = BRAKE_LIMIT_SWITCH;
@@ -34,6 +35,8 @@ void pedal_run() {
   uint32_t throttle_position = 0;
   gpio_get_state(&brake, &brake_state);
   prv_read_throttle_data(&throttle_position);
+  // Tag the command with its sample time to trace it through to the motor controllers
+  set_cc_pedal_sample_time(can_trace_tag());
 
   // Sending messages
   if (brake_state == GPIO_STATE_LOW) {
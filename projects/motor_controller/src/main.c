@@ -3,6 +3,8 @@
 #include "can.h"
 #include "can_board_ids.h"
 #include "can_codegen.h"
+#include "can_diag.h"
+#include "can_trace.h"
 #include "delay.h"
 #include "fsm.h"
 #include "gpio_it.h"
@@ -78,7 +80,13 @@ void run_medium_cycle() {
   wait_tasks(1);
 }
 
-void run_slow_cycle() {}
+void run_slow_cycle() {
+#ifdef MS_CAN_TRACE_LOG
+  can_trace_log();
+#endif
+  can_diag_tx_master_cycles();
+  can_diag_tx_run_time_stats();
+}
 
 int main() {
   tasks_init();
@@ -88,6 +96,7 @@ int main() {
   gpio_it_init();
 
   can_init(&s_can_storage, &can_settings);
+  can_trace_init(SYSTEM_CAN_MESSAGE_CENTRE_CONSOLE_CC_PEDAL);
 
   LOG_DEBUG("Motor Controller Task\n");
 
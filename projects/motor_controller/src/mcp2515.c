@@ -50,6 +50,7 @@ TASK(MCP2515_TX, TASK_STACK_256) {
 }
 
 StatusCode run_mcp2515_rx_cycle() {
+  tasks_expect_end(MCP2515_RX);
   StatusCode ret = notify(MCP2515_RX, 1);
   if (ret == pdFALSE) {
     return STATUS_CODE_INTERNAL_ERROR;
@@ -59,6 +60,7 @@ StatusCode run_mcp2515_rx_cycle() {
 }
 
 StatusCode run_mcp2515_tx_cycle() {
+  tasks_expect_end(MCP2515_TX);
   StatusCode ret = notify(MCP2515_TX, 1);
   if (ret == pdFALSE) {
     return STATUS_CODE_INTERNAL_ERROR;
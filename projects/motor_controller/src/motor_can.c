@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 
+#include "can_trace.h"
 #include "log.h"
 #include "mcp2515.h"
 #include "motor_controller_getters.h"
@@ -197,7 +198,9 @@ static void motor_controller_tx_all() {
   // LOG_DEBUG("s_target_current: %d\n", (int)(s_target_current * 100));
   // LOG_DEBUG("s_target_velocity: %d\n", (int)(s_target_velocity * 100));
 
-  mcp2515_transmit(&message);
+  if (mcp2515_transmit(&message) == STATUS_CODE_OK) {
+    can_trace_record(CAN_TRACE_HOP_MCP2515_TX, get_cc_pedal_sample_time());
+  }
 }
 
 static void motor_controller_rx_all() {
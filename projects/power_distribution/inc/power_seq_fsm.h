@@ -20,7 +20,7 @@ typedef struct BpsStorage {
   uint16_t fault_val;
 } BpsStorage;
 
-DECLARE_FSM(power_seq);
+DECLARE_SHARED_FSM(power_seq);
 typedef enum PowerSeqStateId {
   POWER_STATE_OFF = 0,
   POWER_STATE_PRECHARGE,
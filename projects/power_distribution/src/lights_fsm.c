@@ -19,7 +19,7 @@ GpioAddress LEFT_LIGHT_ADDR = { .port = GPIO_PORT_A, .pin = 15 };
 static SoftTimer s_timer_single;
 static EELightType light_id_callback;
 
-FSM(lights, NUM_LIGHTS_STATES, TASK_STACK_512);
+FSM_SHARED(lights, NUM_LIGHTS_STATES);
 static OutputState left_signal_state = OUTPUT_STATE_OFF;
 static OutputState right_signal_state = OUTPUT_STATE_OFF;
 static LightsStateId fsm_prev_state = INIT_STATE;
@@ -186,17 +186,17 @@ static FsmState s_PD_lights_list[NUM_LIGHTS_STATES] = {
   STATE(HAZARD, prv_hazard_input, prv_hazard_output)
 };
 
-static bool s_PD_transition_list[NUM_LIGHTS_STATES][NUM_LIGHTS_STATES] = {
-  TRANSITION(INIT_STATE, LEFT_SIGNAL),   TRANSITION(INIT_STATE, RIGHT_SIGNAL),
-  TRANSITION(INIT_STATE, HAZARD),        TRANSITION(LEFT_SIGNAL, INIT_STATE),
-  TRANSITION(LEFT_SIGNAL, HAZARD),       TRANSITION(LEFT_SIGNAL, RIGHT_SIGNAL),
-  TRANSITION(RIGHT_SIGNAL, INIT_STATE),  TRANSITION(RIGHT_SIGNAL, HAZARD),
-  TRANSITION(RIGHT_SIGNAL, LEFT_SIGNAL), TRANSITION(HAZARD, INIT_STATE),
-  TRANSITION(HAZARD, LEFT_SIGNAL),       TRANSITION(HAZARD, RIGHT_SIGNAL)
+static const FsmTransition s_PD_transition_list[] = {
+  FSM_TRANSITION(INIT_STATE, LEFT_SIGNAL),   FSM_TRANSITION(INIT_STATE, RIGHT_SIGNAL),
+  FSM_TRANSITION(INIT_STATE, HAZARD),        FSM_TRANSITION(LEFT_SIGNAL, INIT_STATE),
+  FSM_TRANSITION(LEFT_SIGNAL, HAZARD),       FSM_TRANSITION(LEFT_SIGNAL, RIGHT_SIGNAL),
+  FSM_TRANSITION(RIGHT_SIGNAL, INIT_STATE),  FSM_TRANSITION(RIGHT_SIGNAL, HAZARD),
+  FSM_TRANSITION(RIGHT_SIGNAL, LEFT_SIGNAL), FSM_TRANSITION(HAZARD, INIT_STATE),
+  FSM_TRANSITION(HAZARD, LEFT_SIGNAL),       FSM_TRANSITION(HAZARD, RIGHT_SIGNAL)
 };
 
 StatusCode init_lights(void) {
   soft_timer_init(SIGNAL_BLINK_PERIOD_MS, prv_lights_signal_blinker, &s_timer_single);
-  fsm_init(lights, s_PD_lights_list, s_PD_transition_list, INIT_STATE, NULL);
+  fsm_shared_init(lights, s_PD_lights_list, s_PD_transition_list, INIT_STATE, NULL);
   return STATUS_CODE_OK;
 }
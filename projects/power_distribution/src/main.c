@@ -3,12 +3,15 @@
 #include "bts_load_switch.h"
 #include "can.h"
 #include "can_board_ids.h"
+#include "fork_join.h"
+#include "fsm_executor.h"
 #include "gpio.h"
 #include "i2c.h"
 #include "interrupt.h"
 #include "lights_fsm.h"
 #include "log.h"
 #include "master_task.h"
+#include "misc.h"
 #include "output_current_sense.h"
 #include "pd_fault.h"
 #include "pin_defs.h"
@@ -30,29 +33,63 @@ I2CSettings i2c_settings = {
   .scl = PD_I2C_SCL,
 };
 
+static void prv_start_can_rx(void) {
+  run_can_rx_cycle();
+}
+
+static void prv_start_adc(void) {
+  adc_run();
+}
+
+// Power sequencing and lights share a task, stepped one after the other
+FSM_EXECUTOR(pd_fsms, TASK_STACK_512);
+
+static void prv_start_fsms(void) {
+  fsm_executor_run_cycle(pd_fsms_executor);
+}
+
+static void prv_start_can_tx(void) {
+  run_can_tx_cycle();
+}
+
+// The FSMs read CAN RX and ADC data, CAN TX sends their outputs
+static ForkJoinStage s_medium_stages[] = {
+  { .name = "can_rx", .start = prv_start_can_rx },
+  { .name = "adc", .start = prv_start_adc },
+  { .name = "fsms", .start = prv_start_fsms, .deps = FORK_JOIN_DEP(0) | FORK_JOIN_DEP(1) },
+  { .name = "can_tx", .start = prv_start_can_tx, .deps = FORK_JOIN_DEP(2) },
+};
+static ForkJoin s_medium_cycle;
+
 void pre_loop_init() {
   pca9555_gpio_init(I2C_PORT_1);
   pd_output_init();
   pd_sense_init();
   adc_init();
   pd_set_active_output_group(OUTPUT_GROUP_POWER_OFF);
+  fork_join_init(&s_medium_cycle, s_medium_stages, SIZEOF_ARRAY(s_medium_stages));
 }
 
 void run_fast_cycle() {}
 void run_medium_cycle() {
-  run_can_rx_cycle();
-  wait_tasks(1);
-
-  adc_run();
-  fsm_run_cycle(power_seq);
-  fsm_run_cycle(lights);
-  wait_tasks(2);
-
-  run_can_tx_cycle();
-  wait_tasks(1);
+  fork_join_run(&s_medium_cycle);
 }
 
-void run_slow_cycle() {}
+void run_slow_cycle() {
+#ifdef MS_FORK_JOIN_LOG
+  fork_join_log(&s_medium_cycle);
+#else
+  // Stage timings are only logged once a stage has gone over its time
+  static uint32_t s_logged_timeouts;
+  if (s_medium_cycle.timeouts != s_logged_timeouts) {
+    s_logged_timeouts = s_medium_cycle.timeouts;
+    fork_join_log(&s_medium_cycle);
+  }
+#endif
+#ifdef MS_FSM_EXECUTOR_LOG
+  fsm_executor_log_report(pd_fsms_executor);
+#endif
+}
 
 int main() {
   tasks_init();
@@ -63,6 +100,9 @@ int main() {
   i2c_init(I2C_PORT_1, &i2c_settings);
   init_power_seq();
   init_lights();
+  fsm_executor_init(pd_fsms);
+  fsm_executor_add(pd_fsms_executor, power_seq_fsm);
+  fsm_executor_add(pd_fsms_executor, lights_fsm);
   init_bps_fault();
 
   LOG_DEBUG("Welcome to PD!\n");
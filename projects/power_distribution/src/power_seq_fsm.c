@@ -16,7 +16,7 @@ static BpsStorage s_bps_storage;
     return;                                  \
   }
 
-FSM(power_seq, NUM_POWER_STATES, TASK_STACK_256);
+FSM_SHARED(power_seq, NUM_POWER_STATES);
 
 static PowerFsmContext power_context = { 0 };
 
@@ -115,14 +115,14 @@ static FsmState s_power_seq_state_list[NUM_POWER_STATES] = {
   STATE(POWER_STATE_FAULT, prv_fault_state_input, prv_fault_state_output),
 };
 
-static bool s_power_seq_transitions[NUM_POWER_STATES][NUM_POWER_STATES] = {
-  TRANSITION(POWER_STATE_OFF, POWER_STATE_FAULT),
-  TRANSITION(POWER_STATE_OFF, POWER_STATE_PRECHARGE),
-  TRANSITION(POWER_STATE_PRECHARGE, POWER_STATE_OFF),
-  TRANSITION(POWER_STATE_PRECHARGE, POWER_STATE_DRIVE),
-  TRANSITION(POWER_STATE_PRECHARGE, POWER_STATE_FAULT),
-  TRANSITION(POWER_STATE_DRIVE, POWER_STATE_OFF),
-  TRANSITION(POWER_STATE_DRIVE, POWER_STATE_FAULT)
+static const FsmTransition s_power_seq_transitions[] = {
+  FSM_TRANSITION(POWER_STATE_OFF, POWER_STATE_FAULT),
+  FSM_TRANSITION(POWER_STATE_OFF, POWER_STATE_PRECHARGE),
+  FSM_TRANSITION(POWER_STATE_PRECHARGE, POWER_STATE_OFF),
+  FSM_TRANSITION(POWER_STATE_PRECHARGE, POWER_STATE_DRIVE),
+  FSM_TRANSITION(POWER_STATE_PRECHARGE, POWER_STATE_FAULT),
+  FSM_TRANSITION(POWER_STATE_DRIVE, POWER_STATE_OFF),
+  FSM_TRANSITION(POWER_STATE_DRIVE, POWER_STATE_FAULT)
 };
 
 StatusCode init_power_seq(void) {
@@ -132,6 +132,7 @@ StatusCode init_power_seq(void) {
   if (s_bps_storage.fault_bitset) set_pd_status_bps_persist(s_bps_storage.fault_bitset);
   pd_sense_init();
 
-  fsm_init(power_seq, s_power_seq_state_list, s_power_seq_transitions, POWER_STATE_OFF, NULL);
+  fsm_shared_init(power_seq, s_power_seq_state_list, s_power_seq_transitions, POWER_STATE_OFF,
+                  NULL);
   return STATUS_CODE_OK;
 }
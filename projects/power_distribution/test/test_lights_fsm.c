@@ -15,97 +15,82 @@ void teardown_test(void) {}
 
 TEST_IN_TASK
 void test_pd_lights_fsm(void) {
-  Fsm *f = lights->context;
+  Fsm *f = lights_fsm;
 
   // In init state
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(INIT_STATE, f->curr_state);
 
   // Init State -> Hazard State
   HAZARD_SIGNAL_MSG = HAZARD_ON;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(HAZARD, f->curr_state);
 
   // Hazard State -> Init State
   HAZARD_SIGNAL_MSG = HAZARD_OFF;
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_OFF;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(INIT_STATE, f->curr_state);
 
   // Init State -> Left Signal
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_SIGNAL_LEFT;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(LEFT_SIGNAL, f->curr_state);
 
   // Left Signal ->Init State
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_OFF;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(INIT_STATE, f->curr_state);
 
   // Init State -> Right Signal
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_SIGNAL_RIGHT;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(RIGHT_SIGNAL, f->curr_state);
 
   // Right Signal -> Init State
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_OFF;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(INIT_STATE, f->curr_state);
 
   // Init State -> Left Signal
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_SIGNAL_LEFT;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(LEFT_SIGNAL, f->curr_state);
 
   // Left Signal -> Right Signal
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_SIGNAL_RIGHT;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(RIGHT_SIGNAL, f->curr_state);
 
   // Right Signal -> Left Signal
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_SIGNAL_LEFT;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(LEFT_SIGNAL, f->curr_state);
 
   // Left Signal -> Hazard State
   HAZARD_SIGNAL_MSG = HAZARD_ON;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(HAZARD, f->curr_state);
 
   // Hazard State -> Init State
   HAZARD_SIGNAL_MSG = HAZARD_OFF;
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_OFF;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(INIT_STATE, f->curr_state);
 
   // Init State -> Right Signal
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_SIGNAL_RIGHT;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(RIGHT_SIGNAL, f->curr_state);
 
   // Right Signal -> Hazard State
   HAZARD_SIGNAL_MSG = HAZARD_ON;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(HAZARD, f->curr_state);
 
   // Hazard State -> Init State
   HAZARD_SIGNAL_MSG = HAZARD_OFF;
   STEERING_ANALOG_SIGNAL_MSG = EE_LIGHT_TYPE_OFF;
-  fsm_run_cycle(lights);
-  wait_tasks(1);
+  fsm_step(lights_fsm);
   TEST_ASSERT_EQUAL(INIT_STATE, f->curr_state);
 }
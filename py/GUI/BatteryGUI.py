@@ -1,9 +1,16 @@
 # pylint: skip-file
-import tkinter as tk
-import can
-import cantools
+import argparse
 import subprocess
 import sys
+import threading
+import time
+import tkinter as tk
+from array import array
+from collections import deque
+
+import can
+
+from can_decoder.decoder import Decoder
 
 """
 For VCAN:
@@ -18,8 +25,29 @@ sudo modprobe vcan
 
 sudo ip link set can0 up type can bitrate 500000
 sudo ip link set can0 up
+
+Run from py/ with PYTHONPATH=. so the generated batch decoder (py/can_decoder) can be found.
+
+Frames are received and decoded on a background thread in batches. The Tk main loop only
+redraws from the latest values at RENDER_FPS, so a burst of AFE traffic can no longer
+starve the UI.
 """
 
+RENDER_FPS = 10
+# Frames are decoded once BATCH_SIZE arrive or BATCH_TIMEOUT_S passes, whichever is first
+BATCH_SIZE = 256
+BATCH_TIMEOUT_S = 0.02
+# Number of samples of history kept for every signal
+HISTORY_LEN = 1024
+
+AFE_MESSAGES = ["AFE1_status", "AFE2_status", "AFE3_status"]
+CURRENT_SENSE_MESSAGE = "battery_vt"
+DISPLAY_MESSAGES = AFE_MESSAGES + [CURRENT_SENSE_MESSAGE]
+NUM_AFE_TEMPS = 3
+NUM_AFE_CELLS = 12
+
+BorderThickness = 2
+
 
 def initialize(command):
     try:
@@ -41,431 +69,241 @@ commands = [
     "sudo ip link set can0 up",
 ]
 
-for command in commands:
-    output = initialize(command)
-    if output:
-        print(output)
-
-# change the file path to (can/tools/system_can.dbc)
-db = cantools.database.load_file("GUI/system_can.dbc")
-can_bus = can.interface.Bus(channel="can0", bustype="socketcan")
-root = tk.Tk()
-root.resizable(False, False)
-root.geometry("800x480")
-root.title("Dashboard")
-root.configure(background="black")
-BorderThickness = 2
 
-red = "#FF0000"
-orange = "#FF9900"
-yellow = "#FCFF77"
-listCount = 0
-
-AFE1Max = None
-AFE1Min = None
-
-AFE2Max = None
-AFE2Min = None
-
-AFE3Max = None
-AFE3Min = None
-
-CurrentBox = tk.Canvas(
-    root,
-    width=268,
-    height=65,
-    bg="#000000",
-    highlightbackground="white",
-    highlightthickness=BorderThickness,
-).place(x=265, y=0)
-tk.Label(
-    CurrentBox, text="CURRENT", font="Montserrat 20", bg="#000000", fg="white"
-).place(x=278, y=18)
-VoltBox = tk.Canvas(
-    root,
-    width=268,
-    height=65,
-    bg="#000000",
-    highlightbackground="white",
-    highlightthickness=BorderThickness,
-).place(x=533, y=0)
-tk.Label(VoltBox, text="VOLT.", font="Montserrat 20", bg="#000000", fg="white").place(
-    x=549, y=18
-)
-
-tk.Label(root, text="AFE1.", font="Montserrat 20", bg="#000000", fg="white").place(
-    x=5, y=57
-)
-tk.Label(root, text="AFE2.", font="Montserrat 20", bg="#000000", fg="white").place(
-    x=5, y=191
-)
-tk.Label(root, text="AFE3.", font="Montserrat 20", bg="#000000", fg="white").place(
-    x=5, y=326
-)
-
-for y in range(2):  # AFE1
-    for x in range(3):
-        Box = tk.Canvas(
-            root,
-            width=133,
-            height=51.5,
-            bg="#000000",
-            highlightbackground="white",
-            highlightthickness=BorderThickness,
-        ).place(x=133 * (x), y=88 + (51.5 * y))
-
-for y in range(3):
-    for x in range(4):
-        Box = tk.Canvas(
-            root,
-            width=93,
-            height=35,
-            bg="#000000",
-            highlightbackground="white",
-            highlightthickness=BorderThickness,
-        ).place(x=428 + 93 * (x), y=88 + (35 * y))
-
-for y in range(2):  # AFE2
-    for x in range(3):
-        Box = tk.Canvas(
-            root,
-            width=133,
-            height=51.5,
+class SignalStore:
+    """
+    Latest value and ring-buffered history of every displayed signal.
+    Written by the receiver thread, read by the render loop.
+    """
+
+    def __init__(self, history_len=HISTORY_LEN):
+        self.lock = threading.Lock()
+        self.history_len = history_len
+        self.latest = {}  # (message, signal) -> value
+        self.history = {}  # (message, signal) -> deque of (time, value)
+        # AFE_Data[afe] = {"Temp": [...], "Voltages": [...]}, the latest reading of each
+        self.afe_data = [
+            {"Temp": [None] * NUM_AFE_TEMPS, "Voltages": [None] * NUM_AFE_CELLS}
+            for _ in AFE_MESSAGES
+        ]
+        self.frames_received = 0
+        self.frames_decoded = 0
+        self.batches = 0
+        self.last_update = None
+        self.version = 0
+
+    def update(self, message, columns, recv_times):
+        """Append a decoded message's columns, called with the lock held"""
+        frames = columns["frame"]
+        for signal, values in columns.items():
+            if signal == "frame":
+                continue
+            key = (message, signal)
+            hist = self.history.get(key)
+            if hist is None:
+                hist = self.history[key] = deque(maxlen=self.history_len)
+            # Only the tail of a large batch can survive in the ring
+            start = max(0, len(values) - self.history_len)
+            hist.extend(zip((recv_times[frames[i]] for i in range(start, len(values))),
+                            values[start:]))
+            if len(values):
+                self.latest[key] = values[-1]
+
+        if message in AFE_MESSAGES:
+            afe = self.afe_data[AFE_MESSAGES.index(message)]
+            for row in range(len(frames)):
+                afe_id = columns["id"][row]
+                if afe_id < NUM_AFE_TEMPS:  # only need 3 temperatures
+                    afe["Temp"][afe_id] = columns["temp"][row]
+                if 3 * afe_id + 2 < NUM_AFE_CELLS:
+                    afe["Voltages"][3 * afe_id] = round(columns["v1"][row] / 10000, 2)
+                    afe["Voltages"][3 * afe_id + 1] = round(columns["v2"][row] / 10000, 2)
+                    afe["Voltages"][3 * afe_id + 2] = round(columns["v3"][row] / 10000, 2)
+
+
+class Receiver(threading.Thread):
+    """Receives frames in batches, decodes them and publishes them to a SignalStore"""
+
+    def __init__(self, bus, decoder, store):
+        super().__init__(daemon=True)
+        self.bus = bus
+        self.decoder = decoder
+        self.store = store
+        self.running = True
+
+    def run(self):
+        ids = array("I")
+        data = array("Q")
+        recv_times = []
+        while self.running:
+            deadline = time.monotonic() + BATCH_TIMEOUT_S
+            while len(ids) < BATCH_SIZE:
+                timeout = deadline - time.monotonic()
+                if timeout <= 0:
+                    break
+                msg = self.bus.recv(timeout)
+                if msg is None:
+                    break
+                ids.append(msg.arbitration_id)
+                data.append(int.from_bytes(bytes(msg.data).ljust(8, b"\0"), "little"))
+                recv_times.append(time.monotonic())
+            if not ids:
+                continue
+
+            decoded = self.decoder.decode(ids, data)
+            with self.store.lock:
+                self.store.frames_received += len(ids)
+                for message, columns in decoded.items():
+                    if len(columns["frame"]):
+                        self.store.frames_decoded += len(columns["frame"])
+                        if message in DISPLAY_MESSAGES:
+                            self.store.update(message, columns, recv_times)
+                self.store.batches += 1
+                self.store.last_update = recv_times[-1]
+                self.store.version += 1
+            ids = array("I")
+            data = array("Q")
+            recv_times = []
+
+
+class Dashboard:
+    """Tk widgets, created once and refreshed from the store at RENDER_FPS"""
+
+    def __init__(self, root, store):
+        self.root = root
+        self.store = store
+        self.rendered_version = -1
+        self.refresh_ms = 0.0
+        self.data_age_ms = 0.0
+        self.labels = {}
+        self._draw_layout()
+
+    def _box(self, width, height, x, y):
+        tk.Canvas(
+            self.root,
+            width=width,
+            height=height,
             bg="#000000",
             highlightbackground="white",
             highlightthickness=BorderThickness,
-        ).place(x=133 * (x), y=222 + (51.5 * y))
-
-for y in range(3):
-    for x in range(4):
-        Box = tk.Canvas(
-            root,
-            width=93,
-            height=35,
-            bg="#000000",
-            highlightbackground="white",
-            highlightthickness=BorderThickness,
-        ).place(x=428 + 93 * (x), y=222 + (35 * y))
-
-for y in range(2):  # AFE3
-    for x in range(3):
-        Box = tk.Canvas(
-            root,
-            width=133,
-            height=51.5,
-            bg="#000000",
-            highlightbackground="white",
-            highlightthickness=BorderThickness,
-        ).place(x=133 * (x), y=355 + (51.5 * y))
-
-for y in range(3):
-    for x in range(4):
-        Box = tk.Canvas(
-            root,
-            width=93,
-            height=35,
-            bg="#000000",
-            highlightbackground="white",
-            highlightthickness=BorderThickness,
-        ).place(x=428 + 93 * (x), y=355 + (35 * y))
-
-# AFE1-------------------------------
-
-
-def updateAFE1(box, num):
-    if box < 4:
-        tk.Label(
-            Box, text=num, font="Montserrat 20", width=6, bg="#000000", fg="white"
-        ).place(x=5 + 133 * (box - 1), y=107)
-    if box >= 4 and box < 7:
-        tk.Label(
-            Box, text=num, font="Montserrat 20", width=6, bg="#000000", fg="white"
-        ).place(x=5 + 133 * (box - 4), y=158.5)
-
-
-def update_AFE1_cells(box, num):
-    if box < 5:
-        tk.Label(
-            Box, text=num, font="Montserrat 18", width=5, bg="#000000", fg="white"
-        ).place(x=436 + 93 * (box - 1), y=90 + (35 * 0))
-    if box >= 5 and box < 9:
-        tk.Label(
-            Box, text=num, font="Montserrat 18", width=5, bg="#000000", fg="white"
-        ).place(x=436 + 93 * (box - 5), y=90 + (35 * 1))
-    if box >= 9 and box < 13:
-        tk.Label(
-            Box, text=num, font="Montserrat 18", width=5, bg="#000000", fg="white"
-        ).place(x=436 + 93 * (box - 9), y=90 + (35 * 2))
-
-
-# AFE2-------------------------------
-
-
-def updateAFE2(box, num):
-    if box < 4:
-        tk.Label(
-            Box, text=num, font="Montserrat 20", width=6, bg="#000000", fg="white"
-        ).place(x=4 + 133 * (box - 1), y=231)
-    if box >= 4 and box < 7:
-        tk.Label(
-            Box, text=num, font="Montserrat 20", width=6, bg="#000000", fg="white"
-        ).place(x=4 + 133 * (box - 4), y=282.5)
-
-
-def update_AFE2_cells(box, num):
-    if box < 5:
-        tk.Label(
-            Box, text=num, font="Montserrat 18", width=5, bg="#000000", fg="white"
-        ).place(x=436 + 93 * (box - 1), y=224 + (35 * 0))
-    if box >= 5 and box < 9:
-        tk.Label(
-            Box, text=num, font="Montserrat 18", width=5, bg="#000000", fg="white"
-        ).place(x=436 + 93 * (box - 5), y=224 + (35 * 1))
-    if box >= 9 and box < 13:
-        tk.Label(
-            Box, text=num, font="Montserrat 18", width=5, bg="#000000", fg="white"
-        ).place(x=436 + 93 * (box - 9), y=224 + (35 * 2))
-
-
-# AFE3-------------------------------
-
-
-def updateAFE3(box, num):
-    if box < 4:
-        tk.Label(
-            Box, text=num, font="Montserrat 20", width=6, bg="#000000", fg="white"
-        ).place(x=4 + 133 * (box - 1), y=364)
-    if box >= 4 and box < 7:
-        tk.Label(
-            Box, text=num, font="Montserrat 20", width=6, bg="#000000", fg="white"
-        ).place(x=4 + 133 * (box - 4), y=415.5)
-
-
-def update_AFE3_cells(box, num):
-    if box < 5:
-        tk.Label(
-            Box, text=num, font="Montserrat 18", width=5, bg="#000000", fg="white"
-        ).place(x=436 + 93 * (box - 1), y=357 + (35 * 0))
-    if box >= 5 and box < 9:
-        tk.Label(
-            Box, text=num, font="Montserrat 18", width=5, bg="#000000", fg="white"
-        ).place(x=436 + 93 * (box - 5), y=357 + (35 * 1))
-    if box >= 9 and box < 13:
-        tk.Label(
-            Box, text=num, font="Montserrat 18", width=5, bg="#000000", fg="white"
-        ).place(x=436 + 93 * (box - 9), y=357 + (35 * 2))
-
-
-DISPLAY_MSG_DICT_CURRENT_SENSE = {
-    db.get_message_by_name("battery_vt").frame_id}
-
-DISPLAY_MSG_AFES = [
-    db.get_message_by_name("AFE1_status").frame_id,
-    db.get_message_by_name("AFE2_status").frame_id,
-    db.get_message_by_name("AFE3_status").frame_id,
-]
-
-"""
-AFE1_status {id: 0, temp: 10, v1: 10, v2: 10, v3:10} temp1, v1, v2, v3
-AFE2_status {id: 0, temp: 10, v1: 10, v2: 10, v3:10}
-AFE3_status {id: 0, temp: 10, v1: 10, v2: 10, v3:10}
-AFE1_status {id: 1, temp: 10, v1: 10, v2: 10, v3:10} temp1, v4, v5, v6
-AFE2_status {id: 1, temp: 10, v1: 10, v2: 10, v3:10}
-AFE3_status {id: 1, temp: 10, v1: 10, v2: 10, v3:10}
-AFE1_status {id: 2, temp: 10, v1: 10, v2: 10, v3:10} temp1, v7, v8, v9
-AFE2_status {id: 2, temp: 10, v1: 10, v2: 10, v3:10}
-AFE3_status {id: 2, temp: 10, v1: 10, v2: 10, v3:10}
-AFE1_status {id: 3, temp: 10, v1: 10, v2: 10, v3:10} temp1, v10, v11, v12
-AFE2_status {id: 3, temp: 10, v1: 10, v2: 10, v3:10}
-AFE3_status {id: 3, temp: 10, v1: 10, v2: 10, v3:10}
-"""
-
-AFE_Data = [
-    {
-        "Temp": [None, None, None],
-        "Voltages": [
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-        ],
-    },
-    {
-        "Temp": [None, None, None],
-        "Voltages": [
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-        ],
-    },
-    {
-        "Temp": [None, None, None],
-        "Voltages": [
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-            None,
-        ],
-    },
-]
-
-
-def AFE1FullUpdate():
-    global AFE1Max, AFE1Min
-
-    if None not in AFE_Data[0]["Temp"]:
-        updateAFE1(1, (AFE_Data[0]["Temp"][0], "C"))
-        updateAFE1(2, (AFE_Data[0]["Temp"][1], "C"))
-        updateAFE1(3, (AFE_Data[0]["Temp"][2], "C"))
-        AFE_Data[0]["Temp"] = [None] * 3
-
-    if None not in AFE_Data[0]["Voltages"]:
-        for x in range(1, 13):
-            update_AFE1_cells(x, AFE_Data[0]["Voltages"][x - 1])
-
-        AFE1Max = max(AFE_Data[0]["Voltages"])
-        AFE1Min = min(AFE_Data[0]["Voltages"])
-        Unbalance = AFE1Max - AFE1Min
-
-        updateAFE1(4, AFE1Max)
-        updateAFE1(5, AFE1Min)
-        updateAFE1(6, Unbalance)
-
-        AFE_Data[0]["Voltages"] = [None] * 12
-
-
-def AFE2FullUpdate():
-    global AFE2Max, AFE2Min
-
-    if None not in AFE_Data[1]["Temp"]:
-        updateAFE2(1, (AFE_Data[1]["Temp"][0], "C"))
-        updateAFE2(2, (AFE_Data[1]["Temp"][1], "C"))
-        updateAFE2(3, (AFE_Data[1]["Temp"][2], "C"))
-        AFE_Data[1]["Temp"] = [None] * 3
-
-    if None not in AFE_Data[1]["Voltages"]:
-        for x in range(1, 13):
-            update_AFE2_cells(x, AFE_Data[1]["Voltages"][x - 1])
-
-        AFE2Max = max(AFE_Data[1]["Voltages"])
-        AFE2Min = min(AFE_Data[1]["Voltages"])
-        Unbalance = AFE2Max - AFE2Min
-
-        updateAFE2(4, AFE2Max)
-        updateAFE2(5, AFE2Min)
-        updateAFE2(6, Unbalance)
-
-        AFE_Data[1]["Voltages"] = [None] * 12
-
-
-def AFE3FullUpdate():
-    global AFE3Max, AFE3Min
-
-    if None not in AFE_Data[2]["Temp"]:
-        updateAFE3(1, (AFE_Data[2]["Temp"][0], "C"))
-        updateAFE3(2, (AFE_Data[2]["Temp"][1], "C"))
-        updateAFE3(3, (AFE_Data[2]["Temp"][2], "C"))
-        AFE_Data[2]["Temp"] = [None] * 3
-
-    if None not in AFE_Data[2]["Voltages"]:
-        for x in range(1, 13):
-            update_AFE3_cells(x, AFE_Data[2]["Voltages"][x - 1])
-
-        AFE3Max = max(AFE_Data[2]["Voltages"])
-        AFE3Min = min(AFE_Data[2]["Voltages"])
-        Unbalance = AFE3Max - AFE3Min
-
-        updateAFE3(4, AFE3Max)
-        updateAFE3(5, AFE3Min)
-        updateAFE3(6, Unbalance)
-
-        AFE_Data[2]["Voltages"] = [None] * 12
-
-
-def handle_message(msg):
-    global AFE1Max, AFE1Min, AFE2Max, AFE2Min, AFE3Max, AFE3Min
-
-    try:
-        decoded_message = db.decode_message(msg.arbitration_id, msg.data)
-        if msg.arbitration_id in DISPLAY_MSG_AFES:
-            afe_index = DISPLAY_MSG_AFES.index(
-                msg.arbitration_id
-            )  # Figures out which AFE
-            if decoded_message["id"] < 3:  # only need 3 temperatures
-                # which AFE, temp/voltage, index in that array
-                AFE_Data[afe_index]["Temp"][decoded_message["id"]] = decoded_message[
-                    "temp"
-                ]
-            AFE_Data[afe_index]["Voltages"][3 * decoded_message["id"]] = round(
-                decoded_message["v1"] / 10000, 2
-            )
-            AFE_Data[afe_index]["Voltages"][3 * decoded_message["id"] + 1] = round(
-                decoded_message["v2"] / 10000, 2
-            )
-            AFE_Data[afe_index]["Voltages"][3 * decoded_message["id"] + 2] = round(
-                decoded_message["v3"] / 10000, 2
-            )
-            AFE1FullUpdate()
-            AFE2FullUpdate()
-            AFE3FullUpdate()
-
-        if msg.arbitration_id in DISPLAY_MSG_DICT_CURRENT_SENSE:
-            tk.Label(
-                Box,
-                text=((decoded_message["current"] / 1000), "A"),
-                font="Montserrat 16",
-                width=6,
-                bg="#000000",
-                fg="white",
-            ).place(x=438, y=18)
-            print(decoded_message["current"])
-            tk.Label(
-                Box,
-                text=((decoded_message["voltage"] / 1000), "V"),
-                font="Montserrat 16",
-                width=6,
-                bg="#000000",
-                fg="white",
-            ).place(x=709, y=18)
-            print(decoded_message["voltage"])
-
-    except KeyError:
-        print("Unknown message:", msg)
-
-
-# update_displays()
+        ).place(x=x, y=y)
+
+    def _label(self, key, x, y, font, width):
+        label = tk.Label(self.root, text="", font=font, width=width, bg="#000000", fg="white")
+        label.place(x=x, y=y)
+        self.labels[key] = label
+
+    def _draw_layout(self):
+        self._box(268, 65, 265, 0)
+        tk.Label(self.root, text="CURRENT", font="Montserrat 20", bg="#000000",
+                 fg="white").place(x=278, y=18)
+        self._box(268, 65, 533, 0)
+        tk.Label(self.root, text="VOLT.", font="Montserrat 20", bg="#000000",
+                 fg="white").place(x=549, y=18)
+        self._label("current", 438, 18, "Montserrat 16", 6)
+        self._label("voltage", 709, 18, "Montserrat 16", 6)
+
+        # (title y, summary box y, summary label x, summary label y, cell label y) per AFE
+        afe_layout = [(57, 88, 5, 107, 90), (191, 222, 4, 231, 224), (326, 355, 4, 364, 357)]
+        for afe, (title_y, box_y, label_x, label_y, cell_y) in enumerate(afe_layout):
+            tk.Label(self.root, text=f"AFE{afe + 1}.", font="Montserrat 20", bg="#000000",
+                     fg="white").place(x=5, y=title_y)
+            for y in range(2):
+                for x in range(3):
+                    self._box(133, 51.5, 133 * x, box_y + 51.5 * y)
+            for y in range(3):
+                for x in range(4):
+                    self._box(93, 35, 428 + 93 * x, box_y + 35 * y)
+
+            # Boxes 1-3 are temperatures, 4-6 are max, min and unbalance
+            for box in range(6):
+                self._label((afe, "summary", box), label_x + 133 * (box % 3),
+                            label_y + 51.5 * (box // 3), "Montserrat 20", 6)
+            for cell in range(NUM_AFE_CELLS):
+                self._label((afe, "cell", cell), 436 + 93 * (cell % 4),
+                            cell_y + 35 * (cell // 4), "Montserrat 18", 5)
+
+        self.stats = tk.Label(self.root, text="", font="Montserrat 9", bg="#000000", fg="grey")
+        self.stats.place(x=5, y=460)
+
+    def _set(self, key, text):
+        label = self.labels[key]
+        if label.cget("text") != text:
+            label.config(text=text)
+
+    def _render_afe(self, afe, data):
+        for i, temp in enumerate(data["Temp"]):
+            if temp is not None:
+                self._set((afe, "summary", i), f"{temp} C")
+        for cell, voltage in enumerate(data["Voltages"]):
+            if voltage is not None:
+                self._set((afe, "cell", cell), voltage)
+        voltages = [v for v in data["Voltages"] if v is not None]
+        if voltages:
+            self._set((afe, "summary", 3), max(voltages))
+            self._set((afe, "summary", 4), min(voltages))
+            self._set((afe, "summary", 5), round(max(voltages) - min(voltages), 2))
+
+    def render(self):
+        start = time.monotonic()
+        with self.store.lock:
+            changed = self.store.version != self.rendered_version
+            if changed:
+                self.rendered_version = self.store.version
+                afe_data = [{"Temp": list(d["Temp"]), "Voltages": list(d["Voltages"])}
+                            for d in self.store.afe_data]
+                current = self.store.latest.get((CURRENT_SENSE_MESSAGE, "current"))
+                voltage = self.store.latest.get((CURRENT_SENSE_MESSAGE, "voltage"))
+                last_update = self.store.last_update
+            received = self.store.frames_received
+            decoded = self.store.frames_decoded
+
+        if changed:
+            for afe, data in enumerate(afe_data):
+                self._render_afe(afe, data)
+            if current is not None:
+                self._set("current", f"{current / 1000} A")
+            if voltage is not None:
+                self._set("voltage", f"{voltage / 1000} V")
+            self.root.update_idletasks()
+            now = time.monotonic()
+            self.refresh_ms = (now - start) * 1000
+            # Time from the newest frame being received to it being on screen
+            self.data_age_ms = (now - last_update) * 1000
+
+        self.stats.config(
+            text=f"rx {received}  decoded {decoded}  "
+                 f"refresh {self.refresh_ms:.1f} ms  latency {self.data_age_ms:.1f} ms")
+        self.root.after(max(1, int(1000 / RENDER_FPS - (time.monotonic() - start) * 1000)),
+                        self.render)
 
 
 def main():
-    notifier = can.Notifier(can_bus, [handle_message])
-
-    while True:
-        root.mainloop()
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--channel", default="can0")
+    args = parser.parse_args()
+
+    if not args.channel.startswith("vcan"):
+        for command in commands:
+            output = initialize(command)
+            if output:
+                print(output)
+
+    can_bus = can.interface.Bus(channel=args.channel, interface="socketcan")
+    store = SignalStore()
+    receiver = Receiver(can_bus, Decoder(), store)
+
+    root = tk.Tk()
+    root.resizable(False, False)
+    root.geometry("800x480")
+    root.title("Dashboard")
+    root.configure(background="black")
+    dashboard = Dashboard(root, store)
+
+    receiver.start()
+    dashboard.render()
+    root.mainloop()
+    receiver.running = False
 
 
 if __name__ == "__main__":
@@ -0,0 +1,141 @@
+'''
+Batch CAN decoder backed by the generated C library (libraries/codegen/templates/can_decoder.*)
+'''
+import ctypes
+import subprocess
+import sys
+from array import array
+from pathlib import Path
+
+ROOT = Path(__file__).resolve().parents[2]
+GENERATOR = ROOT / "libraries" / "codegen" / "generator.py"
+TEMPLATES_DIR = ROOT / "libraries" / "codegen" / "templates"
+BUILD_DIR = ROOT / "build" / "can_decoder"
+TEMPLATES = ["can_decoder.h.jinja", "can_decoder.c.jinja"]
+
+# array typecodes for each column element size in bytes
+COLUMN_TYPECODES = {1: "B", 2: "H", 4: "I", 8: "Q"}
+
+
+class CanDecoderSignal(ctypes.Structure):
+    '''mirror of CanDecoderSignal in can_decoder.h'''
+    _fields_ = [("name", ctypes.c_char_p),
+                ("start_bit", ctypes.c_uint8),
+                ("length", ctypes.c_uint8),
+                ("column_size", ctypes.c_uint8)]
+
+
+class CanDecoderMessage(ctypes.Structure):
+    '''mirror of CanDecoderMessage in can_decoder.h'''
+    _fields_ = [("id", ctypes.c_uint32),
+                ("name", ctypes.c_char_p),
+                ("sender", ctypes.c_char_p),
+                ("num_signals", ctypes.c_uint8),
+                ("column_offset", ctypes.c_uint16),
+                ("signals", ctypes.POINTER(CanDecoderSignal))]
+
+
+def _sources():
+    return [GENERATOR] + list((ROOT / "libraries" / "codegen" / "boards").glob("*.yaml")) + \
+        [TEMPLATES_DIR / t for t in TEMPLATES]
+
+
+def build(build_dir=BUILD_DIR):
+    '''generate and compile the decoder library if any of its inputs changed, returns its path'''
+    build_dir.mkdir(parents=True, exist_ok=True)
+    lib = build_dir / "libcan_decoder.so"
+    if lib.exists() and lib.stat().st_mtime >= max(s.stat().st_mtime for s in _sources()):
+        return lib
+
+    subprocess.run([sys.executable, str(GENERATOR), "-f", str(build_dir), "-t"] + TEMPLATES,
+                   check=True)
+    subprocess.run(["gcc", "-O2", "-shared", "-fPIC", "-std=gnu11", "-Wall", "-Werror",
+                    "-o", str(lib), str(build_dir / "can_decoder.c")], check=True)
+    return lib
+
+
+class Message:
+    '''name, id and signal layout of one message'''
+
+    def __init__(self, index, msg):
+        self.index = index
+        self.id = msg.id
+        self.name = msg.name.decode()
+        self.sender = msg.sender.decode()
+        self.column_offset = msg.column_offset
+        self.signals = [(msg.signals[i].name.decode(), msg.signals[i].start_bit,
+                         msg.signals[i].length, msg.signals[i].column_size)
+                        for i in range(msg.num_signals)]
+
+
+class Decoder:
+    '''
+    Decodes batches of raw frames into columns.
+    decode() returns {message name: {"frame": frame indices, <signal>: values, ...}}
+    where every column is an array.array of the same length.
+    '''
+
+    def __init__(self, lib_path=None):
+        self._lib = ctypes.CDLL(str(lib_path or build()))
+        self._lib.can_decoder_count.restype = None
+        self._lib.can_decoder_decode.restype = ctypes.c_size_t
+        self._lib.can_decoder_parse_candump.restype = ctypes.c_size_t
+        self._lib.can_decoder_parse_candump.argtypes = [
+            ctypes.c_char_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+            ctypes.c_size_t]
+
+        num_messages = ctypes.c_uint32.in_dll(self._lib, "g_can_decoder_num_messages").value
+        table = (CanDecoderMessage * num_messages).in_dll(self._lib, "g_can_decoder_messages")
+        messages = [Message(i, table[i]) for i in range(num_messages)]
+        self.messages = messages
+        self.num_signals = ctypes.c_uint32.in_dll(self._lib, "g_can_decoder_num_signals").value
+        self.by_id = {m.id: m for m in messages}
+        self.by_name = {m.name: m for m in messages}
+
+    @staticmethod
+    def _ptr(arr):
+        return arr.buffer_info()[0]
+
+    def decode(self, ids, data):
+        '''decode frames given as array('I') ids and array('Q') little-endian payloads'''
+        num_frames = len(ids)
+        counts = (ctypes.c_uint32 * len(self.messages))()
+        self._lib.can_decoder_count(ctypes.c_void_p(self._ptr(ids)), ctypes.c_size_t(num_frames),
+                                    counts)
+
+        result = {}
+        columns = (ctypes.c_void_p * max(self.num_signals, 1))()
+        frame_index = (ctypes.c_void_p * len(self.messages))()
+        for msg in self.messages:
+            n = counts[msg.index]
+            table = {"frame": array("I", bytes(4 * n))}
+            frame_index[msg.index] = self._ptr(table["frame"]) if n else None
+            for i, (name, _, _, size) in enumerate(msg.signals):
+                column = array(COLUMN_TYPECODES[size], bytes(size * n))
+                columns[msg.column_offset + i] = self._ptr(column) if n else None
+                table[name] = column
+            result[msg.name] = table
+
+        rows = (ctypes.c_uint32 * len(self.messages))()
+        self._lib.can_decoder_decode(ctypes.c_void_p(self._ptr(ids)),
+                                     ctypes.c_void_p(self._ptr(data)),
+                                     ctypes.c_size_t(num_frames), columns, frame_index, rows)
+        return result
+
+    def parse_candump(self, text):
+        '''parse candump -L formatted bytes into (timestamps, ids, data) arrays'''
+        max_frames = text.count(b"\n") + 1
+        timestamps = array("d", bytes(8 * max_frames))
+        ids = array("I", bytes(4 * max_frames))
+        data = array("Q", bytes(8 * max_frames))
+        n = self._lib.can_decoder_parse_candump(text, len(text), self._ptr(timestamps),
+                                                self._ptr(ids), self._ptr(data), max_frames)
+        return timestamps[:n], ids[:n], data[:n]
+
+    def decode_candump(self, text):
+        '''parse and decode a candump -L log, adding a "timestamp" column to each message'''
+        timestamps, ids, data = self.parse_candump(text)
+        result = self.decode(ids, data)
+        for table in result.values():
+            table["timestamp"] = array("d", (timestamps[i] for i in table["frame"]))
+        return result
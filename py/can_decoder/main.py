@@ -0,0 +1,114 @@
+'''
+Benchmarks the generated batch decoder against per-frame decoding.
+Frames are random payloads for every message in the generated system_can.dbc. The baseline is
+cantools decoding that dbc when it is installed, and a per-frame pure python decoder otherwise.
+The decoded values are only checked against cantools: the python decoder reads the same signal
+table as the generated one, so agreeing with it proves nothing.
+'''
+import argparse
+import random
+import subprocess
+import sys
+import time
+from array import array
+
+from can_decoder.decoder import Decoder, BUILD_DIR, GENERATOR
+
+
+def make_frames(decoder, num_frames, seed=0):
+    '''random frames for known messages, returned as (ids, data) arrays'''
+    rng = random.Random(seed)
+    ids = array("I", (rng.choice(decoder.messages).id for _ in range(num_frames)))
+    data = array("Q", (rng.getrandbits(64) for _ in range(num_frames)))
+    return ids, data
+
+
+def python_decode(decoder, ids, data):
+    '''reference per-frame decoder, one dict per frame like cantools returns'''
+    decoded = []
+    for can_id, payload in zip(ids, data):
+        msg = decoder.by_id.get(can_id)
+        if msg is None:
+            continue
+        decoded.append((msg.name, {name: (payload >> start) & ((1 << length) - 1)
+                                   for name, start, length, _ in msg.signals}))
+    return decoded
+
+
+def load_cantools():
+    '''cantools database for the generated dbc, or None when cantools is unavailable'''
+    try:
+        import cantools  # pylint: disable=import-outside-toplevel
+    except ImportError:
+        return None
+    BUILD_DIR.mkdir(parents=True, exist_ok=True)
+    subprocess.run([sys.executable, str(GENERATOR), "-f", str(BUILD_DIR),
+                    "-t", "system_can.dbc.jinja"], check=True)
+    return cantools.database.load_file(str(BUILD_DIR / "system_can.dbc"), strict=False)
+
+
+def cantools_decode(db, ids, data):
+    '''per-frame cantools decoding'''
+    decoded = []
+    for can_id, payload in zip(ids, data):
+        try:
+            msg = db.get_message_by_frame_id(can_id)
+        except KeyError:
+            continue
+        decoded.append((msg.name, msg.decode(payload.to_bytes(8, "little")[:msg.length],
+                                             decode_choices=False, scaling=False)))
+    return decoded
+
+
+def check(columns, reference):
+    '''verify the columns hold exactly the rows of the per-frame reference'''
+    rows = {name: 0 for name in columns}
+    for name, signals in reference:
+        row = rows[name]
+        for signal, value in signals.items():
+            if columns[name][signal][row] != value:
+                raise Exception(f"Mismatch in {name}.{signal} row {row}")
+        rows[name] += 1
+    if any(len(table["frame"]) != rows[name] for name, table in columns.items()):
+        raise Exception("Row count mismatch")
+
+
+def bench(func, *args):
+    '''run func once and return (result, seconds)'''
+    start = time.perf_counter()
+    result = func(*args)
+    return result, time.perf_counter() - start
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-n", "--frames", type=int, default=500000)
+    args = parser.parse_args()
+
+    decoder = Decoder()
+    ids, data = make_frames(decoder, args.frames)
+    print(f"{len(decoder.messages)} messages, {decoder.num_signals} signals, {len(ids)} frames")
+
+    columns, batch_time = bench(decoder.decode, ids, data)
+    print(f"batch (C):      {batch_time * 1e3:9.1f} ms  {len(ids) / batch_time / 1e6:8.2f} Mframe/s")
+
+    db = load_cantools()
+    if db is not None:
+        reference, ref_time = bench(cantools_decode, db, ids, data)
+        label = "cantools"
+    else:
+        reference, ref_time = bench(python_decode, decoder, ids, data)
+        label = "python"
+    print(f"{label + ':':15} {ref_time * 1e3:9.1f} ms  {len(ids) / ref_time / 1e6:8.2f} Mframe/s")
+    print(f"speedup: {ref_time / batch_time:.1f}x")
+
+    if db is None:
+        print("cantools is not installed, skipped checking the decoded values "
+              "(pip install cantools to check them)")
+        return
+    check(columns, reference)
+    print("decoded values match cantools")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,376 @@
+'''
+Runs several x86 boards together on one virtual clock and one virtual CAN bus.
+
+Every board is started under this controller (see libraries/x86/inc/x86_cosim.h), which advances
+all of their clocks in lockstep: each step, every board runs until all of its tasks are blocked
+at the step's tick, then reports the frames it sent. Those frames then arbitrate for the bus by
+ID, as many as fit in the step's bits at the bitrate, and the winners are delivered to every other
+board at the start of the next step. Frames that lose wait for the next step, and the time they
+spend waiting is reported as CAN latency. Boards must be built with --define=MS_VIRTUAL_TIME.
+
+  scons --platform=x86 --define=MS_VIRTUAL_TIME
+  python3 py/cosim/main.py bms_carrier power_distribution
+
+Commands: start, pause, step [ticks], report, quit. With --run-ms the boards run for that long,
+the report is printed and the controller exits. py/scenario drives the boards' inputs on top of
+this.
+'''
+import argparse
+import os
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from pathlib import Path
+
+ROOT = Path(__file__).resolve().parents[2]
+
+# Must match x86_cosim.h
+MSG_HELLO, MSG_DONE, MSG_STEP = b"H"[0], b"D"[0], b"S"[0]
+HELLO = struct.Struct("<B3x32s")
+DONE = struct.Struct("<BBBxIQII")
+STEP = struct.Struct("<BBBxI")
+COUNTER = struct.Struct("<16sI")
+FRAME = struct.Struct("<IBB2xQ")
+INPUT = struct.Struct("<BBBBI24s")
+MAX_FRAMES = 64
+MAX_INPUTS = 32
+INPUT_DATA_LEN = 24
+INPUT_ADC, INPUT_GPIO, INPUT_I2C, INPUT_SPI = range(4)
+MAX_MSG_SIZE = 4096
+
+# Bits on the wire per frame before stuffing, including the 3 bit interframe space
+STD_FRAME_BITS = 47
+EXT_FRAME_BITS = 67
+# Window the peak bus load is measured over
+LOAD_WINDOW_MS = 100
+SLOW_BOARD_S = 5
+
+
+def frame_bits(extended, dlc):
+    return (EXT_FRAME_BITS if extended else STD_FRAME_BITS) + 8 * dlc
+
+
+def pack_frame(can_id, data, extended=False):
+    '''data is the payload bytes, at most 8'''
+    return FRAME.pack(can_id, extended, len(data), int.from_bytes(bytes(data).ljust(8, b"\0"),
+                                                                  "little"))
+
+
+class BusFrame:
+    '''a frame waiting for the bus'''
+
+    def __init__(self, frame, sender, tick):
+        self.frame = frame
+        self.sender = sender
+        self.tick = tick
+        self.id, extended, dlc, self.data = FRAME.unpack(frame)
+        self.extended = bool(extended)
+        self.dlc = dlc
+        self.bits = frame_bits(extended, dlc)
+        # Lower wins: the 11 bit base ID is sent first and a standard frame beats an extended one
+        # with the same base ID
+        self.priority = ((self.id >> 18) if extended else self.id, extended, self.id)
+
+
+class Board:
+    '''one board process and its statistics'''
+
+    def __init__(self, name, path, log_dir, socket_path):
+        self.name = name
+        log = open(log_dir / f"{name}.log", "w")
+        # Each board gets its own flash file so persisted data isn't shared
+        env = dict(os.environ, MIDSUN_COSIM_SOCKET=socket_path, MIDSUN_COSIM_NAME=name,
+                   MIDSUN_X86_FLASH_FILE=str(log_dir / f"{name}.flash"))
+        self.proc = subprocess.Popen([str(path)], env=env, stdout=log, stderr=subprocess.STDOUT)
+        self.conn = None
+        self.exited = False
+        self.tick = 0
+        self.cpu_ns = 0
+        self.start_cpu_ns = None
+        self.max_step_cpu_ns = 0
+        self.counters = {}
+        self.tx_frames = 0
+        self.tx_dropped = 0
+        # Frames from the other boards and inputs, delivered with the next step
+        self.rx_pending = []
+        self.inputs_pending = []
+
+    def add_input(self, kind, port, pin=0, value=0, data=b""):
+        '''queues a peripheral input, see x86CosimInput'''
+        if len(data) > INPUT_DATA_LEN:
+            raise ValueError(f"at most {INPUT_DATA_LEN} bytes per input")
+        self.inputs_pending.append(INPUT.pack(kind, port, pin, len(data), value, bytes(data)))
+
+    def send_step(self, target):
+        frames, self.rx_pending = self.rx_pending[:MAX_FRAMES], self.rx_pending[MAX_FRAMES:]
+        inputs = self.inputs_pending[:MAX_INPUTS]
+        self.inputs_pending = self.inputs_pending[MAX_INPUTS:]
+        msg = STEP.pack(MSG_STEP, len(frames), len(inputs), target) + b"".join(inputs) + \
+            b"".join(frames)
+        self.conn.send(msg)
+
+    def receive_done(self):
+        '''returns the frames sent during the step, or None once the board has exited'''
+        warned = False
+        while True:
+            try:
+                msg = self.conn.recv(MAX_MSG_SIZE)
+                break
+            except socket.timeout:
+                if not warned:
+                    print(f"{self.name} has not gone idle in {SLOW_BOARD_S} s, is a task "
+                          "busy-waiting on the tick?")
+                    warned = True
+        if not msg:
+            self.exited = True
+            print(f"{self.name} exited with {self.proc.wait()}")
+            return None
+
+        _, num_counters, num_frames, tick, cpu_ns, tx_dropped, _ = DONE.unpack_from(msg)
+        offset = DONE.size
+        for _ in range(num_counters):
+            name, value = COUNTER.unpack_from(msg, offset)
+            self.counters[name.rstrip(b"\0").decode()] = value
+            offset += COUNTER.size
+        frames = [msg[offset + i * FRAME.size:offset + (i + 1) * FRAME.size]
+                  for i in range(num_frames)]
+
+        if self.start_cpu_ns is None:
+            self.start_cpu_ns = cpu_ns
+        else:
+            self.max_step_cpu_ns = max(self.max_step_cpu_ns, cpu_ns - self.cpu_ns)
+        self.tick = tick
+        self.cpu_ns = cpu_ns
+        self.tx_frames += num_frames
+        self.tx_dropped = tx_dropped
+        return frames
+
+
+class Cosim:
+    '''steps every board together, one quantum of ticks at a time'''
+
+    def __init__(self, paths, log_dir, quantum, tick_ms, bitrate):
+        self.quantum = quantum
+        self.tick_ms = tick_ms
+        self.bitrate = bitrate
+        self.tick = 0
+        self.bus_frames = 0
+        self.bus_bits = 0
+        self.window_bits = 0
+        self.window_start = 0
+        self.peak_load = 0.0
+        self.host_s = 0.0
+        # Frames waiting for the bus and the bits the bus has left this step
+        self.bus_queue = []
+        self.bus_credit = 0.0
+        self.latencies_ms = []
+        self.max_latency_ms = 0.0
+        self.max_latency_id = None
+        # Called with (tick, sender name or None, BusFrame) for every frame that wins the bus
+        self.frame_listeners = []
+        self.lock = threading.Lock()
+        self.running = threading.Event()
+
+        self.tmp_dir = tempfile.TemporaryDirectory()
+        socket_path = os.path.join(self.tmp_dir.name, "cosim.sock")
+        self.server = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+        self.server.bind(socket_path)
+        self.server.listen(len(paths))
+
+        log_dir.mkdir(parents=True, exist_ok=True)
+        self.boards = []
+        for path in paths:
+            name = path.name
+            count = sum(b.name.split("#")[0] == name for b in self.boards)
+            self.boards.append(Board(f"{name}#{count}" if count else name, path, log_dir,
+                                     socket_path))
+
+        by_name = {b.name: b for b in self.boards}
+        for _ in self.boards:
+            conn, _ = self.server.accept()
+            _, name = HELLO.unpack(conn.recv(MAX_MSG_SIZE))
+            board = by_name[name.rstrip(b"\0").decode()]
+            conn.settimeout(SLOW_BOARD_S)
+            board.conn = conn
+        # Each board reports once its start up code has finished at tick 0
+        self._collect(0)
+
+    def _collect(self, tick):
+        for board in self.live_boards():
+            frames = board.receive_done()
+            if frames:
+                self.bus_queue += [BusFrame(frame, board, tick) for frame in frames]
+
+    def _arbitrate(self, tick, ticks):
+        '''sends the highest priority frames that fit in the last ticks'''
+        self.bus_credit += self.bitrate * ticks * self.tick_ms / 1000
+        self.bus_queue.sort(key=lambda f: f.priority)
+        sent = 0
+        while sent < len(self.bus_queue) and self.bus_queue[sent].bits <= self.bus_credit:
+            frame = self.bus_queue[sent]
+            sent += 1
+            self.bus_credit -= frame.bits
+            self.bus_frames += 1
+            self.bus_bits += frame.bits
+            self.window_bits += frame.bits
+
+            if frame.sender is not None:
+                latency = (tick - frame.tick) * self.tick_ms + 1000 * frame.bits / self.bitrate
+                if latency > self.max_latency_ms:
+                    self.max_latency_ms = latency
+                    self.max_latency_id = frame.id
+                self.latencies_ms.append(latency)
+            for other in self.live_boards():
+                if other is not frame.sender:
+                    other.rx_pending.append(frame.frame)
+            for listener in self.frame_listeners:
+                listener(tick, frame.sender.name if frame.sender else None, frame)
+        del self.bus_queue[:sent]
+        if not self.bus_queue:
+            # An idle bus doesn't save up bits
+            self.bus_credit = 0.0
+
+    def inject(self, frame):
+        '''puts a frame on the bus from outside the boards, e.g. a node that isn't simulated'''
+        self.bus_queue.append(BusFrame(frame, None, self.tick))
+
+    def live_boards(self):
+        return [b for b in self.boards if not b.exited]
+
+    def step(self, ticks, before_step=None):
+        '''before_step is called with the tick at the start of every quantum'''
+        with self.lock:
+            start_s = time.monotonic()
+            end = self.tick + ticks
+            while self.tick < end and self.live_boards():
+                if before_step is not None:
+                    before_step(self.tick)
+                target = min(self.tick + self.quantum, end)
+                for board in self.live_boards():
+                    board.send_step(target)
+                self._collect(target)
+                self._arbitrate(target, target - self.tick)
+                self.tick = target
+
+                window_ticks = self.tick - self.window_start
+                if window_ticks * self.tick_ms >= LOAD_WINDOW_MS:
+                    load = self.window_bits / (self.bitrate * window_ticks * self.tick_ms / 1000)
+                    self.peak_load = max(self.peak_load, load)
+                    self.window_bits = 0
+                    self.window_start = self.tick
+            self.host_s += time.monotonic() - start_s
+
+    def _run(self):
+        while self.running.is_set() and self.live_boards():
+            self.step(self.quantum)
+
+    def start(self):
+        if not self.running.is_set():
+            self.running.set()
+            threading.Thread(target=self._run, daemon=True).start()
+
+    def pause(self):
+        self.running.clear()
+        # Waits for the step in progress
+        with self.lock:
+            pass
+
+    def report(self):
+        sim_ms = self.tick * self.tick_ms
+        speed = sim_ms / 1000 / self.host_s if self.host_s else 0
+        print(f"{sim_ms} ms simulated in {self.host_s:.2f} s ({speed:.1f}x real time)")
+        print(f"{'board':<24}{'cpu ms':>10}{'cpu %':>8}{'max step us':>13}{'tx frames':>11}"
+              f"{'dropped':>9}  counters")
+        for board in self.boards:
+            cpu_ms = (board.cpu_ns - (board.start_cpu_ns or 0)) / 1e6
+            cpu_pct = 100 * cpu_ms / sim_ms if sim_ms else 0
+            counters = ", ".join(f"{k} {v}" for k, v in board.counters.items())
+            name = board.name + (" (exited)" if board.exited else "")
+            print(f"{name:<24}{cpu_ms:>10.1f}{cpu_pct:>8.1f}{board.max_step_cpu_ns / 1000:>13.0f}"
+                  f"{board.tx_frames:>11}{board.tx_dropped:>9}  {counters}")
+        load = self.bus_bits / (self.bitrate * sim_ms / 1000) if sim_ms else 0
+        print(f"bus: {self.bus_frames} frames, {self.bus_bits} bits, load {100 * load:.1f} % "
+              f"(peak {100 * self.peak_load:.1f} % over {LOAD_WINDOW_MS} ms) at "
+              f"{self.bitrate // 1000} kbps")
+        if self.latencies_ms:
+            mean = sum(self.latencies_ms) / len(self.latencies_ms)
+            print(f"CAN latency: mean {mean:.2f} ms, max {self.max_latency_ms:.2f} ms "
+                  f"(id {self.max_latency_id:#x}), {len(self.bus_queue)} frames waiting")
+
+    def quit(self):
+        self.pause()
+        # Boards exit when the controller hangs up
+        for board in self.boards:
+            if board.conn is not None:
+                board.conn.close()
+        for board in self.boards:
+            try:
+                board.proc.wait(timeout=2)
+            except subprocess.TimeoutExpired:
+                board.proc.kill()
+        self.server.close()
+        self.tmp_dir.cleanup()
+
+
+def board_path(name, bin_dir):
+    path = Path(name)
+    if path.exists():
+        return path
+    for kind in ("projects", "smoke"):
+        path = bin_dir / kind / name
+        if path.exists():
+            return path
+    sys.exit(f"no binary for {name} in {bin_dir}, build it with --define=MS_VIRTUAL_TIME")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("boards", nargs="+", help="project names or paths to x86 binaries")
+    parser.add_argument("--bin-dir", type=Path, default=ROOT / "build" / "x86" / "bin")
+    parser.add_argument("--log-dir", type=Path, default=ROOT / "build" / "x86" / "cosim",
+                        help="each board's output goes to <board>.log here")
+    parser.add_argument("--quantum", type=int, default=1,
+                        help="ticks per step, frames are delivered between steps")
+    parser.add_argument("--tick-ms", type=int, default=1, help="configTICK_RATE_HZ period")
+    parser.add_argument("--bitrate", type=int, default=500000)
+    parser.add_argument("--run-ms", type=int, help="run for this long, report and exit")
+    args = parser.parse_args()
+
+    cosim = Cosim([board_path(b, args.bin_dir) for b in args.boards], args.log_dir,
+                  args.quantum, args.tick_ms, args.bitrate)
+    print(f"{len(cosim.boards)} boards ready, logs in {args.log_dir}")
+    try:
+        if args.run_ms is not None:
+            cosim.step(args.run_ms // args.tick_ms)
+            cosim.report()
+            return
+        for line in sys.stdin:
+            command = line.split()
+            if not command:
+                continue
+            if command[0] == "start":
+                cosim.start()
+            elif command[0] == "pause":
+                cosim.pause()
+                print(f"paused at {cosim.tick * args.tick_ms} ms")
+            elif command[0] == "step":
+                cosim.pause()
+                cosim.step(int(command[1]) if len(command) > 1 else 1)
+                print(f"at {cosim.tick * args.tick_ms} ms")
+            elif command[0] == "report":
+                cosim.report()
+            elif command[0] == "quit":
+                break
+            else:
+                print("commands: start, pause, step [ticks], report, quit")
+    finally:
+        cosim.quit()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,260 @@
+'''
+Drives the simulated car through a scripted drive cycle and reports how the firmware kept up.
+
+The boards run together under py/cosim, and a scenario file sets their inputs over time: ADC
+readings, input pins, I2C and SPI device data, and CAN frames from nodes that aren't simulated.
+Expectations check that a board reacts to an input on the bus within a deadline. Boards must be
+built with --define=MS_VIRTUAL_TIME.
+
+  scons --platform=x86 --define=MS_VIRTUAL_TIME
+  PYTHONPATH=py python3 py/scenario/main.py py/scenario/drive_cycle.json
+
+Scenario files are JSON:
+
+  boards        projects to run, as for py/cosim
+  duration_ms   how long to run for
+  signals       inputs, each with a name, points [[ms, value], ...] and one of
+                  "adc": {"board", "pin": "A0"}       reading in mV, linear between points
+                  "gpio": {"board", "pin": "B13"}     0 or 1, held until the next point
+                  "i2c": {"board", "port": 0}         bytes queued for the next reads
+                  "spi": {"board", "port": 0}         bytes answering every exchange
+                  "can": {"id", "extended"}           payload of a frame sent on the bus
+                For i2c, spi and can a value is a list of bytes, or of numbers packed with
+                "format" (python struct), linear between points. With "period_ms" the data is sent
+                again every period, e.g. a sensor read each cycle or a periodic frame.
+                Inputs at 0 ms are applied once the boards have finished starting up.
+  expect        reactions, each with a name, "after_ms", "can_id", "within_ms" and optionally
+                "from" (board) and "match": {"byte", "mask", "value"} on the frame's payload
+
+KPIs: cycle overruns per board, CAN latency (time from the end of the step a frame was sent in to
+the end of its transmission, including time lost in arbitration) and the reaction time of every
+expectation. The exit code is 1 if an expectation missed its deadline or a board exited early.
+'''
+import argparse
+import json
+import struct
+import sys
+import time
+from pathlib import Path
+
+from cosim.main import (Cosim, ROOT, INPUT_ADC, INPUT_GPIO, INPUT_I2C, INPUT_SPI, board_path,
+                        pack_frame)
+
+GPIO_PORTS = "ABCDEFGH"
+# Inputs that are lists of bytes rather than a single number
+DATA_KINDS = ("i2c", "spi", "can")
+
+
+def parse_pin(pin):
+    '''"B13" to (1, 13)'''
+    return GPIO_PORTS.index(pin[0].upper()), int(pin[1:])
+
+
+def interpolate(points, ms, linear):
+    '''value at ms of a [ms, value] series, values may be numbers or lists of numbers'''
+    if ms < points[0][0]:
+        return None
+    for (t0, v0), (t1, v1) in zip(points, points[1:]):
+        if t0 <= ms < t1:
+            if not linear:
+                return v0
+            frac = (ms - t0) / (t1 - t0)
+            if isinstance(v0, list):
+                return [a + (b - a) * frac for a, b in zip(v0, v1)]
+            return v0 + (v1 - v0) * frac
+    return points[-1][1]
+
+
+class Signal:
+    '''one scripted input'''
+
+    def __init__(self, spec):
+        self.name = spec["name"]
+        kinds = [k for k in ("adc", "gpio") + DATA_KINDS if k in spec]
+        if len(kinds) != 1:
+            raise ValueError(f"{self.name}: needs exactly one of adc, gpio, i2c, spi or can")
+        self.kind = kinds[0]
+        self.target = spec[self.kind]
+        self.points = sorted(spec["points"], key=lambda p: p[0])
+        self.format = spec.get("format")
+        self.period_ms = spec.get("period_ms")
+        # Byte lists are held, numbers are ramped
+        self.linear = self.kind == "adc" or (self.kind in DATA_KINDS and self.format is not None)
+        self.last = None
+        self.next_ms = self.points[0][0]
+
+    def payload(self, ms):
+        value = interpolate(self.points, ms, self.linear)
+        if value is None:
+            return None
+        if self.kind == "adc":
+            return round(value)
+        if self.kind == "gpio":
+            return 1 if value else 0
+        if self.format is None:
+            return bytes(value)
+        values = value if isinstance(value, list) else [value]
+        return struct.pack(self.format, *(round(v) for v in values))
+
+    def due(self, ms):
+        '''the value to send at ms, or None'''
+        value = self.payload(ms)
+        if value is None:
+            return None
+        if self.period_ms is not None:
+            if ms < self.next_ms:
+                return None
+            self.next_ms += self.period_ms * ((ms - self.next_ms) // self.period_ms + 1)
+            return value
+        if value == self.last:
+            return None
+        self.last = value
+        return value
+
+    def apply(self, cosim, boards, value):
+        if self.kind == "can":
+            cosim.inject(pack_frame(self.target["id"], value, self.target.get("extended", False)))
+            return
+        board = boards.get(self.target["board"])
+        if board is None or board.exited:
+            return
+        if self.kind == "adc":
+            port, pin = parse_pin(self.target["pin"])
+            board.add_input(INPUT_ADC, port, pin, value=value)
+        elif self.kind == "gpio":
+            port, pin = parse_pin(self.target["pin"])
+            board.add_input(INPUT_GPIO, port, pin, value=value)
+        else:
+            kind = INPUT_I2C if self.kind == "i2c" else INPUT_SPI
+            board.add_input(kind, self.target["port"], data=value)
+
+
+class Expectation:
+    '''a frame that must be on the bus within a deadline of a scripted input'''
+
+    def __init__(self, spec):
+        self.name = spec["name"]
+        self.after_ms = spec["after_ms"]
+        self.can_id = spec["can_id"]
+        self.within_ms = spec["within_ms"]
+        self.sender = spec.get("from")
+        self.match = spec.get("match")
+        self.reaction_ms = None
+
+    def on_frame(self, ms, sender, frame):
+        if self.reaction_ms is not None or ms < self.after_ms or frame.id != self.can_id:
+            return
+        if self.sender is not None and sender != self.sender:
+            return
+        if self.match is not None:
+            byte = (frame.data >> (8 * self.match["byte"])) & 0xff
+            if byte & self.match.get("mask", 0xff) != self.match["value"]:
+                return
+        self.reaction_ms = ms - self.after_ms
+
+    def passed(self):
+        return self.reaction_ms is not None and self.reaction_ms <= self.within_ms
+
+
+def overruns(board):
+    return sum(v for k, v in board.counters.items() if k.endswith("overruns"))
+
+
+def run(scenario, args):
+    paths = [board_path(b, args.bin_dir) for b in scenario["boards"]]
+    signals = [Signal(s) for s in scenario.get("signals", [])]
+    expectations = [Expectation(e) for e in scenario.get("expect", [])]
+    for signal in signals:
+        if signal.kind != "can" and signal.target["board"] not in scenario["boards"]:
+            sys.exit(f"{signal.name}: {signal.target['board']} isn't in the scenario's boards")
+    cosim = Cosim(paths, args.log_dir, args.quantum, args.tick_ms, args.bitrate)
+    boards = {b.name: b for b in cosim.boards}
+    # Overruns during start up aren't the drive cycle's
+    start_overruns = {b.name: overruns(b) for b in cosim.boards}
+
+    cosim.frame_listeners += [
+        lambda tick, sender, frame, e=e: e.on_frame(tick * args.tick_ms, sender, frame)
+        for e in expectations
+    ]
+    start_s = time.monotonic()
+    max_lag_ms = 0.0
+
+    def before_step(tick):
+        nonlocal max_lag_ms
+        ms = tick * args.tick_ms
+        if args.realtime:
+            ahead_s = start_s + ms / 1000 - time.monotonic()
+            if ahead_s > 0:
+                time.sleep(ahead_s)
+            else:
+                max_lag_ms = max(max_lag_ms, -1000 * ahead_s)
+        for signal in signals:
+            value = signal.due(ms)
+            if value is not None:
+                signal.apply(cosim, boards, value)
+
+    print(f"running {scenario.get('name', args.scenario.stem)} for {scenario['duration_ms']} ms"
+          f"{' in real time' if args.realtime else ''}, logs in {args.log_dir}")
+    try:
+        cosim.step(scenario["duration_ms"] // args.tick_ms, before_step)
+        cosim.report()
+    finally:
+        cosim.quit()
+
+    latencies = sorted(cosim.latencies_ms)
+    kpis = {
+        "overruns": {b.name: overruns(b) - start_overruns[b.name] for b in cosim.boards},
+        "exited": [b.name for b in cosim.boards if b.exited],
+        "can_latency_ms": {
+            "mean": sum(latencies) / len(latencies) if latencies else 0,
+            "p99": latencies[int(0.99 * (len(latencies) - 1))] if latencies else 0,
+            "max": latencies[-1] if latencies else 0,
+        },
+        "reactions": {e.name: {"ms": e.reaction_ms, "within_ms": e.within_ms, "passed": e.passed()}
+                      for e in expectations},
+    }
+    if args.realtime:
+        kpis["max_lag_ms"] = max_lag_ms
+
+    print("\ncycle overruns: " + ", ".join(f"{k} {v}" for k, v in kpis["overruns"].items()))
+    print(f"CAN latency p99: {kpis['can_latency_ms']['p99']:.2f} ms")
+    for e in expectations:
+        result = "missed" if e.reaction_ms is None else f"{e.reaction_ms} ms"
+        print(f"{'PASS' if e.passed() else 'FAIL'} {e.name}: {result} "
+              f"(deadline {e.within_ms} ms)")
+    if args.realtime:
+        print(f"fell behind real time by up to {max_lag_ms:.1f} ms")
+    for name in kpis["exited"]:
+        print(f"FAIL {name} exited early")
+    return kpis
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("scenario", type=Path, help="scenario JSON file")
+    parser.add_argument("--bin-dir", type=Path, default=ROOT / "build" / "x86" / "bin")
+    parser.add_argument("--log-dir", type=Path, default=ROOT / "build" / "x86" / "scenario",
+                        help="each board's output goes to <board>.log here")
+    parser.add_argument("--quantum", type=int, default=1,
+                        help="ticks per step, inputs and frames are delivered between steps")
+    parser.add_argument("--tick-ms", type=int, default=1, help="configTICK_RATE_HZ period")
+    parser.add_argument("--bitrate", type=int, default=500000)
+    parser.add_argument("--realtime", action="store_true",
+                        help="pace the virtual clock to the wall clock, e.g. to watch on a GUI")
+    parser.add_argument("--json", type=Path, help="write the KPIs here")
+    args = parser.parse_args()
+
+    with open(args.scenario) as f:
+        scenario = json.load(f)
+    kpis = run(scenario, args)
+    if args.json is not None:
+        with open(args.json, "w") as f:
+            json.dump(kpis, f, indent=2)
+
+    failed = kpis["exited"] or not all(r["passed"] for r in kpis["reactions"].values())
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
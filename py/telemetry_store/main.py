@@ -0,0 +1,138 @@
+'''
+Import and query benchmarks for the telemetry store.
+A synthetic candump -L log is generated from the board YAMLs: every message is sent at a fixed
+period (AFE status messages faster, like the BMS sends them) with slowly drifting signal values.
+Multiplexed messages cycle through their mux values, so the AFE messages carry every cell in turn.
+'''
+import argparse
+import random
+import shutil
+import statistics
+import sys
+import time
+from pathlib import Path
+
+from can_decoder.decoder import Decoder, ROOT
+from telemetry_store.store import AFE_CELLS_PER_DEVICE, AFE_CELLS_PER_MESSAGE, MUX_SIGNALS, \
+    TelemetryStore, import_candump
+
+sys.path.append(str(ROOT / "libraries" / "codegen"))
+import generator  # pylint: disable=wrong-import-position
+
+BUILD_DIR = ROOT / "build" / "telemetry_store"
+# Transmit period in ms per message, anything not listed is sent every DEFAULT_PERIOD_MS
+PERIODS_MS = {"AFE1_status": 50, "AFE2_status": 50, "AFE3_status": 50, "battery_vt": 100,
+              "cc_pedal": 50, "motor_velocity": 100}
+DEFAULT_PERIOD_MS = 1000
+TICK_MS = 10
+# Number of mux values each multiplexed message cycles through
+MUX_VALUES = AFE_CELLS_PER_DEVICE // AFE_CELLS_PER_MESSAGE
+
+
+def write_synthetic_log(path, hours, seed=0):
+    '''write an interleaved candump -L log covering hours of traffic, returns the frame count'''
+    rng = random.Random(seed)
+    data = generator.get_data()
+    boards = data["Boards"]
+    schedule = []
+    for message in data["Messages"]:
+        can_id = message["id"] if message["critical"] else \
+            (message["id"] << 5) + boards.index(message["sender"])
+        period = PERIODS_MS.get(message["name"], DEFAULT_PERIOD_MS)
+        mux = MUX_SIGNALS.get(message["name"])
+        schedule.append({"id": can_id,
+                         "mux": next((i for i, s in enumerate(message["signals"])
+                                      if s["name"] == mux), None),
+                         "period": period,
+                         "phase": rng.randrange(period // TICK_MS) * TICK_MS,
+                         # [current value, length] of every signal
+                         "signals": [[rng.getrandbits(s["length"] - 4), s["length"]]
+                                     for s in message["signals"]]})
+
+    # Every period divides DEFAULT_PERIOD_MS, so the set of due messages repeats each second
+    ticks = DEFAULT_PERIOD_MS // TICK_MS
+    due = [[m for m in schedule if (tick * TICK_MS - m["phase"]) % m["period"] == 0]
+           for tick in range(ticks)]
+
+    end_ms = int(hours * 3600 * 1000)
+    frames = 0
+    with open(path, "w") as log:
+        lines = []
+        for tick, now in enumerate(range(0, end_ms, TICK_MS)):
+            for message in due[tick % ticks]:
+                if message["mux"] is not None:
+                    mux = message["signals"][message["mux"]]
+                    mux[0] = (mux[0] + 1) % MUX_VALUES
+                payload = 0
+                shift = 0
+                for i, signal in enumerate(message["signals"]):
+                    if i != message["mux"]:
+                        signal[0] = max(0, min((1 << signal[1]) - 1,
+                                               signal[0] + rng.randint(-8, 8)))
+                    payload |= signal[0] << shift
+                    shift += signal[1]
+                size = (shift + 7) // 8
+                lines.append(f"({now / 1000:.6f}) vcan0 {message['id']:03X}#"
+                             f"{payload.to_bytes(size, 'little').hex().upper()}\n")
+            if len(lines) > 65536:
+                frames += len(lines)
+                log.writelines(lines)
+                lines = []
+        frames += len(lines)
+        log.writelines(lines)
+    return frames
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--hours", type=float, default=3.0)
+    parser.add_argument("--queries", type=int, default=200)
+    parser.add_argument("--window", type=float, default=60.0, help="query window in seconds")
+    args = parser.parse_args()
+
+    BUILD_DIR.mkdir(parents=True, exist_ok=True)
+    log_path = BUILD_DIR / f"synthetic_{args.hours:g}h.log"
+    store_path = BUILD_DIR / "store"
+    decoder = Decoder()
+
+    if not log_path.exists():
+        start = time.perf_counter()
+        frames = write_synthetic_log(log_path, args.hours)
+        print(f"generated {frames} frames in {time.perf_counter() - start:.1f} s")
+    log_size = log_path.stat().st_size
+
+    shutil.rmtree(store_path, ignore_errors=True)
+    start = time.perf_counter()
+    frames = import_candump(log_path, store_path, decoder)
+    import_time = time.perf_counter() - start
+    store_size = sum(f.stat().st_size for f in Path(store_path).iterdir())
+    print(f"import: {frames} frames, {log_size / 1e6:.1f} MB in {import_time:.2f} s "
+          f"({frames / import_time / 1e6:.2f} Mframe/s, {log_size / import_time / 1e6:.1f} MB/s)")
+    print(f"store: {store_size / 1e6:.1f} MB ({log_size / store_size:.1f}x smaller than the log)")
+
+    store = TelemetryStore(store_path)
+    signals = store.signals()
+    first, last = store.time_range()
+    rng = random.Random(1)
+    latencies = []
+    rows = 0
+    for _ in range(args.queries):
+        t0 = rng.uniform(first, max(first, last - args.window))
+        start = time.perf_counter()
+        times, _ = store.query(rng.choice(signals), t0, t0 + args.window)
+        latencies.append(time.perf_counter() - start)
+        rows += len(times)
+    latencies.sort()
+    print(f"query ({args.window:g} s window): mean {statistics.mean(latencies) * 1e3:.2f} ms, "
+          f"p99 {latencies[int(len(latencies) * 0.99) - 1] * 1e3:.2f} ms, "
+          f"{store.blocks_read / args.queries:.1f} blocks/query, {rows / args.queries:.0f} rows/query")
+
+    # Baseline: re-decoding the whole log to plot one signal
+    start = time.perf_counter()
+    decoder.decode_candump(log_path.read_bytes())
+    print(f"full log re-decode: {(time.perf_counter() - start) * 1e3:.0f} ms")
+    store.close()
+
+
+if __name__ == "__main__":
+    main()
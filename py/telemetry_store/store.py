@@ -0,0 +1,240 @@
+'''
+Columnar telemetry store for decoded CAN logs.
+
+A store is a directory holding:
+  index.json          - block index of every message and the signal names / column types
+  <message>.t         - timestamp column, microseconds, delta encoded
+  <message>.<signal>  - value column of one signal
+Multiplexed messages are split on their mux signal while importing, so each mux value gets its
+own columns, e.g. AFE2_status[1].v3 holds cell 17's voltage (see CELLS). Each column file is a sequence of independently zlib compressed blocks of up to block_rows rows.
+Blocks are aligned across the columns of a message, and the index records the time range, row
+count and byte range of every block, so a query only reads the blocks overlapping its window.
+'''
+import bisect
+import json
+import zlib
+from array import array
+from itertools import accumulate
+from pathlib import Path
+
+from can_decoder.decoder import Decoder, COLUMN_TYPECODES
+
+INDEX_FILE = "index.json"
+DEFAULT_BLOCK_ROWS = 8192
+# candump logs are imported this many bytes at a time
+IMPORT_CHUNK_BYTES = 16 << 20
+
+# Mux signal of each multiplexed message. The BMS sends 3 cell voltages of one AFE per frame, and
+# the mux picks which 3 (projects/bms_carrier/src/cell_sense.c).
+MUX_SIGNALS = {"AFE1_status": "id", "AFE2_status": "id", "AFE3_status": "id"}
+AFE_NUM_DEVICES = 3
+AFE_CELLS_PER_DEVICE = 12
+AFE_CELLS_PER_MESSAGE = 3
+# "cell<N>" aliases of the column holding each cell's voltage
+CELLS = {f"cell{cell}": f"AFE{cell // AFE_CELLS_PER_DEVICE + 1}_status"
+                        f"[{cell % AFE_CELLS_PER_DEVICE // AFE_CELLS_PER_MESSAGE}]"
+                        f".v{cell % AFE_CELLS_PER_MESSAGE + 1}"
+         for cell in range(AFE_NUM_DEVICES * AFE_CELLS_PER_DEVICE)}
+
+
+class _ColumnWriter:
+    '''appends compressed blocks to one column file'''
+
+    def __init__(self, path, typecode, level):
+        self.file = open(path, "wb")
+        self.typecode = typecode
+        self.level = level
+        self.pending = array(typecode)
+        self.offset = 0
+
+    def write_block(self, values):
+        '''compress values as one block, returns its (offset, length) in the file'''
+        data = zlib.compress(values.tobytes(), self.level)
+        self.file.write(data)
+        extent = (self.offset, len(data))
+        self.offset += len(data)
+        return extent
+
+    def close(self):
+        self.file.close()
+
+
+class _MessageWriter:
+    '''buffers the rows of one message, or of one mux value, and flushes them as aligned blocks'''
+
+    def __init__(self, root, name, message, signals, block_rows, level, mux=None):
+        self.name = name
+        self.message = message
+        self.mux = mux
+        self.block_rows = block_rows
+        self.times = array("q")
+        self.time_column = _ColumnWriter(root / f"{name}.t", "q", level)
+        self.columns = {signal: _ColumnWriter(root / f"{name}.{signal}", typecode, level)
+                        for signal, typecode in signals.items()}
+        self.blocks = []
+
+    def append(self, times, columns):
+        self.times.extend(times)
+        for name, column in self.columns.items():
+            column.pending.extend(columns[name])
+        while len(self.times) >= self.block_rows:
+            self._flush(self.block_rows)
+
+    def _flush(self, rows):
+        times = self.times[:rows]
+        del self.times[:rows]
+        # Delta encode the timestamps against the block's first row, which lives in the index
+        deltas = array("q", [0])
+        deltas.extend(b - a for a, b in zip(times, times[1:]))
+        block = {"t0": times[0], "t1": times[-1], "rows": rows,
+                 "t": self.time_column.write_block(deltas)}
+        for name, column in self.columns.items():
+            block[name] = column.write_block(column.pending[:rows])
+            del column.pending[:rows]
+        self.blocks.append(block)
+
+    def index(self):
+        index = {"id": self.message.id,
+                 "signals": {name: column.typecode for name, column in self.columns.items()},
+                 "blocks": self.blocks}
+        if self.mux is not None:
+            index["mux"] = {"signal": self.mux[0], "value": self.mux[1]}
+        return index
+
+    def close(self):
+        if self.times:
+            self._flush(len(self.times))
+        self.time_column.close()
+        for column in self.columns.values():
+            column.close()
+
+
+def import_candump(log_path, store_path, decoder=None, block_rows=DEFAULT_BLOCK_ROWS, level=6):
+    '''
+    Convert a candump -L log into a store at store_path, returns the number of frames decoded.
+    Timestamps must be non-decreasing, as written by candump.
+    '''
+    decoder = decoder or Decoder()
+    root = Path(store_path)
+    root.mkdir(parents=True, exist_ok=True)
+    writers = {}
+    frames = 0
+
+    def writer_for(message, mux=None):
+        name = message.name if mux is None else f"{message.name}[{mux[1]}]"
+        writer = writers.get(name)
+        if writer is None:
+            signals = {s: COLUMN_TYPECODES[size] for s, _, _, size in message.signals
+                       if mux is None or s != mux[0]}
+            writer = writers[name] = _MessageWriter(root, name, message, signals, block_rows,
+                                                    level, mux)
+        return writer
+
+    with open(log_path, "rb") as log:
+        tail = b""
+        while True:
+            chunk = log.read(IMPORT_CHUNK_BYTES)
+            text = tail + chunk
+            if chunk:
+                # Only hand complete lines to the parser
+                cut = text.rfind(b"\n") + 1
+                text, tail = text[:cut], text[cut:]
+            if text:
+                timestamps, ids, data = decoder.parse_candump(text)
+                micros = array("q", (int(t * 1e6 + 0.5) for t in timestamps))
+                for name, columns in decoder.decode(ids, data).items():
+                    rows = columns["frame"]
+                    if not rows:
+                        continue
+                    message = decoder.by_name[name]
+                    frames += len(rows)
+                    mux = MUX_SIGNALS.get(name)
+                    if mux is None:
+                        writer_for(message).append(array("q", (micros[i] for i in rows)), columns)
+                        continue
+                    # Split the rows by mux value, keeping their order
+                    groups = {}
+                    for row, value in enumerate(columns[mux]):
+                        groups.setdefault(value, array("I")).append(row)
+                    for value, group in sorted(groups.items()):
+                        writer_for(message, (mux, value)).append(
+                            array("q", (micros[rows[i]] for i in group)),
+                            {s: array(c.typecode, (c[i] for i in group))
+                             for s, c in columns.items() if s not in ("frame", mux)})
+            if not chunk:
+                break
+
+    index = {"version": 2, "block_rows": block_rows, "messages": {}}
+    for name, writer in writers.items():
+        writer.close()
+        index["messages"][name] = writer.index()
+    (root / INDEX_FILE).write_text(json.dumps(index))
+    return frames
+
+
+class TelemetryStore:
+    '''
+    Read side of a store.
+    query("battery_vt.voltage", t0, t1) returns (times, values) arrays for t0 <= time <= t1
+    seconds, decompressing only the blocks whose time range overlaps the window. Multiplexed
+    signals are named with their mux value, e.g. "AFE2_status[1].v3", or by a CELLS alias such as
+    "cell17".
+    '''
+
+    def __init__(self, path):
+        self.root = Path(path)
+        self.index = json.loads((self.root / INDEX_FILE).read_text())
+        self.messages = self.index["messages"]
+        # Block end times per message, for bisecting to the first block of a window
+        self._block_ends = {name: [b["t1"] for b in msg["blocks"]]
+                            for name, msg in self.messages.items()}
+        self._files = {}
+        self.blocks_read = 0
+
+    def signals(self):
+        '''all "message.signal" names in the store'''
+        return [f"{m}.{s}" for m, msg in self.messages.items() for s in msg["signals"]]
+
+    def time_range(self):
+        '''(first, last) timestamp in the store in seconds'''
+        blocks = [b for msg in self.messages.values() for b in msg["blocks"]]
+        return min(b["t0"] for b in blocks) / 1e6, max(b["t1"] for b in blocks) / 1e6
+
+    def _read(self, file_name, extent, typecode):
+        file = self._files.get(file_name)
+        if file is None:
+            file = self._files[file_name] = open(self.root / file_name, "rb")
+        file.seek(extent[0])
+        self.blocks_read += 1
+        return array(typecode, zlib.decompress(file.read(extent[1])))
+
+    def query(self, signal, t0=None, t1=None):
+        '''times (seconds) and values of signal between t0 and t1 (inclusive, seconds)'''
+        message, name = CELLS.get(signal, signal).rsplit(".", 1)
+        msg = self.messages[message]
+        typecode = msg["signals"][name]
+        lo = -(1 << 63) if t0 is None else int(t0 * 1e6 + 0.5)
+        hi = (1 << 63) - 1 if t1 is None else int(t1 * 1e6 + 0.5)
+
+        times = array("d")
+        values = array(typecode)
+        blocks = msg["blocks"]
+        for block in blocks[bisect.bisect_left(self._block_ends[message], lo):]:
+            if block["t0"] > hi:
+                break
+            block_times = list(accumulate(self._read(f"{message}.t", block["t"], "q"),
+                                          initial=block["t0"]))[1:]
+            block_values = self._read(f"{message}.{name}", block[name], typecode)
+            if lo <= block["t0"] and block["t1"] <= hi:
+                first, last = 0, block["rows"]
+            else:
+                first = bisect.bisect_left(block_times, lo)
+                last = bisect.bisect_right(block_times, hi)
+            times.extend(t / 1e6 for t in block_times[first:last])
+            values.extend(block_values[first:last])
+        return times, values
+
+    def close(self):
+        for file in self._files.values():
+            file.close()
+        self._files = {}
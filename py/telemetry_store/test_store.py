@@ -0,0 +1,78 @@
+'''
+Store round trip of one cell through the multiplexed AFE messages.
+Run with: cd py && python3 -m unittest telemetry_store.test_store
+'''
+import tempfile
+import unittest
+from pathlib import Path
+
+from can_decoder.decoder import Decoder
+from telemetry_store.store import CELLS, TelemetryStore, import_candump
+
+CELL = 17
+
+
+def _frame(message, values):
+    payload = 0
+    for name, start_bit, length, _ in message.signals:
+        payload |= (values.get(name, 0) & ((1 << length) - 1)) << start_bit
+    return f"{message.id:03X}#{payload.to_bytes(8, 'little').hex().upper()}"
+
+
+class TestStore(unittest.TestCase):
+    '''cell 17 is AFE2_status mux 1, v3'''
+
+    @classmethod
+    def setUpClass(cls):
+        cls.decoder = Decoder()
+        cls.dir = tempfile.TemporaryDirectory()
+        log_path = Path(cls.dir.name) / "afe.log"
+        afe = [cls.decoder.by_name[f"AFE{i}_status"] for i in (1, 2, 3)]
+        lines = []
+        # 100 rounds of every mux value of every AFE, 10 ms apart, the voltage encodes the
+        # round and where it came from so a wrong column is caught
+        for rnd in range(100):
+            for mux in range(4):
+                t = rnd * 0.04 + mux * 0.01
+                for device, message in enumerate(afe):
+                    values = {"id": mux, "temp": device,
+                              "v1": device * 1000 + mux * 100 + rnd,
+                              "v2": device * 1000 + mux * 100 + rnd + 10000,
+                              "v3": device * 1000 + mux * 100 + rnd + 20000}
+                    lines.append(f"({t:.6f}) vcan0 {_frame(message, values)}\n")
+        log_path.write_text("".join(lines))
+        cls.store_path = Path(cls.dir.name) / "store"
+        cls.frames = import_candump(log_path, cls.store_path, cls.decoder, block_rows=16)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.dir.cleanup()
+
+    def setUp(self):
+        self.store = TelemetryStore(self.store_path)
+
+    def tearDown(self):
+        self.store.close()
+
+    def test_demux(self):
+        self.assertEqual(self.frames, 100 * 4 * 3)
+        self.assertEqual(CELLS[f"cell{CELL}"], "AFE2_status[1].v3")
+        self.assertIn("AFE2_status[1].v3", self.store.signals())
+        # The mux signal isn't stored as a value
+        self.assertNotIn("AFE2_status[1].id", self.store.signals())
+
+    def test_query_cell(self):
+        times, values = self.store.query(f"cell{CELL}")
+        self.assertEqual(len(times), 100)
+        self.assertEqual(list(values), [1000 + 100 + rnd + 20000 for rnd in range(100)])
+        self.assertAlmostEqual(times[0], 0.01)
+
+        # Rounds 50 to 59 only lie in 1 of the cell's 7 blocks: its time and value columns are read
+        blocks_read = self.store.blocks_read
+        times, values = self.store.query(f"cell{CELL}", 50 * 0.04, 59 * 0.04 + 0.015)
+        self.assertEqual(list(values), [1000 + 100 + rnd + 20000 for rnd in range(50, 60)])
+        self.assertEqual(self.store.blocks_read - blocks_read, 2)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,157 @@
+'''
+Converts a trace drained from a board (see libraries/ms-common/inc/trace.h) to Chrome trace event
+JSON, which chrome://tracing and the Perfetto UI open directly.
+
+The input is either the raw stream captured from trace_drain_uart(), or a `candump -L` log holding
+the CAN_DIAG_TRACE frames sent by can_diag_tx_trace().
+'''
+import argparse
+import json
+import re
+import struct
+import sys
+
+# Must match TraceEvent and TraceEventType in trace.h
+EVENT = struct.Struct("<IBBHI")
+(TASK_SWITCH, TASK_NOTIFY, QUEUE_SEND, QUEUE_RECEIVE, CAN_TX, CAN_RX, SPAN_BEGIN, SPAN_END,
+ INSTANT, TASK_NAME, SPAN_NAME) = range(11)
+
+# Must match can_diag.h
+CAN_DIAG_MSG_ID = 63
+CAN_DIAG_TRACE = 3
+CANDUMP_LINE = re.compile(r"\S+\s+\S+\s+([0-9A-Fa-f]+)#([0-9A-Fa-f]*)")
+
+
+def events_from_stream(data):
+    '''TraceEvent tuples from a raw stream, a trailing partial event is ignored'''
+    usable = len(data) - len(data) % EVENT.size
+    return list(EVENT.iter_unpack(data[:usable]))
+
+
+def stream_from_candump(lines, device=None):
+    '''reassembles the trace stream from CAN_DIAG_TRACE frames, returns (stream, frames lost)'''
+    stream = bytearray()
+    lost = 0
+    last_seq = None
+    for line in lines:
+        match = CANDUMP_LINE.match(line.strip())
+        if match is None:
+            continue
+        can_id = int(match.group(1), 16)
+        payload = bytes.fromhex(match.group(2))
+        if can_id >> 5 != CAN_DIAG_MSG_ID or len(payload) != 8 or payload[0] != CAN_DIAG_TRACE:
+            continue
+        if device is not None and can_id & 0x1f != device:
+            continue
+        if last_seq is not None and (payload[1] - last_seq) % 256 != 1:
+            lost += (payload[1] - last_seq - 1) % 256
+        last_seq = payload[1]
+        stream += payload[2:]
+    return bytes(stream), lost
+
+
+class Exporter:
+    '''follows the running task like trace_export_json() on x86'''
+
+    def __init__(self, pid=1):
+        self.pid = pid
+        self.events = []
+        self.task_names = {}
+        self.span_names = {}
+        self.partial_names = {}
+        self.last_us = None
+        self.running = 0
+        self.running_since = 0
+
+    def task(self, number):
+        return self.task_names.get(number, f"task {number}")
+
+    def span(self, span):
+        return self.span_names.get(span, f"span {span}")
+
+    def instant(self, ts, name, args):
+        self.events.append({"name": name, "ph": "i", "s": "t", "ts": ts, "pid": self.pid,
+                            "tid": self.running, "args": args})
+
+    def name_chunk(self, kind, ident, offset, arg):
+        key = (kind, ident)
+        name = self.partial_names.get(key, b"")[:offset] + struct.pack("<I", arg)
+        self.partial_names[key] = name
+        if b"\0" in name:
+            names = self.task_names if kind == TASK_NAME else self.span_names
+            names[ident] = name.split(b"\0")[0].decode(errors="replace")
+            del self.partial_names[key]
+
+    def add(self, timestamp, kind, chunk, ident, arg):
+        if kind in (TASK_NAME, SPAN_NAME):
+            self.name_chunk(kind, ident, chunk, arg)
+            return
+        if self.last_us is None:
+            self.last_us = timestamp
+        # unwrap the 32 bit timestamp against the previous event
+        delta = (timestamp - self.last_us) & 0xffffffff
+        self.last_us += delta - (1 << 32) if delta >= 1 << 31 else delta
+        ts = self.last_us
+
+        if kind == TASK_SWITCH:
+            if self.running != 0:
+                self.events.append({"name": self.task(self.running), "ph": "X",
+                                    "ts": self.running_since, "dur": ts - self.running_since,
+                                    "pid": self.pid, "tid": self.running})
+            self.running = ident
+            self.running_since = ts
+        elif kind == TASK_NOTIFY:
+            self.instant(ts, "notify", {"task": self.task(ident)})
+        elif kind in (QUEUE_SEND, QUEUE_RECEIVE):
+            items = arg + (1 if kind == QUEUE_SEND else -1)
+            self.events.append({"name": f"queue {ident}", "ph": "C", "ts": ts, "pid": self.pid,
+                                "args": {"items": items}})
+        elif kind in (CAN_TX, CAN_RX):
+            self.instant(ts, "can tx" if kind == CAN_TX else "can rx",
+                         {"id": hex(arg), "dlc": ident})
+        elif kind in (SPAN_BEGIN, SPAN_END):
+            self.events.append({"name": self.span(ident), "ph": "B" if kind == SPAN_BEGIN else "E",
+                                "ts": ts, "pid": self.pid, "tid": self.running})
+        elif kind == INSTANT:
+            self.instant(ts, self.span(ident), {"value": arg})
+
+    def trace(self):
+        # names arrive in the stream, so spans and slices are relabelled once they're all known
+        for event in self.events:
+            if event["ph"] == "X":
+                event["name"] = self.task(event["tid"])
+        metadata = [{"name": "thread_name", "ph": "M", "pid": self.pid, "tid": number,
+                     "args": {"name": name}} for number, name in sorted(self.task_names.items())]
+        return {"displayTimeUnit": "ms", "traceEvents": metadata + self.events}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="raw UART capture, or candump -L log with --candump")
+    parser.add_argument("-o", "--output", default="trace.json")
+    parser.add_argument("--candump", action="store_true")
+    parser.add_argument("--device", type=int, help="only frames from this CAN device ID")
+    args = parser.parse_args()
+
+    lost = 0
+    if args.candump:
+        with open(args.input, encoding="utf-8") as log:
+            stream, lost = stream_from_candump(log, args.device)
+    else:
+        with open(args.input, "rb") as capture:
+            stream = capture.read()
+
+    exporter = Exporter()
+    events = events_from_stream(stream)
+    for event in events:
+        exporter.add(*event)
+    with open(args.output, "w", encoding="utf-8") as out:
+        json.dump(exporter.trace(), out)
+    print(f"{len(events)} events, {lost} frames lost -> {args.output}")
+    if lost:
+        print("warning: events after a lost frame are misaligned", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
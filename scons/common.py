@@ -12,9 +12,11 @@ def parse_config(entry):
         'arm_libs': [],
         'cflags': [],
         'mocks': {},
+        'defines': {},
         'no_lint': False,
         'can': False,
-        'arm_only': False
+        'arm_only': False,
+        'mem_budget': {}
     }
     config_file = entry.File('config.json')
     if not config_file.exists():
@@ -26,6 +28,15 @@ def parse_config(entry):
     return ret
 
 
+def get_lib_deps(entry, lib_dir, platform):
+    # Recursively get library dependencies for entry
+    config = parse_config(entry)
+    deps = config['libs'] + config['{}_libs'.format(platform)]
+    for dep in deps:
+        deps += get_lib_deps(lib_dir.Dir(dep), lib_dir, platform)
+    return deps
+
+
 def flash_run(entry, flash_type):
     '''flash and run file, return a pyserial object which monitors the device serial output'''
     try:
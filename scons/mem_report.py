@@ -1,85 +1,324 @@
+'''Memory budget report for an arm build.
 
+Attributes the RAM and flash in the linker map to task stacks, queues, generated CAN structs, FSMs
+and the libraries they come from. It can save the report and diff against a saved one, and fails
+when the project's "mem_budget" in config.json is exceeded.
+
+Usage:
+    python3 scons/mem_report.py build/arm/bin/projects/bms_carrier
+        [--map <map file>] [--config projects/bms_carrier/config.json]
+        [--save <report.json>] [--baseline <report.json>] [--check]
+
+A budget is bytes, or a string ending in K, for "ram", "flash" or the RAM of any category:
+
+    "mem_budget": {
+        "ram": "18K",
+        "flash": "60K",
+        "tasks": 12288
+    }
+'''
+import argparse
+import json
 import os
+import re
 import sys
 
+RAM = 'ram'
+FLASH = 'flash'
+REGIONS = (RAM, FLASH)
+
+# First match wins, on the symbol name then the object it comes from
+CATEGORIES = [
+    # g_rx_struct and g_tx_struct, and the watchdogs and code from the jinja templates
+    ('can', r'^g_(rx|tx)_struct$|_msg_watchdog$', r'_(rx|tx)_all\.o$'),
+    # TASK() stacks, and the Task and Fsm compound literals which hold the TCBs
+    ('tasks', r'^_s_stack_|^__compound_literal|^ux(Idle|Timer)TaskStack$|^x(Idle|Timer)TaskTCB$',
+     None),
+    ('fsm', r'_fsm$|^_s_sem_buf_|transition|_states$', None),
+    # CanStorage holds the rx queue
+    ('queues', r'(?i)queue|_storage$|_buf$', None),
+    ('heap', r'^ucHeap$', None),
+]
+
+# Stacks of TASK() and the FreeRTOS idle and timer tasks
+TASK_STACK_PATTERN = r'^_s_stack_(\w+)$|^ux(Idle|Timer)TaskStack$'
+
+# Output sections which are in RAM and flash when the map has no memory configuration
+RAM_SECTIONS = ('.data', '.bss', '.tdata', '.tbss', '.noinit', '._user_heap_stack')
+LOADED_SECTIONS = ('.data', '.tdata')
+
+HEX = r'0x([0-9a-fA-F]+)'
+
+
+def parse_size(value):
+    if isinstance(value, str) and value.upper().endswith('K'):
+        return int(value[:-1]) * 1024
+    return int(value)
+
+
+def symbol_name(section):
+    '''Symbol name from an input section, e.g. .bss._s_stack_master_task or .text.prv_foo'''
+    for prefix in ('.text.', '.rodata.', '.data.rel.ro.local.', '.data.rel.ro.', '.data.rel.local.',
+                   '.data.rel.', '.data.', '.bss.', '.sbss.', '.sdata.'):
+        if section.startswith(prefix):
+            name = section[len(prefix):]
+            # String literals and merged constants, e.g. .rodata.prv_foo.str1.1
+            if re.search(r'(^|\.)(str|cst)\d+(\.\d+)?$', name):
+                return '(strings)'
+            # Function statics have a .N suffix
+            return re.sub(r'\.\d+$', '', name)
+    return f'({section})'
+
+
+def object_owner(path):
+    '''Library, project or toolchain the object file was linked from, and a short object name'''
+    archive = re.search(r'lib([\w\-+.]+)\.a\((.+)\)$', path)
+    if archive:
+        owner, member = archive.groups()
+        if os.path.isabs(path) and not path.startswith(os.getcwd()):
+            owner = 'toolchain'
+        return owner, f'{owner}/{member}'
+    if os.path.isabs(path) and not path.startswith(os.getcwd()):
+        return 'toolchain', os.path.basename(path)
+    if '/can/' in path:
+        return 'can', f'can/{os.path.basename(path)}'
+    project = re.search(r'obj/(?:projects|smoke)/([\w\-]+)/', path)
+    if project:
+        return project.group(1), f'{project.group(1)}/{os.path.basename(path)}'
+    return os.path.basename(path), os.path.basename(path)
+
+
+def categorize(name, obj, section):
+    for category, name_pattern, obj_pattern in CATEGORIES:
+        if re.search(name_pattern, name) or (obj_pattern and re.search(obj_pattern, obj)):
+            return category
+    if section.startswith('.text'):
+        return 'code'
+    if section.startswith('.rodata'):
+        return 'const'
+    return 'data'
+
+
+class MapFile:
+    '''Input sections of a GNU ld map, by the output section and memory region they went to'''
+
+    def __init__(self, path):
+        self.memory = {}
+        self.outputs = []
+        self.sections = []
+        with open(path) as f:
+            lines = f.read().splitlines()
+        self._parse(lines)
+
+    def _region(self, output, address, load_address):
+        regions = set()
+        if self.memory:
+            for region, (origin, length) in self.memory.items():
+                for addr in (address, load_address):
+                    if addr is not None and origin <= addr < origin + length:
+                        regions.add(region)
+        else:
+            regions.add(RAM if output.startswith(RAM_SECTIONS) else FLASH)
+            if output.startswith(LOADED_SECTIONS):
+                regions.add(FLASH)
+        return regions
+
+    def _parse(self, lines):
+        i = 0
+        # Memory regions are named in the linker script, e.g. FLASH and RAM
+        while i < len(lines) and not lines[i].startswith('Linker script and memory map'):
+            match = re.match(rf'^(\w+)\s+{HEX}\s+{HEX}', lines[i])
+            if match and match.group(1) != '*default*':
+                name = match.group(1).lower()
+                if name in REGIONS:
+                    self.memory[name] = (int(match.group(2), 16), int(match.group(3), 16))
+            i += 1
+
+        regions = set()
+        while i < len(lines):
+            line = lines[i]
+            i += 1
+            if line.startswith('OUTPUT('):
+                break
+            if not line or line.startswith(('LOAD ', 'START GROUP', 'END GROUP')):
+                continue
+
+            # Long names put the address and size on the next line
+            fields = line.split()
+            if len(fields) == 1 and i < len(lines) and re.match(rf'^\s+{HEX}\s+{HEX}', lines[i]):
+                line = line + lines[i]
+                fields = line.split()
+                i += 1
+
+            if not line[0].isspace():
+                # Output section, e.g. ".data 0x20000000 0x100 load address 0x08001234"
+                match = re.match(rf'^(\S+)\s+{HEX}\s+{HEX}(?:\s+load address {HEX})?', line)
+                if match:
+                    address = int(match.group(2), 16)
+                    load_address = int(match.group(4), 16) if match.group(4) else None
+                    # Debug sections aren't loaded
+                    regions = self._region(match.group(1), address, load_address) \
+                        if address != 0 else set()
+                    self.outputs.append((int(match.group(3), 16), regions))
+                continue
+
+            if not regions:
+                continue
+            match = re.match(rf'^ (\S+)\s+{HEX}\s+{HEX}\s*(.*)$', line)
+            if not match:
+                # Linker script patterns, assignments and symbols
+                continue
+            section, size, obj = match.group(1), int(match.group(3), 16), match.group(4).strip()
+            if size == 0:
+                continue
+            if section == '*fill*':
+                section, obj = '(padding)', '(padding)'
+            self.sections.append((section, obj, size, regions))
+
+
+def build_report(map_file):
+    report = {
+        'total': {region: 0 for region in REGIONS},
+        'capacity': {region: map_file.memory[region][1] for region in map_file.memory},
+        'categories': {},
+        'libraries': {},
+        'tasks': {},
+        'symbols': {},
+    }
+
+    def add(table, key, region, size):
+        entry = table.setdefault(key, {r: 0 for r in REGIONS})
+        entry[region] += size
+
+    # Totals include the alignment between input sections
+    for size, regions in map_file.outputs:
+        for region in regions:
+            report['total'][region] += size
+
+    for section, obj, size, regions in map_file.sections:
+        if section == '(padding)':
+            name, owner, short_obj, category = '(padding)', '(padding)', '(padding)', 'padding'
+        else:
+            name = symbol_name(section)
+            owner, short_obj = object_owner(obj)
+            category = categorize(name, short_obj, section)
+        for region in regions:
+            add(report['categories'], category, region, size)
+            add(report['libraries'], owner, region, size)
+            add(report['symbols'], f'{short_obj}:{name}', region, size)
+
+        stack = re.match(TASK_STACK_PATTERN, name)
+        if stack and RAM in regions:
+            task = stack.group(1) or ('IDLE' if stack.group(2) == 'Idle' else 'Tmr Svc')
+            report['tasks'][task] = report['tasks'].get(task, 0) + size
+
+    for region in REGIONS:
+        gap = report['total'][region] - sum(c[region] for c in report['categories'].values())
+        if gap > 0:
+            add(report['categories'], 'padding', region, gap)
+            add(report['libraries'], '(padding)', region, gap)
+    return report
+
+
+def print_table(title, rows, regions=REGIONS, sign=''):
+    print(f'\n{title}:')
+    for name, sizes in rows:
+        print(''.join(f'{sizes.get(r, 0):>{sign}10}' for r in regions) + f'    {name}')
+
+
+def print_report(report, top):
+    print('Memory usage:')
+    for region in REGIONS:
+        used = report['total'][region]
+        capacity = report['capacity'].get(region)
+        percent = f' of {capacity} ({100 * used / capacity:.1f}%)' if capacity else ''
+        print(f'    {region:<6}{used:>10} bytes{percent}')
+
+    def by_ram(table):
+        return sorted(table.items(), key=lambda item: (item[1][RAM], item[1][FLASH]), reverse=True)
+
+    print(f'\n{"RAM":>10}{"flash":>10}')
+    print_table('By category', by_ram(report['categories']))
+    print_table('By library', by_ram(report['libraries']))
+    print_table('Task stacks', [(task, {RAM: size}) for task, size in
+                              sorted(report['tasks'].items(), key=lambda t: t[1], reverse=True)],
+              (RAM,))
+    print_table(f'Largest {top} in RAM', by_ram(report['symbols'])[:top])
+    by_flash = sorted(report['symbols'].items(), key=lambda item: item[1][FLASH], reverse=True)
+    print_table(f'Largest {top} in flash', by_flash[:top])
+
+
+def print_diff(report, baseline, top):
+    def deltas(table, base_table):
+        rows = []
+        for key in set(table) | set(base_table):
+            sizes = table.get(key, {})
+            base = base_table.get(key, {})
+            delta = {r: sizes.get(r, 0) - base.get(r, 0) for r in REGIONS}
+            if any(delta.values()):
+                rows.append((key, delta))
+        return sorted(rows, key=lambda row: abs(row[1][RAM]) + abs(row[1][FLASH]), reverse=True)
+
+    print('\nChange from baseline:')
+    for region in REGIONS:
+        delta = report['total'][region] - baseline['total'][region]
+        print(f'    {region:<6}{delta:>+10} bytes')
+
+    print_table('By category', deltas(report['categories'], baseline['categories']), sign='+')
+    print_table('By library', deltas(report['libraries'], baseline['libraries']), sign='+')
+    tasks = {t: {RAM: s} for t, s in report['tasks'].items()}
+    base_tasks = {t: {RAM: s} for t, s in baseline['tasks'].items()}
+    print_table('Task stacks', deltas(tasks, base_tasks), (RAM,), '+')
+    rows = deltas(report['symbols'], baseline['symbols'])
+    print_table(f'Symbols ({len(rows)} changed, largest {top})', rows[:top], sign='+')
+
+
+def check_budget(report, budget):
+    '''Returns the list of budgets exceeded'''
+    exceeded = []
+    for key, limit in budget.items():
+        limit = parse_size(limit)
+        if key in REGIONS:
+            used = report['total'][key]
+        else:
+            used = report['categories'].get(key, {}).get(RAM, 0)
+        if used > limit:
+            exceeded.append(f'{key} uses {used} bytes, {used - limit} over its budget of {limit}')
+    return exceeded
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Reports the memory used by an arm build')
+    parser.add_argument('binary', help='linked ELF, e.g. build/arm/bin/projects/bms_carrier')
+    parser.add_argument('--map', help='linker map, defaults to <binary>.map')
+    parser.add_argument('--config', help='config.json with the project\'s mem_budget')
+    parser.add_argument('--save', help='write the report as JSON, to diff against later')
+    parser.add_argument('--baseline', help='JSON report to diff against')
+    parser.add_argument('--check', action='store_true', help='only check the budget')
+    parser.add_argument('--top', type=int, default=10, help='number of symbols to list')
+    args = parser.parse_args()
+
+    report = build_report(MapFile(args.map or args.binary + '.map'))
+
+    if not args.check:
+        print(f'Memory report for {args.binary}\n')
+        print_report(report, args.top)
+        if args.baseline:
+            with open(args.baseline) as f:
+                print_diff(report, json.load(f), args.top)
+    if args.save:
+        with open(args.save, 'w') as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+
+    budget = {}
+    if args.config and os.path.exists(args.config):
+        with open(args.config) as f:
+            budget = json.load(f).get('mem_budget', {})
+    exceeded = check_budget(report, budget)
+    for message in exceeded:
+        print(f'{args.binary}: {message}', file=sys.stderr)
+    return 1 if exceeded else 0
+
 
-# Path to main project binary file
-path_to_binary = sys.argv[1]
-
-##########################################################                
-# Size Info For Main Binary              
-##########################################################
-
-print('Size Info For Main Binary' + '(' + path_to_binary + '):\n')
-
-stream = os.popen('size ' + path_to_binary)
-size_info = stream.read().rstrip()
-print(size_info)
-
-########################################################## 
-# Size Info For Libraries With Top 5 Size Usage 
-##########################################################
-
-if (os.path.isdir('build/arm/bin/libraries')):
-  stream = os.popen('size build/arm/bin/libraries/*')
-  size_info = stream.readlines()
-
-  # remove the first element (columns)
-  columns = size_info[0]
-  size_info.pop(0)
-
-  size_info_list = []
-  for size in size_info:
-      size_info_list.append(size.split(None, 5))
-
-  # sorts by the 'dec' and 'bss' columns
-  size_info_dec = sorted(size_info_list, key = lambda x: int(x[3]), reverse=True)
-  size_info_bss = sorted(size_info_list, key = lambda x: int(x[2]), reverse=True)
-
-  print("\n\nSize Info for Top 5 Libraries with the Greatest Total Size('dec'):\n")
-  for i in range (0,5):
-    size_info_dec[i][5] = size_info_dec[i][5].strip()
-    print("\t".join(size_info_dec[i]))
-    
-  print("\n\nSize Info for Libraries with the Greatest Block Starting Symbol('bss'):\n")
-  for i in range (0,5):
-    size_info_bss[i][5] = size_info_bss[i][5].strip()
-    print("\t".join(size_info_bss[i]))
-else:
-  print("\n\nNo libaries info found")
-  
-##########################################################
-# Display all bss objects with size >= 512  
-##########################################################
-
-def split_str(line):
-  return line.split()
-
-bss_data = []
-
-with open('build/out.map') as file:
-  rows = map(split_str, file)
-  for row in rows:
-    if (len(row) != 0 and row[0].startswith(".bss.")):
-      if (len(row) != 1):
-        bss_data.append(row)
-      else:
-        row.extend(next(rows))
-        bss_data.append(row)
-      
-if (len(bss_data) != 0):
-  # sorts bss_data by size of the object 
-  def order_by_size(data):
-    return int(data[2], 16)
-
-  sorted_bss_data = sorted(bss_data, key=order_by_size, reverse=True)
-
-  print('\n\nBSS Object info with Greatest Total Size (>= 512 bytes):\n')
-  for row in sorted_bss_data:
-    size = row[2] = int(row[2], 16)
-    if (size >= 512):
-      print(row[0] + '\n')
-      print('\t\t\t\t' + row[1] + '      ' + str(row[2]) + ' ' + row[3] + '\n')
-      
-else:
-  print("\nNo BSS data found\n")
+if __name__ == '__main__':
+    sys.exit(main())
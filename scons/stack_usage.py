@@ -0,0 +1,523 @@
+'''Worst-case stack depth of every task in a build.
+
+Frame sizes come from the .su files gcc writes with -fstack-usage, and the call graph from the
+disassembly of the linked binary. Functions without a .su file, e.g. newlib's printf, are sized from
+their prologue. Each task's depth is its deepest path from the task function, plus what an
+interrupt and a context switch push onto the task's stack.
+
+Calls through function pointers, e.g. FSM states and callbacks, may reach any function whose address
+is taken in the binary, other than task functions and interrupt handlers. That overestimates, but
+never misses a path.
+
+Only tasks the binary starts are reported: a TASK() counts once a function reachable from main(), or
+from a task already counted, passes it to tasks_init_task(). FreeRTOS' idle task is always counted,
+and its timer task only if configUSE_TIMERS is set in FreeRTOSConfig.h.
+
+Usage:
+    python3 scons/stack_usage.py build/arm/bin/projects/bms_carrier --su-dir build/arm/obj
+        [--fix projects/bms_carrier] [--margin 10] [--config libraries/ms-freertos/inc/FreeRTOSConfig.h]
+
+--fix rewrites the TASK_STACK_* constant of each TASK(), FSM() and FSM_EXECUTOR() under the given
+directory to the smallest one that fits.
+'''
+import argparse
+import bisect
+import os
+import re
+import subprocess
+import sys
+
+# Stack sizes in tasks.h, in words
+TASK_STACK_CONSTANTS = [256, 512, 1024, 2048, 4096]
+
+TASK_FUNC_PREFIX = '_prv_task_impl_'
+TASK_STACK_PREFIX = '_s_stack_'
+# tasks.c runs every task function from its own prv_task()
+TASK_WRAPPER = ('tasks.c', 'prv_task')
+# Address-taken functions which the scheduler, interrupts or the x86 host threads run, rather than
+# a task through a function pointer
+ENTRY_FILES = ('port.c', 'port_coroutine.c', 'x86_interrupt.c', 'x86_cosim.c')
+ENTRY_FUNCTIONS = ('main', 'prv_task', 'prv_cosim_input')
+# Starts the task given by its Task pointer
+TASK_INIT = 'tasks_init_task'
+# FreeRTOS' own tasks, by their function, stack and the config option which creates them, if any
+KERNEL_TASKS = {
+    'IDLE': ('prvIdleTask', 'uxIdleTaskStack', None),
+    'Tmr Svc': ('prvTimerTask', 'uxTimerTaskStack', 'configUSE_TIMERS'),
+}
+DEFAULT_CONFIG = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'libraries',
+                              'ms-freertos', 'inc', 'FreeRTOSConfig.h')
+
+ARCHS = {
+    # e_machine in the ELF header
+    40: {
+        'name': 'arm',
+        'prefix': 'arm-none-eabi-',
+        'word': 4,
+        # An interrupt stacks r0-r3, r12, lr, pc and xPSR on the task's stack, aligned to 8 bytes,
+        # and PendSV saves r4-r11 there to switch tasks. Handlers themselves run on the main stack.
+        'overhead': 8 * 4 + 4 + 8 * 4,
+    },
+    62: {
+        'name': 'x86',
+        'prefix': '',
+        'word': 8,
+        # Signal frames for the interrupt model depend on the host, so only code is counted
+        'overhead': 0,
+    },
+}
+
+# configCHECK_FOR_STACK_OVERFLOW 2 checks the last 16 bytes are never written
+OVERFLOW_CHECK_BYTES = 16
+
+FUNC_HEADER = re.compile(r'^([0-9a-f]+) <(.+)>:$')
+INSTRUCTION = re.compile(r'^\s+([0-9a-f]+):\s+(\S+)\s*(.*)$')
+TARGET = re.compile(r'\b([0-9a-f]+) <([^+>]+)>')
+
+
+class Function:
+    def __init__(self, address, name):
+        self.address = address
+        self.name = name
+        self.file = None
+        self.frame = None
+        # How the frame size was found: su, prologue or None if unknown
+        self.source = None
+        self.dynamic = False
+        self.calls = set()
+        # Addresses the function loads, e.g. a task's Task pointer
+        self.refs = set()
+        self.indirect = False
+        self.prologue = []
+
+    def label(self):
+        return f'{self.name}({self.frame if self.frame is not None else "?"})'
+
+
+def run(args):
+    return subprocess.run(args, check=True, capture_output=True, text=True).stdout
+
+
+def elf_arch(path):
+    with open(path, 'rb') as f:
+        header = f.read(20)
+    if header[:4] != b'\x7fELF':
+        sys.exit(f'{path} is not an ELF file')
+    machine = int.from_bytes(header[18:20], 'little')
+    if machine not in ARCHS:
+        sys.exit(f'{path}: unsupported machine {machine}')
+    return ARCHS[machine]
+
+
+def load_su(su_dir):
+    '''Frame sizes by (source file name, function) from every .su file under su_dir'''
+    frames = {}
+    for root, _, files in os.walk(su_dir):
+        for name in files:
+            if not name.endswith('.su'):
+                continue
+            with open(os.path.join(root, name)) as f:
+                for line in f:
+                    # can.c:22:1:_prv_task_impl_CAN_RX	48	static
+                    fields = line.rstrip('\n').split('\t')
+                    if len(fields) != 3:
+                        continue
+                    location, size, qualifier = fields
+                    parts = location.rsplit(':', 3)
+                    if len(parts) != 4:
+                        continue
+                    key = (os.path.basename(parts[0]), parts[3])
+                    frames[key] = (int(size), qualifier != 'static' and 'bounded' not in qualifier)
+    return frames
+
+
+def load_config(path):
+    '''Numeric #defines in FreeRTOSConfig.h'''
+    config = {}
+    with open(path) as f:
+        for line in f:
+            match = re.match(r'^\s*#define\s+(config\w+)\s+\(?(\d+)', line)
+            if match:
+                config[match.group(1)] = int(match.group(2))
+    return config
+
+
+def load_symbols(arch, elf):
+    '''Source file of each function, and the size and address of every data symbol, from nm'''
+    files = {}
+    sizes = {}
+    addresses = {}
+    for line in run([arch['prefix'] + 'nm', '-l', '-S', '--defined-only', elf]).splitlines():
+        # 080001a5 00000030 t prv_foo	/path/foo.c:12
+        match = re.match(r'^([0-9a-f]+)\s+([0-9a-f]+\s+)?(\w)\s+(\S+)(?:\t(.+):\d+)?$', line)
+        if not match:
+            continue
+        address, size, kind, name, path = match.groups()
+        name = re.sub(r'\.\d+$', '', name)
+        if kind in 'tTwW' and path:
+            # Thumb function symbols have the low bit set
+            thumb_bit = 1 if arch['name'] == 'arm' else 0
+            files[int(address, 16) & ~thumb_bit] = os.path.basename(path)
+        if size:
+            sizes[name] = int(size, 16)
+        if kind not in 'tTwW':
+            addresses[name] = int(address, 16)
+    return files, sizes, addresses
+
+
+def prologue_frame(arch, instructions):
+    '''Frame size from the pushes and stack adjustments at the start of a function'''
+    frame = 8 if arch['name'] == 'x86' else 0  # return address
+    found = False
+    for mnemonic, operands in instructions:
+        if arch['name'] == 'arm':
+            if mnemonic in ('push', 'push.w', 'stmdb', 'stmdb.w', 'vpush') and \
+                    (mnemonic.startswith('push') or mnemonic == 'vpush' or 'sp!' in operands):
+                registers = re.search(r'\{(.*)\}', operands)
+                if registers:
+                    count = 0
+                    for reg in registers.group(1).split(','):
+                        span = re.match(r'\s*[rds](\d+)-[rds](\d+)', reg)
+                        count += int(span.group(2)) - int(span.group(1)) + 1 if span else 1
+                    frame += count * (8 if mnemonic == 'vpush' and 'd' in operands else 4)
+                    found = True
+                continue
+            adjust = re.match(r'sp,\s*(?:sp,\s*)?#(\d+)', operands)
+            if mnemonic in ('sub', 'sub.w', 'subw') and adjust:
+                frame += int(adjust.group(1))
+                found = True
+        else:
+            if mnemonic == 'push':
+                frame += 8
+                found = True
+                continue
+            adjust = re.match(r'\$0x([0-9a-f]+),%rsp', operands)
+            if mnemonic == 'sub' and adjust:
+                frame += int(adjust.group(1), 16)
+                found = True
+    return frame, found
+
+
+def load_functions(arch, elf):
+    '''Functions by address, with the calls each one makes'''
+    functions = {}
+    address_taken = set()
+    current = None
+    for line in run([arch['prefix'] + 'objdump', '-d', '--no-show-raw-insn', elf]).splitlines():
+        header = FUNC_HEADER.match(line)
+        if header:
+            address = int(header.group(1), 16)
+            current = functions.setdefault(address, Function(address, header.group(2)))
+            continue
+        instruction = INSTRUCTION.match(line)
+        if not instruction or current is None:
+            continue
+        mnemonic, operands = instruction.group(2), instruction.group(3)
+        if len(current.prologue) < 8:
+            current.prologue.append((mnemonic, operands))
+        target = TARGET.search(operands)
+
+        if arch['name'] == 'arm':
+            direct = mnemonic in ('bl', 'blx') and target
+            indirect = mnemonic == 'blx' and not target
+            # A branch to the start of another function is a tail call
+            tail = mnemonic in ('b', 'b.w', 'b.n') and target
+        else:
+            direct = mnemonic.startswith('call') and target and '*' not in operands
+            indirect = mnemonic.startswith('call') and '*' in operands
+            tail = mnemonic.startswith('jmp') and target and '*' not in operands
+            # Position independent code takes a function's address with lea
+            if mnemonic.startswith('lea') and target:
+                address_taken.add(int(target.group(1), 16))
+
+        if (direct or tail) and int(target.group(1), 16) != current.address:
+            current.calls.add(int(target.group(1), 16))
+        elif target:
+            current.refs.add(int(target.group(1), 16))
+        if indirect:
+            current.indirect = True
+    # Tail branches within a function are just jumps
+    for function in functions.values():
+        function.calls = {call for call in function.calls if call in functions}
+    return functions, address_taken
+
+
+def load_words(arch, elf, sections):
+    '''Address and value of every word in the given sections, for arm'''
+    words = []
+    args = [arch['prefix'] + 'objdump', '-s']
+    for section in sections:
+        args += ['-j', section]
+    dump = subprocess.run(args + [elf], capture_output=True, text=True).stdout
+    for line in dump.splitlines():
+        # " 8000100 a5010008 00000000 ..."
+        match = re.match(r'^ ([0-9a-f]+) ((?:[0-9a-f]{8} ?){1,4})', line)
+        if not match:
+            continue
+        for i, word in enumerate(match.group(2).split()):
+            words.append((int(match.group(1), 16) + 4 * i,
+                          int.from_bytes(bytes.fromhex(word), 'little')))
+    return words
+
+
+def load_literal_refs(arch, elf, functions):
+    '''On arm, a function loads addresses from the literal pool after its code'''
+    if arch['name'] != 'arm':
+        return
+    starts = sorted(functions)
+    for address, value in load_words(arch, elf, ['.text']):
+        index = bisect.bisect_right(starts, address) - 1
+        if index >= 0:
+            functions[starts[index]].refs.add(value)
+
+
+def load_address_taken(arch, elf, functions):
+    '''Functions whose address is stored in data or a literal pool, so may be called indirectly'''
+    taken = set()
+    if arch['name'] == 'x86':
+        # Pointers in data are filled in by relative relocations in a position independent binary
+        for line in run(['objdump', '-R', elf]).splitlines():
+            match = re.search(r'R_X86_64_RELATIVE\s+\*ABS\*\+0x([0-9a-f]+)', line)
+            if match:
+                taken.add(int(match.group(1), 16))
+        return taken
+
+    for _, value in load_words(arch, elf, ['.text', '.data', '.rodata']):
+        # Thumb function pointers have the low bit set
+        if value & 1 and (value & ~1) in functions:
+            taken.add(value & ~1)
+    return taken
+
+
+def is_entry(function):
+    return function.name.endswith('_Handler') or function.name in ENTRY_FUNCTIONS or \
+        function.file in ENTRY_FILES
+
+
+class StackGraph:
+    def __init__(self, arch, functions, indirect_targets):
+        self.arch = arch
+        self.functions = functions
+        self.indirect_targets = indirect_targets
+        self.depths = {}
+        self.next = {}
+        self.recursive = set()
+        self.unknown = set()
+        self.unbounded = set()
+        self.indirect = set()
+
+    def callees(self, function):
+        callees = set(function.calls)
+        if function.indirect:
+            self.indirect.add(function.name)
+            callees |= self.indirect_targets
+        return callees
+
+    def depth(self, address, active=None):
+        '''Deepest stack below and including the function at address'''
+        if address in self.depths:
+            return self.depths[address]
+        active = active or set()
+        function = self.functions[address]
+        if function.frame is None:
+            self.unknown.add(function.name)
+        if function.dynamic:
+            self.unbounded.add(function.name)
+
+        active.add(address)
+        deepest, deepest_callee = 0, None
+        for callee in self.callees(function):
+            if callee in active:
+                # Recursion is only counted once round
+                self.recursive.add(self.functions[callee].name)
+                continue
+            callee_depth = self.depth(callee, active)
+            if callee_depth > deepest:
+                deepest, deepest_callee = callee_depth, callee
+        active.discard(address)
+
+        self.depths[address] = (function.frame or 0) + deepest
+        self.next[address] = deepest_callee
+        return self.depths[address]
+
+    def path(self, address):
+        path = []
+        while address is not None:
+            path.append(self.functions[address])
+            address = self.next.get(address)
+        return path
+
+
+def find_tasks(functions, sizes, config):
+    '''Each task's entry function and stack size in bytes'''
+    by_name = {}
+    for function in functions.values():
+        by_name.setdefault(function.name, function)
+    tasks = {}
+    for name, size in sizes.items():
+        if name.startswith(TASK_STACK_PREFIX):
+            task = name[len(TASK_STACK_PREFIX):]
+            entry = by_name.get(TASK_FUNC_PREFIX + task)
+            if entry:
+                tasks[task] = (entry, size, True)
+    for task, (func, stack, option) in KERNEL_TASKS.items():
+        if option is not None and not config.get(option):
+            continue
+        if func not in by_name or stack not in sizes:
+            print(f'{task}: no {func} or {stack} in the binary', file=sys.stderr)
+            continue
+        tasks[task] = (by_name[func], sizes[stack], False)
+    return tasks
+
+
+def find_started(graph, tasks, addresses):
+    '''TASK()s passed to tasks_init_task() by a function reachable from main() or a started task'''
+    init = {address for address, f in graph.functions.items() if f.name == TASK_INIT}
+    pending = [address for address, f in graph.functions.items() if f.name == 'main']
+    reached = set(pending)
+    started = {task for task, (_, _, wrapped) in tasks.items() if not wrapped}
+    while pending:
+        function = graph.functions[pending.pop()]
+        callees = graph.callees(function)
+        entries = []
+        if callees & init:
+            entries = [entry.address for task, (entry, _, _) in tasks.items()
+                       if task not in started and addresses.get(task) in function.refs]
+            started |= {task for task, (entry, _, _) in tasks.items() if entry.address in entries}
+        for callee in callees | set(entries):
+            if callee not in reached:
+                reached.add(callee)
+                pending.append(callee)
+    return started
+
+
+def recommend(words):
+    for constant in TASK_STACK_CONSTANTS:
+        if words <= constant:
+            return f'TASK_STACK_{constant}'
+    return None
+
+
+def fix_sources(directory, recommendations):
+    '''Rewrites the stack size of TASK(), FSM() and FSM_EXECUTOR() for tasks under directory'''
+    pattern = re.compile(r'\b(TASK|FSM|FSM_EXECUTOR)\((\w+),(\s*(?:\w+,\s*)?)TASK_STACK_(\d+)\)')
+    for root, _, files in os.walk(directory):
+        for name in files:
+            if not name.endswith('.c'):
+                continue
+            path = os.path.join(root, name)
+            with open(path) as f:
+                source = f.read()
+
+            def replace(match):
+                constant = recommendations.get(match.group(2))
+                if constant is None or constant == f'TASK_STACK_{match.group(4)}':
+                    return match.group(0)
+                print(f'{path}: {match.group(2)} TASK_STACK_{match.group(4)} -> {constant}')
+                return f'{match.group(1)}({match.group(2)},{match.group(3)}{constant})'
+
+            fixed = pattern.sub(replace, source)
+            if fixed != source:
+                with open(path, 'w') as f:
+                    f.write(fixed)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Reports the worst-case stack depth of each task')
+    parser.add_argument('binary', help='linked ELF, e.g. build/arm/bin/projects/bms_carrier')
+    parser.add_argument('--su-dir', action='append', default=[],
+                        help='directory with the .su files from -fstack-usage')
+    parser.add_argument('--margin', type=int, default=0,
+                        help='percent to add to the worst case before picking a stack size')
+    parser.add_argument('--fix', help='set the stack sizes of the tasks under this directory')
+    parser.add_argument('--config', default=DEFAULT_CONFIG,
+                        help='FreeRTOSConfig.h, for the kernel tasks the binary creates')
+    args = parser.parse_args()
+    # Depth first through the call graph
+    sys.setrecursionlimit(10000)
+
+    arch = elf_arch(args.binary)
+    frames = {}
+    for su_dir in args.su_dir:
+        frames.update(load_su(su_dir))
+    files, sizes, addresses = load_symbols(arch, args.binary)
+    functions, lea_taken = load_functions(arch, args.binary)
+    load_literal_refs(arch, args.binary, functions)
+    address_taken = lea_taken | load_address_taken(arch, args.binary, functions)
+
+    for function in functions.values():
+        function.file = files.get(function.address)
+        su = frames.get((function.file, function.name))
+        if su is not None:
+            function.frame, function.dynamic = su
+            function.source = 'su'
+            continue
+        frame, found = prologue_frame(arch, function.prologue)
+        if found or not function.name.endswith('@plt'):
+            function.frame, function.source = frame, 'prologue'
+
+    tasks = find_tasks(functions, sizes, load_config(args.config))
+    entries = {entry.address for entry, _, _ in tasks.values()}
+    indirect_targets = {address for address in address_taken if address in functions and
+                        address not in entries and not is_entry(functions[address])}
+    graph = StackGraph(arch, functions, indirect_targets)
+    started = find_started(graph, tasks, addresses)
+    unstarted = sorted(task for task in tasks if task not in started)
+    tasks = {task: info for task, info in tasks.items() if task in started}
+
+    wrapper = next((f for f in functions.values() if (f.file, f.name) == TASK_WRAPPER), None)
+    word = arch['word']
+    overhead = arch['overhead'] + OVERFLOW_CHECK_BYTES
+    print(f'Worst-case stack per task ({arch["name"]}, {overhead} bytes for interrupts, '
+          f'context switches and the overflow check)\n')
+    print(f'{"task":<28}{"stack":>8}{"worst":>8}{"free":>8}  recommended')
+
+    recommendations = {}
+    undersized = []
+    for task, (entry, stack_bytes, wrapped) in sorted(tasks.items()):
+        depth = graph.depth(entry.address)
+        path = graph.path(entry.address)
+        if wrapped and wrapper is not None:
+            # prv_task calls the task function, and logs around it
+            around = max([graph.depth(call) for call in wrapper.calls], default=0)
+            depth = max(depth, around) + (wrapper.frame or 0)
+            path = [wrapper] + path
+        worst = depth + overhead
+        needed_words = -(-worst * (100 + args.margin) // 100 // word)
+        constant = recommend(needed_words)
+        if wrapped and constant:
+            recommendations[task] = constant
+        free = stack_bytes - worst
+        if free < 0:
+            undersized.append(task)
+        print(f'{task:<28}{stack_bytes:>8}{worst:>8}{free:>8}  '
+              f'{constant or "over " + str(TASK_STACK_CONSTANTS[-1])} ({needed_words} words)')
+        print(f'    {" > ".join(f.label() for f in path)}')
+
+    if unstarted:
+        print(f'\nDefined but never started, not counted: {", ".join(unstarted)}')
+    if graph.unbounded:
+        print(f'\nDynamic stack frames, not bounded: {", ".join(sorted(graph.unbounded))}')
+    if graph.recursive:
+        print(f'\nRecursive, counted once: {", ".join(sorted(graph.recursive))}')
+    if graph.unknown:
+        print(f'\nUnknown frame sizes, counted as 0: {", ".join(sorted(graph.unknown))}')
+    estimated = sorted({f.name for f in functions.values() if f.source == 'prologue' and
+                        f.address in graph.depths})
+    if estimated:
+        print(f'\nSized from their prologue, no .su file: {len(estimated)} functions')
+    if graph.indirect:
+        print(f'\nIndirect calls, may reach any of {len(indirect_targets)} address-taken '
+              f'functions: {", ".join(sorted(graph.indirect))}')
+
+    if args.fix:
+        print()
+        fix_sources(args.fix, recommendations)
+    elif undersized:
+        print(f'\nStacks smaller than their worst case: {", ".join(undersized)}', file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
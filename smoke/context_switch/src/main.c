@@ -0,0 +1,94 @@
+#include <stdint.h>
+
+#include "delay.h"
+#include "log.h"
+#include "tasks.h"
+#include "timestamp.h"
+
+// Notifications exchanged, and yields by each task, per measurement
+#define NUM_ROUNDS 20000
+
+DECLARE_TASK(ping_task);
+DECLARE_TASK(pong_task);
+DECLARE_TASK(bench_task);
+
+static void prv_wait(void) {
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+TASK(ping_task, TASK_STACK_512) {
+  while (true) {
+    prv_wait();
+    for (uint32_t i = 0; i < NUM_ROUNDS; ++i) {
+      xTaskNotifyGive(pong_task->handle);
+      prv_wait();
+    }
+    xTaskNotifyGive(bench_task->handle);
+  }
+}
+
+TASK(pong_task, TASK_STACK_512) {
+  while (true) {
+    prv_wait();
+    xTaskNotifyGive(ping_task->handle);
+  }
+}
+
+static void prv_yield_loop(void) {
+  while (true) {
+    prv_wait();
+    for (uint32_t i = 0; i < NUM_ROUNDS; ++i) {
+      taskYIELD();
+    }
+    xTaskNotifyGive(bench_task->handle);
+  }
+}
+
+TASK(yield_a_task, TASK_STACK_512) {
+  prv_yield_loop();
+}
+
+TASK(yield_b_task, TASK_STACK_512) {
+  prv_yield_loop();
+}
+
+static void prv_log_result(const char *name, uint64_t elapsed_us) {
+  // Two switches per round
+  LOG_DEBUG("%s: %u switches in %u us, %u ns per switch\n", name, (unsigned)(2 * NUM_ROUNDS),
+            (unsigned)elapsed_us, (unsigned)(elapsed_us * 1000 / (2 * NUM_ROUNDS)));
+}
+
+TASK(bench_task, TASK_STACK_512) {
+  while (true) {
+    // Blocking: ping and pong each block on a notification until the other sends it
+    uint64_t start_us = timestamp_us();
+    xTaskNotifyGive(ping_task->handle);
+    prv_wait();
+    prv_log_result("notify", timestamp_us() - start_us);
+
+    // Yielding: both tasks are always ready, and take turns
+    start_us = timestamp_us();
+    xTaskNotifyGive(yield_a_task->handle);
+    xTaskNotifyGive(yield_b_task->handle);
+    prv_wait();
+    prv_wait();
+    prv_log_result("yield", timestamp_us() - start_us);
+
+    delay_ms(1000);
+  }
+}
+
+int main() {
+  tasks_init();
+  log_init();
+
+  tasks_init_task(ping_task, TASK_PRIORITY(1), NULL);
+  tasks_init_task(pong_task, TASK_PRIORITY(1), NULL);
+  tasks_init_task(yield_a_task, TASK_PRIORITY(1), NULL);
+  tasks_init_task(yield_b_task, TASK_PRIORITY(1), NULL);
+  tasks_init_task(bench_task, TASK_PRIORITY(2), NULL);
+
+  tasks_start();
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "delay.h"
+#include "log.h"
+#include "mem_pool.h"
+#include "queue.h"
+#include "tasks.h"
+#include "timestamp.h"
+
+// Buffers handed from the producer to the consumer per measurement
+#define NUM_BUFFERS 20000
+#define QUEUE_DEPTH 16
+#define MAX_BUFFER_BYTES 256
+
+typedef enum {
+  HANDOFF_COPY = 0,  // Buffers are copied into and out of the queue
+  HANDOFF_POOL,      // Buffers come from a pool, the queue carries pointers
+  NUM_HANDOFFS,
+} Handoff;
+
+static const char *s_handoff_names[NUM_HANDOFFS] = { "queue copy", "pool pointer" };
+static const size_t s_sizes[] = { 8, 64, MAX_BUFFER_BYTES };
+#define NUM_SIZES (sizeof(s_sizes) / sizeof(s_sizes[0]))
+
+// Every queued buffer, plus the one each task holds
+MEM_POOL_DEFINE(s_buffer_pool, MAX_BUFFER_BYTES, QUEUE_DEPTH + 2);
+
+static StaticQueue_t s_copy_queues[NUM_SIZES];
+static uint8_t s_copy_storage[NUM_SIZES][QUEUE_DEPTH * MAX_BUFFER_BYTES];
+static QueueHandle_t s_copy_handles[NUM_SIZES];
+
+static StaticQueue_t s_pointer_queue;
+static uint8_t s_pointer_storage[QUEUE_DEPTH * sizeof(uint8_t *)];
+static QueueHandle_t s_pointer_handle;
+
+static Handoff s_handoff;
+static uint8_t s_size_index;
+static volatile uint32_t s_checksum;
+
+DECLARE_TASK(producer_task);
+DECLARE_TASK(consumer_task);
+DECLARE_TASK(bench_task);
+
+static void prv_wait(void) {
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+TASK(producer_task, TASK_STACK_1024) {
+  uint8_t buffer[MAX_BUFFER_BYTES];
+  while (true) {
+    prv_wait();
+    size_t size = s_sizes[s_size_index];
+    for (uint32_t i = 0; i < NUM_BUFFERS; ++i) {
+      if (s_handoff == HANDOFF_COPY) {
+        memset(buffer, (int)i, size);
+        xQueueSend(s_copy_handles[s_size_index], buffer, portMAX_DELAY);
+      } else {
+        uint8_t *block;
+        while ((block = mem_pool_alloc(&s_buffer_pool)) == NULL) {
+          taskYIELD();
+        }
+        memset(block, (int)i, size);
+        xQueueSend(s_pointer_handle, &block, portMAX_DELAY);
+      }
+    }
+  }
+}
+
+TASK(consumer_task, TASK_STACK_1024) {
+  uint8_t buffer[MAX_BUFFER_BYTES];
+  while (true) {
+    prv_wait();
+    size_t size = s_sizes[s_size_index];
+    uint32_t checksum = 0;
+    for (uint32_t i = 0; i < NUM_BUFFERS; ++i) {
+      if (s_handoff == HANDOFF_COPY) {
+        xQueueReceive(s_copy_handles[s_size_index], buffer, portMAX_DELAY);
+        checksum += buffer[size - 1];
+      } else {
+        uint8_t *block;
+        xQueueReceive(s_pointer_handle, &block, portMAX_DELAY);
+        checksum += block[size - 1];
+        mem_pool_free(&s_buffer_pool, block);
+      }
+    }
+    s_checksum = checksum;
+    xTaskNotifyGive(bench_task->handle);
+  }
+}
+
+TASK(bench_task, TASK_STACK_512) {
+  while (true) {
+    // The pool on its own, without the queue and task switches
+    uint64_t start_us = timestamp_us();
+    for (uint32_t i = 0; i < NUM_BUFFERS; ++i) {
+      mem_pool_free(&s_buffer_pool, mem_pool_alloc(&s_buffer_pool));
+    }
+    LOG_DEBUG("pool alloc and free: %u ns\n",
+              (unsigned)((timestamp_us() - start_us) * 1000 / NUM_BUFFERS));
+
+    // And a queue, copying a pointer in and out
+    uint8_t *block = NULL;
+    start_us = timestamp_us();
+    for (uint32_t i = 0; i < NUM_BUFFERS; ++i) {
+      xQueueSend(s_pointer_handle, &block, 0);
+      xQueueReceive(s_pointer_handle, &block, 0);
+    }
+    LOG_DEBUG("queue send and receive: %u ns\n",
+              (unsigned)((timestamp_us() - start_us) * 1000 / NUM_BUFFERS));
+
+    for (s_size_index = 0; s_size_index < NUM_SIZES; ++s_size_index) {
+      for (s_handoff = 0; s_handoff < NUM_HANDOFFS; ++s_handoff) {
+        start_us = timestamp_us();
+        xTaskNotifyGive(producer_task->handle);
+        xTaskNotifyGive(consumer_task->handle);
+        prv_wait();
+        uint64_t elapsed_us = timestamp_us() - start_us;
+        LOG_DEBUG("%s, %u bytes: %u ns per buffer\n", s_handoff_names[s_handoff],
+                  (unsigned)s_sizes[s_size_index], (unsigned)(elapsed_us * 1000 / NUM_BUFFERS));
+      }
+    }
+    MemStats stats;
+    mem_pool_get_stats(&s_buffer_pool, &stats);
+    LOG_DEBUG("pool: %u of %u blocks at most, %u failed allocations\n",
+              (unsigned)stats.peak_in_use, (unsigned)stats.capacity, (unsigned)stats.failures);
+    delay_ms(1000);
+  }
+}
+
+int main() {
+  tasks_init();
+  log_init();
+
+  for (uint8_t i = 0; i < NUM_SIZES; ++i) {
+    s_copy_handles[i] =
+        xQueueCreateStatic(QUEUE_DEPTH, s_sizes[i], s_copy_storage[i], &s_copy_queues[i]);
+  }
+  s_pointer_handle =
+      xQueueCreateStatic(QUEUE_DEPTH, sizeof(uint8_t *), s_pointer_storage, &s_pointer_queue);
+
+  tasks_init_task(producer_task, TASK_PRIORITY(1), NULL);
+  tasks_init_task(consumer_task, TASK_PRIORITY(1), NULL);
+  tasks_init_task(bench_task, TASK_PRIORITY(2), NULL);
+
+  tasks_start();
+
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "can.h"
+#include "can_time_sync.h"
+#include "gpio.h"
+#include "log.h"
+#include "master_task.h"
+#include "tasks.h"
+#include "timestamp.h"
+
+#ifndef TIME_SYNC_SMOKE_MASTER
+#define TIME_SYNC_SMOKE_MASTER 0
+#endif
+
+static CanStorage s_can_storage = { 0 };
+const CanSettings can_settings = {
+  .device_id = 0,
+  .bitrate = CAN_HW_BITRATE_500KBPS,
+  .tx = { GPIO_PORT_A, 12 },
+  .rx = { GPIO_PORT_A, 11 },
+  .loopback = false,
+};
+
+static bool s_master;
+
+static bool prv_is_master(void) {
+#ifdef MS_PLATFORM_X86
+  return getenv("MIDSUN_TIME_SYNC_MASTER") != NULL;
+#else
+  return TIME_SYNC_SMOKE_MASTER;
+#endif
+}
+
+void run_fast_cycle() {
+  run_can_rx_cycle();
+  wait_tasks(1);
+}
+
+void run_medium_cycle() {
+  if (s_master) {
+    can_time_sync_tx();
+  }
+}
+
+void run_slow_cycle() {
+  if (s_master) {
+    LOG_DEBUG("master: car time %u ms\n", (unsigned)(can_time_us() / 1000));
+    return;
+  }
+
+  CanTimeSyncStats stats = { 0 };
+  can_time_sync_get_stats(&stats);
+  LOG_DEBUG("syncs %u steps %u missed %u | error last %d us max %u us mean %u us\n",
+            (unsigned)stats.num_syncs, (unsigned)stats.num_steps, (unsigned)stats.num_missed,
+            (int)stats.last_error_us, (unsigned)stats.max_error_us,
+            (unsigned)stats.mean_error_us);
+  LOG_DEBUG("drift %d ppb, offset %lli us, local %u ms, car %u ms\n", (int)stats.drift_ppb,
+            (long long)stats.offset_us, (unsigned)(timestamp_us() / 1000),
+            (unsigned)(can_time_us() / 1000));
+}
+
+int main() {
+  tasks_init();
+  log_init();
+  gpio_init();
+
+  can_init(&s_can_storage, &can_settings);
+  s_master = prv_is_master();
+  can_time_sync_set_master(s_master);
+  LOG_DEBUG("CAN time sync smoke test, %s\n", s_master ? "master" : "slave");
+
+  init_master_task();
+  tasks_start();
+
+  LOG_DEBUG("exiting main?\n");
+  return 0;
+}